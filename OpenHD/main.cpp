@@ -14,6 +14,8 @@
 #include "openhd_global_constants.hpp"
 #include "openhd_platform.h"
 #include "openhd_profile.h"
+#include "openhd_config.h"
+#include "openhd_settings_persistent.h"
 #include "openhd_rpi_gpio.hpp"
 #include "openhd_spdlog.h"
 #include "openhd_temporary_air_or_ground.h"
@@ -196,6 +198,8 @@ int main(int argc, char *argv[]) {
   std::cout<<"Version number:"<<openhd::VERSION_NUMBER_STRING<<"\n";
   std::cout<<"Git info:Branch:"<<git_Branch()<<" SHA:"<<git_CommitSHA1()<<"Dirty:"<<OHDUtil::yes_or_no(git_AnyUncommittedChanges())<<"\n";
   openhd::debug_config();
+  openhd::PersistentSettingsWriter::instance().set_write_delay(
+      std::chrono::milliseconds(openhd::load_config().DEV_SETTINGS_WRITE_DELAY_MS));
   OHDInterface::print_internal_fec_optimization_method();
 
   // This is the console we use inside main, in general different openhd modules/classes have their own loggers
@@ -368,6 +372,9 @@ int main(int argc, char *argv[]) {
       ohdInterface.reset();
       m_console->debug("Terminating ohd_interface - end");
     }
+    // Write out the settings that were changed just before terminating
+    openhd::flush_persistent_settings();
+    m_console->debug(openhd::PersistentSettingsWriter::instance().get_stats_string());
   } catch (std::exception &ex) {
     std::cerr << "Error: " << ex.what() << std::endl;
     exit(1);
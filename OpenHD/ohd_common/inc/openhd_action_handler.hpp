@@ -69,6 +69,22 @@ class ActionHandler{
       cb(all_stats);
     }
   }
+ public:
+  // Air only - the ground unit's view of the video link (received via telemetry) for the wb link (ohd_interface)
+  void action_ground_link_feedback_register(const openhd::link_statistics::GROUND_LINK_FEEDBACK_CALLBACK& cb){
+    if(cb== nullptr){
+      m_ground_link_feedback_cb= nullptr;
+      return;
+    }
+    m_ground_link_feedback_cb=std::make_shared<openhd::link_statistics::GROUND_LINK_FEEDBACK_CALLBACK>(cb);
+  }
+  void action_ground_link_feedback_handle(openhd::link_statistics::GroundLinkFeedback feedback){
+    auto tmp=m_ground_link_feedback_cb;
+    if(tmp){
+      auto & cb=*tmp;
+      cb(feedback);
+    }
+  }
  public:
   // checking both 2G and 5G channels takes really long, but in rare cases might be wanted by the user
   // checking both 20Mhz and 40Mhz (instead of only either of them both) also duplicates the scan time
@@ -99,6 +115,7 @@ class ActionHandler{
     action_request_bitrate_change_register(nullptr);
     action_wb_link_statistics_register(nullptr);
     action_wb_link_scan_channels_register(nullptr);
+    action_ground_link_feedback_register(nullptr);
     action_on_ony_rc_channel_register(nullptr);
     m_action_disable_wifi_when_armed= nullptr;
   }
@@ -177,6 +194,7 @@ class ActionHandler{
   std::shared_ptr<ACTION_REQUEST_BITRATE_CHANGE> m_action_request_bitrate_change =nullptr;
   std::shared_ptr<openhd::link_statistics::STATS_CALLBACK> m_link_statistics_callback=nullptr;
   std::shared_ptr<SCAN_CHANNELS_CB> m_scan_channels_cb=nullptr;
+  std::shared_ptr<openhd::link_statistics::GROUND_LINK_FEEDBACK_CALLBACK> m_ground_link_feedback_cb=nullptr;
  private:
   // dirty - bitrate(s)  might be changed at run time, this exists since we write the wb stats in ohd_interface but the value
   // should be whatever the cam is actually doing
@@ -0,0 +1,218 @@
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_BUFFER_POOL_HPP_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_BUFFER_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace openhd{
+
+namespace detail{
+
+// Free list of equally sized memory blocks - the shared_ptr control blocks of the buffers handed out by BufferPool
+// all have the same size.
+class BlockPool{
+ public:
+  explicit BlockPool(size_t max_n_pooled_blocks):m_max_n_pooled_blocks(max_n_pooled_blocks){
+    m_free_blocks.reserve(max_n_pooled_blocks);
+  }
+  BlockPool(const BlockPool&)=delete;
+  BlockPool(BlockPool&&)=delete;
+  ~BlockPool(){
+    for(auto* block:m_free_blocks){
+      ::operator delete(block);
+    }
+  }
+  void* allocate(const size_t size){
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_block_size==0)m_block_size=size;
+      if(size==m_block_size && !m_free_blocks.empty()){
+        void* ret=m_free_blocks.back();
+        m_free_blocks.pop_back();
+        return ret;
+      }
+    }
+    m_n_allocations++;
+    return ::operator new(size);
+  }
+  void deallocate(void* block,const size_t size){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(size==m_block_size && m_free_blocks.size()<m_max_n_pooled_blocks){
+      m_free_blocks.push_back(block);
+      return;
+    }
+    lock.unlock();
+    ::operator delete(block);
+  }
+  [[nodiscard]] uint64_t get_n_allocations()const{
+    return m_n_allocations;
+  }
+ private:
+  const size_t m_max_n_pooled_blocks;
+  std::mutex m_mutex;
+  size_t m_block_size=0;
+  std::vector<void*> m_free_blocks;
+  std::atomic<uint64_t> m_n_allocations=0;
+};
+
+// Allocator for the control block of the shared_ptr (see the shared_ptr(ptr,deleter,allocator) constructor).
+// The control block keeps a copy of the allocator, and with it the BlockPool, alive until it is deallocated.
+template<class T>
+struct PooledAllocator{
+  using value_type=T;
+  explicit PooledAllocator(std::shared_ptr<BlockPool> pool):m_pool(std::move(pool)){}
+  template<class U>
+  PooledAllocator(const PooledAllocator<U>& other):m_pool(other.m_pool){}
+  T* allocate(const size_t n){
+    return static_cast<T*>(m_pool->allocate(n*sizeof(T)));
+  }
+  void deallocate(T* p,const size_t n){
+    m_pool->deallocate(p,n*sizeof(T));
+  }
+  template<class U>
+  bool operator==(const PooledAllocator<U>& other)const{
+    return m_pool==other.m_pool;
+  }
+  template<class U>
+  bool operator!=(const PooledAllocator<U>& other)const{
+    return m_pool!=other.m_pool;
+  }
+  std::shared_ptr<BlockPool> m_pool;
+};
+
+}
+
+/**
+ * Pool of recycled byte buffers, used on the video hot path (gstreamer appsink -> wb link).
+ * The link (wifibroadcast) takes shared_ptr<std::vector<uint8_t>> fragments - we keep that type, but hand out
+ * buffers with a custom deleter that returns the vector to the pool once the last user (e.g. the FEC encoder)
+ * is done with it. The shared_ptr control blocks are recycled as well (pooled allocator).
+ * After warm-up (~ the n of fragments in flight) no heap allocation is needed per fragment anymore.
+ * Thread-safe - buffers are usually acquired by the appsink thread and returned by the link tx thread.
+ * NOTE: Must be created via create(), since returned buffers keep a weak reference to the pool.
+ * If the pool is gone when a buffer is released, the buffer is just freed.
+ */
+class BufferPool : public std::enable_shared_from_this<BufferPool>{
+ public:
+  struct Stats{
+    // total n of buffers handed out
+    uint64_t n_acquired=0;
+    // n of times a recycled buffer could be re-used without a (re)allocation
+    uint64_t n_pool_hits=0;
+    // n of times a new buffer had to be allocated (or a recycled one had to grow)
+    uint64_t n_allocations=0;
+    // n of times a new shared_ptr control block had to be allocated
+    uint64_t n_control_block_allocations=0;
+    // n of buffers returned to the pool
+    uint64_t n_recycled=0;
+    // n of buffers freed on release since the pool was already full
+    uint64_t n_dropped=0;
+    [[nodiscard]] std::string to_string()const{
+      std::stringstream ss;
+      ss<<"BufferPool{acquired:"<<n_acquired<<", hits:"<<n_pool_hits<<", allocs:"<<n_allocations
+         <<", control block allocs:"<<n_control_block_allocations<<", recycled:"<<n_recycled<<", dropped:"<<n_dropped<<"}";
+      return ss.str();
+    }
+  };
+  /**
+   * @param max_n_pooled_buffers upper limit of free buffers kept around, more are freed on release.
+   * @param default_capacity capacity newly allocated buffers are reserved with, should be >= the usual buffer size
+   * (e.g. the rtp mtu) to avoid re-allocations.
+   */
+  static std::shared_ptr<BufferPool> create(size_t max_n_pooled_buffers=1024,size_t default_capacity=1500){
+    return std::shared_ptr<BufferPool>(new BufferPool(max_n_pooled_buffers,default_capacity));
+  }
+  BufferPool(const BufferPool&)=delete;
+  BufferPool(BufferPool&&)=delete;
+  /**
+   * @return a buffer of exactly @param size bytes. Content is not guaranteed to be zeroed
+   * (only bytes that were not part of the buffer during its previous use are).
+   */
+  std::shared_ptr<std::vector<uint8_t>> acquire(const size_t size){
+    std::vector<uint8_t>* buff=nullptr;
+    {
+      std::lock_guard<std::mutex> lock(m_free_buffers_mutex);
+      if(!m_free_buffers.empty()){
+        buff=m_free_buffers.back();
+        m_free_buffers.pop_back();
+      }
+    }
+    m_n_acquired++;
+    if(buff==nullptr){
+      buff=new std::vector<uint8_t>();
+      buff->reserve(std::max(size,m_default_capacity));
+      m_n_allocations++;
+    }else if(buff->capacity()<size){
+      buff->reserve(size);
+      m_n_allocations++;
+    }else{
+      m_n_pool_hits++;
+    }
+    buff->resize(size);
+    std::weak_ptr<BufferPool> weak_pool=weak_from_this();
+    return {buff,[weak_pool](std::vector<uint8_t>* released){
+      auto pool=weak_pool.lock();
+      if(pool){
+        pool->recycle(released);
+      }else{
+        delete released;
+      }
+    },detail::PooledAllocator<std::vector<uint8_t>>(m_control_blocks)};
+  }
+  [[nodiscard]] Stats get_stats()const{
+    Stats ret{};
+    ret.n_acquired=m_n_acquired;
+    ret.n_pool_hits=m_n_pool_hits;
+    ret.n_allocations=m_n_allocations;
+    ret.n_control_block_allocations=m_control_blocks->get_n_allocations();
+    ret.n_recycled=m_n_recycled;
+    ret.n_dropped=m_n_dropped;
+    return ret;
+  }
+  ~BufferPool(){
+    std::lock_guard<std::mutex> lock(m_free_buffers_mutex);
+    for(auto* buff:m_free_buffers){
+      delete buff;
+    }
+    m_free_buffers.clear();
+  }
+ private:
+  explicit BufferPool(size_t max_n_pooled_buffers,size_t default_capacity):
+    m_max_n_pooled_buffers(max_n_pooled_buffers),m_default_capacity(default_capacity),
+    m_control_blocks(std::make_shared<detail::BlockPool>(max_n_pooled_buffers)){
+    m_free_buffers.reserve(max_n_pooled_buffers);
+  }
+  void recycle(std::vector<uint8_t>* buff){
+    std::unique_lock<std::mutex> lock(m_free_buffers_mutex);
+    if(m_free_buffers.size()<m_max_n_pooled_buffers){
+      m_free_buffers.push_back(buff);
+      lock.unlock();
+      m_n_recycled++;
+      return;
+    }
+    lock.unlock();
+    m_n_dropped++;
+    delete buff;
+  }
+  const size_t m_max_n_pooled_buffers;
+  const size_t m_default_capacity;
+  std::mutex m_free_buffers_mutex;
+  std::vector<std::vector<uint8_t>*> m_free_buffers;
+  // Buffers that are still in use when the pool is destroyed keep it alive
+  std::shared_ptr<detail::BlockPool> m_control_blocks;
+  std::atomic<uint64_t> m_n_acquired=0;
+  std::atomic<uint64_t> m_n_pool_hits=0;
+  std::atomic<uint64_t> m_n_allocations=0;
+  std::atomic<uint64_t> m_n_recycled=0;
+  std::atomic<uint64_t> m_n_dropped=0;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_BUFFER_POOL_HPP_
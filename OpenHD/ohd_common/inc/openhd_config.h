@@ -27,6 +27,19 @@ struct Config{
   std::string NW_ETHERNET_CARD=RPI_ETHERNET_ONLY;
   std::vector<std::string> NW_MANUAL_FORWARDING_IPS;
   bool NW_FORWARD_TO_LOCALHOST_58XX=false;
+  // DEV - optional, missing values fall back to the defaults here
+  bool DEV_GST_APPSINK_PUSH_MODE=false;
+  bool DEV_VIDEO_LATENCY_TRACING=false;
+  bool DEV_GST_PIPELINE_BUILDER=false;
+  bool DEV_VIDEO_GROUND_BATCH_FORWARDER=false;
+  bool DEV_WB_ADAPTIVE_LINK_CONTROLLER=false;
+  bool DEV_WIFI_NETLINK_BACKEND=false;
+  bool DEV_TELEMETRY_EPOLL_REACTOR=false;
+  int DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND=0;
+  int DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS=1000;
+  int DEV_SETTINGS_WRITE_DELAY_MS=1000;
+  bool DEV_AIR_RECORDING_FRAGMENTED_MP4=false;
+  int DEV_AIR_RECORDING_PREROLL_S=0;
 };
 
 Config load_config();
@@ -0,0 +1,95 @@
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LATENCY_HISTOGRAM_HPP_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LATENCY_HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "openhd_util_time.hpp"
+
+namespace openhd{
+
+/**
+ * Lock-free latency histogram, cheap enough to be fed from a gstreamer streaming thread / link thread
+ * and read from any other thread (e.g. for debug output or statistics).
+ * Buckets are logarithmic with 4 buckets per power of 2 (microsecond resolution at the low end),
+ * which means percentiles have an error of < ~19% - good enough to compare / attribute latencies.
+ */
+class LatencyHistogram{
+ public:
+  // 2^(N_BUCKETS/4) us ~= 67 seconds upper limit, everything above lands in the last bucket
+  static constexpr int N_BUCKETS=104;
+  void record(const std::chrono::steady_clock::duration& delta){
+    const auto us=std::chrono::duration_cast<std::chrono::microseconds>(delta).count();
+    record_us(us<0 ? 0 : us);
+  }
+  void record_us(const int64_t us){
+    m_buckets[bucket_for_us(us)]++;
+    m_count++;
+    m_sum_us+=us;
+    int64_t curr_max=m_max_us;
+    while(us>curr_max && !m_max_us.compare_exchange_weak(curr_max,us)){}
+  }
+  [[nodiscard]] uint64_t count()const{
+    return m_count;
+  }
+  // @param percentile in range [0,100]
+  // @return an estimate (upper bound of the matching bucket) of the given percentile, 0 if no samples
+  [[nodiscard]] int64_t percentile_us(const double percentile)const{
+    const uint64_t n=m_count;
+    if(n==0)return 0;
+    const auto target=static_cast<uint64_t>(std::ceil(static_cast<double>(n)*percentile/100.0));
+    uint64_t accumulated=0;
+    for(int i=0;i<N_BUCKETS;i++){
+      accumulated+=m_buckets[i];
+      if(accumulated>=target && accumulated>0){
+        // never report more than what we've actually seen
+        return std::min(bucket_upper_bound_us(i),static_cast<int64_t>(m_max_us));
+      }
+    }
+    return m_max_us;
+  }
+  [[nodiscard]] int64_t avg_us()const{
+    const uint64_t n=m_count;
+    if(n==0)return 0;
+    return static_cast<int64_t>(m_sum_us/n);
+  }
+  [[nodiscard]] int64_t max_us()const{
+    return m_max_us;
+  }
+  // Not atomic with regard to concurrent record() calls, which is fine for statistics
+  void reset(){
+    for(auto& bucket:m_buckets)bucket=0;
+    m_count=0;
+    m_sum_us=0;
+    m_max_us=0;
+  }
+  [[nodiscard]] std::string to_string()const{
+    const auto r=[](int64_t us){
+      return openhd::util::time::R(std::chrono::microseconds(us));
+    };
+    return "{n:"+std::to_string(count())+" avg:"+r(avg_us())+" p50:"+r(percentile_us(50))+
+           " p95:"+r(percentile_us(95))+" p99:"+r(percentile_us(99))+" max:"+r(max_us())+"}";
+  }
+ private:
+  static int bucket_for_us(const int64_t us){
+    if(us<=1)return 0;
+    const int idx=static_cast<int>(std::ceil(std::log2(static_cast<double>(us))*4.0));
+    return std::min(idx,N_BUCKETS-1);
+  }
+  static int64_t bucket_upper_bound_us(const int idx){
+    return static_cast<int64_t>(std::floor(std::exp2(static_cast<double>(idx)/4.0)));
+  }
+  std::array<std::atomic<uint64_t>,N_BUCKETS> m_buckets{};
+  std::atomic<uint64_t> m_count=0;
+  std::atomic<uint64_t> m_sum_us=0;
+  std::atomic<int64_t> m_max_us=0;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LATENCY_HISTOGRAM_HPP_
@@ -5,6 +5,7 @@
 #ifndef OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 
+#include <functional>
 #include <string>
 #include <sstream>
 #include <optional>
@@ -23,6 +24,21 @@ static std::string bitrate_to_string(uint64_t bits_per_second){
 }
 
 
+// Only filled if video latency tracing is enabled (see openhd_video_latency_tracer.hpp), 0 otherwise
+struct LatencyPercentilesUs{
+  int32_t p50_us=0;
+  int32_t p95_us=0;
+  int32_t p99_us=0;
+  [[nodiscard]] std::string to_string()const{
+    std::stringstream ss;
+    ss<<"{p50:"<<p50_us<<"us, p95:"<<p95_us<<"us, p99:"<<p99_us<<"us}";
+    return ss.str();
+  }
+  [[nodiscard]] bool is_empty()const{
+    return p50_us==0 && p95_us==0 && p99_us==0;
+  }
+};
+
 // These structs match the custom openhd mavlink messages, kinda annoying but
 // we do not have a mavlink dependency in ohd_interface so we need to duplicate that code
 
@@ -77,6 +93,10 @@ struct StatsWBVideoAir{
   uint16_t curr_fec_block_size_max;
   int32_t curr_wb_mcs_index; // unused0 in mavlink message
   int32_t unused1; // unused1 in mavlink message
+  // not in the openhd stats message, air_total is sent separately (see LinkStatisticsHelper::pack_latency)
+  LatencyPercentilesUs curr_latency_appsink_to_frame_close{};
+  LatencyPercentilesUs curr_latency_frame_close_to_enqueue{};
+  LatencyPercentilesUs curr_latency_air_total{};
   [[nodiscard]] std::string to_string()const{
     return "TODO";
   }
@@ -94,6 +114,8 @@ struct StatsWBVideoGround{
   uint32_t curr_fec_decode_time_max_us;
   int32_t unused0;
   int32_t unused1;
+  // not in the openhd stats message, sent separately (see LinkStatisticsHelper::pack_latency)
+  LatencyPercentilesUs curr_latency_receive_to_forward{};
   [[nodiscard]] std::string to_string()const{
     return "TODO";
   }
@@ -114,6 +136,24 @@ struct StatsPerCard{
 // Stats per connected card
 using StatsAllCards=std::array<StatsPerCard,4>;
 
+// Video link quality as seen by the ground unit, sent back to the air unit (if the adaptive link controller is enabled)
+// such that it can adjust the link. Counters are cumulative, like in StatsWBVideoGround.
+struct GroundLinkFeedback{
+  uint8_t link_index=0;
+  uint64_t count_blocks_total=0;
+  uint64_t count_blocks_lost=0;
+  uint64_t count_blocks_recovered=0;
+  // best rssi of all ground rx card(s)
+  int8_t best_rx_rssi=INT8_MIN;
+  [[nodiscard]] std::string to_string()const{
+    std::stringstream ss;
+    ss<<"GroundLinkFeedback{link:"<<(int)link_index<<", blocks total:"<<count_blocks_total<<" lost:"<<count_blocks_lost
+       <<" recovered:"<<count_blocks_recovered<<", rssi:"<<(int)best_rx_rssi<<"}";
+    return ss.str();
+  }
+};
+typedef std::function<void(GroundLinkFeedback feedback)> GROUND_LINK_FEEDBACK_CALLBACK;
+
 struct StatsAirGround{
   bool is_air=false;
   // air and ground
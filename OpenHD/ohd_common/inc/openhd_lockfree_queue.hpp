@@ -0,0 +1,81 @@
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LOCKFREE_QUEUE_HPP_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LOCKFREE_QUEUE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace openhd{
+
+/**
+ * Bounded, lock-free multi producer / multi consumer queue of trivially copyable elements (Dmitry Vyukov's design).
+ * Neither push nor pop ever block or allocate - if the queue is full, try_push just fails, and it is up to the caller
+ * to drop (and count) the element. Useful where something is produced on a hot path (e.g. logging from any thread) and
+ * consumed by a background thread.
+ */
+template<class T,size_t CAPACITY>
+class BoundedMPMCQueue{
+ public:
+  static_assert(CAPACITY>=2 && (CAPACITY & (CAPACITY-1))==0,"Capacity must be a power of 2");
+  BoundedMPMCQueue(){
+    for(size_t i=0;i<CAPACITY;i++){
+      m_cells[i].sequence.store(i,std::memory_order_relaxed);
+    }
+  }
+  BoundedMPMCQueue(const BoundedMPMCQueue&)=delete;
+  BoundedMPMCQueue(BoundedMPMCQueue&&)=delete;
+  // returns false if the queue is full
+  bool try_push(const T& data){
+    Cell* cell;
+    size_t pos=m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true){
+      cell=&m_cells[pos & (CAPACITY-1)];
+      const size_t seq=cell->sequence.load(std::memory_order_acquire);
+      const auto dif=static_cast<intptr_t>(seq)-static_cast<intptr_t>(pos);
+      if(dif==0){
+        if(m_enqueue_pos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))break;
+      }else if(dif<0){
+        return false;
+      }else{
+        pos=m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data=data;
+    cell->sequence.store(pos+1,std::memory_order_release);
+    return true;
+  }
+  // returns false if the queue is empty
+  bool try_pop(T& data){
+    Cell* cell;
+    size_t pos=m_dequeue_pos.load(std::memory_order_relaxed);
+    while (true){
+      cell=&m_cells[pos & (CAPACITY-1)];
+      const size_t seq=cell->sequence.load(std::memory_order_acquire);
+      const auto dif=static_cast<intptr_t>(seq)-static_cast<intptr_t>(pos+1);
+      if(dif==0){
+        if(m_dequeue_pos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))break;
+      }else if(dif<0){
+        return false;
+      }else{
+        pos=m_dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    data=cell->data;
+    cell->sequence.store(pos+CAPACITY,std::memory_order_release);
+    return true;
+  }
+ private:
+  struct Cell{
+    std::atomic<size_t> sequence;
+    T data;
+  };
+  std::array<Cell,CAPACITY> m_cells;
+  // On their own cache lines, producers and the consumer(s) don't share them
+  alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+  alignas(64) std::atomic<size_t> m_dequeue_pos{0};
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_LOCKFREE_QUEUE_HPP_
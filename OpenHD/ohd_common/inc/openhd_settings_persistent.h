@@ -5,10 +5,16 @@
 #ifndef OPENHD_OPENHD_OHD_COMMON_OPENHD_SETTINGS_PERSISTENT_HPP_
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_SETTINGS_PERSISTENT_HPP_
 
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <utility>
 
 #include "include_json.hpp"
+#include "openhd_latency_histogram.hpp"
 #include "openhd_spdlog.h"
 #include "openhd_util.h"
 #include "openhd_util_filesystem.h"
@@ -19,6 +25,62 @@
  */
 namespace openhd{
 
+/**
+ * Write-behind for the settings files: A GCS changing many params in a row results in many (small) changes,
+ * writing the whole file each time is slow (on the caller thread, e.g. the mavlink param thread) and wears the SD card.
+ * Instead, a write is scheduled and all the changes to the same file within the delay are written at once, on the writer thread.
+ * A file is written to a temporary file first, then synced and renamed - such that on power loss, the file is either
+ * the previous or the new version, but never half written.
+ * A write that failed (e.g. SD card full / read only for a moment) stays pending and is retried, with an exponential backoff.
+ * Pending writes must be flushed before terminating / rebooting, see flush().
+ */
+class PersistentSettingsWriter{
+ public:
+  static PersistentSettingsWriter& instance();
+  // Replaces any pending write of the same file. Never blocks on IO.
+  void schedule_write(const std::string& file_path,std::string content);
+  // Blocks until each pending write has been written, or attempted once (it then stays pending and is retried later).
+  void flush();
+  // How long changes are coalesced, 0 writes (on the writer thread) right away.
+  void set_write_delay(std::chrono::milliseconds delay);
+  [[nodiscard]] int get_n_pending_writes();
+  // pending writes, writes, coalesced changes and the write latency (tmp file, fsync, rename)
+  std::string get_stats_string();
+  // Write to file_path.tmp, fsync, rename to file_path and fsync the directory. Returns false on error.
+  static bool write_file_atomic(const std::string& file_path,const std::string& content);
+ private:
+  PersistentSettingsWriter();
+  void loop();
+  struct PendingWrite{
+    std::string content;
+    // deadline of the first change that is not written yet - further changes don't delay the write
+    std::chrono::steady_clock::time_point deadline;
+    // consecutive failed attempts, for the retry backoff
+    int n_failures=0;
+    // the last flush() that attempted this write (or the last one before it was scheduled)
+    uint64_t flush_id=0;
+  };
+  static constexpr auto RETRY_BACKOFF_MIN=std::chrono::seconds(1);
+  static constexpr auto RETRY_BACKOFF_MAX=std::chrono::seconds(60);
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::map<std::string,PendingWrite> m_pending;
+  std::chrono::milliseconds m_write_delay=std::chrono::seconds(1);
+  // true while the writer thread writes (without holding the mutex)
+  bool m_writing=false;
+  // incremented with each flush(), the writer ignores the deadlines of writes not attempted by the current flush yet
+  uint64_t m_flush_id=0;
+  uint64_t m_n_scheduled=0;
+  uint64_t m_n_coalesced=0;
+  uint64_t m_n_written=0;
+  uint64_t m_n_write_errors=0;
+  openhd::LatencyHistogram m_write_latency;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+// Shorthand for PersistentSettingsWriter::instance().flush(), call before terminating / rebooting
+void flush_persistent_settings();
+
 /**
  * Helper class to persist settings during reboots using json. Properly handles the typical edge cases, e.g.
  * a) No settings have been stored for the given unique hash (e.g. for camera of type X) => create default settings.
@@ -77,6 +139,8 @@ class PersistentJsonSettings {
    * If this file exists, create settings from it - otherwise, create default and persist.
    */
   void init(){
+    // A previous instance might still have a pending write of the same file
+    PersistentSettingsWriter::instance().flush();
     if(!OHDFilesystemUtil::exists(_base_path)){
       OHDFilesystemUtil::create_directory(_base_path);
     }
@@ -99,15 +163,15 @@ class PersistentJsonSettings {
     return _base_path+get_unique_filename();
   }
   /**
-   * serialize settings to json and write to file for persistence
+   * serialize settings to json and schedule writing them to the file for persistence (see PersistentSettingsWriter)
    */
   void persist_settings()const {
     assert(_settings);
     const auto file_path=get_file_path();
-    // Serialize to json
+    // Serialize to (compact) json
     const nlohmann::json tmp=*_settings;
     // and write them locally for persistence
-    OHDFilesystemUtil::write_file(file_path,tmp.dump(4));
+    PersistentSettingsWriter::instance().schedule_write(file_path,tmp.dump());
   }
   /**
    * Try and deserialize the last stored settings (json)
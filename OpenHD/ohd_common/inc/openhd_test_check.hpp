@@ -0,0 +1,21 @@
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_TEST_CHECK_HPP_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_TEST_CHECK_HPP_
+
+#include <cstdlib>
+#include <iostream>
+
+namespace openhd::test{
+
+static inline void check_or_exit(bool condition,const char* expression,const char* file,int line){
+  if(condition)return;
+  std::cerr<<file<<":"<<line<<" check failed: "<<expression<<"\n";
+  std::exit(EXIT_FAILURE);
+}
+
+}
+
+// For the test executables - unlike assert(), the expression is always evaluated and a failed check also makes
+// release (NDEBUG) builds of the test exit with an error.
+#define OHD_TEST_CHECK(condition) openhd::test::check_or_exit(static_cast<bool>(condition),#condition,__FILE__,__LINE__)
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_TEST_CHECK_HPP_
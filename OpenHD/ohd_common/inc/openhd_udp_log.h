@@ -6,6 +6,10 @@
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_UDP_LOG_H_
 
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+
 #include "openhd_global_constants.hpp"
 #include "spdlog/common.h"
 
@@ -17,6 +21,11 @@
  * this works is simple: The log messages is sent to a specific udp port on
  * localhost and then picked up by the telemetry service, which converts it to
  * mavlink and forwards it accordingly.
+ * Sending never blocks the caller: messages are put into a lock-free queue and sent out in batches
+ * (over one long-lived socket) by a background thread. Since warnings tend to come in bursts (e.g. on link trouble) and
+ * all end up in a low bandwidth mavlink link, the background thread collapses repeated lines into one
+ * "(nx) <line>" message and limits the n of messages per second. Whatever is dropped is counted
+ * and reported in a message of its own.
  */
 namespace openhd::log::udp{
 
@@ -60,10 +69,34 @@ STATUS_LEVEL level_spdlog_to_mavlink(const spdlog::level::level_enum& level);
 
 /**
  * Send a log message out via udp to localhost, it wll be picked up by the telemetry service.
+ * Never blocks, the message is queued (or dropped if the queue is full).
  * @param message the log message to send, has to have a valid null terminator.
  */
 void sendLocalLogMessageUDP(const LogMessage & message);
 
+struct ForwarderStats{
+  // n of messages queued
+  uint64_t n_enqueued=0;
+  // n of messages actually sent (including the repeated / dropped summaries)
+  uint64_t n_sent=0;
+  // dropped since the queue was full
+  uint64_t n_dropped_queue_full=0;
+  // dropped since there were too many messages per second
+  uint64_t n_dropped_rate_limit=0;
+  // not sent since they were the same as the previous one (and included in a "(nx) <line>" message)
+  uint64_t n_deduplicated=0;
+  [[nodiscard]] std::string to_string()const;
+};
+// Total since the start
+ForwarderStats get_forwarder_stats();
+
+// Send to a different (localhost) port than LOCAL_LOG_MESSAGES_UDP_PORT, for testing
+void set_log_messages_udp_port(int port);
+
+// Waits until all the messages queued so far are sent (at most timeout), e.g. before rebooting.
+// Also done on exit.
+void flush_log_messages(std::chrono::milliseconds timeout=std::chrono::milliseconds(200));
+
 /*
  * Messages sent here will end up in the telemetry microservice, where they will be packed up and sent through
  * mavlink for storage and review by qopenhd, the boot screen system, and other software.
@@ -8,6 +8,7 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <optional>
 
 namespace openhd{
 
@@ -21,6 +22,9 @@ struct FragmentedVideoFrame{
   // ideally, this would be the time point when the frame was generated by the CMOS - but r.n
   // no platform supports measurements this deep.
   std::chrono::steady_clock::time_point creation_time=std::chrono::steady_clock::now();
+  // Only set if latency tracing is enabled - time point when the first fragment of this frame
+  // was pulled out of the gstreamer pipeline (creation_time is when the end of the frame was detected)
+  std::optional<std::chrono::steady_clock::time_point> opt_trace_appsink_time=std::nullopt;
 };
 
 }
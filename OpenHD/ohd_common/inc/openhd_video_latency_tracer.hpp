@@ -0,0 +1,88 @@
+#ifndef OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_VIDEO_LATENCY_TRACER_HPP_
+#define OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_VIDEO_LATENCY_TRACER_HPP_
+
+#include <array>
+#include <sstream>
+#include <string>
+
+#include "openhd_latency_histogram.hpp"
+#include "openhd_link_statistics.hpp"
+
+namespace openhd{
+
+/**
+ * Opt-in (DEV_VIDEO_LATENCY_TRACING in hardware.config) per-frame latency tracing of a video stream.
+ * Air: the camera stream marks when the first fragment of a frame was pulled out of the appsink (see FragmentedVideoFrame),
+ * the frame creation time is when the rtp end of frame was detected, and the link records when the frame has been enqueued
+ * (the FEC encode time itself is already reported by wb).
+ * Ground: time the link's receive callback for a fragment takes, e.g. forwarding it via UDP to all consumers. This does
+ * not include the time a fragment spends in the wb receiver (FEC decode / waiting for a block to complete, inside
+ * wifibroadcast) or in the consumer (e.g. QOpenHD decoding / displaying) - the wifibroadcast (ground) latency is only
+ * available via its own stats.
+ * Percentiles are per reporting interval (take_percentiles() resets the stage).
+ */
+class VideoLatencyTracer{
+ public:
+  enum Stage{
+    // air: first fragment of a frame at the appsink -> end of frame detected
+    APPSINK_TO_FRAME_CLOSE=0,
+    // air: end of frame detected -> handed over to the FEC encoder / tx queue
+    FRAME_CLOSE_TO_LINK_ENQUEUE,
+    // air: first fragment of a frame at the appsink -> handed over to the FEC encoder / tx queue
+    AIR_TOTAL,
+    // ground: fragment handed out by the wb receiver (after FEC) -> forwarded to all UDP consumers (synchronous callback)
+    GROUND_RECEIVE_TO_FORWARD,
+    N_STAGES
+  };
+  static std::string stage_to_string(const int stage){
+    switch (stage) {
+      case APPSINK_TO_FRAME_CLOSE: return "appsink_to_frame_close";
+      case FRAME_CLOSE_TO_LINK_ENQUEUE: return "frame_close_to_enqueue";
+      case AIR_TOTAL: return "air_total";
+      case GROUND_RECEIVE_TO_FORWARD: return "gnd_receive_to_forward";
+      default:
+        break;
+    }
+    return "unknown";
+  }
+  void record(const Stage stage,const std::chrono::steady_clock::duration& delta){
+    m_stages[stage].record(delta);
+  }
+  // Air: all stages of a frame at once
+  void record_frame(const std::chrono::steady_clock::time_point& appsink_time,const std::chrono::steady_clock::time_point& frame_close_time,
+                    const std::chrono::steady_clock::time_point& enqueued_time){
+    record(APPSINK_TO_FRAME_CLOSE,frame_close_time-appsink_time);
+    record(FRAME_CLOSE_TO_LINK_ENQUEUE,enqueued_time-frame_close_time);
+    record(AIR_TOTAL,enqueued_time-appsink_time);
+  }
+  [[nodiscard]] link_statistics::LatencyPercentilesUs get_percentiles(const Stage stage)const{
+    const auto& histogram=m_stages[stage];
+    link_statistics::LatencyPercentilesUs ret{};
+    ret.p50_us=static_cast<int32_t>(histogram.percentile_us(50));
+    ret.p95_us=static_cast<int32_t>(histogram.percentile_us(95));
+    ret.p99_us=static_cast<int32_t>(histogram.percentile_us(99));
+    return ret;
+  }
+  // get percentiles, then reset, such that the next call only returns the percentiles of the next interval
+  link_statistics::LatencyPercentilesUs take_percentiles(const Stage stage){
+    const auto ret=get_percentiles(stage);
+    m_stages[stage].reset();
+    return ret;
+  }
+  [[nodiscard]] std::string to_string()const{
+    std::stringstream ss;
+    ss<<"VideoLatency{";
+    for(int i=0;i<N_STAGES;i++){
+      if(m_stages[i].count()==0)continue;
+      ss<<stage_to_string(i)<<":"<<m_stages[i].to_string()<<" ";
+    }
+    ss<<"}";
+    return ss.str();
+  }
+ private:
+  std::array<LatencyHistogram,N_STAGES> m_stages;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_COMMON_INC_OPENHD_VIDEO_LATENCY_TRACER_HPP_
@@ -36,6 +36,19 @@ openhd::Config openhd::load_config() {
 	ret.NW_ETHERNET_CARD = r.Get<std::string>("network", "NW_ETHERNET_CARD");
     ret.NW_MANUAL_FORWARDING_IPS =  r.GetVector<std::string>("network", "NW_MANUAL_FORWARDING_IPS");
     ret.NW_FORWARD_TO_LOCALHOST_58XX = r.Get<bool>("network","NW_FORWARD_TO_LOCALHOST_58XX");
+    // dev options are optional (older config files don't have them)
+    ret.DEV_GST_APPSINK_PUSH_MODE = r.Get<bool>("dev","DEV_GST_APPSINK_PUSH_MODE",false);
+    ret.DEV_VIDEO_LATENCY_TRACING = r.Get<bool>("dev","DEV_VIDEO_LATENCY_TRACING",false);
+    ret.DEV_GST_PIPELINE_BUILDER = r.Get<bool>("dev","DEV_GST_PIPELINE_BUILDER",false);
+    ret.DEV_VIDEO_GROUND_BATCH_FORWARDER = r.Get<bool>("dev","DEV_VIDEO_GROUND_BATCH_FORWARDER",false);
+    ret.DEV_WB_ADAPTIVE_LINK_CONTROLLER = r.Get<bool>("dev","DEV_WB_ADAPTIVE_LINK_CONTROLLER",false);
+    ret.DEV_WIFI_NETLINK_BACKEND = r.Get<bool>("dev","DEV_WIFI_NETLINK_BACKEND",false);
+    ret.DEV_TELEMETRY_EPOLL_REACTOR = r.Get<bool>("dev","DEV_TELEMETRY_EPOLL_REACTOR",false);
+    ret.DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND = r.Get<int>("dev","DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND",0);
+    ret.DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS = r.Get<int>("dev","DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS",1000);
+    ret.DEV_SETTINGS_WRITE_DELAY_MS = r.Get<int>("dev","DEV_SETTINGS_WRITE_DELAY_MS",1000);
+    ret.DEV_AIR_RECORDING_FRAGMENTED_MP4 = r.Get<bool>("dev","DEV_AIR_RECORDING_FRAGMENTED_MP4",false);
+    ret.DEV_AIR_RECORDING_PREROLL_S = r.Get<int>("dev","DEV_AIR_RECORDING_PREROLL_S",0);
     return ret;
   }catch (std::exception& exception){
     get_logger()->error("Ill-formatted config file {}",std::string(exception.what()));
@@ -46,10 +59,18 @@ openhd::Config openhd::load_config() {
 void openhd::debug_config(const openhd::Config& config) {
   get_logger()->debug("WIFI_ENABLE_AUTODETECT:{}, WIFI_WB_LINK_CARDS:{}, WIFI_WIFI_HOTSPOT_CARD:{},\n"
       "CAMERA_ENABLE_AUTODETECT:{}, CAMERA_N_CAMERAS:{}, CAMERA_CAMERA0_TYPE:{}, CAMERA_CAMERA1_TYPE:{}\n"
-      "NW_MANUAL_FORWARDING_IPS:{},NW_ETHERNET_CARD:{},NW_FORWARD_TO_LOCALHOST_58XX:{}",
+      "NW_MANUAL_FORWARDING_IPS:{},NW_ETHERNET_CARD:{},NW_FORWARD_TO_LOCALHOST_58XX:{}\n"
+      "DEV_GST_APPSINK_PUSH_MODE:{}, DEV_VIDEO_LATENCY_TRACING:{}, DEV_VIDEO_GROUND_BATCH_FORWARDER:{}\n"
+      "DEV_WB_ADAPTIVE_LINK_CONTROLLER:{}, DEV_WIFI_NETLINK_BACKEND:{}, DEV_TELEMETRY_EPOLL_REACTOR:{}\n"
+      "DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND:{}, DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS:{}\n"
+      "DEV_SETTINGS_WRITE_DELAY_MS:{}, DEV_GST_PIPELINE_BUILDER:{}, DEV_AIR_RECORDING_FRAGMENTED_MP4:{}, DEV_AIR_RECORDING_PREROLL_S:{}",
       config.WIFI_ENABLE_AUTODETECT,OHDUtil::str_vec_as_string(config.WIFI_WB_LINK_CARDS),config.WIFI_WIFI_HOTSPOT_CARD,
       config.CAMERA_ENABLE_AUTODETECT,config.CAMERA_N_CAMERAS,config.CAMERA_CAMERA0_TYPE,config.CAMERA_CAMERA1_TYPE,
-      OHDUtil::str_vec_as_string(config.NW_MANUAL_FORWARDING_IPS),config.NW_ETHERNET_CARD,config.NW_FORWARD_TO_LOCALHOST_58XX
+      OHDUtil::str_vec_as_string(config.NW_MANUAL_FORWARDING_IPS),config.NW_ETHERNET_CARD,config.NW_FORWARD_TO_LOCALHOST_58XX,
+      config.DEV_GST_APPSINK_PUSH_MODE,config.DEV_VIDEO_LATENCY_TRACING,config.DEV_VIDEO_GROUND_BATCH_FORWARDER,
+      config.DEV_WB_ADAPTIVE_LINK_CONTROLLER,config.DEV_WIFI_NETLINK_BACKEND,config.DEV_TELEMETRY_EPOLL_REACTOR,
+      config.DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND,config.DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS,
+      config.DEV_SETTINGS_WRITE_DELAY_MS,config.DEV_GST_PIPELINE_BUILDER,config.DEV_AIR_RECORDING_FRAGMENTED_MP4,config.DEV_AIR_RECORDING_PREROLL_S
       );
 }
 
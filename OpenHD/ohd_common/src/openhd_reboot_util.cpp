@@ -7,6 +7,8 @@
 
 #include <thread>
 
+#include "openhd_settings_persistent.h"
+#include "openhd_udp_log.h"
 #include "openhd_util.h"
 
 void openhd::reboot::systemctl_shutdown() {
@@ -18,6 +20,9 @@ void openhd::reboot::systemctl_reboot() {
 }
 
 void openhd::reboot::systemctl_power(bool shutdownOnly) {
+  // Don't lose the last settings change(s) / log message(s)
+  openhd::flush_persistent_settings();
+  openhd::log::udp::flush_log_messages();
   if(shutdownOnly){
     systemctl_shutdown();
   }else{
@@ -4,3 +4,173 @@
 
 #include "openhd_settings_persistent.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+openhd::PersistentSettingsWriter& openhd::PersistentSettingsWriter::instance() {
+  // Never destroyed - settings might be persisted during static destruction, and the thread is never joined.
+  static auto* instance=new PersistentSettingsWriter();
+  return *instance;
+}
+
+openhd::PersistentSettingsWriter::PersistentSettingsWriter() {
+  m_thread=std::make_unique<std::thread>(&PersistentSettingsWriter::loop,this);
+  m_thread->detach();
+}
+
+void openhd::PersistentSettingsWriter::schedule_write(const std::string& file_path,std::string content) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_n_scheduled++;
+    auto it=m_pending.find(file_path);
+    if(it!=m_pending.end()){
+      // Written once with the latest content, at the deadline of the first change
+      it->second.content=std::move(content);
+      m_n_coalesced++;
+      return;
+    }
+    // A flush() only covers the writes scheduled before it
+    m_pending.emplace(file_path,PendingWrite{std::move(content),std::chrono::steady_clock::now()+m_write_delay,0,m_flush_id});
+  }
+  m_cv.notify_all();
+}
+
+void openhd::PersistentSettingsWriter::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if(m_pending.empty() && !m_writing)return;
+  const uint64_t flush_id=++m_flush_id;
+  m_cv.notify_all();
+  m_cv.wait(lock,[this,flush_id](){
+    if(m_writing)return false;
+    // Written, or attempted by (this or a later) flush and failed
+    for(const auto& pending:m_pending){
+      if(pending.second.flush_id<flush_id)return false;
+    }
+    return true;
+  });
+}
+
+void openhd::PersistentSettingsWriter::set_write_delay(std::chrono::milliseconds delay) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_write_delay=delay;
+}
+
+int openhd::PersistentSettingsWriter::get_n_pending_writes() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return static_cast<int>(m_pending.size());
+}
+
+void openhd::PersistentSettingsWriter::loop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true){
+    if(m_pending.empty()){
+      m_cv.wait(lock,[this](){
+        return !m_pending.empty();
+      });
+      continue;
+    }
+    // On flush, everything that was not attempted by this flush yet is written right away
+    auto next=m_pending.end();
+    for(auto it=m_pending.begin();it!=m_pending.end();++it){
+      if(it->second.flush_id<m_flush_id){
+        next=it;
+        break;
+      }
+    }
+    if(next==m_pending.end()){
+      next=m_pending.begin();
+      for(auto it=m_pending.begin();it!=m_pending.end();++it){
+        if(it->second.deadline<next->second.deadline)next=it;
+      }
+      if(std::chrono::steady_clock::now()<next->second.deadline){
+        // Woken up early by another write / flush
+        m_cv.wait_until(lock,next->second.deadline);
+        continue;
+      }
+    }
+    const std::string file_path=next->first;
+    PendingWrite write=std::move(next->second);
+    write.flush_id=m_flush_id;
+    m_pending.erase(next);
+    m_writing=true;
+    lock.unlock();
+    const auto before=std::chrono::steady_clock::now();
+    const bool success=write_file_atomic(file_path,write.content);
+    const auto write_time=std::chrono::steady_clock::now()-before;
+    lock.lock();
+    m_writing=false;
+    m_write_latency.record(write_time);
+    if(success){
+      m_n_written++;
+    }else{
+      m_n_write_errors++;
+      write.n_failures++;
+      const auto backoff=std::min<std::chrono::steady_clock::duration>(
+          RETRY_BACKOFF_MIN*(1<<std::min(write.n_failures-1,6)),RETRY_BACKOFF_MAX);
+      const auto retry=std::chrono::steady_clock::now()+backoff;
+      openhd::log::get_default()->warn("Cannot write settings [{}], retry in {}s",file_path,
+                                       std::chrono::duration_cast<std::chrono::seconds>(backoff).count());
+      // Stays dirty - unless a newer change was scheduled in the meantime, that one is retried instead
+      auto it=m_pending.find(file_path);
+      if(it==m_pending.end()){
+        write.deadline=retry;
+        m_pending.emplace(file_path,std::move(write));
+      }else{
+        it->second.n_failures=write.n_failures;
+        it->second.deadline=std::max(it->second.deadline,retry);
+      }
+    }
+    // For flush()
+    m_cv.notify_all();
+  }
+}
+
+bool openhd::PersistentSettingsWriter::write_file_atomic(const std::string& file_path,const std::string& content) {
+  const std::string tmp_file_path=file_path+".tmp";
+  const int fd=open(tmp_file_path.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0644);
+  if(fd<0){
+    return false;
+  }
+  size_t offset=0;
+  while (offset<content.size()){
+    const auto n=write(fd,content.data()+offset,content.size()-offset);
+    if(n<=0){
+      close(fd);
+      unlink(tmp_file_path.c_str());
+      return false;
+    }
+    offset+=n;
+  }
+  // The data needs to be on disk before the rename, otherwise we might end up with an empty file on power loss
+  const bool synced=fsync(fd)==0;
+  close(fd);
+  if(!synced || rename(tmp_file_path.c_str(),file_path.c_str())!=0){
+    unlink(tmp_file_path.c_str());
+    return false;
+  }
+  // And the rename itself
+  const auto last_slash=file_path.find_last_of('/');
+  const std::string directory=last_slash==std::string::npos ? "." : file_path.substr(0,last_slash+1);
+  const int dir_fd=open(directory.c_str(),O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if(dir_fd>=0){
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+std::string openhd::PersistentSettingsWriter::get_stats_string() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::stringstream ss;
+  ss<<"PersistentSettingsWriter{pending:"<<m_pending.size()<<", scheduled:"<<m_n_scheduled<<", coalesced:"<<m_n_coalesced
+     <<", written:"<<m_n_written<<", errors:"<<m_n_write_errors<<", write latency:"<<m_write_latency.to_string()<<"}";
+  return ss.str();
+}
+
+void openhd::flush_persistent_settings() {
+  PersistentSettingsWriter::instance().flush();
+}
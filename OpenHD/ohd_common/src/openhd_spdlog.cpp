@@ -8,6 +8,7 @@
 #include <spdlog/common.h>
 #include <spdlog/spdlog.h>
 //
+#include <spdlog/details/null_mutex.h>
 #include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
@@ -20,21 +21,20 @@
 // such that they can be picked up by the telemetry module
 namespace openhd::log::sink{
 
-class UdpTelemetrySink : public spdlog::sinks::base_sink<std::mutex>{
+// Thread-safe without a mutex - the message is formatted on the stack and then handed off to the (lock-free) udp log
+// forwarder, which sends it out on its own thread. Logging a warning therefore never blocks on a socket or another thread.
+class UdpTelemetrySink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>{
  protected:
   void sink_it_(const spdlog::details::log_msg& msg) override{
     // log_msg is a struct containing the log entry info like level, timestamp, thread id etc.
     // msg.raw contains pre formatted log
-    // If needed (very likely but not mandatory), the sink formats the message before sending it to its final destination:
     if(msg.level>=spdlog::level::warn){
       // We do not use the formatter here, since we are limited by 50 chars (and the level, for example, is embedded already but not as a string).
-      //spdlog::memory_buf_t formatted;
-      //spdlog::sinks::base_sink<std::mutex>::formatter_->format(msg, formatted);
-      const auto msg_string=fmt::to_string(msg.payload);
-      const std::string msg_with_tag=fmt::format("{} {}",msg.logger_name,msg_string);
-      const auto level=openhd::log::udp::level_spdlog_to_mavlink(msg.level);
-      openhd::log::udp::ohd_log(level,msg_with_tag);
-      //std::cout << "["<<msg_string<<"]";
+      openhd::log::udp::LogMessage lmessage{};
+      lmessage.level=static_cast<uint8_t>(openhd::log::udp::level_spdlog_to_mavlink(msg.level));
+      // zero-initialized, the last char is always the null terminator
+      fmt::format_to_n(reinterpret_cast<char*>(lmessage.message),sizeof(lmessage.message)-1,"{} {}",msg.logger_name,msg.payload);
+      openhd::log::udp::sendLocalLogMessageUDP(lmessage);
     }
   }
   void flush_() override{
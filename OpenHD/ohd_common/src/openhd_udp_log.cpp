@@ -7,19 +7,32 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_lockfree_queue.hpp"
 
 openhd::log::udp::STATUS_LEVEL openhd::log::udp::level_spdlog_to_mavlink(
     const spdlog::level::level_enum& level) {
@@ -47,21 +60,261 @@ openhd::log::udp::STATUS_LEVEL openhd::log::udp::level_spdlog_to_mavlink(
   return STATUS_LEVEL::DEBUG;
 }
 
+namespace openhd::log::udp{
+
+namespace {
+
+// Sends the queued log messages on its own thread, see the header. The thread sleeps until a message is queued
+// (eventfd), or until a "repeated" / "dropped" summary is due.
+// Never destroyed - any thread might still log during / after static destruction.
+class LogForwarder{
+ public:
+  static LogForwarder& instance(){
+    static auto* instance=new LogForwarder();
+    return *instance;
+  }
+  void enqueue(const LogMessage& message){
+    if(m_queue.try_push(message)){
+      m_n_enqueued++;
+      // Only one wakeup until the forwarder picked it up, no matter how many messages are queued in the meantime
+      if(!m_wakeup_pending.exchange(true,std::memory_order_acq_rel)){
+        wake_up();
+      }
+    }else{
+      m_n_dropped_queue_full++;
+    }
+  }
+  // Waits (at most timeout) until everything queued before is sent
+  void flush(std::chrono::milliseconds timeout){
+    std::unique_lock<std::mutex> lock(m_flush_mutex);
+    const uint64_t flush_id=++m_n_flush_requested;
+    wake_up();
+    m_flush_cv.wait_for(lock,timeout,[this,flush_id](){
+      return m_n_flushed>=flush_id;
+    });
+  }
+  void set_port(int port){
+    m_port=port;
+  }
+  ForwarderStats get_stats(){
+    ForwarderStats ret{};
+    ret.n_enqueued=m_n_enqueued;
+    ret.n_sent=m_n_sent;
+    ret.n_dropped_queue_full=m_n_dropped_queue_full;
+    ret.n_dropped_rate_limit=m_n_dropped_rate_limit;
+    ret.n_deduplicated=m_n_deduplicated;
+    return ret;
+  }
+ private:
+  static constexpr size_t QUEUE_SIZE=256;
+  static constexpr size_t MAX_BATCH_SIZE=32;
+  // The same line again within this interval is not sent, but counted
+  static constexpr auto DEDUPLICATE_INTERVAL=std::chrono::seconds(2);
+  // about what the telemetry forwards as STATUSTEXT
+  static constexpr double MAX_MESSAGES_PER_SECOND=10;
+  static constexpr double MAX_BURST_MESSAGES=20;
+  static constexpr auto DROPPED_REPORT_INTERVAL=std::chrono::seconds(5);
+  static constexpr auto FLUSH_ON_EXIT_TIMEOUT=std::chrono::milliseconds(200);
+  LogForwarder(){
+    m_socket=socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(m_socket<0){
+      std::cerr<<"Log message - create socket failed";
+    }
+    m_dest.sin_family = AF_INET;
+    inet_aton("127.0.0.1", &m_dest.sin_addr);
+    m_event_fd=eventfd(0,EFD_CLOEXEC | EFD_NONBLOCK);
+    if(m_event_fd<0){
+      std::cerr<<"Log message - create eventfd failed";
+    }
+    std::thread(&LogForwarder::loop,this).detach();
+    // Whatever is still queued when openhd terminates
+    std::atexit([](){
+      instance().flush(FLUSH_ON_EXIT_TIMEOUT);
+    });
+  }
+  void wake_up(){
+    if(m_event_fd<0)return;
+    const uint64_t one=1;
+    [[maybe_unused]] const auto ret=write(m_event_fd,&one,sizeof(one));
+  }
+  // Blocks until woken up or the timeout (ms, -1 for none) elapsed
+  void wait_for_wakeup(int timeout_ms){
+    if(m_event_fd<0){
+      // Fall back to polling
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      return;
+    }
+    struct pollfd pfd{m_event_fd,POLLIN,0};
+    if(poll(&pfd,1,timeout_ms)>0){
+      uint64_t value;
+      [[maybe_unused]] const auto ret=read(m_event_fd,&value,sizeof(value));
+    }
+  }
+  // -1 if there is nothing to do until the next message is queued
+  int get_timeout_ms(std::chrono::steady_clock::time_point now)const{
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    if(m_n_repeated>0){
+      deadline=m_last_time+DEDUPLICATE_INTERVAL;
+    }
+    if(m_n_dropped_queue_full+m_n_dropped_rate_limit!=m_last_reported_n_dropped){
+      const auto report=m_last_dropped_report+DROPPED_REPORT_INTERVAL;
+      deadline=deadline.has_value() ? std::min(deadline.value(),report) : report;
+    }
+    if(!deadline.has_value())return -1;
+    // rounded up, such that we don't wake up (just) before the deadline
+    const auto delta=std::chrono::duration_cast<std::chrono::milliseconds>(deadline.value()-now).count()+1;
+    return static_cast<int>(std::max(static_cast<int64_t>(0),static_cast<int64_t>(delta)));
+  }
+  void loop(){
+    std::vector<LogMessage> to_send;
+    to_send.reserve(MAX_BATCH_SIZE*2);
+    int timeout_ms=-1;
+    while (true){
+      wait_for_wakeup(timeout_ms);
+      m_wakeup_pending.exchange(false,std::memory_order_acq_rel);
+      uint64_t flush_id;
+      {
+        std::lock_guard<std::mutex> lock(m_flush_mutex);
+        flush_id=m_n_flush_requested;
+      }
+      const auto now=std::chrono::steady_clock::now();
+      refill_tokens(now);
+      LogMessage message{};
+      size_t n_popped;
+      do{
+        n_popped=0;
+        while (n_popped<MAX_BATCH_SIZE && m_queue.try_pop(message)){
+          n_popped++;
+          process(message,now,to_send);
+        }
+        if(!to_send.empty()){
+          send_batch(to_send);
+          to_send.resize(0);
+        }
+      }while (n_popped==MAX_BATCH_SIZE);
+      const bool flush=m_n_flushed<flush_id;
+      if(m_n_repeated>0 && (flush || now-m_last_time>=DEDUPLICATE_INTERVAL)){
+        to_send.push_back(create_repeated_message());
+      }
+      maybe_report_dropped(now,to_send);
+      if(!to_send.empty()){
+        send_batch(to_send);
+        to_send.resize(0);
+      }
+      if(flush){
+        std::lock_guard<std::mutex> lock(m_flush_mutex);
+        m_n_flushed=flush_id;
+        m_flush_cv.notify_all();
+      }
+      timeout_ms=get_timeout_ms(now);
+    }
+  }
+  void process(const LogMessage& message,std::chrono::steady_clock::time_point now,std::vector<LogMessage>& to_send){
+    if(m_has_last && now-m_last_time<DEDUPLICATE_INTERVAL && std::memcmp(&message,&m_last,sizeof(LogMessage))==0){
+      m_n_repeated++;
+      m_n_deduplicated++;
+      return;
+    }
+    if(m_n_repeated>0){
+      to_send.push_back(create_repeated_message());
+    }
+    m_last=message;
+    m_last_time=now;
+    m_has_last=true;
+    if(m_tokens<1){
+      m_n_dropped_rate_limit++;
+      return;
+    }
+    m_tokens-=1;
+    to_send.push_back(message);
+  }
+  // "(nx) <last message>", with the same level as the repeated message
+  LogMessage create_repeated_message(){
+    LogMessage ret{};
+    ret.level=m_last.level;
+    snprintf((char*)ret.message,sizeof(ret.message),"(%dx) %s",m_n_repeated,(const char*)m_last.message);
+    m_n_repeated=0;
+    // Repeats after this are counted again
+    m_has_last=false;
+    return ret;
+  }
+  void refill_tokens(std::chrono::steady_clock::time_point now){
+    const double elapsed_s=std::chrono::duration<double>(now-m_last_refill).count();
+    m_tokens=std::min(MAX_BURST_MESSAGES,m_tokens+elapsed_s*MAX_MESSAGES_PER_SECOND);
+    m_last_refill=now;
+  }
+  void maybe_report_dropped(std::chrono::steady_clock::time_point now,std::vector<LogMessage>& to_send){
+    if(now-m_last_dropped_report<DROPPED_REPORT_INTERVAL)return;
+    const uint64_t n_dropped=m_n_dropped_queue_full+m_n_dropped_rate_limit;
+    if(n_dropped==m_last_reported_n_dropped)return;
+    LogMessage ret{};
+    ret.level=static_cast<uint8_t>(STATUS_LEVEL::WARNING);
+    snprintf((char*)ret.message,sizeof(ret.message),"log: %llu messages dropped",
+             static_cast<unsigned long long>(n_dropped-m_last_reported_n_dropped));
+    to_send.push_back(ret);
+    m_last_reported_n_dropped=n_dropped;
+    m_last_dropped_report=now;
+  }
+  // All the messages in one syscall, one datagram per message (what the receiver expects)
+  void send_batch(const std::vector<LogMessage>& messages){
+    if(m_socket<0)return;
+    m_dest.sin_port=htons(static_cast<uint16_t>(m_port.load()));
+    std::array<struct iovec,MAX_BATCH_SIZE> iovecs{};
+    std::array<struct mmsghdr,MAX_BATCH_SIZE> headers{};
+    size_t offset=0;
+    while (offset<messages.size()){
+      const size_t n=std::min(MAX_BATCH_SIZE,messages.size()-offset);
+      for(size_t i=0;i<n;i++){
+        iovecs[i].iov_base=(void*)&messages[offset+i];
+        iovecs[i].iov_len=sizeof(LogMessage);
+        headers[i].msg_hdr=msghdr{};
+        headers[i].msg_hdr.msg_name=&m_dest;
+        headers[i].msg_hdr.msg_namelen=sizeof(m_dest);
+        headers[i].msg_hdr.msg_iov=&iovecs[i];
+        headers[i].msg_hdr.msg_iovlen=1;
+      }
+      const int n_sent=sendmmsg(m_socket,headers.data(),static_cast<unsigned int>(n),0);
+      if(n_sent>0){
+        m_n_sent+=n_sent;
+      }
+      offset+=n;
+    }
+  }
+  BoundedMPMCQueue<LogMessage,QUEUE_SIZE> m_queue;
+  std::atomic<uint64_t> m_n_enqueued=0;
+  std::atomic<uint64_t> m_n_sent=0;
+  std::atomic<uint64_t> m_n_dropped_queue_full=0;
+  std::atomic<uint64_t> m_n_dropped_rate_limit=0;
+  std::atomic<uint64_t> m_n_deduplicated=0;
+  int m_socket=-1;
+  std::atomic<int> m_port=openhd::LOCAL_LOG_MESSAGES_UDP_PORT;
+  // Only used by the forwarder thread
+  struct sockaddr_in m_dest{};
+  int m_event_fd=-1;
+  std::atomic<bool> m_wakeup_pending=false;
+  std::mutex m_flush_mutex;
+  std::condition_variable m_flush_cv;
+  uint64_t m_n_flush_requested=0;
+  uint64_t m_n_flushed=0;
+  // Only used by the forwarder thread
+  LogMessage m_last{};
+  bool m_has_last=false;
+  std::chrono::steady_clock::time_point m_last_time{};
+  int m_n_repeated=0;
+  double m_tokens=MAX_BURST_MESSAGES;
+  std::chrono::steady_clock::time_point m_last_refill=std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point m_last_dropped_report{};
+  uint64_t m_last_reported_n_dropped=0;
+};
+
+}
+
+}
+
 void openhd::log::udp::sendLocalLogMessageUDP(
     const openhd::log::udp::LogMessage &message) {
   assert(message.hasNullTerminator());
-  int sockfd;
-  struct sockaddr_in servaddr{};
-  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-    std::cerr<<"Log message - create socket failed";
-    return;
-  }
-  memset(&servaddr, 0, sizeof(servaddr));
-  servaddr.sin_family = AF_INET;
-  servaddr.sin_port = htons(openhd::LOCAL_LOG_MESSAGES_UDP_PORT);
-  inet_aton("127.0.0.1", (in_addr *)&servaddr.sin_addr.s_addr);
-  sendto(sockfd, &message, sizeof(message), 0, (const struct sockaddr *)&servaddr, sizeof(servaddr));
-  close(sockfd);
+  LogForwarder::instance().enqueue(message);
 }
 
 void openhd::log::udp::ohd_log(openhd::log::udp::STATUS_LEVEL level,
@@ -74,3 +327,22 @@ void openhd::log::udp::ohd_log(openhd::log::udp::STATUS_LEVEL level,
   }
   sendLocalLogMessageUDP(lmessage);
 }
+
+void openhd::log::udp::set_log_messages_udp_port(int port) {
+  LogForwarder::instance().set_port(port);
+}
+
+void openhd::log::udp::flush_log_messages(std::chrono::milliseconds timeout) {
+  LogForwarder::instance().flush(timeout);
+}
+
+openhd::log::udp::ForwarderStats openhd::log::udp::get_forwarder_stats() {
+  return LogForwarder::instance().get_stats();
+}
+
+std::string openhd::log::udp::ForwarderStats::to_string() const {
+  std::stringstream ss;
+  ss<<"LogForwarder{enqueued:"<<n_enqueued<<", sent:"<<n_sent<<", dropped queue full:"<<n_dropped_queue_full
+     <<", dropped rate limit:"<<n_dropped_rate_limit<<", deduplicated:"<<n_deduplicated<<"}";
+  return ss.str();
+}
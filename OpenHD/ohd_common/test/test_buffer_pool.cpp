@@ -0,0 +1,120 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "openhd_buffer_pool.hpp"
+#include "openhd_test_check.hpp"
+
+// Checks buffers (and their shared_ptr control blocks) are re-used, the pool doesn't grow beyond its max size,
+// buffers outliving the pool are freed and the stats add up. Also checks that once warmed up, acquiring / releasing
+// a buffer doesn't allocate at all.
+
+// Counts all heap allocations of this process
+static uint64_t n_heap_allocations=0;
+void* operator new(std::size_t size){
+  n_heap_allocations++;
+  void* p=std::malloc(size);
+  if(p==nullptr)throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p)noexcept{
+  std::free(p);
+}
+void operator delete(void* p,std::size_t)noexcept{
+  std::free(p);
+}
+
+static void test_reuse(){
+  auto pool=openhd::BufferPool::create(4,1500);
+  const uint8_t* data;
+  {
+    auto buff=pool->acquire(1000);
+    OHD_TEST_CHECK(buff->size()==1000);
+    OHD_TEST_CHECK(buff->capacity()>=1500);
+    data=buff->data();
+  }
+  // The same memory again, without an allocation
+  auto buff=pool->acquire(1400);
+  OHD_TEST_CHECK(buff->size()==1400);
+  OHD_TEST_CHECK(buff->data()==data);
+  // A copy shares the buffer, it is only recycled once the last user is gone
+  auto copy=buff;
+  buff.reset();
+  OHD_TEST_CHECK(pool->get_stats().n_recycled==1);
+  copy.reset();
+  // Larger than the capacity - the recycled buffer has to grow
+  buff=pool->acquire(3000);
+  OHD_TEST_CHECK(buff->size()==3000);
+  buff.reset();
+  const auto stats=pool->get_stats();
+  std::cout<<stats.to_string()<<"\n";
+  OHD_TEST_CHECK(stats.n_acquired==3);
+  OHD_TEST_CHECK(stats.n_pool_hits==1);
+  OHD_TEST_CHECK(stats.n_allocations==2);
+  OHD_TEST_CHECK(stats.n_control_block_allocations==1);
+  OHD_TEST_CHECK(stats.n_recycled==3);
+  OHD_TEST_CHECK(stats.n_dropped==0);
+}
+
+static void test_max_pool_size(){
+  auto pool=openhd::BufferPool::create(4,1500);
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> buffers;
+  for(int i=0;i<10;i++){
+    buffers.push_back(pool->acquire(100));
+  }
+  buffers.clear();
+  auto stats=pool->get_stats();
+  std::cout<<stats.to_string()<<"\n";
+  OHD_TEST_CHECK(stats.n_allocations==10);
+  OHD_TEST_CHECK(stats.n_control_block_allocations==10);
+  OHD_TEST_CHECK(stats.n_recycled==4);
+  OHD_TEST_CHECK(stats.n_dropped==6);
+  // Only the 4 pooled buffers can be re-used
+  for(int i=0;i<10;i++){
+    buffers.push_back(pool->acquire(100));
+  }
+  buffers.clear();
+  stats=pool->get_stats();
+  OHD_TEST_CHECK(stats.n_pool_hits==4);
+  OHD_TEST_CHECK(stats.n_allocations==16);
+  OHD_TEST_CHECK(stats.n_control_block_allocations==16);
+}
+
+static void test_outlives_pool(){
+  auto pool=openhd::BufferPool::create(4,1500);
+  auto buff=pool->acquire(100);
+  pool.reset();
+  // Still usable, freed (not recycled) once released
+  (*buff)[99]=1;
+  buff.reset();
+}
+
+static void test_no_allocations(){
+  auto pool=openhd::BufferPool::create(64,1500);
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> in_flight;
+  in_flight.reserve(32);
+  // Warm up
+  for(int i=0;i<32;i++){
+    in_flight.push_back(pool->acquire(1400));
+  }
+  in_flight.clear();
+  const auto allocations_before=n_heap_allocations;
+  for(int run=0;run<1000;run++){
+    for(int i=0;i<32;i++){
+      in_flight.push_back(pool->acquire(1000+i*10));
+    }
+    in_flight.clear();
+  }
+  const auto n_allocations=n_heap_allocations-allocations_before;
+  std::cout<<"Heap allocations after warm-up:"<<n_allocations<<" "<<pool->get_stats().to_string()<<"\n";
+  OHD_TEST_CHECK(n_allocations==0);
+}
+
+int main(int argc, char *argv[]) {
+  test_reuse();
+  test_max_pool_size();
+  test_outlives_pool();
+  test_no_allocations();
+  std::cout<<"Done\n";
+  return 0;
+}
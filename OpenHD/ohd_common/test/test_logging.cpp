@@ -2,10 +2,103 @@
 // Created by consti10 on 19.03.23.
 //
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "openhd_spdlog.h"
+#include "openhd_test_check.hpp"
+#include "openhd_udp_log.h"
+
+// Receives what is forwarded to the telemetry service (like StatusTextAccumulator does)
+static std::vector<std::string> receive_for(int socket_fd,std::chrono::milliseconds duration){
+  std::vector<std::string> ret;
+  const auto begin=std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now()-begin<duration){
+    openhd::log::udp::LogMessage msg{};
+    const auto n=recv(socket_fd,&msg,sizeof(msg),0);
+    if(n==sizeof(msg) && msg.hasNullTerminator()){
+      ret.emplace_back((const char*)msg.message);
+    }
+  }
+  return ret;
+}
+
+static int count_containing(const std::vector<std::string>& messages,const std::string& what){
+  int ret=0;
+  for(const auto& msg:messages){
+    if(msg.find(what)!=std::string::npos)ret++;
+  }
+  return ret;
+}
 
 int main(int argc, char *argv[]) {
   openhd::log::get_default()->debug("Example debug");
   openhd::log::get_default()->warn("Example warn");
+
+  // Any free port - runs while OpenHD (listening on LOCAL_LOG_MESSAGES_UDP_PORT) is running, too
+  const int socket_fd=socket(AF_INET,SOCK_DGRAM,0);
+  OHD_TEST_CHECK(socket_fd>=0);
+  struct sockaddr_in addr{};
+  addr.sin_family=AF_INET;
+  addr.sin_port=0;
+  inet_aton("127.0.0.1",&addr.sin_addr);
+  OHD_TEST_CHECK(bind(socket_fd,(struct sockaddr*)&addr,sizeof(addr))==0);
+  socklen_t addr_len=sizeof(addr);
+  OHD_TEST_CHECK(getsockname(socket_fd,(struct sockaddr*)&addr,&addr_len)==0);
+  openhd::log::udp::set_log_messages_udp_port(ntohs(addr.sin_port));
+  struct timeval tv{0,100*1000};
+  setsockopt(socket_fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+  // Don't spam stdout, only the udp sink is of interest here
+  auto console=openhd::log::create_or_get("burst");
+  console->set_level(spdlog::level::warn);
+  console->sinks().erase(console->sinks().begin());
+
+  // A burst of the same warning from multiple threads, like on link trouble
+  const int n_threads=4;
+  const int n_per_thread=10000;
+  std::vector<std::thread> threads;
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<n_threads;i++){
+    threads.emplace_back([console](){
+      for(int j=0;j<n_per_thread;j++){
+        console->warn("Cannot send data, no fd");
+      }
+    });
+  }
+  for(auto& thread:threads)thread.join();
+  const auto elapsed=std::chrono::steady_clock::now()-begin;
+  std::cout<<"Warn (udp sink only): "<<std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()/(n_threads*n_per_thread)
+           <<" ns/msg\n";
+  auto received=receive_for(socket_fd,std::chrono::seconds(3));
+  std::cout<<"Identical burst: received "<<received.size()<<" messages "<<openhd::log::udp::get_forwarder_stats().to_string()<<"\n";
+  for(const auto& msg:received)std::cout<<" "<<msg<<"\n";
+  // Sent once, then collapsed into "(nx) ..." messages
+  OHD_TEST_CHECK(received.size()<10);
+  OHD_TEST_CHECK(count_containing(received,"x) burst Cannot send data")>=1);
+
+  // Distinct messages are rate limited, and the n of dropped ones is reported
+  for(int i=0;i<1000;i++){
+    console->warn("Distinct {}",i);
+  }
+  received=receive_for(socket_fd,std::chrono::seconds(6));
+  std::cout<<"Distinct burst: received "<<received.size()<<" messages "<<openhd::log::udp::get_forwarder_stats().to_string()<<"\n";
+  OHD_TEST_CHECK(received.size()<100);
+  OHD_TEST_CHECK(count_containing(received,"messages dropped")>=1);
+  const auto stats=openhd::log::udp::get_forwarder_stats();
+  OHD_TEST_CHECK(stats.n_dropped_queue_full+stats.n_dropped_rate_limit+stats.n_deduplicated+stats.n_sent>=n_threads*n_per_thread+1000);
+  // Sent right away on flush (e.g. before a reboot), not only once the forwarder thread gets to it
+  console->warn("Last message");
+  openhd::log::udp::flush_log_messages();
+  received=receive_for(socket_fd,std::chrono::milliseconds(100));
+  OHD_TEST_CHECK(count_containing(received,"Last message")==1);
+  close(socket_fd);
+  std::cout<<"Done\n";
   return 0;
-}
\ No newline at end of file
+}
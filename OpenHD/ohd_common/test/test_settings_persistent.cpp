@@ -0,0 +1,64 @@
+#include <iostream>
+
+#include "openhd_settings_persistent.h"
+#include "openhd_test_check.hpp"
+#include "openhd_util_filesystem.h"
+
+// A GCS setting many params in a row - the changes to the same file are coalesced into one (atomic) write,
+// nothing is lost on flush, and a failed write stays pending until it succeeds.
+// The writes are driven by flush() - with the long write delay, nothing is written in the background.
+int main(int argc, char *argv[]) {
+  const std::string directory="/tmp/openhd_test_settings_persistent/";
+  OHDFilesystemUtil::safe_delete_directory(directory);
+  OHDFilesystemUtil::create_directories(directory);
+  const std::string file_path=directory+"test.json";
+  auto& writer=openhd::PersistentSettingsWriter::instance();
+  writer.set_write_delay(std::chrono::seconds(100));
+
+  const int n_changes=1000;
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<n_changes;i++){
+    writer.schedule_write(file_path,"{\"value\":"+std::to_string(i)+"}");
+  }
+  const auto elapsed=std::chrono::steady_clock::now()-begin;
+  std::cout<<"Schedule write: "<<std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()/n_changes<<" ns/change\n";
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==1);
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file_path));
+  openhd::flush_persistent_settings();
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==0);
+  OHD_TEST_CHECK(OHDFilesystemUtil::read_file(file_path)=="{\"value\":999}");
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file_path+".tmp"));
+
+  // Multiple files
+  writer.schedule_write(file_path,"{\"value\":-1}");
+  writer.schedule_write(directory+"test2.json","{}");
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==2);
+  openhd::flush_persistent_settings();
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==0);
+  OHD_TEST_CHECK(OHDFilesystemUtil::read_file(file_path)=="{\"value\":-1}");
+  OHD_TEST_CHECK(OHDFilesystemUtil::read_file(directory+"test2.json")=="{}");
+  // Nothing pending, returns immediately
+  openhd::flush_persistent_settings();
+
+  // Cannot write into a directory that doesn't exist (yet) - flush returns after the failed attempt, the write stays pending
+  const std::string missing_directory=directory+"missing/";
+  const std::string missing_file_path=missing_directory+"test.json";
+  OHD_TEST_CHECK(!openhd::PersistentSettingsWriter::write_file_atomic(missing_file_path,"{}"));
+  writer.schedule_write(missing_file_path,"{\"value\":1}");
+  openhd::flush_persistent_settings();
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==1);
+  // Fails again, now with the latest change
+  writer.schedule_write(missing_file_path,"{\"value\":2}");
+  openhd::flush_persistent_settings();
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==1);
+  // Once it can be written, the latest change is not lost
+  OHDFilesystemUtil::create_directories(missing_directory);
+  openhd::flush_persistent_settings();
+  OHD_TEST_CHECK(writer.get_n_pending_writes()==0);
+  OHD_TEST_CHECK(OHDFilesystemUtil::read_file(missing_file_path)=="{\"value\":2}");
+
+  std::cout<<writer.get_stats_string()<<"\n";
+  OHDFilesystemUtil::safe_delete_directory(directory);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "openhd_latency_histogram.hpp"
+#include "openhd_test_check.hpp"
+#include "openhd_video_latency_tracer.hpp"
+
+// Checks the percentiles of the latency histogram against known distributions (within the bucket error), that it works
+// when fed from multiple threads, and that the video latency tracer attributes a frame to the right stages and resets
+// each interval.
+
+using namespace std::chrono_literals;
+
+// The histogram reports the upper bound of a bucket - at most ~19% (one quarter of a power of 2) too high, never lower
+static bool is_close(int64_t reported_us,int64_t expected_us){
+  return reported_us>=expected_us && reported_us<=expected_us*1.19+1;
+}
+
+static void test_histogram(){
+  openhd::LatencyHistogram histogram;
+  OHD_TEST_CHECK(histogram.count()==0);
+  OHD_TEST_CHECK(histogram.percentile_us(50)==0);
+  OHD_TEST_CHECK(histogram.avg_us()==0);
+  // 1..1000us, once each
+  for(int us=1;us<=1000;us++){
+    histogram.record(std::chrono::microseconds(us));
+  }
+  std::cout<<"1..1000us "<<histogram.to_string()<<"\n";
+  OHD_TEST_CHECK(histogram.count()==1000);
+  OHD_TEST_CHECK(histogram.avg_us()==500);
+  OHD_TEST_CHECK(histogram.max_us()==1000);
+  OHD_TEST_CHECK(is_close(histogram.percentile_us(50),500));
+  OHD_TEST_CHECK(is_close(histogram.percentile_us(95),950));
+  // Never more than the max
+  OHD_TEST_CHECK(histogram.percentile_us(99)<=1000 && histogram.percentile_us(99)>=990);
+  OHD_TEST_CHECK(histogram.percentile_us(100)==1000);
+  histogram.reset();
+  OHD_TEST_CHECK(histogram.count()==0);
+  OHD_TEST_CHECK(histogram.max_us()==0);
+  // One outlier in 1000 is only visible in p99.9 / max, not in p99
+  for(int i=0;i<999;i++){
+    histogram.record(2ms);
+  }
+  histogram.record(500ms);
+  OHD_TEST_CHECK(is_close(histogram.percentile_us(99),2000));
+  OHD_TEST_CHECK(histogram.max_us()==500*1000);
+  // Negative deltas (e.g. time points from different threads) count as 0, more than ~67s lands in the last bucket
+  histogram.reset();
+  histogram.record(-5ms);
+  histogram.record(100s);
+  OHD_TEST_CHECK(histogram.count()==2);
+  // the first bucket is [0,1]us
+  OHD_TEST_CHECK(histogram.percentile_us(50)<=1);
+  OHD_TEST_CHECK(histogram.max_us()==100*1000*1000);
+}
+
+static void test_histogram_threads(){
+  openhd::LatencyHistogram histogram;
+  const int n_threads=4;
+  const int n_per_thread=100000;
+  std::vector<std::thread> threads;
+  for(int i=0;i<n_threads;i++){
+    threads.emplace_back([&histogram,i](){
+      for(int j=0;j<n_per_thread;j++){
+        histogram.record_us(100*(i+1));
+      }
+    });
+  }
+  for(auto& thread:threads)thread.join();
+  std::cout<<"Threads "<<histogram.to_string()<<"\n";
+  OHD_TEST_CHECK(histogram.count()==n_threads*n_per_thread);
+  OHD_TEST_CHECK(histogram.max_us()==100*n_threads);
+  OHD_TEST_CHECK(histogram.avg_us()==250);
+  OHD_TEST_CHECK(is_close(histogram.percentile_us(50),200));
+}
+
+static void test_tracer(){
+  openhd::VideoLatencyTracer tracer;
+  OHD_TEST_CHECK(tracer.to_string()=="VideoLatency{}");
+  const auto appsink_time=std::chrono::steady_clock::now();
+  for(int i=0;i<100;i++){
+    // 1ms until the end of frame, 3ms until enqueued
+    tracer.record_frame(appsink_time,appsink_time+1ms,appsink_time+4ms);
+  }
+  auto percentiles=tracer.get_percentiles(openhd::VideoLatencyTracer::APPSINK_TO_FRAME_CLOSE);
+  OHD_TEST_CHECK(percentiles.p50_us==1000 && percentiles.p99_us==1000);
+  percentiles=tracer.get_percentiles(openhd::VideoLatencyTracer::FRAME_CLOSE_TO_LINK_ENQUEUE);
+  OHD_TEST_CHECK(percentiles.p50_us==3000);
+  percentiles=tracer.take_percentiles(openhd::VideoLatencyTracer::AIR_TOTAL);
+  OHD_TEST_CHECK(percentiles.p50_us==4000 && percentiles.p95_us==4000);
+  // Not recorded on air
+  OHD_TEST_CHECK(tracer.get_percentiles(openhd::VideoLatencyTracer::GROUND_RECEIVE_TO_FORWARD).p50_us==0);
+  std::cout<<tracer.to_string()<<"\n";
+  OHD_TEST_CHECK(tracer.to_string().find("air_total")==std::string::npos);
+  OHD_TEST_CHECK(tracer.to_string().find("appsink_to_frame_close")!=std::string::npos);
+  // The next interval only has the new values
+  tracer.record_frame(appsink_time,appsink_time+1ms,appsink_time+20ms);
+  percentiles=tracer.take_percentiles(openhd::VideoLatencyTracer::AIR_TOTAL);
+  OHD_TEST_CHECK(percentiles.p50_us==20000);
+  OHD_TEST_CHECK(tracer.take_percentiles(openhd::VideoLatencyTracer::AIR_TOTAL).p99_us==0);
+  // Ground
+  tracer.record(openhd::VideoLatencyTracer::GROUND_RECEIVE_TO_FORWARD,50us);
+  OHD_TEST_CHECK(is_close(tracer.take_percentiles(openhd::VideoLatencyTracer::GROUND_RECEIVE_TO_FORWARD).p50_us,50));
+}
+
+int main(int argc, char *argv[]) {
+  test_histogram();
+  test_histogram_threads();
+  test_tracer();
+  std::cout<<"Done\n";
+  return 0;
+}
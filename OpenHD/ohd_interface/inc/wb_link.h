@@ -3,6 +3,7 @@
 
 #include <array>
 #include <chrono>
+#include <mutex>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -17,9 +18,13 @@
 #include "openhd_profile.h"
 #include "openhd_settings_imp.hpp"
 #include "openhd_spdlog.h"
+#include "openhd_video_latency_tracer.hpp"
+#include "wb_link_channel_scan.h"
+#include "wb_link_rate_controller.h"
 #include "wb_link_settings.hpp"
 #include "wifi_card.h"
 #include "wb_link_work_item.hpp"
+#include "wb_link_work_scheduler.h"
 
 /**
  * This class takes a list of cards supporting monitor mode (only 1 card on air) and
@@ -81,6 +86,10 @@ class WBLink :public OHDLink{
   // Make sure no processes interfering with monitor mode run on the given cards,
   // then sets them to monitor mode
   void takeover_cards_monitor_mode();
+  // Re-enables monitor mode on cards that are not (yet) in monitor mode until all are or timeout (nl80211 only)
+  void wait_for_cards_monitor_mode(std::chrono::steady_clock::duration timeout);
+  // Once all cards report monitor mode (nl80211), wait this long before they are used (opening pcap)
+  static constexpr auto MONITOR_MODE_SETTLE_DELAY=std::chrono::milliseconds(200);
   // set the right frequency, channel width and tx power. Cards need to be in monitor mode already !
   void configure_cards();
   // start telemetry and video rx/tx stream(s)
@@ -93,14 +102,20 @@ class WBLink :public OHDLink{
   std::unique_ptr<WBTransmitter> create_wb_tx(uint8_t radio_port,bool is_video);
   std::unique_ptr<AsyncWBReceiver> create_wb_rx(uint8_t radio_port,WBReceiver::OUTPUT_DATA_CALLBACK cb);
  private:
-  // Recalculate stats, apply settings asynchronously and more
-  void loop_do_work();
+  // Register the periodic tasks (stats, rate adjustment, ...) on the work scheduler
+  void register_periodic_work();
   // update statistics, done in regular intervals, update data is given to the ohd_telemetry module via the action handler
   void update_statistics();
   static constexpr auto RECALCULATE_STATISTICS_INTERVAL=std::chrono::seconds(1);
-  std::chrono::steady_clock::time_point m_last_stats_recalculation=std::chrono::steady_clock::now();
   // Do rate adjustments, does nothing if variable bitrate is disabled
   void perform_rate_adjustment();
+  // Rate adjustment using the closed loop controller (DEV_WB_ADAPTIVE_LINK_CONTROLLER)
+  void perform_rate_adjustment_adaptive();
+  void apply_rate_controller_decision(const openhd::wb::RateController::Decision& decision);
+  // Removes the controller (if any) and re-applies the mcs index / fec percentage set by the user
+  void reset_rate_controller();
+  // Dirty - deliberately crash openhd and let the service restart it if we think a wi-fi card disconnected (disabled)
+  void check_rx_wifi_disconnected();
   void schedule_work_item(const std::shared_ptr<WorkItem>& work_item);
   // We limit changing specific params to one after another
   bool check_work_queue_empty();
@@ -111,6 +126,9 @@ class WBLink :public OHDLink{
   // Called by the camera stream on the air unit only
   // transmit video data via wifibradcast
   void transmit_video_data(int stream_index,const openhd::FragmentedVideoFrame& fragmented_video_frame) override;
+  // Called by the wb receiver(s) on the ground unit only, forwards to on_receive_video_data
+  // and measures how long forwarding took if latency tracing is enabled.
+  void on_receive_video_data_traced(int stream_index,const uint8_t* data,int data_len);
  public:
   // Warning: This operation will block the calling thread for up to X ms.
   // During scan, you cannot change any wb settings
@@ -118,19 +136,44 @@ class WBLink :public OHDLink{
     bool success=false;
     uint32_t frequency =0;
     uint32_t channel_width=0;
+    // metrics, a candidate is a channel + channel width
+    int n_candidates_scanned=0;
+    int n_candidates_total=0;
+    std::chrono::steady_clock::duration scan_duration{};
+    // time until the first packet from an openhd air unit could be decrypted
+    std::optional<std::chrono::steady_clock::duration> opt_time_to_lock;
+    // false while the scan is still running (progress)
+    bool done=false;
   };
   // Testing shows we have to listen for up to 1 second to reliable get data (the wifi card might take some time switching)
+  // This is the max. dwell time, we move on to the next channel(s) as soon as a packet of an openhd air unit
+  // could be decrypted
   static constexpr std::chrono::seconds DEFAULT_SCAN_TIME_PER_CHANNEL{1};
+  // Max time to wait for a packet we can decrypt once we got any packets on a channel
+  static constexpr std::chrono::seconds SCAN_TIMEOUT_CONFIRM_CHANNEL{2};
+  static constexpr std::chrono::milliseconds SCAN_TIME_MEASURE_PACKET_LOSS{1000};
+  static constexpr std::chrono::milliseconds SCAN_POLL_INTERVAL{50};
   // This is a long-running operation during which changing things like frequency and more are disabled.
   // Loop through all possible frequencies + optionally channel widths until we can say with a high certainty
   // we have found a running air unit on this channel. (-> only supported on ground).
+  // If there is more than one card, the channels are split across all cards.
   // On success, apply this frequency.
   // On failure, restore previous state.
   ScanResult scan_channels(const openhd::ActionHandler::ScanChannelsParam& scan_channels_params);
   // queue it up on the work queue
   void async_scan_channels(openhd::ActionHandler::ScanChannelsParam scan_channels_params);
+  // Progress of the currently running scan (updated after each batch of channels), or the result of the last scan.
+  // nullopt if no scan has been started yet. Thread-safe.
+  std::optional<ScanResult> get_scan_result();
  private:
   void reset_all_rx_stats();
+  // Channel scan helper - listens on the channel(s) the cards are currently set to, see openhd::wb::scan_dwell
+  openhd::wb::ScanDwellResult scan_dwell(std::chrono::steady_clock::duration max_dwell);
+  void update_scan_result(const ScanResult& result);
+  std::mutex m_scan_result_mutex;
+  std::optional<ScanResult> m_scan_result;
+  // Channel scan helper - returns true as soon as any packet could be decrypted, false on timeout
+  bool scan_wait_for_decrypted_packets(std::chrono::steady_clock::duration timeout);
   int get_rx_count_p_all();
   int get_rx_count_p_decryption_ok();
   int get_last_rx_packet_chan_width();
@@ -151,6 +194,11 @@ class WBLink :public OHDLink{
   const std::vector<WiFiCard> m_broadcast_cards;
   // disable all openhd frequency checking - note that I am quite sure about the correctness of openhd internal checking in regards to wifi channels ;)
   const bool m_disable_all_frequency_checks;
+  // See DEV_VIDEO_LATENCY_TRACING, one tracer for primary and secondary video
+  const bool m_enable_latency_tracing;
+  std::array<openhd::VideoLatencyTracer,2> m_video_latency_tracers;
+  // See DEV_WB_ADAPTIVE_LINK_CONTROLLER, only used on air
+  const bool m_enable_adaptive_link_controller;
   std::shared_ptr<openhd::ActionHandler> m_opt_action_handler=nullptr;
   std::shared_ptr<spdlog::logger> m_console;
   std::unique_ptr<openhd::WBStreamsSettingsHolder> m_settings;
@@ -164,17 +212,25 @@ class WBLink :public OHDLink{
   std::atomic<bool> is_scanning=false;
   // We have one worker thread for asynchronously performing operation(s) like changing the frequency
   // but also recalculating statistics that are then forwarded to openhd_telemetry for broadcast
-  bool m_work_thread_run;
-  std::unique_ptr<std::thread> m_work_thread;
-  std::mutex m_work_item_queue_mutex;
-  std::queue<std::shared_ptr<WorkItem>> m_work_item_queue;
+  std::unique_ptr<WorkScheduler> m_work_scheduler;
+  // scheduler stats are logged in a lower interval than the link stats
+  static constexpr auto LOG_WORK_SCHEDULER_STATS_INTERVAL=std::chrono::seconds(10);
   // These are for variable bitrate / tx error reduces bitrate
   static constexpr auto RATE_ADJUSTMENT_INTERVAL=std::chrono::seconds(1);
-  std::chrono::steady_clock::time_point m_last_rate_adjustment=std::chrono::steady_clock::now();
   int64_t m_last_total_tx_error_count=0;
   int m_n_detected_and_reset_tx_errors=0;
   uint32_t m_max_video_rate_for_current_wifi_config =0;
   uint32_t m_recommended_video_bitrate=0;
+  // These are for the adaptive link controller, re-created whenever the user changes one of the settings it was created with
+  // Upper limit of the FEC overhead the controller may use (the fec percentage set by the user is the lower limit).
+  // 100% doubles the video tx rate, the recommended encoder bitrate is lowered accordingly.
+  static constexpr int ADAPTIVE_LINK_MAX_FEC_PERCENTAGE=100;
+  std::unique_ptr<openhd::wb::RateController> m_rate_controller;
+  std::array<int,4> m_rate_controller_settings_key{};
+  std::optional<int> m_rate_controller_mcs_index;
+  // latest feedback from the ground, set by telemetry
+  std::mutex m_ground_link_feedback_mutex;
+  std::optional<openhd::link_statistics::GroundLinkFeedback> m_ground_link_feedback;
   // Set to true when armed, disarmed by default
   // Used to differentiate between different tx power levels when armed / disarmed
   bool m_is_armed= false;
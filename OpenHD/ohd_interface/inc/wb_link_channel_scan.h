@@ -0,0 +1,50 @@
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_CHANNEL_SCAN_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_CHANNEL_SCAN_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "wifi_channel.h"
+
+// The card scheduling and the adaptive dwell of WBLink::scan_channels, without the wifibroadcast rx instances,
+// such that it can be tested without a wifi card (see test_wb_link_channel_scan).
+namespace openhd::wb{
+
+// A channel + channel width we listen on
+struct ScanCandidate{
+  openhd::WifiChannel channel;
+  uint32_t channel_width;
+};
+
+// Splits the candidates into batches, each card listens on a different candidate of the batch
+// (element i of a batch is the candidate for card i). Cards left over in the last batch listen on
+// the first candidate of the batch.
+std::vector<std::vector<ScanCandidate>> split_scan_candidates(const std::vector<ScanCandidate>& candidates,int n_cards);
+
+struct ScanDwellResult{
+  // n of packets the tele / video rx of the link got on each card during the dwell
+  std::vector<int> n_packets_per_card;
+  // true if a packet for the link could be decrypted (valid wifibroadcast session) on any of the cards
+  bool valid_session=false;
+};
+struct ScanDwellIO{
+  // cumulative n of packets the tele / video rx of the link got on each card
+  std::function<std::vector<int>()> get_n_packets_per_card;
+  // true once a packet could be decrypted since the dwell began
+  std::function<bool()> has_valid_session;
+  std::function<void(std::chrono::steady_clock::duration)> sleep;
+};
+// Listens (polls every poll_interval) until a packet for the link could be decrypted on any of the cards
+// (early exit) or max_dwell has elapsed.
+ScanDwellResult scan_dwell(const ScanDwellIO& io,std::chrono::steady_clock::duration max_dwell,
+                           std::chrono::steady_clock::duration poll_interval);
+
+// Indices (into the batch) of the candidates worth confirming - the ones whose card got packets, most packets first.
+// If the link was found but no card can be told apart (e.g. more cards than per card stats), all of them.
+std::vector<int> get_scan_candidates_to_confirm(const ScanDwellResult& dwell_result,int batch_size);
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_CHANNEL_SCAN_H_
@@ -0,0 +1,126 @@
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_RATE_CONTROLLER_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_RATE_CONTROLLER_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace openhd::wb{
+
+/**
+ * Closed loop controller for the air video link (opt-in via DEV_WB_ADAPTIVE_LINK_CONTROLLER in hardware.config).
+ * Once per interval it is fed with a Sample of the link stats and jointly picks
+ * 1) the MCS index (between min_mcs and the mcs index set by the user, which acts as the upper limit)
+ * 2) the FEC overhead (between the fec percentage set by the user, which acts as the lower limit, and max_fec_percentage)
+ * 3) the recommended encoder bitrate (what's left of the max rate for 1) after 2), scaled down on tx queue overflow)
+ * Inputs are the FEC blocks lost / recovered and rssi reported by the ground unit (forwarded via telemetry) and the
+ * local tx errors / dropped packets (the tx queue overflowing is the only hint of its fill level we have).
+ * Changes need a couple of consecutive bad / good intervals (hysteresis), stepping down is faster than stepping up
+ * and after each change there is a short cooldown for the stats to settle.
+ * Deterministic (no clock, no randomness, no logging) - such that recorded traces can be replayed,
+ * see test_wb_link_rate_controller.
+ */
+class RateController{
+ public:
+  struct Config{
+    int min_mcs=0;
+    // the mcs index set by the user
+    int max_mcs=3;
+    // the fec percentage set by the user
+    int min_fec_percentage=20;
+    // upper limit, see WBLink::ADAPTIVE_LINK_MAX_FEC_PERCENTAGE
+    int max_fec_percentage=100;
+    int fec_percentage_step=20;
+    uint32_t min_bitrate_kbits=2000;
+    // max (video+fec) rate the card can do for a given mcs index
+    std::function<uint32_t(int mcs_index)> get_max_rate_for_mcs_kbits;
+    // n of consecutive bad intervals before we step down
+    int n_bad_intervals_step_down=2;
+    // n of consecutive good intervals before we step up
+    int n_good_intervals_step_up=5;
+    // n of intervals nothing is changed after a change
+    int n_cooldown_intervals=2;
+    // FEC blocks that could not be recovered
+    double lost_blocks_bad_perc=1.0;
+    // FEC blocks that needed recovery - lots of recovered blocks means we are close to loosing some
+    double recovered_blocks_warn_perc=15.0;
+    double recovered_blocks_good_perc=3.0;
+    // how much the rssi needs to be above the sensitivity of the next higher mcs before we step up
+    int rssi_margin_step_up_db=6;
+    // ground feedback older than that is ignored (we never step up without recent ground feedback)
+    int n_intervals_ground_feedback_stale=3;
+  };
+  // Cumulative counters, as reported by the stats
+  struct GroundFeedback{
+    uint64_t count_blocks_total=0;
+    uint64_t count_blocks_lost=0;
+    uint64_t count_blocks_recovered=0;
+    // best rssi of all ground rx cards, INT8_MIN if unknown
+    int8_t rx_rssi=INT8_MIN;
+  };
+  struct Sample{
+    // Cumulative counters of the air video tx instance(s)
+    uint64_t count_tx_injections_error_hint=0;
+    uint64_t count_tx_dropped_packets=0;
+    // uplink rssi measured on air, INT8_MIN if unknown. Used if there is no rssi from the ground.
+    int8_t air_rx_rssi=INT8_MIN;
+    // Latest feedback from the ground, if any. Reports without any new FEC blocks (e.g. the same report twice) are ignored.
+    std::optional<GroundFeedback> ground;
+    // Single line, used for recording / replaying traces
+    [[nodiscard]] std::string to_csv()const;
+    static std::optional<Sample> from_csv(const std::string& line);
+  };
+  struct Decision{
+    int mcs_index;
+    int fec_percentage;
+    uint32_t recommended_bitrate_kbits;
+    bool mcs_changed=false;
+    bool fec_changed=false;
+    bool bitrate_changed=false;
+    // What the controller thinks of the link / why it changed something, for debugging
+    std::string reason;
+    [[nodiscard]] bool any_changed()const{
+      return mcs_changed || fec_changed || bitrate_changed;
+    }
+    [[nodiscard]] std::string to_string()const;
+  };
+  explicit RateController(Config config);
+  // Start with the most aggressive config (user mcs, user fec) and the max bitrate for it
+  Decision reset();
+  Decision on_new_sample(const Sample& sample);
+  [[nodiscard]] const Config& get_config()const{
+    return m_config;
+  }
+  // Roughly what a 802.11n card needs to decode a given mcs index (20Mhz), in dBm
+  static int rssi_sensitivity_for_mcs(int mcs_index);
+ private:
+  enum class LinkState{
+    GOOD,
+    // Still working, but close to the limit - e.g. a lot of blocks need recovery
+    MARGINAL,
+    BAD
+  };
+  [[nodiscard]] uint32_t calculate_bitrate()const;
+  Decision make_decision(std::string reason,int prev_mcs,int prev_fec,uint32_t prev_bitrate);
+ private:
+  const Config m_config;
+  int m_mcs_index;
+  int m_fec_percentage;
+  // 1.0 = all of the theoretical video rate for the current mcs / fec, reduced on tx queue overflow
+  double m_bitrate_factor=1.0;
+  uint32_t m_bitrate_kbits=0;
+  int m_n_consecutive_bad=0;
+  int m_n_consecutive_marginal=0;
+  int m_n_consecutive_good=0;
+  int m_cooldown=0;
+  int m_n_intervals_since_ground_feedback=INT32_MAX/2;
+  std::optional<Sample> m_last_sample;
+  std::optional<GroundFeedback> m_last_ground_feedback;
+  int8_t m_last_ground_rssi=INT8_MIN;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_RATE_CONTROLLER_H_
@@ -5,6 +5,9 @@
 #ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_WORK_ITEM_H_
 #define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_WORK_ITEM_H_
 
+#include <chrono>
+#include <functional>
+
 // I took this pattern from MAVSDK.
 // A work item refers to some task that is queued up for a worker thread to handle
 class WorkItem{
@@ -22,6 +25,9 @@ class WorkItem{
   bool ready_to_be_executed(){
     return std::chrono::steady_clock::now()>=m_earliest_execution_time;
   }
+  [[nodiscard]] std::chrono::steady_clock::time_point get_earliest_execution_time()const{
+    return m_earliest_execution_time;
+  }
  private:
   const std::chrono::steady_clock::time_point m_earliest_execution_time;
   const std::function<void()> m_work;
@@ -0,0 +1,98 @@
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_WORK_SCHEDULER_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_WORK_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_latency_histogram.hpp"
+#include "openhd_spdlog.h"
+#include "wb_link_work_item.hpp"
+
+/**
+ * Worker thread for the wb link (frequency changes, channel scan, statistics, rate adjustment, ...).
+ * Sleeps on a condition variable until the next deadline (instead of polling) - one-shot work items
+ * run as soon as their earliest_execution_time is reached, all items that are due are drained at once,
+ * periodic tasks are registered as timers with a fixed interval.
+ * Work items and timers are executed on the worker thread without holding the queue lock, such that
+ * scheduling new work from within a work item (or from any other thread) never blocks.
+ */
+class WorkScheduler{
+ public:
+  struct Stats{
+    // n of one-shot items waiting for execution (not counting the one(s) currently executing)
+    int queue_depth=0;
+    int max_queue_depth=0;
+    uint64_t n_wakeups=0;
+    uint64_t n_executed_work_items=0;
+    uint64_t n_executed_timers=0;
+    // time from when an item / timer was due to when it actually started executing
+    int64_t lateness_avg_us=0;
+    int64_t lateness_p99_us=0;
+    int64_t lateness_max_us=0;
+    [[nodiscard]] std::string to_string()const;
+  };
+  explicit WorkScheduler(std::string tag);
+  ~WorkScheduler();
+  WorkScheduler(const WorkScheduler&)=delete;
+  WorkScheduler(WorkScheduler&&)=delete;
+  // Thread-safe, wakes up the worker if the item is due before anything else
+  void schedule_work_item(std::shared_ptr<WorkItem> work_item);
+  /**
+   * Register a task that is executed every @param interval (first execution after one interval).
+   * If the worker falls behind (e.g. blocked by a long channel scan), missed executions are skipped
+   * instead of being run back to back.
+   */
+  void register_periodic_timer(std::string name,std::chrono::steady_clock::duration interval,std::function<void()> task);
+  // True if there is no one-shot work item queued up or currently executing
+  bool is_idle();
+  // Blocks until is_idle() (all the queued work items are executed), false on timeout
+  bool wait_until_idle(std::chrono::steady_clock::duration timeout);
+  [[nodiscard]] Stats get_stats();
+ private:
+  struct QueuedItem{
+    std::chrono::steady_clock::time_point deadline;
+    // Items with the same deadline are executed in the order they were scheduled in
+    uint64_t sequence_nr;
+    std::shared_ptr<WorkItem> item;
+    bool operator>(const QueuedItem& other)const{
+      if(deadline==other.deadline)return sequence_nr>other.sequence_nr;
+      return deadline>other.deadline;
+    }
+  };
+  struct PeriodicTimer{
+    std::string name;
+    std::chrono::steady_clock::duration interval;
+    std::function<void()> task;
+    std::chrono::steady_clock::time_point next_deadline;
+  };
+  void loop();
+  // Returns the earliest deadline of all items and timers, nullopt if there is nothing to do
+  std::optional<std::chrono::steady_clock::time_point> next_deadline_locked();
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  // notified each time the worker finished executing the due items, for wait_until_idle
+  std::condition_variable m_idle_cv;
+  std::priority_queue<QueuedItem,std::vector<QueuedItem>,std::greater<>> m_queue;
+  std::vector<PeriodicTimer> m_timers;
+  uint64_t m_sequence_nr=0;
+  int m_n_executing_work_items=0;
+  int m_max_queue_depth=0;
+  uint64_t m_n_wakeups=0;
+  uint64_t m_n_executed_work_items=0;
+  uint64_t m_n_executed_timers=0;
+  openhd::LatencyHistogram m_lateness;
+  bool m_run=true;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WB_LINK_WORK_SCHEDULER_H_
@@ -5,10 +5,15 @@
 #ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_CHANNEL_H_
 #define OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_CHANNEL_H_
 
+#include <cassert>
+#include <optional>
 #include <sstream>
 #include <vector>
 #include <cstdint>
 
+#include "openhd_spdlog.h"
+#include "openhd_util.h"
+
 // NOTE: DO NOT USE CHANNEL NUMBERS ANYWHERE IN CODE - USE FREQUENCIES IN MHZ, SINCE THEY ARE UNIQUE
 namespace openhd {
 
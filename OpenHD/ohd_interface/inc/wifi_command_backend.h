@@ -0,0 +1,50 @@
+#ifndef OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_COMMAND_BACKEND_H_
+#define OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_COMMAND_BACKEND_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "wifi_command_helper2.h"
+
+// Runtime selection between the iw / ip commands (wifi_command_helper, default) and nl80211 (wifi_command_helper2)
+// for everything we do frequently / during startup with the wifibroadcast cards.
+// If a nl80211 command fails, the same command is retried via iw / ip - the iw / ip path is battle-tested on all the
+// drivers we support, netlink is the fast path.
+// All calls are timed, see get_stats_string().
+namespace wifi::backend{
+
+// The iw / ip path, see wifi_command_helper.h
+class ShellCommands{
+ public:
+  virtual ~ShellCommands()=default;
+  virtual bool set_card_state(const std::string &device, bool up);
+  virtual bool enable_monitor_mode(const std::string &device);
+  virtual bool set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width);
+  virtual bool set_tx_power(const std::string &device, uint32_t tx_power_mBm);
+};
+
+// Use nl80211 if use_netlink==true and nl80211 is available, iw / ip otherwise.
+// Optionally, a transport and / or the iw / ip commands can be given (testing),
+// otherwise the kernel / the real iw and ip commands are used.
+void select(bool use_netlink,std::shared_ptr<commandhelper2::NetlinkTransport> opt_transport=nullptr,
+            std::shared_ptr<ShellCommands> opt_shell_commands=nullptr);
+bool is_netlink_active();
+
+bool set_card_state(const std::string &device, bool up);
+// card down, monitor mode (otherbss), card up
+bool enable_monitor_mode(const std::string &device);
+// nullopt if unknown (not supported via iw / ip)
+std::optional<bool> is_monitor_mode(const std::string &device);
+bool set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width);
+bool set_tx_power(const std::string &device, uint32_t tx_power_mBm);
+
+// Timing of all the calls above since the last select(), per operation
+std::string get_stats_string();
+// n of nl80211 commands that failed and were retried via iw / ip
+int get_n_fallbacks();
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_COMMAND_BACKEND_H_
@@ -6,35 +6,74 @@
 #define OPENHD_OPENHD_OHD_INTERFACE_SRC_WIFI_COMMAND_HELPER2_H_
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <optional>
 #include <vector>
 
-// Pretty much taken from https://github.com/webbbn/wifibroadcast_bridge/blob/9220947fd01f6aaf58adc271037b550ce5385b1e/src/raw_socket.cc
-// has some advantages over using the "run terminal commands" approach -
-// iw and so forth just call the apropriate nl method(s). So we could skip the (quite dirty) "linux run command" workaround and can
-// properly evaluate any error codes.
+#include "openhd_spdlog.h"
+
+// Talk to the wifi card(s) via nl80211 directly - iw and so forth just call the appropriate nl80211 method(s).
+// So we can skip the (quite dirty and slow) "linux run command" workaround and can properly evaluate any error codes.
 // e.g. see https://github.com/Distrotech/iw
+// Written against the raw generic netlink socket api (no libnl dependency).
+// The socket part is hidden behind NetlinkTransport such that it can be replaced by a fake in tests (no wifi card needed).
 namespace wifi::commandhelper2{
 
-bool set_wifi_up_down(const std::string &device, bool up);
+// A netlink attribute (type + raw payload), nested attributes are serialized into the payload
+struct NlAttribute{
+  uint16_t type;
+  std::vector<uint8_t> payload;
+  bool is_nested=false;
+  static NlAttribute u32(uint16_t type,uint32_t value);
+  static NlAttribute flag(uint16_t type);
+  static NlAttribute nested(uint16_t type,const std::vector<NlAttribute>& children);
+  // nullopt if the payload is not a u32
+  [[nodiscard]] std::optional<uint32_t> as_u32()const;
+  [[nodiscard]] std::vector<NlAttribute> as_nested()const;
+};
 
-// Set wifi down
-// then enables monitor mode
-// Set wifi up
-// Returns true on success, false otherwise
-bool set_wifi_monitor_mode(const std::string &device);
+// Serialize / parse a list of attributes (incl. padding), as used in netlink messages
+std::vector<uint8_t> serialize_attributes(const std::vector<NlAttribute>& attributes);
+std::vector<NlAttribute> parse_attributes(const uint8_t* data,int data_len);
+std::optional<uint32_t> find_u32(const std::vector<NlAttribute>& attributes,uint16_t type);
 
-// set frequency and optionally also the channel width if given
-// also see https://github.com/Distrotech/iw/blob/fe424b2465118eca166b2e901b5a378bf9582fb0/phy.c#L33
-bool set_wifi_frequency(const std::string &device, uint32_t freq_mhz,std::optional<uint32_t> channel_width=std::nullopt);
-bool set_wifi_frequency_and_log_result(const std::string &device, uint32_t freq_mhz,std::optional<uint32_t> channel_width=std::nullopt);
+class NetlinkTransport{
+ public:
+  virtual ~NetlinkTransport()=default;
+  // 0 if there is no interface with this name
+  virtual int get_ifindex(const std::string& device)=0;
+  // returns 0 on success, -errno otherwise
+  virtual int set_interface_up(const std::string& device,bool up)=0;
+  // Send a nl80211 command and wait for the ack of the kernel.
+  // If the kernel replies with data (e.g. GET_ commands), the attributes of the reply are written to opt_reply.
+  // returns 0 on success, -errno otherwise
+  virtual int nl80211_request(uint8_t cmd,const std::vector<NlAttribute>& attributes,std::vector<NlAttribute>* opt_reply)=0;
+};
 
-bool exp_set_wifi_frequency(const std::string& device,uint32_t freq_mhz);
+// Talks to the kernel, returns nullptr if nl80211 is not available
+std::shared_ptr<NetlinkTransport> create_kernel_transport();
 
-// See https://elixir.bootlin.com/linux/latest/source/include/uapi/linux/nl80211.h#L1905
-// NOTE: even linux seems to have no idea what mBm means - rtl8812au interprets that not as milli(1000)dBm, but dBm/100
-bool set_wifi_txpower(const std::string &device, uint32_t tx_power_mBm);
+// The nl80211 equivalents of the iw / ip commands in wifi_command_helper.h
+class Nl80211Backend{
+ public:
+  explicit Nl80211Backend(std::shared_ptr<NetlinkTransport> transport);
+  // ip link set dev <devname> up/down
+  bool set_card_state(const std::string &device, bool up);
+  // iw dev <devname> set monitor otherbss, the card needs to be down
+  bool set_monitor_mode(const std::string &device);
+  // nullopt if the type cannot be queried
+  std::optional<bool> is_monitor_mode(const std::string &device);
+  // iw dev <devname> set freq <freq> [5MHz|10MHz|HT20|HT40+]
+  bool set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width);
+  // iw dev <devname> set txpower fixed <tx power in mBm>
+  bool set_tx_power(const std::string &device, uint32_t tx_power_mBm);
+ private:
+  // 0 and logs a warning if the device doesn't exist
+  int get_ifindex_or_warn(const std::string &device);
+  std::shared_ptr<NetlinkTransport> m_transport;
+  std::shared_ptr<spdlog::logger> m_console;
+};
 
 }
 
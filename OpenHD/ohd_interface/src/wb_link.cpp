@@ -1,6 +1,6 @@
 #include "wb_link.h"
 #include "wifi_command_helper.h"
-//#include "wifi_command_helper2.h"
+#include "wifi_command_backend.h"
 
 #include <utility>
 
@@ -10,6 +10,7 @@
 #include "openhd_util_filesystem.h"
 #include "openhd_reboot_util.h"
 #include "openhd_bitrate_conversions.hpp"
+#include "openhd_config.h"
 #include "wb_link_helper.h"
 #include "wifi_card.h"
 
@@ -25,6 +26,8 @@ WBLink::WBLink(OHDProfile profile,OHDPlatform platform,std::vector<WiFiCard> bro
       m_platform(platform),
       m_broadcast_cards(std::move(broadcast_cards)),
       m_disable_all_frequency_checks(openhd::wb::disable_all_frequency_checks()),
+      m_enable_latency_tracing(openhd::load_config().DEV_VIDEO_LATENCY_TRACING),
+      m_enable_adaptive_link_controller(openhd::load_config().DEV_WB_ADAPTIVE_LINK_CONTROLLER),
       m_opt_action_handler(std::move(opt_action_handler))
 {
   m_console = openhd::log::create_or_get("wb_streams");
@@ -58,8 +61,8 @@ WBLink::WBLink(OHDProfile profile,OHDPlatform platform,std::vector<WiFiCard> bro
   configure_cards();
   configure_telemetry();
   configure_video();
-  m_work_thread_run = true;
-  m_work_thread =std::make_unique<std::thread>(&WBLink::loop_do_work, this);
+  m_work_scheduler=std::make_unique<WorkScheduler>("wb_work");
+  register_periodic_work();
   if(m_opt_action_handler){
         auto cb_scan=[this](openhd::ActionHandler::ScanChannelsParam param){
           async_scan_channels(param);
@@ -73,6 +76,13 @@ WBLink::WBLink(OHDProfile profile,OHDPlatform platform,std::vector<WiFiCard> bro
           update_arming_state(armed);
         };
         m_opt_action_handler->m_action_tx_power_when_armed=std::make_shared<openhd::ActionHandler::ACTION_TX_POWER_WHEN_ARMED>(cb_arm);
+        if(m_profile.is_air && m_enable_adaptive_link_controller){
+          auto cb_feedback=[this](openhd::link_statistics::GroundLinkFeedback feedback){
+            std::lock_guard<std::mutex> guard(m_ground_link_feedback_mutex);
+            m_ground_link_feedback=feedback;
+          };
+          m_opt_action_handler->action_ground_link_feedback_register(cb_feedback);
+        }
   }
   // exp
   /*const auto t_radio_port_rx = m_profile.is_air ? openhd::TELEMETRY_WIFIBROADCAST_RX_RADIO_PORT : openhd::TELEMETRY_WIFIBROADCAST_TX_RADIO_PORT;
@@ -92,11 +102,10 @@ WBLink::~WBLink() {
     m_opt_action_handler->action_wb_link_scan_channels_register(nullptr);
     m_opt_action_handler->action_on_ony_rc_channel_register(nullptr);
     m_opt_action_handler->m_action_tx_power_when_armed= nullptr;
+    m_opt_action_handler->action_ground_link_feedback_register(nullptr);
   }
-  if(m_work_thread){
-    m_work_thread_run =false;
-    m_work_thread->join();
-  }
+  // stops the worker thread, queued up work items are dropped
+  m_work_scheduler.reset();
   // stop all the receiver/transmitter instances, after that, give card back to network manager
   m_wb_tele_rx.reset();
   m_wb_tele_tx.reset();
@@ -111,6 +120,8 @@ WBLink::~WBLink() {
 
 void WBLink::takeover_cards_monitor_mode() {
   m_console->debug( "takeover_cards_monitor_mode() begin");
+  const auto begin=std::chrono::steady_clock::now();
+  wifi::backend::select(openhd::load_config().DEV_WIFI_NETLINK_BACKEND);
   // We need to take "ownership" from the system over the cards used for monitor mode / wifibroadcast.
   // This can be different depending on the OS we are running on - in general, we try to go for the following with openhd:
   // Have network manager running on the host OS - the nice thing about network manager is that we can just tell it
@@ -121,20 +132,49 @@ void WBLink::takeover_cards_monitor_mode() {
     wifi::commandhelper::nmcli_set_device_managed_status(card.device_name, false);
   }
   wifi::commandhelper::rfkill_unblock_all();
-  // TODO: sometimes this happens:
-  // 1) Running openhd fist time: pcap_compile doesn't work (fatal error)
-  // 2) Running openhd second time: works
-  // I cannot find what's causing the issue - a sleep here is the worst solution, but r.n the only one I can come up with
-  // perhaps we'd need to wait for network manager to finish switching to ignoring the monitor mode cards ?!
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+  if(!wifi::backend::is_netlink_active()){
+    // TODO: sometimes this happens:
+    // 1) Running openhd fist time: pcap_compile doesn't work (fatal error)
+    // 2) Running openhd second time: works
+    // I cannot find what's causing the issue - a sleep here is the worst solution, but r.n the only one I can come up with
+    // perhaps we'd need to wait for network manager to finish switching to ignoring the monitor mode cards ?!
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
   // now we can enable monitor mode on the given cards.
   for(const auto& card: m_broadcast_cards) {
-    wifi::commandhelper::ip_link_set_card_state(card.device_name, false);
-    wifi::commandhelper::iw_enable_monitor_mode(card.device_name);
-    wifi::commandhelper::ip_link_set_card_state(card.device_name, true);
-    //wifi::commandhelper2::set_wifi_monitor_mode(card->_wifi_card.interface_name);
+    wifi::backend::enable_monitor_mode(card.device_name);
+  }
+  if(wifi::backend::is_netlink_active()){
+    // With nl80211 we can check the card(s) are actually in monitor mode instead of the blind sleep above -
+    // if network manager wasn't done yet and took the card back, enable monitor mode again.
+    wait_for_cards_monitor_mode(std::chrono::seconds(1));
+    // The iftype being monitor doesn't guarantee the card is ready for pcap yet (see the pcap_compile issue above,
+    // which the blind sleep works around) - keep a short settle delay instead of none.
+    std::this_thread::sleep_for(MONITOR_MODE_SETTLE_DELAY);
+  }
+  const auto delta=std::chrono::steady_clock::now()-begin;
+  m_console->debug("takeover_cards_monitor_mode() end, took {} {}",MyTimeHelper::R(delta),wifi::backend::get_stats_string());
+}
+
+void WBLink::wait_for_cards_monitor_mode(const std::chrono::steady_clock::duration timeout) {
+  const auto begin=std::chrono::steady_clock::now();
+  while(true){
+    bool all_monitor_mode=true;
+    for(const auto& card: m_broadcast_cards) {
+      const auto monitor_mode=wifi::backend::is_monitor_mode(card.device_name);
+      if(monitor_mode.has_value() && !monitor_mode.value()){
+        m_console->debug("{} not in monitor mode",card.device_name);
+        wifi::backend::enable_monitor_mode(card.device_name);
+        all_monitor_mode=false;
+      }
+    }
+    if(all_monitor_mode)return;
+    if(std::chrono::steady_clock::now()-begin>=timeout){
+      m_console->warn("Card(s) not in monitor mode after {}",MyTimeHelper::R(timeout));
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
-  m_console->debug("takeover_cards_monitor_mode() end");
 }
 
 void WBLink::configure_cards() {
@@ -169,10 +209,10 @@ void WBLink::configure_video() {
   } else {
     // we receive video
     auto cb1=[this](const uint8_t* data,int data_len){
-      on_receive_video_data(0,data,data_len);
+      on_receive_video_data_traced(0,data,data_len);
     };
     auto cb2=[this](const uint8_t* data,int data_len){
-      on_receive_video_data(1,data,data_len);
+      on_receive_video_data_traced(1,data,data_len);
     };
     auto primary = create_wb_rx(openhd::VIDEO_PRIMARY_RADIO_PORT,cb1);
     primary->start_async();
@@ -303,7 +343,9 @@ bool WBLink::request_set_frequency(int frequency) {
 }
 
 bool WBLink::apply_frequency_and_channel_width(uint32_t frequency, uint32_t channel_width) {
+  const auto begin=std::chrono::steady_clock::now();
   const auto res=openhd::wb::set_frequency_and_channel_width_for_all_cards(frequency,channel_width,m_broadcast_cards);
+  m_console->debug("Changing frequency took {}",MyTimeHelper::R(std::chrono::steady_clock::now()-begin));
   // TODO: R.n I am not sure if and how you need / even can set it either via radiotap or "iw"
   apply_all_tx_instances([channel_width](WBTransmitter& tx){
 	tx.update_channel_width(channel_width);
@@ -328,10 +370,10 @@ void WBLink::apply_txpower() {
         pwr_index=settings.wb_rtl8812au_tx_pwr_idx_armed;
       }
       m_console->debug("RTL8812AU tx_pwr_idx_override: {}",pwr_index);
-      wifi::commandhelper::iw_set_tx_power(card.device_name,pwr_index);
+      wifi::backend::set_tx_power(card.device_name,pwr_index);
     }else{
       const auto tmp=openhd::milli_watt_to_mBm(settings.wb_tx_power_milli_watt);
-      wifi::commandhelper::iw_set_tx_power(card.device_name,tmp);
+      wifi::backend::set_tx_power(card.device_name,tmp);
     }
   }
   const auto delta=std::chrono::steady_clock::now()-before;
@@ -530,54 +572,41 @@ static uint32_t get_micros(std::chrono::nanoseconds ns){
   return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(ns).count());
 }
 
-void WBLink::loop_do_work() {
-  while (m_work_thread_run){
-    // Perform any queued up work if it exists
-    {
-      m_work_item_queue_mutex.lock();
-      if(!m_work_item_queue.empty()){
-        auto front=m_work_item_queue.front();
-        if(front->ready_to_be_executed()){
-          front->execute();
-          m_work_item_queue.pop();
-        }
-      }
-      m_work_item_queue_mutex.unlock();
-    }
-    // update statistics in regular intervals
+void WBLink::register_periodic_work() {
+  // update statistics in regular intervals
+  m_work_scheduler->register_periodic_timer("stats",RECALCULATE_STATISTICS_INTERVAL,[this](){
     update_statistics();
-    //const auto delta_calc_stats=std::chrono::steady_clock::now()-begin_calculate_stats;
-    //m_console->debug("Calculating stats took:{} ms",std::chrono::duration_cast<std::chrono::microseconds>(delta_calc_stats).count()/1000.0f);
-    // update recommended rate if enabled in regular intervals
+  });
+  // update recommended rate if enabled in regular intervals
+  m_work_scheduler->register_periodic_timer("rate_adjustment",RATE_ADJUSTMENT_INTERVAL,[this](){
     perform_rate_adjustment();
-    // Dirty - deliberately crash openhd and let the service restart it
-    // if we think a wi-fi card disconnected
-    bool any_rx_wifi_disconnected_errors=false;
-    if(m_wb_tele_rx->get_latest_stats().wb_rx_stats.n_receiver_likely_disconnect_errors>100){
+    check_rx_wifi_disconnected();
+  });
+  m_work_scheduler->register_periodic_timer("scheduler_stats",LOG_WORK_SCHEDULER_STATS_INTERVAL,[this](){
+    m_console->debug("{}",m_work_scheduler->get_stats().to_string());
+  });
+}
+
+void WBLink::check_rx_wifi_disconnected() {
+  bool any_rx_wifi_disconnected_errors=false;
+  if(m_wb_tele_rx->get_latest_stats().wb_rx_stats.n_receiver_likely_disconnect_errors>100){
+    any_rx_wifi_disconnected_errors= true;
+  }
+  for(auto& rx: m_wb_video_rx_list){
+    if(rx->get_latest_stats().wb_rx_stats.n_receiver_likely_disconnect_errors>100){
       any_rx_wifi_disconnected_errors= true;
     }
-    for(auto& rx: m_wb_video_rx_list){
-      if(rx->get_latest_stats().wb_rx_stats.n_receiver_likely_disconnect_errors>100){
-        any_rx_wifi_disconnected_errors= true;
-      }
-    }
-    //if(any_rx_wifi_disconnected_errors){
-    //  openhd::fatalerror::handle_needs_openhd_restart("wifi disconnected");
-    //}
-    std::this_thread::sleep_for(std::chrono::milliseconds (100));
   }
+  //if(any_rx_wifi_disconnected_errors){
+  //  openhd::fatalerror::handle_needs_openhd_restart("wifi disconnected");
+  //}
 }
 
 void WBLink::update_statistics() {
-  const auto elapsed_since_last=std::chrono::steady_clock::now()-m_last_stats_recalculation;
-  if(elapsed_since_last<RECALCULATE_STATISTICS_INTERVAL){
-    return;
-  }
   if(m_foreign_packets_receiver){
     const auto stats=m_foreign_packets_receiver->get_current_stats();
     m_console->debug("Foreign packets stats:{}",stats.to_string());
   }
-  m_last_stats_recalculation=std::chrono::steady_clock::now();
   // telemetry is available on both air and ground
   openhd::link_statistics::StatsAirGround stats{};
   if(m_wb_tele_tx){
@@ -592,7 +621,7 @@ void WBLink::update_statistics() {
   }
   if(m_profile.is_air){
     // video on air
-    for(int i=0;i< m_wb_video_tx_list.size();i++){
+    for(size_t i=0;i< m_wb_video_tx_list.size();i++){
       auto& wb_tx= *m_wb_video_tx_list.at(i);
       //auto& air_video=i==0 ? stats.air_video0 : stats.air_video1;
       const auto curr_tx_stats=wb_tx.get_latest_stats();
@@ -615,13 +644,20 @@ void WBLink::update_statistics() {
       air_video.curr_fec_block_size_min=curr_tx_fec_stats.curr_fec_block_length.min;
       air_video.curr_fec_block_size_max=curr_tx_fec_stats.curr_fec_block_length.max;
       air_video.curr_fec_block_size_avg=curr_tx_fec_stats.curr_fec_block_length.avg;
-      air_video.curr_wb_mcs_index=m_settings->unsafe_get_settings().wb_mcs_index;
+      air_video.curr_wb_mcs_index=m_rate_controller_mcs_index.value_or(m_settings->unsafe_get_settings().wb_mcs_index);
+      if(m_enable_latency_tracing && i<m_video_latency_tracers.size()){
+        auto& tracer=m_video_latency_tracers.at(i);
+        m_console->debug("Video{} {}",i,tracer.to_string());
+        air_video.curr_latency_appsink_to_frame_close=tracer.take_percentiles(openhd::VideoLatencyTracer::APPSINK_TO_FRAME_CLOSE);
+        air_video.curr_latency_frame_close_to_enqueue=tracer.take_percentiles(openhd::VideoLatencyTracer::FRAME_CLOSE_TO_LINK_ENQUEUE);
+        air_video.curr_latency_air_total=tracer.take_percentiles(openhd::VideoLatencyTracer::AIR_TOTAL);
+      }
       // TODO otimization: Only send stats for an active link
       stats.stats_wb_video_air.push_back(air_video);
     }
   }else{
     // video on ground
-    for(int i=0;i< m_wb_video_rx_list.size();i++){
+    for(size_t i=0;i< m_wb_video_rx_list.size();i++){
       auto& wb_rx= *m_wb_video_rx_list.at(i);
       const auto wb_rx_stats=wb_rx.get_latest_stats();
       //if(wb_rx_stats.wb_rx_stats.last_received_packet_mcs_index>=0){
@@ -641,6 +677,11 @@ void WBLink::update_statistics() {
         ground_video.curr_fec_decode_time_min_us =get_micros(fec_stats.curr_fec_decode_time.min);
         ground_video.curr_fec_decode_time_max_us =get_micros(fec_stats.curr_fec_decode_time.max);
       }
+      if(m_enable_latency_tracing && i<m_video_latency_tracers.size()){
+        auto& tracer=m_video_latency_tracers.at(i);
+        m_console->debug("Video{} {}",i,tracer.to_string());
+        ground_video.curr_latency_receive_to_forward=tracer.take_percentiles(openhd::VideoLatencyTracer::GROUND_RECEIVE_TO_FORWARD);
+      }
       // TODO otimization: Only send stats for an active link
       stats.stats_wb_video_ground.push_back(ground_video);
     }
@@ -713,14 +754,15 @@ void WBLink::update_statistics() {
 void WBLink::perform_rate_adjustment() {
   // Rate adjustment is done on air and only if enabled
   if(!(m_profile.is_air && m_settings->get_settings().enable_wb_video_variable_bitrate)){
+    reset_rate_controller();
     return;
   }
-  // We do it at a fixed interval
-  const auto elapsed_since_last=std::chrono::steady_clock::now()-m_last_rate_adjustment;
-  if(elapsed_since_last<RATE_ADJUSTMENT_INTERVAL){
+  // Called at a fixed interval (RATE_ADJUSTMENT_INTERVAL) by the work scheduler
+  if(m_enable_adaptive_link_controller){
+    perform_rate_adjustment_adaptive();
     return;
   }
-  m_last_rate_adjustment=std::chrono::steady_clock::now();
+  reset_rate_controller();
   // First we calculate the theoretical rate for the current "wifi config" aka taking mcs index, channel width, ... into account
   const auto settings = m_settings->get_settings();
   const auto wifi_space=openhd::get_space_from_frequency(settings.wb_frequency);
@@ -787,6 +829,93 @@ void WBLink::perform_rate_adjustment() {
   }
 }
 
+void WBLink::perform_rate_adjustment_adaptive() {
+  const auto settings = m_settings->get_settings();
+  const std::array<int,4> settings_key{(int)settings.wb_frequency,(int)settings.wb_channel_width,
+                                       (int)settings.wb_mcs_index,(int)settings.wb_video_fec_percentage};
+  if(!m_rate_controller || m_rate_controller_settings_key!=settings_key){
+    // The user's mcs index / fec percentage are the limits the controller works within
+    openhd::wb::RateController::Config config{};
+    config.max_mcs=static_cast<int>(settings.wb_mcs_index);
+    config.min_mcs=all_cards_support_setting_mcs_index(m_broadcast_cards) ? 0 : config.max_mcs;
+    config.min_fec_percentage=static_cast<int>(settings.wb_video_fec_percentage);
+    config.max_fec_percentage=std::max(config.min_fec_percentage,ADAPTIVE_LINK_MAX_FEC_PERCENTAGE);
+    const auto card=m_broadcast_cards.at(0);
+    const auto wifi_space=openhd::get_space_from_frequency(settings.wb_frequency);
+    const bool is_40Mhz=settings.wb_channel_width == 40;
+    config.get_max_rate_for_mcs_kbits=[card,wifi_space,is_40Mhz](int mcs_index){
+      return openhd::wb::get_max_rate_possible(card,wifi_space,mcs_index,is_40Mhz);
+    };
+    m_console->debug("Adaptive link controller mcs:[{},{}] fec:[{},{}]",config.min_mcs,config.max_mcs,
+                     config.min_fec_percentage,config.max_fec_percentage);
+    m_rate_controller=std::make_unique<openhd::wb::RateController>(config);
+    m_rate_controller_settings_key=settings_key;
+    apply_rate_controller_decision(m_rate_controller->reset());
+    return;
+  }
+  openhd::wb::RateController::Sample sample{};
+  for(const auto& tx: m_wb_video_tx_list){
+    const auto tx_stats=tx->get_latest_stats();
+    sample.count_tx_injections_error_hint+=tx_stats.count_tx_injections_error_hint;
+    sample.count_tx_dropped_packets+=tx_stats.n_dropped_packets;
+  }
+  // air always has exactly one card
+  sample.air_rx_rssi=m_wb_tele_rx->get_latest_stats().stats_per_card.at(0).rssi_for_wifi_card.last_rssi;
+  {
+    std::lock_guard<std::mutex> guard(m_ground_link_feedback_mutex);
+    if(m_ground_link_feedback.has_value()){
+      const auto& feedback=m_ground_link_feedback.value();
+      sample.ground=openhd::wb::RateController::GroundFeedback{feedback.count_blocks_total,feedback.count_blocks_lost,
+                                                              feedback.count_blocks_recovered,feedback.best_rx_rssi};
+      m_ground_link_feedback=std::nullopt;
+    }
+  }
+  // Can be replayed with test_wb_link_rate_controller
+  m_console->debug("rate_ctrl_sample,{}",sample.to_csv());
+  apply_rate_controller_decision(m_rate_controller->on_new_sample(sample));
+}
+
+void WBLink::apply_rate_controller_decision(const openhd::wb::RateController::Decision& decision) {
+  if(decision.any_changed()){
+    m_console->info("{}",decision.to_string());
+  }
+  // Not persisted - the settings are the limits, these are the currently used values
+  if(decision.mcs_changed){
+    const int mcs_index=decision.mcs_index;
+    apply_all_tx_instances([mcs_index](WBTransmitter& tx){
+      tx.update_mcs_index(mcs_index);
+    });
+  }
+  if(decision.fec_changed){
+    for(auto& tx: m_wb_video_tx_list){
+      tx->update_fec_percentage(decision.fec_percentage);
+    }
+  }
+  m_rate_controller_mcs_index=decision.mcs_index;
+  m_recommended_video_bitrate=decision.recommended_bitrate_kbits;
+  // Same as without the controller, we constantly recommend a bitrate to the encoder / camera
+  if (m_opt_action_handler) {
+    openhd::ActionHandler::LinkBitrateInformation lb{};
+    lb.recommended_encoder_bitrate_kbits = static_cast<int>(m_recommended_video_bitrate);
+    m_opt_action_handler->action_request_bitrate_change_handle(lb);
+  }
+}
+
+void WBLink::reset_rate_controller() {
+  if(!m_rate_controller)return;
+  m_rate_controller=nullptr;
+  m_rate_controller_mcs_index=std::nullopt;
+  const auto settings = m_settings->get_settings();
+  m_console->info("Adaptive link controller disabled, mcs:{} fec:{}",settings.wb_mcs_index,settings.wb_video_fec_percentage);
+  const int mcs_index=static_cast<int>(settings.wb_mcs_index);
+  apply_all_tx_instances([mcs_index](WBTransmitter& tx){
+    tx.update_mcs_index(mcs_index);
+  });
+  for(auto& tx: m_wb_video_tx_list){
+    tx->update_fec_percentage(settings.wb_video_fec_percentage);
+  }
+}
+
 bool WBLink::set_enable_wb_video_variable_bitrate(int value) {
   if(openhd::validate_yes_or_no(value)){
     // value is read in regular intervals.
@@ -805,13 +934,11 @@ bool WBLink::set_max_fec_block_size_for_platform(int value) {
 }
 
 void WBLink::schedule_work_item(const std::shared_ptr<WorkItem>& work_item) {
-  std::lock_guard<std::mutex> guard(m_work_item_queue_mutex);
-  m_work_item_queue.push(work_item);
+  m_work_scheduler->schedule_work_item(work_item);
 }
 
 bool WBLink::check_work_queue_empty() {
-  std::lock_guard<std::mutex> guard(m_work_item_queue_mutex);
-  if(!m_work_item_queue.empty()){
+  if(!m_work_scheduler->is_idle()){
     m_console->info("Rejecting param, another change is still queued up");
     return false;
   }
@@ -848,12 +975,28 @@ void WBLink::transmit_video_data(int stream_index,const openhd::FragmentedVideoF
     }else{
       tx.try_enqueue_block(fragmented_video_frame.frame_fragments, 100);
     }
+    if(m_enable_latency_tracing && fragmented_video_frame.opt_trace_appsink_time.has_value()){
+      m_video_latency_tracers.at(stream_index).record_frame(fragmented_video_frame.opt_trace_appsink_time.value(),
+                                                           fragmented_video_frame.creation_time,std::chrono::steady_clock::now());
+    }
   }else{
     m_console->debug("Invalid camera stream_index {}",stream_index);
   }
 }
 
+void WBLink::on_receive_video_data_traced(int stream_index,const uint8_t* data,int data_len) {
+  if(!m_enable_latency_tracing){
+    on_receive_video_data(stream_index,data,data_len);
+    return;
+  }
+  const auto before=std::chrono::steady_clock::now();
+  on_receive_video_data(stream_index,data,data_len);
+  m_video_latency_tracers.at(stream_index).record(openhd::VideoLatencyTracer::GROUND_RECEIVE_TO_FORWARD,
+                                                 std::chrono::steady_clock::now()-before);
+}
+
 WBLink::ScanResult WBLink::scan_channels(const openhd::ActionHandler::ScanChannelsParam& params){
+  const auto scan_begin=std::chrono::steady_clock::now();
   const WiFiCard& card=m_broadcast_cards.at(0);
   std::vector<openhd::WifiChannel> channels_to_scan;
   if(params.check_2g_channels_if_card_support && card.supports_2GHz()){
@@ -879,6 +1022,17 @@ WBLink::ScanResult WBLink::scan_channels(const openhd::ActionHandler::ScanChanne
     m_console->warn("No channel_widths to scan, return early");
     return {};
   }
+  // All possible channels and all possible channel widths (20 or 40Mhz only right now),
+  // skipping channels / frequencies the card(s) don't support anyways
+  std::vector<openhd::wb::ScanCandidate> candidates;
+  for(const auto& channel:channels_to_scan){
+    if(!openhd::wb::cards_support_frequency(channel.frequency,m_broadcast_cards,m_platform, m_console)){
+      continue;
+    }
+    for(const auto& channel_width:channel_widths_to_scan){
+      candidates.push_back(openhd::wb::ScanCandidate{channel,channel_width});
+    }
+  }
   is_scanning=true;
   // Issue / bug with RTL8812AU: Apparently the adapter sometimes receives data from a frequency that is not correct
   // (e.g. when the air is set to 5700 and the rx listens on frequency  5540 ) but with an incredibly high packet loss.
@@ -890,60 +1044,86 @@ WBLink::ScanResult WBLink::scan_channels(const openhd::ActionHandler::ScanChanne
     int packet_loss_perc=0;
   };
   std::vector<TmpResult> possible_frequencies{};
+  // With more than one rx card (ground), each card listens on a different channel - if any of them picks up packets,
+  // all cards are set to this channel to check if those packets are actually from an openhd air unit.
+  const int n_cards=static_cast<int>(m_broadcast_cards.size());
+  const auto batches=openhd::wb::split_scan_candidates(candidates,n_cards);
   // Note: We intentionally do not modify the persistent settings here
-  m_console->debug("Channel scan, time per channel:{}ms N channels to scan:{} N channel widths to scan:{}",
-                   std::chrono::duration_cast<std::chrono::milliseconds>(DEFAULT_SCAN_TIME_PER_CHANNEL).count(),
-                   channels_to_scan.size(),channel_widths_to_scan.size());
+  m_console->debug("Channel scan, N channels to scan:{} N channel widths to scan:{} N cards:{} N batches:{}",
+                   channels_to_scan.size(),channel_widths_to_scan.size(),n_cards,batches.size());
+  ScanResult result{};
+  result.n_candidates_total=static_cast<int>(candidates.size());
+  update_scan_result(result);
+  std::optional<std::chrono::steady_clock::duration> time_to_first_packets;
   bool done_early=false;
-  // We need to loop through all possible channels
-  for(const auto& channel:channels_to_scan){
+  for(const auto& batch:batches){
     if(done_early)break;
-    // and all possible channel widths (20 or 40Mhz only right now)
-    for(const auto& channel_width:channel_widths_to_scan){
-      // Return early in some cases (e.g. when we have a low loss and are quite certain about a frequency)
+    const int batch_size=std::min(n_cards,result.n_candidates_total-result.n_candidates_scanned);
+    for(int i=0;i<n_cards;i++){
+      const auto& candidate=batch.at(i);
+      openhd::wb::set_frequency_and_channel_width_for_all_cards(candidate.channel.frequency,candidate.channel_width,{m_broadcast_cards.at(i)});
+      m_console->debug("Scanning [{}] {}Mhz@{}Mhz on {}",candidate.channel.channel,candidate.channel.frequency,
+                       candidate.channel_width,m_broadcast_cards.at(i).device_name);
+    }
+    result.n_candidates_scanned+=batch_size;
+    // Adaptive dwell - move on as soon as a packet of an openhd air unit could be decrypted,
+    // otherwise listen for up to DEFAULT_SCAN_TIME_PER_CHANNEL
+    const auto dwell_result=scan_dwell(DEFAULT_SCAN_TIME_PER_CHANNEL);
+    for(const int i:openhd::wb::get_scan_candidates_to_confirm(dwell_result,batch_size)){
       if(done_early)break;
-      // Skip channels / frequencies the card doesn't support anyways
-      if(!openhd::wb::cards_support_frequency(channel.frequency,m_broadcast_cards,m_platform, m_console)){
-        continue;
+      const auto& candidate=batch.at(i);
+      if(!time_to_first_packets.has_value()){
+        time_to_first_packets=std::chrono::steady_clock::now()-scan_begin;
       }
-      // set new frequency, reset the packet count, sleep, then check if any openhd packets have been received
-      apply_frequency_and_channel_width(channel.frequency,channel_width);
-      m_console->warn("Scanning [{}] {}Mhz@{}Mhz",channel.channel,channel.frequency,channel_width);
-      reset_all_rx_stats();
-      std::this_thread::sleep_for(DEFAULT_SCAN_TIME_PER_CHANNEL);
-      const int n_packets= get_rx_count_p_all();
+      // We got packets on this frequency, but it is not guaranteed those packets are from an openhd air unit
+      // (and with more than one card, we don't know which card decrypted them).
+      // Set all cards to it, then wait until we can decrypt a packet (valid wb session) or time out
+      apply_frequency_and_channel_width(candidate.channel.frequency,candidate.channel_width);
+      const bool got_decrypted_packets=scan_wait_for_decrypted_packets(SCAN_TIMEOUT_CONFIRM_CHANNEL);
       // We might receive 20Mhz channel width packets from a air unit sending on 20Mhz channel width while
       // receiving on 40Mhz channel width - if we were to then to set the gnd to 40Mhz, we will be able to receive data,
       // but not be able to send any data up to the air unit.
       const int rx_chann_width=get_last_rx_packet_chan_width();
-      m_console->debug("Got {} packets on {}@{}",n_packets,channel.frequency,rx_chann_width);
-      if(n_packets>0){
-        // We got packets on this frequency, but it is not guaranteed those packets are from an openhd air unit.
-        // sleep a bit more, then check if we actually got any decrypted packets
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        const int n_packets_decrypted= get_rx_count_p_decryption_ok();
-        const int packet_loss=m_wb_video_rx_list.at(0)->get_latest_stats().wb_rx_stats.curr_packet_loss_percentage;
-        m_console->debug("Got {} decrypted packets on frequency {} with {} packet loss",n_packets_decrypted,channel.frequency,packet_loss);
-        if(n_packets_decrypted>0 && rx_chann_width==channel_width){
-          TmpResult tmp_result{channel,channel_width,packet_loss};
-          possible_frequencies.push_back(tmp_result);
-          if(packet_loss<10){
-            // if the packet loss is low, we can safely return early
-            m_console->debug("Got <10% packet loss, return early");
-            done_early= true;
-          }else{
-            m_console->warn("Got >10% packet loss,continue and select most likely at the end");
-          }
-        }
+      m_console->debug("Got {} packets on {}@{}, decrypted:{} rx channel width:{}",dwell_result.n_packets_per_card.at(i),
+                       candidate.channel.frequency,candidate.channel_width,OHDUtil::yes_or_no(got_decrypted_packets),rx_chann_width);
+      if(!got_decrypted_packets || rx_chann_width!=static_cast<int>(candidate.channel_width)){
+        continue;
+      }
+      if(!result.opt_time_to_lock.has_value()){
+        result.opt_time_to_lock=std::chrono::steady_clock::now()-scan_begin;
+      }
+      // Listen a bit longer to get a meaningful packet loss
+      std::this_thread::sleep_for(SCAN_TIME_MEASURE_PACKET_LOSS);
+      const int packet_loss=m_wb_video_rx_list.at(0)->get_latest_stats().wb_rx_stats.curr_packet_loss_percentage;
+      m_console->debug("Got {} decrypted packets on frequency {} with {} packet loss",get_rx_count_p_decryption_ok(),
+                       candidate.channel.frequency,packet_loss);
+      TmpResult tmp_result{candidate.channel,candidate.channel_width,packet_loss};
+      possible_frequencies.push_back(tmp_result);
+      if(packet_loss<10){
+        // if the packet loss is low, we can safely return early
+        m_console->debug("Got <10% packet loss, return early");
+        done_early= true;
+      }else{
+        m_console->warn("Got >10% packet loss,continue and select most likely at the end");
       }
     }
-  }
-  ScanResult result{};
+    result.scan_duration=std::chrono::steady_clock::now()-scan_begin;
+    update_scan_result(result);
+    m_console->debug("Scan progress {}/{} elapsed:{}",result.n_candidates_scanned,result.n_candidates_total,
+                     MyTimeHelper::R(result.scan_duration));
+  }
+  result.scan_duration=std::chrono::steady_clock::now()-scan_begin;
+  m_console->debug("Scan took {}, scanned {}/{}, time to first packets:{} time to lock:{}",
+                   MyTimeHelper::R(result.scan_duration),result.n_candidates_scanned,result.n_candidates_total,
+                   time_to_first_packets.has_value() ? MyTimeHelper::R(time_to_first_packets.value()) : std::string("-"),
+                   result.opt_time_to_lock.has_value() ? MyTimeHelper::R(result.opt_time_to_lock.value()) : std::string("-"));
   if(possible_frequencies.empty()){
     m_console->warn("Channel scan failure, restore local settings");
-    apply_frequency_and_channel_width_from_settings();
     result.success= false;
     result.frequency=0;
+    result.done=true;
+    update_scan_result(result);
+    apply_frequency_and_channel_width_from_settings();
   }else{
     m_console->debug("Channel scan success, possible frequencies {}",possible_frequencies.size());
     auto best=possible_frequencies.at(0);
@@ -957,6 +1137,8 @@ WBLink::ScanResult WBLink::scan_channels(const openhd::ActionHandler::ScanChanne
     result.success= true;
     result.frequency=best.channel.frequency;
     result.channel_width=best.channel_width;
+    result.done=true;
+    update_scan_result(result);
     m_settings->unsafe_get_settings().wb_frequency=result.frequency;
     m_settings->unsafe_get_settings().wb_channel_width=result.channel_width;
     m_settings->persist();
@@ -967,6 +1149,55 @@ WBLink::ScanResult WBLink::scan_channels(const openhd::ActionHandler::ScanChanne
   return result;
 }
 
+openhd::wb::ScanDwellResult WBLink::scan_dwell(const std::chrono::steady_clock::duration max_dwell) {
+  const int n_cards=static_cast<int>(m_broadcast_cards.size());
+  openhd::wb::ScanDwellIO io{};
+  io.get_n_packets_per_card=[this,n_cards](){
+    std::vector<int> ret(n_cards,0);
+    // Only the tele / video rx of the link, and the stats only exist for the first few cards
+    for(auto& rx:get_rx_list()){
+      const auto rx_stats=rx->get_latest_stats();
+      const int n_cards_with_stats=std::min(n_cards,static_cast<int>(rx_stats.stats_per_card.size()));
+      for(int i=0;i<n_cards_with_stats;i++){
+        ret.at(i)+=static_cast<int>(rx_stats.stats_per_card.at(i).count_received_packets);
+      }
+    }
+    return ret;
+  };
+  io.has_valid_session=[this](){
+    // A packet can only be decrypted once we got the session key packet of the air unit
+    return get_rx_count_p_decryption_ok()>0;
+  };
+  io.sleep=[](std::chrono::steady_clock::duration duration){
+    std::this_thread::sleep_for(duration);
+  };
+  reset_all_rx_stats();
+  return openhd::wb::scan_dwell(io,max_dwell,SCAN_POLL_INTERVAL);
+}
+
+void WBLink::update_scan_result(const ScanResult& result) {
+  std::lock_guard<std::mutex> guard(m_scan_result_mutex);
+  m_scan_result=result;
+}
+
+std::optional<WBLink::ScanResult> WBLink::get_scan_result() {
+  std::lock_guard<std::mutex> guard(m_scan_result_mutex);
+  return m_scan_result;
+}
+
+bool WBLink::scan_wait_for_decrypted_packets(const std::chrono::steady_clock::duration timeout) {
+  reset_all_rx_stats();
+  const auto begin=std::chrono::steady_clock::now();
+  while(std::chrono::steady_clock::now()-begin<timeout){
+    std::this_thread::sleep_for(SCAN_POLL_INTERVAL);
+    // A packet can only be decrypted once we got the session key packet of the air unit
+    if(get_rx_count_p_decryption_ok()>0){
+      return true;
+    }
+  }
+  return false;
+}
+
 void WBLink::async_scan_channels(openhd::ActionHandler::ScanChannelsParam scan_channels_params) {
   if(!check_work_queue_empty()){
     m_console->warn("Rejecting async_scan_channels, work queue busy");
@@ -0,0 +1,57 @@
+#include "wb_link_channel_scan.h"
+
+#include <algorithm>
+#include <cassert>
+
+std::vector<std::vector<openhd::wb::ScanCandidate>> openhd::wb::split_scan_candidates(
+    const std::vector<ScanCandidate>& candidates,int n_cards) {
+  assert(n_cards>0);
+  std::vector<std::vector<ScanCandidate>> ret;
+  for(size_t batch_begin=0;batch_begin<candidates.size();batch_begin+=n_cards){
+    const size_t batch_size=std::min(static_cast<size_t>(n_cards),candidates.size()-batch_begin);
+    std::vector<ScanCandidate> batch;
+    for(int i=0;i<n_cards;i++){
+      batch.push_back(candidates.at(batch_begin+(i<static_cast<int>(batch_size) ? i : 0)));
+    }
+    ret.push_back(batch);
+  }
+  return ret;
+}
+
+openhd::wb::ScanDwellResult openhd::wb::scan_dwell(const ScanDwellIO& io,const std::chrono::steady_clock::duration max_dwell,
+                                                   const std::chrono::steady_clock::duration poll_interval) {
+  // Packets received while the card(s) were still on the previous channel don't count
+  const auto begin_count=io.get_n_packets_per_card();
+  ScanDwellResult ret{};
+  ret.n_packets_per_card.resize(begin_count.size(),0);
+  std::chrono::steady_clock::duration elapsed{0};
+  while(elapsed<max_dwell){
+    io.sleep(poll_interval);
+    elapsed+=poll_interval;
+    const auto curr_count=io.get_n_packets_per_card();
+    for(size_t i=0;i<ret.n_packets_per_card.size() && i<curr_count.size();i++){
+      ret.n_packets_per_card[i]=curr_count[i]-begin_count[i];
+    }
+    // Any packets are not enough to move on early - e.g. the RTL8812AU sometimes picks up packets of a different
+    // frequency, and there might be other wifi traffic. Only a packet we can decrypt means an openhd air unit.
+    if(io.has_valid_session()){
+      ret.valid_session=true;
+      break;
+    }
+  }
+  return ret;
+}
+
+std::vector<int> openhd::wb::get_scan_candidates_to_confirm(const ScanDwellResult& dwell_result,int batch_size) {
+  std::vector<int> ret;
+  for(int i=0;i<batch_size && i<static_cast<int>(dwell_result.n_packets_per_card.size());i++){
+    if(dwell_result.n_packets_per_card[i]>0)ret.push_back(i);
+  }
+  std::stable_sort(ret.begin(),ret.end(),[&dwell_result](int lhs,int rhs){
+    return dwell_result.n_packets_per_card[lhs]>dwell_result.n_packets_per_card[rhs];
+  });
+  if(ret.empty() && dwell_result.valid_session){
+    for(int i=0;i<batch_size;i++)ret.push_back(i);
+  }
+  return ret;
+}
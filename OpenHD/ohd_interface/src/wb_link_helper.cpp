@@ -4,8 +4,7 @@
 
 #include "wb_link_helper.h"
 
-#include "wifi_command_helper.h"
-//#include "wifi_command_helper2.h"
+#include "wifi_command_backend.h"
 
 bool openhd::wb::disable_all_frequency_checks() {
   static constexpr auto FIlE_DISABLE_ALL_FREQUENCY_CHECKS="/boot/openhd/disable_all_frequency_checks.txt";
@@ -74,8 +73,7 @@ bool openhd::wb::set_frequency_and_channel_width_for_all_cards(
     const std::vector<WiFiCard>& m_broadcast_cards) {
   bool ret=true;
   for(const auto& card: m_broadcast_cards){
-    const bool success=wifi::commandhelper::iw_set_frequency_and_channel_width(card.device_name,frequency,channel_width);
-    //const bool success=wifi::commandhelper2::set_wifi_frequency_and_log_result(card->get_wifi_card().interface_name,frequency,channel_width);
+    const bool success=wifi::backend::set_frequency_and_channel_width(card.device_name,frequency,channel_width);
     if(!success){
       ret=false;
     }
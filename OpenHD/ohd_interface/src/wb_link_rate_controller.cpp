@@ -0,0 +1,240 @@
+#include "wb_link_rate_controller.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+
+// Returns 0 if the counter went backwards (e.g. the ground unit restarted)
+static uint64_t counter_delta(uint64_t curr,uint64_t last){
+  return curr>=last ? curr-last : 0;
+}
+
+std::string openhd::wb::RateController::Sample::to_csv() const {
+  std::stringstream ss;
+  ss<<count_tx_injections_error_hint<<","<<count_tx_dropped_packets<<","<<static_cast<int>(air_rx_rssi)<<",";
+  if(ground.has_value()){
+    ss<<"1,"<<ground->count_blocks_total<<","<<ground->count_blocks_lost<<","<<ground->count_blocks_recovered<<","
+       <<static_cast<int>(ground->rx_rssi);
+  }else{
+    ss<<"0,0,0,0,"<<INT8_MIN;
+  }
+  return ss.str();
+}
+
+std::optional<openhd::wb::RateController::Sample> openhd::wb::RateController::Sample::from_csv(const std::string& line) {
+  std::vector<int64_t> values;
+  std::stringstream ss(line);
+  std::string item;
+  while(std::getline(ss,item,',')){
+    try{
+      values.push_back(std::stoll(item));
+    }catch(...){
+      return std::nullopt;
+    }
+  }
+  if(values.size()!=8)return std::nullopt;
+  Sample ret{};
+  ret.count_tx_injections_error_hint=values[0];
+  ret.count_tx_dropped_packets=values[1];
+  ret.air_rx_rssi=static_cast<int8_t>(values[2]);
+  if(values[3]!=0){
+    GroundFeedback ground{};
+    ground.count_blocks_total=values[4];
+    ground.count_blocks_lost=values[5];
+    ground.count_blocks_recovered=values[6];
+    ground.rx_rssi=static_cast<int8_t>(values[7]);
+    ret.ground=ground;
+  }
+  return ret;
+}
+
+std::string openhd::wb::RateController::Decision::to_string() const {
+  std::stringstream ss;
+  ss<<"RateCtrl{mcs:"<<mcs_index<<(mcs_changed ? "*":"")<<" fec:"<<fec_percentage<<(fec_changed ? "*":"")
+     <<" bitrate:"<<recommended_bitrate_kbits<<"kBit/s"<<(bitrate_changed ? "*":"")<<" "<<reason<<"}";
+  return ss.str();
+}
+
+openhd::wb::RateController::RateController(Config config):m_config(std::move(config)) {
+  assert(m_config.get_max_rate_for_mcs_kbits);
+  assert(m_config.min_mcs<=m_config.max_mcs);
+  assert(m_config.min_fec_percentage<=m_config.max_fec_percentage);
+  m_mcs_index=m_config.max_mcs;
+  m_fec_percentage=m_config.min_fec_percentage;
+  m_bitrate_kbits=calculate_bitrate();
+}
+
+openhd::wb::RateController::Decision openhd::wb::RateController::reset() {
+  m_mcs_index=m_config.max_mcs;
+  m_fec_percentage=m_config.min_fec_percentage;
+  m_bitrate_factor=1.0;
+  m_n_consecutive_bad=0;
+  m_n_consecutive_marginal=0;
+  m_n_consecutive_good=0;
+  m_cooldown=m_config.n_cooldown_intervals;
+  m_n_intervals_since_ground_feedback=INT32_MAX/2;
+  m_last_sample=std::nullopt;
+  m_last_ground_feedback=std::nullopt;
+  m_last_ground_rssi=INT8_MIN;
+  m_bitrate_kbits=calculate_bitrate();
+  Decision ret{m_mcs_index,m_fec_percentage,m_bitrate_kbits,true,true,true,"reset"};
+  return ret;
+}
+
+int openhd::wb::RateController::rssi_sensitivity_for_mcs(int mcs_index) {
+  static constexpr int SENSITIVITY[]={-82,-79,-77,-74,-70,-66,-65,-64};
+  mcs_index=std::clamp(mcs_index,0,7);
+  return SENSITIVITY[mcs_index];
+}
+
+uint32_t openhd::wb::RateController::calculate_bitrate() const {
+  const auto max_rate=static_cast<double>(m_config.get_max_rate_for_mcs_kbits(m_mcs_index));
+  // same as deduce_fec_overhead()
+  const double max_video_rate=max_rate*100.0/(100.0+m_fec_percentage);
+  const auto ret=static_cast<uint32_t>(std::round(max_video_rate*m_bitrate_factor));
+  return std::max(ret,m_config.min_bitrate_kbits);
+}
+
+openhd::wb::RateController::Decision openhd::wb::RateController::make_decision(std::string reason,int prev_mcs,int prev_fec,uint32_t prev_bitrate) {
+  m_bitrate_kbits=calculate_bitrate();
+  Decision ret{m_mcs_index,m_fec_percentage,m_bitrate_kbits};
+  ret.mcs_changed=m_mcs_index!=prev_mcs;
+  ret.fec_changed=m_fec_percentage!=prev_fec;
+  ret.bitrate_changed=m_bitrate_kbits!=prev_bitrate;
+  ret.reason=std::move(reason);
+  if(ret.any_changed()){
+    m_n_consecutive_bad=0;
+    m_n_consecutive_marginal=0;
+    m_n_consecutive_good=0;
+    m_cooldown=m_config.n_cooldown_intervals;
+  }
+  return ret;
+}
+
+openhd::wb::RateController::Decision openhd::wb::RateController::on_new_sample(const Sample& sample) {
+  const int prev_mcs=m_mcs_index;
+  const int prev_fec=m_fec_percentage;
+  const uint32_t prev_bitrate=m_bitrate_kbits;
+  // local tx
+  uint64_t delta_tx_errors=0;
+  uint64_t delta_tx_dropped=0;
+  if(m_last_sample.has_value()){
+    delta_tx_errors=counter_delta(sample.count_tx_injections_error_hint,m_last_sample->count_tx_injections_error_hint);
+    delta_tx_dropped=counter_delta(sample.count_tx_dropped_packets,m_last_sample->count_tx_dropped_packets);
+  }
+  m_last_sample=sample;
+  // ground feedback
+  bool has_ground_data=false;
+  double lost_perc=0;
+  double recovered_perc=0;
+  bool new_ground_data=false;
+  if(sample.ground.has_value()){
+    const auto& ground=sample.ground.value();
+    m_last_ground_rssi=ground.rx_rssi;
+    if(!m_last_ground_feedback.has_value() || ground.count_blocks_total<m_last_ground_feedback->count_blocks_total){
+      // first feedback, or the ground unit restarted
+      new_ground_data=true;
+    }else{
+      const auto delta_total=ground.count_blocks_total-m_last_ground_feedback->count_blocks_total;
+      // The same report twice or no video being received at all - we cannot say anything about the link quality then
+      if(delta_total>0){
+        const auto delta_lost=counter_delta(ground.count_blocks_lost,m_last_ground_feedback->count_blocks_lost);
+        const auto delta_recovered=counter_delta(ground.count_blocks_recovered,m_last_ground_feedback->count_blocks_recovered);
+        lost_perc=static_cast<double>(delta_lost)*100.0/static_cast<double>(delta_total);
+        recovered_perc=static_cast<double>(delta_recovered)*100.0/static_cast<double>(delta_total);
+        has_ground_data=true;
+        new_ground_data=true;
+      }
+    }
+    if(new_ground_data){
+      m_last_ground_feedback=ground;
+    }
+  }
+  if(new_ground_data){
+    m_n_intervals_since_ground_feedback=0;
+  }else{
+    m_n_intervals_since_ground_feedback++;
+  }
+  const bool ground_fresh=m_n_intervals_since_ground_feedback<=m_config.n_intervals_ground_feedback_stale;
+  // The rssi on the ground is what matters for the video link, the air rssi is only an estimate (same path, other direction)
+  const int8_t rssi=(ground_fresh && m_last_ground_rssi!=INT8_MIN) ? m_last_ground_rssi : sample.air_rx_rssi;
+  const bool has_rssi=rssi!=INT8_MIN;
+  // classify the link
+  const bool tx_overflow=delta_tx_errors>0 || delta_tx_dropped>0;
+  // (the rssi alone is not a reason to do anything once we are at the lowest mcs)
+  const bool rf_bad=(has_ground_data && lost_perc>=m_config.lost_blocks_bad_perc) ||
+                      (has_rssi && rssi<rssi_sensitivity_for_mcs(m_mcs_index) && m_mcs_index>m_config.min_mcs);
+  const bool rf_marginal=(has_ground_data && recovered_perc>=m_config.recovered_blocks_warn_perc);
+  const bool rf_good=has_ground_data && lost_perc<=0 && recovered_perc<m_config.recovered_blocks_good_perc;
+  LinkState state;
+  if(rf_bad || tx_overflow){
+    state=LinkState::BAD;
+    m_n_consecutive_bad++;
+    m_n_consecutive_marginal=0;
+    m_n_consecutive_good=0;
+  }else if(rf_marginal){
+    state=LinkState::MARGINAL;
+    m_n_consecutive_marginal++;
+    m_n_consecutive_bad=0;
+    m_n_consecutive_good=0;
+  }else if(rf_good){
+    state=LinkState::GOOD;
+    m_n_consecutive_good++;
+    m_n_consecutive_bad=0;
+    m_n_consecutive_marginal=0;
+  }else{
+    // not enough information (e.g. no video, or no new report from the ground yet) - hold
+    return make_decision("hold",prev_mcs,prev_fec,prev_bitrate);
+  }
+  std::stringstream info;
+  info<<"lost:"<<lost_perc<<"% rec:"<<recovered_perc<<"% rssi:"<<static_cast<int>(rssi)
+      <<" tx_err:"<<delta_tx_errors<<" tx_drop:"<<delta_tx_dropped;
+  if(m_cooldown>0){
+    m_cooldown--;
+    return make_decision("cooldown "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+  }
+  if(state==LinkState::BAD && m_n_consecutive_bad>=m_config.n_bad_intervals_step_down){
+    if(rf_bad){
+      if(m_mcs_index>m_config.min_mcs){
+        m_mcs_index--;
+        return make_decision("rf bad, mcs down "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+      }
+      if(m_fec_percentage<m_config.max_fec_percentage){
+        m_fec_percentage=std::min(m_fec_percentage+m_config.fec_percentage_step,m_config.max_fec_percentage);
+        return make_decision("rf bad at min mcs, fec up "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+      }
+    }
+    // Either the encoder produces more than we can inject, or there is nothing else left to make the link more robust
+    m_bitrate_factor=std::max(m_bitrate_factor*0.8,0.2);
+    return make_decision((rf_bad ? "rf bad at most robust setting, bitrate down " : "tx overflow, bitrate down ")+info.str(),
+                         prev_mcs,prev_fec,prev_bitrate);
+  }
+  if(state==LinkState::MARGINAL && m_n_consecutive_marginal>=m_config.n_bad_intervals_step_down){
+    if(m_fec_percentage<m_config.max_fec_percentage){
+      m_fec_percentage=std::min(m_fec_percentage+m_config.fec_percentage_step,m_config.max_fec_percentage);
+      return make_decision("marginal, fec up "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+    }
+    if(m_mcs_index>m_config.min_mcs){
+      m_mcs_index--;
+      return make_decision("marginal at max fec, mcs down "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+    }
+  }
+  if(state==LinkState::GOOD && ground_fresh && m_n_consecutive_good>=m_config.n_good_intervals_step_up){
+    // undo the most recent kind of degradation first
+    if(m_bitrate_factor<1.0){
+      m_bitrate_factor=std::min(m_bitrate_factor+0.1,1.0);
+      return make_decision("good, bitrate up "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+    }
+    if(m_fec_percentage>m_config.min_fec_percentage){
+      m_fec_percentage=std::max(m_fec_percentage-m_config.fec_percentage_step,m_config.min_fec_percentage);
+      return make_decision("good, fec down "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+    }
+    const bool rssi_allows_step_up=!has_rssi || rssi>=rssi_sensitivity_for_mcs(m_mcs_index+1)+m_config.rssi_margin_step_up_db;
+    if(m_mcs_index<m_config.max_mcs && rssi_allows_step_up){
+      m_mcs_index++;
+      return make_decision("good, mcs up "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+    }
+  }
+  return make_decision("ok "+info.str(),prev_mcs,prev_fec,prev_bitrate);
+}
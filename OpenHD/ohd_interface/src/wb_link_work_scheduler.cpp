@@ -0,0 +1,147 @@
+#include "wb_link_work_scheduler.h"
+
+#include <sstream>
+
+std::string WorkScheduler::Stats::to_string() const {
+  std::stringstream ss;
+  ss<<"WorkScheduler{queue:"<<queue_depth<<" max_queue:"<<max_queue_depth<<" wakeups:"<<n_wakeups
+     <<" items:"<<n_executed_work_items<<" timers:"<<n_executed_timers
+     <<" lateness avg:"<<lateness_avg_us<<"us p99:"<<lateness_p99_us<<"us max:"<<lateness_max_us<<"us}";
+  return ss.str();
+}
+
+WorkScheduler::WorkScheduler(std::string tag) {
+  m_console=openhd::log::create_or_get(tag);
+  assert(m_console);
+  m_thread=std::make_unique<std::thread>(&WorkScheduler::loop,this);
+}
+
+WorkScheduler::~WorkScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_run=false;
+  }
+  m_cv.notify_all();
+  if(m_thread && m_thread->joinable()){
+    m_thread->join();
+  }
+  m_thread=nullptr;
+  if(!m_queue.empty()){
+    m_console->debug("Dropping {} queued work items",m_queue.size());
+  }
+}
+
+void WorkScheduler::schedule_work_item(std::shared_ptr<WorkItem> work_item) {
+  bool wake_up;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto deadline=work_item->get_earliest_execution_time();
+    // only need to wake up the worker if the new item is due before whatever it is currently sleeping for
+    const auto curr_next=next_deadline_locked();
+    wake_up=!curr_next.has_value() || deadline<curr_next.value();
+    m_queue.push(QueuedItem{deadline,m_sequence_nr++,std::move(work_item)});
+    m_max_queue_depth=std::max(m_max_queue_depth,static_cast<int>(m_queue.size()));
+  }
+  if(wake_up){
+    m_cv.notify_one();
+  }
+}
+
+void WorkScheduler::register_periodic_timer(std::string name,std::chrono::steady_clock::duration interval,std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_timers.push_back(PeriodicTimer{std::move(name),interval,std::move(task),std::chrono::steady_clock::now()+interval});
+  }
+  m_cv.notify_one();
+}
+
+bool WorkScheduler::is_idle() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_queue.empty() && m_n_executing_work_items==0;
+}
+
+bool WorkScheduler::wait_until_idle(std::chrono::steady_clock::duration timeout) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_idle_cv.wait_for(lock,timeout,[this](){
+    return m_queue.empty() && m_n_executing_work_items==0;
+  });
+}
+
+WorkScheduler::Stats WorkScheduler::get_stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats ret{};
+  ret.queue_depth=static_cast<int>(m_queue.size());
+  ret.max_queue_depth=m_max_queue_depth;
+  ret.n_wakeups=m_n_wakeups;
+  ret.n_executed_work_items=m_n_executed_work_items;
+  ret.n_executed_timers=m_n_executed_timers;
+  ret.lateness_avg_us=m_lateness.avg_us();
+  ret.lateness_p99_us=m_lateness.percentile_us(99);
+  ret.lateness_max_us=m_lateness.max_us();
+  return ret;
+}
+
+std::optional<std::chrono::steady_clock::time_point> WorkScheduler::next_deadline_locked() {
+  std::optional<std::chrono::steady_clock::time_point> ret=std::nullopt;
+  if(!m_queue.empty()){
+    ret=m_queue.top().deadline;
+  }
+  for(const auto& timer:m_timers){
+    if(!ret.has_value() || timer.next_deadline<ret.value()){
+      ret=timer.next_deadline;
+    }
+  }
+  return ret;
+}
+
+void WorkScheduler::loop() {
+  // Re-used between wakeups
+  std::vector<QueuedItem> due_items;
+  std::vector<std::pair<std::function<void()>,std::chrono::steady_clock::time_point>> due_timers;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_run){
+    const auto next_deadline=next_deadline_locked();
+    if(!next_deadline.has_value()){
+      m_cv.wait(lock);
+      continue;
+    }
+    auto now=std::chrono::steady_clock::now();
+    if(now<next_deadline.value()){
+      m_cv.wait_until(lock,next_deadline.value());
+      continue;
+    }
+    m_n_wakeups++;
+    // Drain everything that is due
+    while(!m_queue.empty() && m_queue.top().deadline<=now){
+      due_items.push_back(m_queue.top());
+      m_queue.pop();
+    }
+    for(auto& timer:m_timers){
+      if(timer.next_deadline<=now){
+        due_timers.emplace_back(timer.task,timer.next_deadline);
+        timer.next_deadline+=timer.interval;
+        if(timer.next_deadline<=now){
+          // fell behind by more than one interval, skip the missed executions
+          timer.next_deadline=now+timer.interval;
+        }
+      }
+    }
+    m_n_executing_work_items=static_cast<int>(due_items.size());
+    lock.unlock();
+    for(auto& due:due_items){
+      m_lateness.record(std::chrono::steady_clock::now()-due.deadline);
+      due.item->execute();
+    }
+    for(auto& due:due_timers){
+      m_lateness.record(std::chrono::steady_clock::now()-due.second);
+      due.first();
+    }
+    lock.lock();
+    m_n_executed_work_items+=due_items.size();
+    m_n_executed_timers+=due_timers.size();
+    m_n_executing_work_items=0;
+    due_items.resize(0);
+    due_timers.resize(0);
+    m_idle_cv.notify_all();
+  }
+}
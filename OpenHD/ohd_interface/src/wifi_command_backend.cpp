@@ -0,0 +1,169 @@
+#include "wifi_command_backend.h"
+
+#include <atomic>
+#include <mutex>
+#include <sstream>
+
+#include "openhd_latency_histogram.hpp"
+#include "openhd_spdlog.h"
+#include "wifi_command_helper.h"
+
+static std::shared_ptr<spdlog::logger> get_logger(){
+  return openhd::log::create_or_get("w_backend");
+}
+
+namespace {
+
+enum Op{
+  OP_CARD_STATE=0,
+  OP_MONITOR_MODE,
+  OP_FREQUENCY,
+  OP_TX_POWER,
+  OP_N
+};
+const char* op_as_string(int op){
+  switch (op) {
+    case OP_CARD_STATE:return "card_state";
+    case OP_MONITOR_MODE:return "monitor_mode";
+    case OP_FREQUENCY:return "frequency";
+    case OP_TX_POWER:return "tx_power";
+    default:break;
+  }
+  return "unknown";
+}
+
+std::mutex g_mutex;
+std::shared_ptr<wifi::commandhelper2::Nl80211Backend> g_nl80211_backend;
+std::shared_ptr<wifi::backend::ShellCommands> g_shell_commands=std::make_shared<wifi::backend::ShellCommands>();
+std::array<openhd::LatencyHistogram,OP_N> g_timings;
+std::atomic<int> g_n_fallbacks=0;
+
+std::shared_ptr<wifi::commandhelper2::Nl80211Backend> get_nl80211_backend(){
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_nl80211_backend;
+}
+
+std::shared_ptr<wifi::backend::ShellCommands> get_shell_commands(){
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_shell_commands;
+}
+
+// Run via nl80211 if active, on failure (or if nl80211 is not active) run via iw / ip
+template<class FN,class FALLBACK>
+bool run_timed(Op op,FN fn_nl80211,FALLBACK fn_shell){
+  const auto begin=std::chrono::steady_clock::now();
+  bool success;
+  auto nl80211=get_nl80211_backend();
+  if(nl80211){
+    success=fn_nl80211(*nl80211);
+    if(!success){
+      get_logger()->warn("nl80211 {} failed, using fallback",op_as_string(op));
+      g_n_fallbacks++;
+      success=fn_shell(*get_shell_commands());
+    }
+  }else{
+    success=fn_shell(*get_shell_commands());
+  }
+  g_timings.at(op).record(std::chrono::steady_clock::now()-begin);
+  return success;
+}
+
+}
+
+bool wifi::backend::ShellCommands::set_card_state(const std::string &device, bool up) {
+  return commandhelper::ip_link_set_card_state(device,up);
+}
+
+bool wifi::backend::ShellCommands::enable_monitor_mode(const std::string &device) {
+  commandhelper::ip_link_set_card_state(device,false);
+  const bool success=commandhelper::iw_enable_monitor_mode(device);
+  return commandhelper::ip_link_set_card_state(device,true) && success;
+}
+
+bool wifi::backend::ShellCommands::set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width) {
+  return commandhelper::iw_set_frequency_and_channel_width(device,freq_mhz,channel_width);
+}
+
+bool wifi::backend::ShellCommands::set_tx_power(const std::string &device, uint32_t tx_power_mBm) {
+  return commandhelper::iw_set_tx_power(device,tx_power_mBm);
+}
+
+void wifi::backend::select(bool use_netlink,std::shared_ptr<commandhelper2::NetlinkTransport> opt_transport,
+                           std::shared_ptr<ShellCommands> opt_shell_commands) {
+  std::shared_ptr<commandhelper2::Nl80211Backend> backend=nullptr;
+  if(use_netlink){
+    auto transport=opt_transport ? opt_transport : commandhelper2::create_kernel_transport();
+    if(transport){
+      backend=std::make_shared<commandhelper2::Nl80211Backend>(transport);
+    }else{
+      get_logger()->warn("nl80211 not available, using iw / ip");
+    }
+  }
+  get_logger()->debug("Using {}",backend ? "nl80211" : "iw / ip");
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_nl80211_backend=backend;
+    g_shell_commands=opt_shell_commands ? opt_shell_commands : std::make_shared<ShellCommands>();
+  }
+  for(auto& timing:g_timings)timing.reset();
+  g_n_fallbacks=0;
+}
+
+bool wifi::backend::is_netlink_active() {
+  return get_nl80211_backend()!=nullptr;
+}
+
+bool wifi::backend::set_card_state(const std::string &device, bool up) {
+  return run_timed(OP_CARD_STATE,[&](commandhelper2::Nl80211Backend& nl80211){
+        return nl80211.set_card_state(device,up);
+      },[&](ShellCommands& shell){
+        return shell.set_card_state(device,up);
+      });
+}
+
+bool wifi::backend::enable_monitor_mode(const std::string &device) {
+  return run_timed(OP_MONITOR_MODE,[&](commandhelper2::Nl80211Backend& nl80211){
+        // The device must be down to change the mode
+        nl80211.set_card_state(device,false);
+        const bool success=nl80211.set_monitor_mode(device);
+        return nl80211.set_card_state(device,true) && success;
+      },[&](ShellCommands& shell){
+        return shell.enable_monitor_mode(device);
+      });
+}
+
+std::optional<bool> wifi::backend::is_monitor_mode(const std::string &device) {
+  auto nl80211=get_nl80211_backend();
+  if(!nl80211)return std::nullopt;
+  return nl80211->is_monitor_mode(device);
+}
+
+bool wifi::backend::set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width) {
+  return run_timed(OP_FREQUENCY,[&](commandhelper2::Nl80211Backend& nl80211){
+        return nl80211.set_frequency_and_channel_width(device,freq_mhz,channel_width);
+      },[&](ShellCommands& shell){
+        return shell.set_frequency_and_channel_width(device,freq_mhz,channel_width);
+      });
+}
+
+bool wifi::backend::set_tx_power(const std::string &device, uint32_t tx_power_mBm) {
+  return run_timed(OP_TX_POWER,[&](commandhelper2::Nl80211Backend& nl80211){
+        return nl80211.set_tx_power(device,tx_power_mBm);
+      },[&](ShellCommands& shell){
+        return shell.set_tx_power(device,tx_power_mBm);
+      });
+}
+
+std::string wifi::backend::get_stats_string() {
+  std::stringstream ss;
+  ss<<(is_netlink_active() ? "nl80211" : "iw / ip")<<" fallbacks:"<<g_n_fallbacks;
+  for(int i=0;i<OP_N;i++){
+    if(g_timings.at(i).count()==0)continue;
+    ss<<" "<<op_as_string(i)<<":"<<g_timings.at(i).to_string();
+  }
+  return ss.str();
+}
+
+int wifi::backend::get_n_fallbacks() {
+  return g_n_fallbacks;
+}
@@ -4,232 +4,326 @@
 
 #include "wifi_command_helper2.h"
 
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
 #include <linux/nl80211.h>
-#include <netlink/genl/ctrl.h>
-#include <netlink/genl/genl.h>
-#include <netlink/netlink.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
-#include <algorithm>
-#include <cstdint>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
 
-#include "openhd_spdlog.h"
 #include "openhd_util.h"
-#undef __USE_MISC
-#include <linux/if.h>
-#include <net/if.h>
-#include <sys/ioctl.h>
 
 static std::shared_ptr<spdlog::logger> get_logger(){
   return openhd::log::create_or_get("w_helper2");
 }
 
-static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg) {
-  int *ret = reinterpret_cast<int*>(arg);
-  *ret = err->error;
-  get_logger()->warn("error_handler {}",err->error);
-  return NL_STOP;
+static constexpr int NL_ALIGN(int len){
+  return (len+3) & ~3;
 }
 
-bool wifi::commandhelper2::set_wifi_up_down(const std::string &device, bool up) {
-  get_logger()->debug("set_wifi_up_down {} up:{}",device,OHDUtil::yes_or_no(up));
-  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-  assert(sockfd>=0);
-  struct ifreq ifr{};
-  memset(&ifr, 0, sizeof ifr);
-  strncpy(ifr.ifr_name, device.c_str(),
-          std::min(static_cast<size_t>(IFNAMSIZ), device.length()));
-  if (up) {
-    ifr.ifr_flags = ifr.ifr_flags | IFF_UP;
-  } else {
-    ifr.ifr_flags = ifr.ifr_flags & ~IFF_UP;
-  }
-  const bool ret=(ioctl(sockfd, SIOCSIFFLAGS, &ifr) >= 0);
-  if(!ret){
-    get_logger()->warn("set_wifi_up_down failed");
-  }
+wifi::commandhelper2::NlAttribute wifi::commandhelper2::NlAttribute::u32(uint16_t type, uint32_t value) {
+  NlAttribute ret{type,std::vector<uint8_t>(sizeof(uint32_t))};
+  std::memcpy(ret.payload.data(),&value,sizeof(uint32_t));
   return ret;
 }
 
+wifi::commandhelper2::NlAttribute wifi::commandhelper2::NlAttribute::flag(uint16_t type) {
+  return NlAttribute{type,{}};
+}
 
-bool wifi::commandhelper2::set_wifi_monitor_mode(const std::string &device) {
-  get_logger()->debug("set_wifi_monitor_mode {} ",device);
-  //The device must be down to change the mode
-  if (!set_wifi_up_down(device, false)) {
-    return false;
-  }
-
-  // Create the socket and connect to it.
-  struct nl_sock *sckt = nl_socket_alloc();
-  genl_connect(sckt);
-
-  // Allocate a new message.
-  struct nl_msg *mesg = nlmsg_alloc();
-
-  // Check /usr/include/linux/nl80211.h for a list of commands and attributes.
-  enum nl80211_commands command = NL80211_CMD_SET_INTERFACE;
-
-  // Create the message so it will send a command to the nl80211 interface.
-  genlmsg_put(mesg, 0, 0, genl_ctrl_resolve(sckt, "nl80211"), 0, 0, command, 0);
+wifi::commandhelper2::NlAttribute wifi::commandhelper2::NlAttribute::nested(uint16_t type,const std::vector<NlAttribute>& children) {
+  return NlAttribute{type,serialize_attributes(children),true};
+}
 
-  // Add specific attributes to change the frequency of the device.
-  NLA_PUT_U32(mesg, NL80211_ATTR_IFINDEX, if_nametoindex(device.c_str()));
-  NLA_PUT_U32(mesg, NL80211_ATTR_IFTYPE, NL80211_IFTYPE_MONITOR);
+std::optional<uint32_t> wifi::commandhelper2::NlAttribute::as_u32() const {
+  if(payload.size()!=sizeof(uint32_t))return std::nullopt;
+  uint32_t ret;
+  std::memcpy(&ret,payload.data(),sizeof(uint32_t));
+  return ret;
+}
 
-  // Finally send it and receive the amount of bytes sent.
-  nl_send_auto_complete(sckt, mesg);
+std::vector<wifi::commandhelper2::NlAttribute> wifi::commandhelper2::NlAttribute::as_nested() const {
+  return parse_attributes(payload.data(),static_cast<int>(payload.size()));
+}
 
-  // Bring the device back up
-  if (!set_wifi_up_down(device, true)) {
-    goto nla_put_failure;
+std::vector<uint8_t> wifi::commandhelper2::serialize_attributes(const std::vector<NlAttribute>& attributes) {
+  std::vector<uint8_t> ret;
+  for(const auto& attr:attributes){
+    nlattr hdr{};
+    hdr.nla_len=static_cast<uint16_t>(NLA_HDRLEN+attr.payload.size());
+    hdr.nla_type=attr.is_nested ? (attr.type | NLA_F_NESTED) : attr.type;
+    const auto offset=ret.size();
+    ret.resize(offset+NL_ALIGN(hdr.nla_len),0);
+    std::memcpy(ret.data()+offset,&hdr,sizeof(hdr));
+    if(!attr.payload.empty()){
+      std::memcpy(ret.data()+offset+NLA_HDRLEN,attr.payload.data(),attr.payload.size());
+    }
   }
+  return ret;
+}
 
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return true;
+std::vector<wifi::commandhelper2::NlAttribute> wifi::commandhelper2::parse_attributes(const uint8_t* data, int data_len) {
+  std::vector<NlAttribute> ret;
+  int offset=0;
+  while(offset+NLA_HDRLEN<=data_len){
+    nlattr hdr{};
+    std::memcpy(&hdr,data+offset,sizeof(hdr));
+    if(hdr.nla_len<NLA_HDRLEN || offset+hdr.nla_len>data_len){
+      break;
+    }
+    NlAttribute attr{static_cast<uint16_t>(hdr.nla_type & NLA_TYPE_MASK),
+                     std::vector<uint8_t>(data+offset+NLA_HDRLEN,data+offset+hdr.nla_len),
+                     (hdr.nla_type & NLA_F_NESTED)!=0};
+    ret.push_back(std::move(attr));
+    offset+=NL_ALIGN(hdr.nla_len);
+  }
+  return ret;
+}
 
-nla_put_failure:
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return false;
+std::optional<uint32_t> wifi::commandhelper2::find_u32(const std::vector<NlAttribute>& attributes,uint16_t type) {
+  for(const auto& attr:attributes){
+    if(attr.type==type)return attr.as_u32();
+  }
+  return std::nullopt;
 }
 
-bool wifi::commandhelper2::set_wifi_frequency(const std::string& device,
-                                             uint32_t freq_mhz,std::optional<uint32_t> channel_width) {
-  if(channel_width.has_value()){
-    get_logger()->debug("set_wifi_frequency {} {}Mhz {}Mhz",device,freq_mhz,channel_width.value());
-  }else{
-    get_logger()->debug("set_wifi_frequency {} {}Mhz",device,freq_mhz);
-  }
-  int err = 1;
-  struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
-  int rc;
-
-  // Create the socket and connect to it.
-  struct nl_sock *sckt = nl_socket_alloc();
-  genl_connect(sckt);
-
-  // Allocate a new message.
-  struct nl_msg *mesg = nlmsg_alloc();
-
-  // Check /usr/include/linux/nl80211.h for a list of commands and attributes.
-  enum nl80211_commands command = NL80211_CMD_SET_WIPHY;
-
-  // Create the message so it will send a command to the nl80211 interface.
-  genlmsg_put(mesg, 0, 0, genl_ctrl_resolve(sckt, "nl80211"), 0, 0, command, 0);
-
-  // Add specific attributes to change the frequency of the device.
-  NLA_PUT_U32(mesg, NL80211_ATTR_IFINDEX, if_nametoindex(device.c_str()));
-  NLA_PUT_U32(mesg, NL80211_ATTR_WIPHY_FREQ, freq_mhz);
-  if(channel_width!=std::nullopt){
-    const uint32_t channel_width_given=channel_width.value();
-    auto netlink_channel_width=NL80211_CHAN_WIDTH_20;
-    switch (channel_width_given) {
-      case 10:
-        netlink_channel_width=NL80211_CHAN_WIDTH_10;
-      case 20:
-        netlink_channel_width=NL80211_CHAN_WIDTH_20;
-        break;
-      case 40:
-        netlink_channel_width=NL80211_CHAN_WIDTH_40;
-        break;
-      default:
-        get_logger()->debug("Invalid channel width {}, assuming 20Mhz",channel_width_given);
-        break;
+namespace wifi::commandhelper2{
+
+// One generic netlink socket, re-used for all commands. Requests are serialized.
+class KernelNetlinkTransport : public NetlinkTransport{
+ public:
+  ~KernelNetlinkTransport() override{
+    if(m_fd>=0)close(m_fd);
+    if(m_ioctl_fd>=0)close(m_ioctl_fd);
+  }
+  // returns false if nl80211 is not available (e.g. no cfg80211 driver loaded)
+  bool initialize(){
+    m_fd=socket(AF_NETLINK,SOCK_RAW | SOCK_CLOEXEC,NETLINK_GENERIC);
+    if(m_fd<0){
+      get_logger()->warn("Cannot create netlink socket {}",strerror(errno));
+      return false;
+    }
+    sockaddr_nl addr{};
+    addr.nl_family=AF_NETLINK;
+    if(bind(m_fd,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))<0){
+      get_logger()->warn("Cannot bind netlink socket {}",strerror(errno));
+      return false;
+    }
+    // Never block forever if the kernel doesn't reply
+    timeval timeout{};
+    timeout.tv_sec=1;
+    setsockopt(m_fd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+    m_ioctl_fd=socket(AF_INET,SOCK_DGRAM | SOCK_CLOEXEC,0);
+    if(m_ioctl_fd<0){
+      get_logger()->warn("Cannot create ioctl socket {}",strerror(errno));
+      return false;
     }
-    NLA_PUT_U32(mesg,NL80211_ATTR_CHANNEL_WIDTH,channel_width_given);
+    std::vector<NlAttribute> reply;
+    const std::string family_name="nl80211";
+    NlAttribute attr_name{CTRL_ATTR_FAMILY_NAME,std::vector<uint8_t>(family_name.c_str(),family_name.c_str()+family_name.size()+1)};
+    const int res=request(GENL_ID_CTRL,CTRL_CMD_GETFAMILY,{attr_name},&reply);
+    if(res!=0){
+      get_logger()->warn("Cannot resolve nl80211 {}",strerror(-res));
+      return false;
+    }
+    for(const auto& attr:reply){
+      if(attr.type==CTRL_ATTR_FAMILY_ID && attr.payload.size()>=sizeof(uint16_t)){
+        std::memcpy(&m_nl80211_family_id,attr.payload.data(),sizeof(uint16_t));
+      }
+    }
+    if(m_nl80211_family_id==0){
+      get_logger()->warn("Cannot resolve nl80211 family id");
+      return false;
+    }
+    return true;
   }
+  int get_ifindex(const std::string &device) override{
+    return static_cast<int>(if_nametoindex(device.c_str()));
+  }
+  int set_interface_up(const std::string &device, bool up) override{
+    ifreq ifr{};
+    strncpy(ifr.ifr_name,device.c_str(),IFNAMSIZ-1);
+    // read - modify - write, we only want to change the up flag
+    if(ioctl(m_ioctl_fd,SIOCGIFFLAGS,&ifr)<0){
+      return -errno;
+    }
+    if(up){
+      ifr.ifr_flags|=IFF_UP;
+    }else{
+      ifr.ifr_flags&=~IFF_UP;
+    }
+    if(ioctl(m_ioctl_fd,SIOCSIFFLAGS,&ifr)<0){
+      return -errno;
+    }
+    return 0;
+  }
+  int nl80211_request(uint8_t cmd,const std::vector<NlAttribute>& attributes,std::vector<NlAttribute>* opt_reply) override{
+    return request(m_nl80211_family_id,cmd,attributes,opt_reply);
+  }
+ private:
+  int request(uint16_t family,uint8_t cmd,const std::vector<NlAttribute>& attributes,std::vector<NlAttribute>* opt_reply){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto attributes_serialized=serialize_attributes(attributes);
+    const int msg_len=NLMSG_HDRLEN+GENL_HDRLEN+static_cast<int>(attributes_serialized.size());
+    std::vector<uint8_t> msg(msg_len,0);
+    auto* nlh=reinterpret_cast<nlmsghdr*>(msg.data());
+    nlh->nlmsg_len=msg_len;
+    nlh->nlmsg_type=family;
+    nlh->nlmsg_flags=NLM_F_REQUEST | NLM_F_ACK;
+    nlh->nlmsg_seq=++m_seq;
+    auto* genlh=reinterpret_cast<genlmsghdr*>(msg.data()+NLMSG_HDRLEN);
+    genlh->cmd=cmd;
+    genlh->version=1;
+    std::memcpy(msg.data()+NLMSG_HDRLEN+GENL_HDRLEN,attributes_serialized.data(),attributes_serialized.size());
+    sockaddr_nl kernel{};
+    kernel.nl_family=AF_NETLINK;
+    if(sendto(m_fd,msg.data(),msg.size(),0,reinterpret_cast<sockaddr*>(&kernel),sizeof(kernel))<0){
+      return -errno;
+    }
+    // The kernel replies with (optional) data, then the ack (an error message with error==0)
+    while(true){
+      const auto len=recv(m_fd,m_rx_buffer.data(),m_rx_buffer.size(),0);
+      if(len<0){
+        return -errno;
+      }
+      int remaining=static_cast<int>(len);
+      for(auto* hdr=reinterpret_cast<nlmsghdr*>(m_rx_buffer.data());NLMSG_OK(hdr,remaining);hdr=NLMSG_NEXT(hdr,remaining)){
+        if(hdr->nlmsg_seq!=m_seq)continue;
+        if(hdr->nlmsg_type==NLMSG_ERROR){
+          const auto* err=reinterpret_cast<nlmsgerr*>(NLMSG_DATA(hdr));
+          return err->error;
+        }
+        if(hdr->nlmsg_type==NLMSG_DONE){
+          return 0;
+        }
+        if(opt_reply){
+          const auto* data=reinterpret_cast<const uint8_t*>(NLMSG_DATA(hdr))+GENL_HDRLEN;
+          const int data_len=static_cast<int>(hdr->nlmsg_len)-NLMSG_HDRLEN-GENL_HDRLEN;
+          *opt_reply=parse_attributes(data,data_len);
+        }
+      }
+    }
+  }
+  std::mutex m_mutex;
+  int m_fd=-1;
+  int m_ioctl_fd=-1;
+  uint16_t m_nl80211_family_id=0;
+  uint32_t m_seq=0;
+  std::array<uint8_t,8192> m_rx_buffer{};
+};
 
-  // Finally send it and receive the amount of bytes sent.
-  nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
-  rc = nl_send_auto(sckt, mesg);
-  nl_recvmsgs(sckt, cb);
-  nl_cb_put(cb);
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return (err >= 0);
-
-nla_put_failure:
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return false;
 }
 
-bool wifi::commandhelper2::set_wifi_frequency_and_log_result(
-    const std::string &device, uint32_t freq_mhz,
-    std::optional<uint32_t> channel_width) {
-  const bool res= set_wifi_frequency(device,freq_mhz,channel_width);
-  get_logger()->debug("Set {} {}",freq_mhz, res ? "Success" : "Failure");
-  return false;
+std::shared_ptr<wifi::commandhelper2::NetlinkTransport> wifi::commandhelper2::create_kernel_transport() {
+  auto ret=std::make_shared<KernelNetlinkTransport>();
+  if(!ret->initialize()){
+    return nullptr;
+  }
+  return ret;
 }
 
-bool wifi::commandhelper2::set_wifi_txpower(const std::string &device,const uint32_t tx_power_mBm){
-  get_logger()->debug("set_wifi_txpower {} {} mBm",device,tx_power_mBm);
-  // Create the socket and connect to it.
-  struct nl_sock *sckt = nl_socket_alloc();
-  genl_connect(sckt);
-
-  // Allocate a new message.
-  struct nl_msg *mesg = nlmsg_alloc();
+wifi::commandhelper2::Nl80211Backend::Nl80211Backend(std::shared_ptr<NetlinkTransport> transport)
+    : m_transport(std::move(transport)) {
+  m_console=get_logger();
+}
 
-  // Check /usr/include/linux/nl80211.h for a list of commands and attributes.
-  enum nl80211_commands command = NL80211_CMD_SET_WIPHY;
+int wifi::commandhelper2::Nl80211Backend::get_ifindex_or_warn(const std::string &device) {
+  const int ifindex=m_transport->get_ifindex(device);
+  if(ifindex<=0){
+    m_console->warn("No interface {}",device);
+    return 0;
+  }
+  return ifindex;
+}
 
-  // Create the message so it will send a command to the nl80211 interface.
-  genlmsg_put(mesg, 0, 0, genl_ctrl_resolve(sckt, "nl80211"), 0, 0, command, 0);
+bool wifi::commandhelper2::Nl80211Backend::set_card_state(const std::string &device, bool up) {
+  m_console->debug("set_card_state {} up:{}",device,OHDUtil::yes_or_no(up));
+  const int res=m_transport->set_interface_up(device,up);
+  if(res!=0){
+    m_console->warn("set_card_state {} failed {}",device,strerror(-res));
+    return false;
+  }
+  return true;
+}
 
-  // Add specific attributes to change the frequency of the device.
-  NLA_PUT_U32(mesg, NL80211_ATTR_IFINDEX, if_nametoindex(device.c_str()));
-  NLA_PUT_U32(mesg, NL80211_ATTR_WIPHY_TX_POWER_SETTING, NL80211_TX_POWER_FIXED);
-  NLA_PUT_U32(mesg, NL80211_ATTR_WIPHY_TX_POWER_LEVEL, tx_power_mBm);
+bool wifi::commandhelper2::Nl80211Backend::set_monitor_mode(const std::string &device) {
+  m_console->debug("set_monitor_mode {}",device);
+  const int ifindex=get_ifindex_or_warn(device);
+  if(ifindex==0)return false;
+  const std::vector<NlAttribute> attributes{
+      NlAttribute::u32(NL80211_ATTR_IFINDEX,ifindex),
+      NlAttribute::u32(NL80211_ATTR_IFTYPE,NL80211_IFTYPE_MONITOR),
+      NlAttribute::nested(NL80211_ATTR_MNTR_FLAGS,{NlAttribute::flag(NL80211_MNTR_FLAG_OTHER_BSS)})
+  };
+  const int res=m_transport->nl80211_request(NL80211_CMD_SET_INTERFACE,attributes,nullptr);
+  if(res!=0){
+    m_console->warn("set_monitor_mode {} failed {}",device,strerror(-res));
+    return false;
+  }
+  return true;
+}
 
-  // Finally send it and receive the amount of bytes sent.
-  nl_send_auto_complete(sckt, mesg);
+std::optional<bool> wifi::commandhelper2::Nl80211Backend::is_monitor_mode(const std::string &device) {
+  const int ifindex=get_ifindex_or_warn(device);
+  if(ifindex==0)return std::nullopt;
+  std::vector<NlAttribute> reply;
+  const int res=m_transport->nl80211_request(NL80211_CMD_GET_INTERFACE,{NlAttribute::u32(NL80211_ATTR_IFINDEX,ifindex)},&reply);
+  if(res!=0){
+    m_console->warn("get_interface {} failed {}",device,strerror(-res));
+    return std::nullopt;
+  }
+  const auto iftype=find_u32(reply,NL80211_ATTR_IFTYPE);
+  if(!iftype.has_value())return std::nullopt;
+  return iftype.value()==NL80211_IFTYPE_MONITOR;
+}
 
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
+bool wifi::commandhelper2::Nl80211Backend::set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width) {
+  m_console->debug("set_frequency_and_channel_width {} {}Mhz {}Mhz",device,freq_mhz,channel_width);
+  const int ifindex=get_ifindex_or_warn(device);
+  if(ifindex==0)return false;
+  std::vector<NlAttribute> attributes{
+      NlAttribute::u32(NL80211_ATTR_IFINDEX,ifindex),
+      NlAttribute::u32(NL80211_ATTR_WIPHY_FREQ,freq_mhz)
+  };
+  // Same as what iw does for 5MHz / 10MHz / HT20 / HT40+
+  if(channel_width==5 || channel_width==10){
+    attributes.push_back(NlAttribute::u32(NL80211_ATTR_CHANNEL_WIDTH,channel_width==5 ? NL80211_CHAN_WIDTH_5 : NL80211_CHAN_WIDTH_10));
+    attributes.push_back(NlAttribute::u32(NL80211_ATTR_CENTER_FREQ1,freq_mhz));
+  }else if(channel_width==40){
+    attributes.push_back(NlAttribute::u32(NL80211_ATTR_WIPHY_CHANNEL_TYPE,NL80211_CHAN_HT40PLUS));
+  }else{
+    if(channel_width!=20){
+      m_console->info("Invalid channel width {}, assuming HT20",channel_width);
+    }
+    attributes.push_back(NlAttribute::u32(NL80211_ATTR_WIPHY_CHANNEL_TYPE,NL80211_CHAN_HT20));
+  }
+  const int res=m_transport->nl80211_request(NL80211_CMD_SET_WIPHY,attributes,nullptr);
+  if(res!=0){
+    m_console->warn("nl80211 {}Mhz@{}Mhz not supported {}",freq_mhz,channel_width,strerror(-res));
+    return false;
+  }
   return true;
+}
 
-nla_put_failure:
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return false;
-}
-
-bool wifi::commandhelper2::exp_set_wifi_frequency(const std::string &device,
-                                                  uint32_t freq_mhz) {
-  openhd::log::get_default()->debug("exp_set_wifi_frequency {} {}",device,freq_mhz);
-  int err = 1;
-  struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
-  int rc;
-
-  // Create the socket and connect to it.
-  struct nl_sock *sckt = nl_socket_alloc();
-  genl_connect(sckt);
-
-  // Allocate a new message.
-  struct nl_msg *mesg = nlmsg_alloc();
-
-  // Check /usr/include/linux/nl80211.h for a list of commands and attributes.
-  enum nl80211_commands command = NL80211_CMD_SET_CHANNEL;
-
-  // Create the message so it will send a command to the nl80211 interface.
-  genlmsg_put(mesg, 0, 0, genl_ctrl_resolve(sckt, "nl80211"), 0, 0, command, 0);
-
-  // Add specific attributes to change the frequency of the device.
-  NLA_PUT_U32(mesg, NL80211_ATTR_IFINDEX, if_nametoindex(device.c_str()));
-  NLA_PUT_U32(mesg, NL80211_ATTR_WIPHY_FREQ, freq_mhz);
-
-  // Finally send it and receive the amount of bytes sent.
-  nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
-  rc = nl_send_auto(sckt, mesg);
-  nl_recvmsgs(sckt, cb);
-  nl_cb_put(cb);
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return (err >= 0);
-
-nla_put_failure:
-  nlmsg_free(mesg);
-  nl_socket_free(sckt);
-  return false;
+bool wifi::commandhelper2::Nl80211Backend::set_tx_power(const std::string &device, uint32_t tx_power_mBm) {
+  m_console->debug("set_tx_power {} {} mBm",device,tx_power_mBm);
+  const int ifindex=get_ifindex_or_warn(device);
+  if(ifindex==0)return false;
+  const std::vector<NlAttribute> attributes{
+      NlAttribute::u32(NL80211_ATTR_IFINDEX,ifindex),
+      NlAttribute::u32(NL80211_ATTR_WIPHY_TX_POWER_SETTING,NL80211_TX_POWER_FIXED),
+      NlAttribute::u32(NL80211_ATTR_WIPHY_TX_POWER_LEVEL,tx_power_mBm)
+  };
+  const int res=m_transport->nl80211_request(NL80211_CMD_SET_WIPHY,attributes,nullptr);
+  if(res!=0){
+    m_console->warn("set_tx_power failed {}",strerror(-res));
+    return false;
+  }
+  return true;
 }
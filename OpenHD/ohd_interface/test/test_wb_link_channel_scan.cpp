@@ -0,0 +1,179 @@
+#include <iostream>
+
+#include "openhd_test_check.hpp"
+#include "wb_link_channel_scan.h"
+
+// Runs the card scheduling and the adaptive dwell of the channel scan against simulated cards (no wifi card needed):
+// the air unit sends on one of the candidates, another channel has foreign wifi traffic (packets, but nothing
+// we can decrypt). Checks the dwell only exits early on a valid session, and prints how long it takes until the
+// air unit is found with 1..4 cards.
+
+using namespace openhd::wb;
+using namespace std::chrono_literals;
+
+static constexpr auto MAX_DWELL=std::chrono::milliseconds(1000);
+static constexpr auto POLL_INTERVAL=std::chrono::milliseconds(50);
+// How long it takes until a card on the air unit's channel got the session key packet
+static constexpr auto TIME_UNTIL_SESSION=std::chrono::milliseconds(300);
+
+static std::vector<ScanCandidate> create_candidates(){
+  std::vector<ScanCandidate> ret;
+  for(const auto& channel:openhd::get_channels_5G()){
+    for(const uint32_t channel_width:{20,40}){
+      ret.push_back(ScanCandidate{channel,channel_width});
+    }
+  }
+  return ret;
+}
+
+static bool is_same(const ScanCandidate& lhs,const ScanCandidate& rhs){
+  return lhs.channel.frequency==rhs.channel.frequency && lhs.channel_width==rhs.channel_width;
+}
+
+// Cards tuned to the candidates of one batch, simulated time
+class SimulatedCards{
+ public:
+  SimulatedCards(ScanCandidate air,ScanCandidate foreign_traffic):m_air(air),m_foreign_traffic(foreign_traffic){}
+  void tune(const std::vector<ScanCandidate>& batch){
+    m_batch=batch;
+    m_time_on_batch=0ms;
+  }
+  ScanDwellIO create_io(){
+    ScanDwellIO io{};
+    io.get_n_packets_per_card=[this](){
+      std::vector<int> ret;
+      for(const auto& candidate:m_batch){
+        // ~1 packet / ms, for both the air unit and the foreign traffic
+        const bool gets_packets=is_same(candidate,m_air) || is_same(candidate,m_foreign_traffic);
+        ret.push_back(gets_packets ? static_cast<int>(m_total_packets+m_time_on_batch.count()) : m_total_packets);
+      }
+      return ret;
+    };
+    io.has_valid_session=[this](){
+      for(const auto& candidate:m_batch){
+        if(is_same(candidate,m_air) && m_time_on_batch>=TIME_UNTIL_SESSION)return true;
+      }
+      return false;
+    };
+    io.sleep=[this](std::chrono::steady_clock::duration duration){
+      const auto ms=std::chrono::duration_cast<std::chrono::milliseconds>(duration);
+      m_time_on_batch+=ms;
+      m_elapsed+=ms;
+    };
+    return io;
+  }
+  [[nodiscard]] std::chrono::milliseconds get_elapsed()const{
+    return m_elapsed;
+  }
+ private:
+  const ScanCandidate m_air;
+  const ScanCandidate m_foreign_traffic;
+  std::vector<ScanCandidate> m_batch;
+  std::chrono::milliseconds m_time_on_batch{0};
+  std::chrono::milliseconds m_elapsed{0};
+  // counters are cumulative, they don't start at 0 on each dwell
+  int m_total_packets=1000;
+};
+
+static void test_split(){
+  const auto candidates=create_candidates();
+  for(int n_cards=1;n_cards<=4;n_cards++){
+    const auto batches=split_scan_candidates(candidates,n_cards);
+    OHD_TEST_CHECK(batches.size()==(candidates.size()+n_cards-1)/n_cards);
+    size_t n_scanned=0;
+    for(const auto& batch:batches){
+      OHD_TEST_CHECK(static_cast<int>(batch.size())==n_cards);
+      for(int i=0;i<n_cards && n_scanned<candidates.size();i++){
+        OHD_TEST_CHECK(is_same(batch.at(i),candidates.at(n_scanned)));
+        n_scanned++;
+      }
+    }
+    // Every candidate is listened on exactly once
+    OHD_TEST_CHECK(n_scanned==candidates.size());
+  }
+  // 3 candidates, 2 cards - the left over card listens on the first candidate of the last batch
+  const std::vector<ScanCandidate> three(candidates.begin(),candidates.begin()+3);
+  const auto batches=split_scan_candidates(three,2);
+  OHD_TEST_CHECK(batches.size()==2);
+  OHD_TEST_CHECK(is_same(batches.at(1).at(0),three.at(2)));
+  OHD_TEST_CHECK(is_same(batches.at(1).at(1),three.at(2)));
+}
+
+static void test_dwell(){
+  const auto candidates=create_candidates();
+  SimulatedCards cards(candidates.at(2),candidates.at(0));
+  auto io=cards.create_io();
+  // Card 0 only gets foreign traffic - no early exit, listen for the full dwell
+  cards.tune({candidates.at(0),candidates.at(1)});
+  auto result=scan_dwell(io,MAX_DWELL,POLL_INTERVAL);
+  OHD_TEST_CHECK(!result.valid_session);
+  OHD_TEST_CHECK(cards.get_elapsed()==MAX_DWELL);
+  OHD_TEST_CHECK(result.n_packets_per_card.at(0)==MAX_DWELL.count());
+  OHD_TEST_CHECK(result.n_packets_per_card.at(1)==0);
+  // Still worth confirming
+  OHD_TEST_CHECK(get_scan_candidates_to_confirm(result,2)==std::vector<int>{0});
+  // Card 1 is on the air unit's channel - exits as soon as the session is valid
+  cards.tune({candidates.at(1),candidates.at(2)});
+  const auto before=cards.get_elapsed();
+  result=scan_dwell(io,MAX_DWELL,POLL_INTERVAL);
+  OHD_TEST_CHECK(result.valid_session);
+  OHD_TEST_CHECK(cards.get_elapsed()-before==TIME_UNTIL_SESSION);
+  OHD_TEST_CHECK(result.n_packets_per_card.at(0)==0);
+  OHD_TEST_CHECK(result.n_packets_per_card.at(1)==TIME_UNTIL_SESSION.count());
+  OHD_TEST_CHECK(get_scan_candidates_to_confirm(result,2)==std::vector<int>{1});
+}
+
+static void test_candidates_to_confirm(){
+  ScanDwellResult result{};
+  // Most packets first
+  result.n_packets_per_card={10,0,50,20};
+  OHD_TEST_CHECK((get_scan_candidates_to_confirm(result,4)==std::vector<int>{2,3,0}));
+  // Only the cards of the (last, smaller) batch
+  OHD_TEST_CHECK((get_scan_candidates_to_confirm(result,2)==std::vector<int>{0}));
+  // Valid session, but the card(s) that got it have no per card stats - try all of them
+  result.n_packets_per_card={0,0,0,0};
+  result.valid_session=true;
+  OHD_TEST_CHECK((get_scan_candidates_to_confirm(result,3)==std::vector<int>{0,1,2}));
+  result.valid_session=false;
+  OHD_TEST_CHECK(get_scan_candidates_to_confirm(result,3).empty());
+}
+
+// Time until the air unit's channel is listened on and confirmed by the dwell, like WBLink::scan_channels does it
+// (without the time for confirming the channel with all cards / measuring the packet loss)
+static std::chrono::milliseconds simulate_time_to_lock(const std::vector<ScanCandidate>& candidates,int air_index,int n_cards){
+  SimulatedCards cards(candidates.at(air_index),candidates.at(0));
+  auto io=cards.create_io();
+  for(const auto& batch:split_scan_candidates(candidates,n_cards)){
+    cards.tune(batch);
+    const auto result=scan_dwell(io,MAX_DWELL,POLL_INTERVAL);
+    if(result.valid_session)break;
+  }
+  return cards.get_elapsed();
+}
+
+static void test_time_to_lock(){
+  const auto candidates=create_candidates();
+  const int air_index=static_cast<int>(candidates.size())-5;
+  // Before: 1s per candidate, one candidate after another (and another 2s for each candidate with packets)
+  std::cout<<"Candidates:"<<candidates.size()<<" air unit on candidate "<<air_index<<"\n";
+  std::chrono::milliseconds last{0};
+  for(int n_cards=1;n_cards<=4;n_cards++){
+    const auto time_to_lock=simulate_time_to_lock(candidates,air_index,n_cards);
+    std::cout<<n_cards<<" card(s): "<<time_to_lock.count()<<"ms\n";
+    const int n_batches_before=air_index/n_cards;
+    OHD_TEST_CHECK(time_to_lock==n_batches_before*MAX_DWELL+TIME_UNTIL_SESSION);
+    if(n_cards>1){
+      OHD_TEST_CHECK(time_to_lock<last);
+    }
+    last=time_to_lock;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  test_split();
+  test_dwell();
+  test_candidates_to_confirm();
+  test_time_to_lock();
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "wb_link_rate_controller.h"
+
+// Simulator harness for the adaptive link controller, runs on any linux box (no wifi card needed).
+// Usage:
+// test_wb_link_rate_controller -> run the synthetic scenarios below (exits with -1 on failure)
+// test_wb_link_rate_controller trace.log [max_mcs] [min_fec] -> replay a recorded trace (every line containing
+// "rate_ctrl_sample," as logged by the air unit when DEV_WB_ADAPTIVE_LINK_CONTROLLER is enabled) and print the decisions
+
+using RateController=openhd::wb::RateController;
+
+// Same as rtl8812au_get_max_rate_5G_kbits (20Mhz), duplicated since wb_link_helper pulls in the whole settings code
+static uint32_t sim_max_rate_for_mcs(int mcs_index){
+  static constexpr uint32_t RATES[]={4500,6500,8500,12000,17000,23000,36000,36000};
+  return RATES[std::max(0,std::min(mcs_index,7))];
+}
+
+static RateController::Config create_config(int max_mcs,int min_fec){
+  RateController::Config config{};
+  config.max_mcs=max_mcs;
+  config.min_fec_percentage=min_fec;
+  config.get_max_rate_for_mcs_kbits=sim_max_rate_for_mcs;
+  return config;
+}
+
+// Very simple (but deterministic) model of the air -> ground video link
+class SimulatedLink{
+ public:
+  struct Condition{
+    int rssi;
+    // fraction of the max rate for the current mcs the card can actually inject (interference / busy channel)
+    double tx_capacity=1.0;
+    // if false, the ground feedback is lost (e.g. uplink down)
+    bool ground_feedback=true;
+  };
+  RateController::Sample step(const Condition& condition,const RateController::Decision& decision){
+    // What the encoder produces (incl. fec) vs what we can inject
+    const double video_rate=decision.recommended_bitrate_kbits*(1.0+decision.fec_percentage/100.0);
+    const double tx_rate=sim_max_rate_for_mcs(decision.mcs_index)*condition.tx_capacity;
+    if(video_rate>tx_rate){
+      m_count_tx_dropped+=static_cast<uint64_t>((video_rate-tx_rate)*1000/8/1400);
+    }
+    // logistic packet loss, 50% at the sensitivity limit, ~2.5% at 3dB margin
+    const double margin=condition.rssi-RateController::rssi_sensitivity_for_mcs(decision.mcs_index);
+    const double p_loss=1.0/(1.0+std::exp(margin*1.2));
+    const int k=8;
+    const int n_fec=static_cast<int>(std::ceil(k*decision.fec_percentage/100.0));
+    const auto n_blocks=static_cast<int>(std::min(video_rate,tx_rate)*1000/8/1400/(k+n_fec));
+    for(int b=0;b<n_blocks;b++){
+      int n_lost=0;
+      for(int i=0;i<k+n_fec;i++){
+        if(next_uniform()<p_loss)n_lost++;
+      }
+      m_count_blocks_total++;
+      if(n_lost>n_fec){
+        m_count_blocks_lost++;
+      }else if(n_lost>0){
+        m_count_blocks_recovered++;
+      }
+    }
+    m_interval_blocks_lost=m_count_blocks_lost-m_last_blocks_lost;
+    m_interval_blocks_total=m_count_blocks_total-m_last_blocks_total;
+    m_last_blocks_lost=m_count_blocks_lost;
+    m_last_blocks_total=m_count_blocks_total;
+    RateController::Sample sample{};
+    sample.count_tx_dropped_packets=m_count_tx_dropped;
+    sample.air_rx_rssi=static_cast<int8_t>(condition.rssi);
+    if(condition.ground_feedback){
+      RateController::GroundFeedback ground{};
+      ground.count_blocks_total=m_count_blocks_total;
+      ground.count_blocks_lost=m_count_blocks_lost;
+      ground.count_blocks_recovered=m_count_blocks_recovered;
+      ground.rx_rssi=static_cast<int8_t>(condition.rssi);
+      sample.ground=ground;
+    }
+    return sample;
+  }
+  uint64_t m_count_blocks_total=0;
+  uint64_t m_count_blocks_lost=0;
+  uint64_t m_count_blocks_recovered=0;
+  uint64_t m_count_tx_dropped=0;
+  uint64_t m_interval_blocks_lost=0;
+  uint64_t m_interval_blocks_total=0;
+ private:
+  // std::uniform_real_distribution is implementation defined, std::mt19937 is not
+  double next_uniform(){
+    return static_cast<double>(m_rng())/static_cast<double>(std::mt19937::max());
+  }
+  std::mt19937 m_rng{42};
+  uint64_t m_last_blocks_lost=0;
+  uint64_t m_last_blocks_total=0;
+};
+
+static bool g_any_failed=false;
+static void check(bool condition,const std::string& what){
+  std::cout<<(condition ? "OK   ":"FAIL ")<<what<<"\n";
+  if(!condition)g_any_failed=true;
+}
+
+// Fly away from the ground station (rssi drops from -50 to -80) and back
+static void scenario_fly_away_and_back(){
+  std::cout<<"Scenario fly away and back\n";
+  RateController controller(create_config(5,20));
+  SimulatedLink link;
+  auto decision=controller.reset();
+  int min_mcs_seen=decision.mcs_index;
+  uint64_t lost_while_far=0;
+  for(int t=0;t<200;t++){
+    int rssi;
+    if(t<60)rssi=-50-t/2;
+    else if(t<100)rssi=-80;
+    else if(t<160)rssi=-80+(t-100)/2;
+    else rssi=-50;
+    const auto sample=link.step({rssi},decision);
+    decision=controller.on_new_sample(sample);
+    min_mcs_seen=std::min(min_mcs_seen,decision.mcs_index);
+    if(t>=80 && t<100)lost_while_far+=link.m_interval_blocks_lost;
+    if(decision.any_changed()){
+      std::cout<<"t:"<<t<<" rssi:"<<rssi<<" "<<decision.to_string()<<"\n";
+    }
+  }
+  check(min_mcs_seen<=1,"steps down to a robust mcs when far away");
+  check(lost_while_far<20,"(almost) no lost blocks once settled at the robust mcs");
+  check(decision.mcs_index==5,"back to the user mcs when close again");
+  const double total_loss_perc=static_cast<double>(link.m_count_blocks_lost)*100.0/static_cast<double>(link.m_count_blocks_total);
+  std::cout<<"Total lost blocks:"<<total_loss_perc<<"%\n";
+  check(total_loss_perc<2.0,"total lost blocks < 2%");
+}
+
+// Channel is busy for a while, we cannot inject what the encoder produces
+static void scenario_tx_congestion(){
+  std::cout<<"Scenario tx congestion\n";
+  RateController controller(create_config(3,20));
+  SimulatedLink link;
+  auto decision=controller.reset();
+  const auto initial_bitrate=decision.recommended_bitrate_kbits;
+  uint32_t min_bitrate=initial_bitrate;
+  for(int t=0;t<120;t++){
+    const double tx_capacity=(t>=20 && t<50) ? 0.6 : 1.0;
+    const auto sample=link.step({-50,tx_capacity},decision);
+    decision=controller.on_new_sample(sample);
+    min_bitrate=std::min(min_bitrate,decision.recommended_bitrate_kbits);
+    if(decision.any_changed()){
+      std::cout<<"t:"<<t<<" "<<decision.to_string()<<"\n";
+    }
+  }
+  check(min_bitrate*(1.0+0.2)<=sim_max_rate_for_mcs(3)*0.6,"bitrate reduced below what can be injected");
+  check(decision.mcs_index==3,"mcs untouched");
+  check(decision.recommended_bitrate_kbits==initial_bitrate,"bitrate back to max after congestion");
+}
+
+// Without ground feedback, we never become more aggressive
+static void scenario_no_ground_feedback(){
+  std::cout<<"Scenario no ground feedback\n";
+  RateController controller(create_config(4,20));
+  SimulatedLink link;
+  auto decision=controller.reset();
+  for(int t=0;t<60;t++){
+    const int rssi=t<20 ? -72 : -50;
+    const auto sample=link.step({rssi,1.0,false},decision);
+    decision=controller.on_new_sample(sample);
+    if(decision.any_changed()){
+      std::cout<<"t:"<<t<<" "<<decision.to_string()<<"\n";
+    }
+  }
+  check(decision.mcs_index<4,"no mcs step up without ground feedback");
+}
+
+static int replay_trace(const std::string& filename,int max_mcs,int min_fec){
+  std::ifstream file(filename);
+  if(!file.is_open()){
+    std::cerr<<"Cannot open "<<filename<<"\n";
+    return -1;
+  }
+  RateController controller(create_config(max_mcs,min_fec));
+  auto decision=controller.reset();
+  std::cout<<decision.to_string()<<"\n";
+  static constexpr auto PREFIX="rate_ctrl_sample,";
+  std::string line;
+  int n_samples=0;
+  while(std::getline(file,line)){
+    const auto idx=line.find(PREFIX);
+    if(idx==std::string::npos)continue;
+    const auto sample=RateController::Sample::from_csv(line.substr(idx+strlen(PREFIX)));
+    if(!sample.has_value()){
+      std::cerr<<"Invalid sample:"<<line<<"\n";
+      continue;
+    }
+    decision=controller.on_new_sample(sample.value());
+    std::cout<<n_samples<<" "<<decision.to_string()<<"\n";
+    n_samples++;
+  }
+  std::cout<<"Replayed "<<n_samples<<" samples\n";
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if(argc>1){
+    const int max_mcs=argc>2 ? std::atoi(argv[2]) : 3;
+    const int min_fec=argc>3 ? std::atoi(argv[3]) : 20;
+    return replay_trace(argv[1],max_mcs,min_fec);
+  }
+  scenario_fly_away_and_back();
+  scenario_tx_congestion();
+  scenario_no_ground_feedback();
+  // Sample <-> csv round trip, such that recorded traces replay exactly
+  {
+    RateController::Sample sample{};
+    sample.count_tx_dropped_packets=12;
+    sample.air_rx_rssi=-60;
+    sample.ground=RateController::GroundFeedback{1000,3,50,-70};
+    const auto parsed=RateController::Sample::from_csv(sample.to_csv());
+    check(parsed.has_value() && parsed->to_csv()==sample.to_csv(),"csv round trip");
+  }
+  if(g_any_failed){
+    std::cerr<<"Some checks failed\n";
+    return -1;
+  }
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "openhd_test_check.hpp"
+#include "wb_link_work_scheduler.h"
+
+// Checks that work items are executed in deadline order, close to their deadline (compared to how late a plain
+// sleep_until wakes up on this machine), and that periodic timers keep running in between.
+
+// Max time a thread wakes up after its sleep_until deadline - what the scheduler can't do better than
+static int64_t measure_sleep_lateness_max_us(){
+  int64_t ret=0;
+  for(int i=0;i<10;i++){
+    const auto deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(50);
+    std::this_thread::sleep_until(deadline);
+    const auto lateness=std::chrono::steady_clock::now()-deadline;
+    ret=std::max(ret,static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(lateness).count()));
+  }
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  const int64_t sleep_lateness_max_us=measure_sleep_lateness_max_us();
+  WorkScheduler scheduler("test_work");
+  std::mutex mutex;
+  std::condition_variable timer_cv;
+  int n_timer_calls=0;
+  scheduler.register_periodic_timer("test",std::chrono::milliseconds(100),[&](){
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      n_timer_calls++;
+    }
+    timer_cv.notify_all();
+  });
+  std::vector<int> order;
+  const auto start=std::chrono::steady_clock::now();
+  // Scheduled in reverse, must be executed in deadline order
+  for(int i=9;i>=0;i--){
+    scheduler.schedule_work_item(std::make_shared<WorkItem>([i,&order,&mutex](){
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(i);
+    },start+std::chrono::milliseconds(50*i)));
+  }
+  OHD_TEST_CHECK(!scheduler.is_idle());
+  // The last item is due after 450ms - returns as soon as it is executed
+  OHD_TEST_CHECK(scheduler.wait_until_idle(std::chrono::seconds(10)));
+  OHD_TEST_CHECK(scheduler.is_idle());
+  OHD_TEST_CHECK(std::chrono::steady_clock::now()-start>=std::chrono::milliseconds(450));
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    OHD_TEST_CHECK(order.size()==10);
+    for(int i=0;i<10;i++){
+      OHD_TEST_CHECK(order[i]==i);
+    }
+    // The timer kept running while items were due
+    OHD_TEST_CHECK(timer_cv.wait_for(lock,std::chrono::seconds(10),[&n_timer_calls](){return n_timer_calls>=5;}));
+  }
+  const auto stats=scheduler.get_stats();
+  OHD_TEST_CHECK(stats.n_executed_work_items==10);
+  std::cout<<stats.to_string()<<" sleep_until lateness max:"<<sleep_lateness_max_us<<"us\n";
+  // The scheduler adds some ms at most on top of what the OS does (a loaded CI machine might be late by a lot more)
+  OHD_TEST_CHECK(stats.lateness_max_us<=std::max<int64_t>(20*1000,sleep_lateness_max_us*2+5*1000));
+  std::cout<<"Done\n";
+  return 0;
+}
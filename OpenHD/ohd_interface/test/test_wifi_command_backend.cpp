@@ -0,0 +1,192 @@
+#include <linux/nl80211.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+
+#include "openhd_test_check.hpp"
+#include "wifi_command_backend.h"
+#include "wifi_command_helper2.h"
+
+// Runs the nl80211 backend against a fake netlink transport (no wifi card / root needed),
+// checks the generated nl80211 commands / the fallback to iw / ip and prints the timings.
+// Usage:
+// test_wifi_command_backend -> fake transport
+// test_wifi_command_backend [wifi card] [frequency] -> real card via nl80211 (needs root), prints how long each step took
+
+using namespace wifi::commandhelper2;
+
+// Emulates what the kernel does for the nl80211 commands we use
+class FakeNetlinkTransport : public NetlinkTransport{
+ public:
+  struct FakeCard{
+    int ifindex;
+    bool up=true;
+    uint32_t iftype=NL80211_IFTYPE_STATION;
+    bool otherbss=false;
+    uint32_t freq_mhz=0;
+    uint32_t channel_type=0;
+    uint32_t tx_power_mBm=0;
+  };
+  explicit FakeNetlinkTransport(std::vector<std::string> devices){
+    int ifindex=10;
+    for(const auto& device:devices){
+      m_cards[device]=FakeCard{ifindex++};
+    }
+  }
+  int get_ifindex(const std::string &device) override{
+    auto card=get_card(device);
+    return card ? card->ifindex : 0;
+  }
+  int set_interface_up(const std::string &device, bool up) override{
+    auto card=get_card(device);
+    if(!card)return -ENODEV;
+    card->up=up;
+    return 0;
+  }
+  int nl80211_request(uint8_t cmd,const std::vector<NlAttribute> &attributes,std::vector<NlAttribute> *opt_reply) override{
+    n_requests++;
+    auto card=get_card_by_ifindex(find_u32(attributes,NL80211_ATTR_IFINDEX).value_or(0));
+    if(!card)return -ENODEV;
+    if(cmd==NL80211_CMD_SET_INTERFACE){
+      // changing the type is only possible while the card is down
+      if(card->up)return -EBUSY;
+      card->iftype=find_u32(attributes,NL80211_ATTR_IFTYPE).value_or(0);
+      for(const auto& attr:attributes){
+        if(attr.type!=NL80211_ATTR_MNTR_FLAGS)continue;
+        for(const auto& flag:attr.as_nested()){
+          if(flag.type==NL80211_MNTR_FLAG_OTHER_BSS)card->otherbss=true;
+        }
+      }
+      return 0;
+    }
+    if(cmd==NL80211_CMD_GET_INTERFACE){
+      if(opt_reply){
+        *opt_reply={NlAttribute::u32(NL80211_ATTR_IFINDEX,card->ifindex),NlAttribute::u32(NL80211_ATTR_IFTYPE,card->iftype)};
+      }
+      return 0;
+    }
+    if(cmd==NL80211_CMD_SET_WIPHY){
+      const auto freq=find_u32(attributes,NL80211_ATTR_WIPHY_FREQ);
+      if(freq.has_value()){
+        if(unsupported_frequencies.count(freq.value())>0)return -EINVAL;
+        card->freq_mhz=freq.value();
+        card->channel_type=find_u32(attributes,NL80211_ATTR_WIPHY_CHANNEL_TYPE).value_or(0);
+      }
+      const auto tx_power_setting=find_u32(attributes,NL80211_ATTR_WIPHY_TX_POWER_SETTING);
+      if(tx_power_setting.has_value()){
+        card->tx_power_mBm=find_u32(attributes,NL80211_ATTR_WIPHY_TX_POWER_LEVEL).value_or(0);
+      }
+      return 0;
+    }
+    return -EOPNOTSUPP;
+  }
+  FakeCard* get_card(const std::string& device){
+    auto it=m_cards.find(device);
+    return it==m_cards.end() ? nullptr : &it->second;
+  }
+  std::set<uint32_t> unsupported_frequencies;
+  int n_requests=0;
+ private:
+  FakeCard* get_card_by_ifindex(uint32_t ifindex){
+    for(auto& card:m_cards){
+      if(card.second.ifindex==static_cast<int>(ifindex))return &card.second;
+    }
+    return nullptr;
+  }
+  std::map<std::string,FakeCard> m_cards;
+};
+
+// Instead of running iw / ip on the host, only records the fallback calls
+class FakeShellCommands : public wifi::backend::ShellCommands{
+ public:
+  bool set_card_state(const std::string &device, bool up) override{
+    n_calls++;
+    return false;
+  }
+  bool enable_monitor_mode(const std::string &device) override{
+    n_calls++;
+    return false;
+  }
+  bool set_frequency_and_channel_width(const std::string &device, uint32_t freq_mhz,uint32_t channel_width) override{
+    n_calls++;
+    last_freq_mhz=freq_mhz;
+    return false;
+  }
+  bool set_tx_power(const std::string &device, uint32_t tx_power_mBm) override{
+    n_calls++;
+    return false;
+  }
+  int n_calls=0;
+  uint32_t last_freq_mhz=0;
+};
+
+static void test_attributes(){
+  const auto nested=NlAttribute::nested(NL80211_ATTR_MNTR_FLAGS,{NlAttribute::flag(NL80211_MNTR_FLAG_OTHER_BSS)});
+  const std::vector<NlAttribute> attributes{NlAttribute::u32(NL80211_ATTR_IFINDEX,3),nested,NlAttribute::u32(NL80211_ATTR_WIPHY_FREQ,5745)};
+  const auto serialized=serialize_attributes(attributes);
+  // 3 attributes, 4 byte header each, 2x 4 byte payload + nested (4 byte header of the flag)
+  OHD_TEST_CHECK(serialized.size()==4*3+4+4+4);
+  const auto parsed=parse_attributes(serialized.data(),static_cast<int>(serialized.size()));
+  OHD_TEST_CHECK(parsed.size()==3);
+  OHD_TEST_CHECK(find_u32(parsed,NL80211_ATTR_IFINDEX).value()==3);
+  OHD_TEST_CHECK(find_u32(parsed,NL80211_ATTR_WIPHY_FREQ).value()==5745);
+  OHD_TEST_CHECK(parsed.at(1).type==NL80211_ATTR_MNTR_FLAGS);
+  OHD_TEST_CHECK(parsed.at(1).as_nested().size()==1);
+  OHD_TEST_CHECK(parsed.at(1).as_nested().at(0).type==NL80211_MNTR_FLAG_OTHER_BSS);
+}
+
+static void test_fake(){
+  auto fake=std::make_shared<FakeNetlinkTransport>(std::vector<std::string>{"wlan0","wlan1"});
+  auto fake_shell=std::make_shared<FakeShellCommands>();
+  wifi::backend::select(true,fake,fake_shell);
+  OHD_TEST_CHECK(wifi::backend::is_netlink_active());
+  for(const auto& device:{"wlan0","wlan1"}){
+    OHD_TEST_CHECK(wifi::backend::enable_monitor_mode(device));
+    OHD_TEST_CHECK(wifi::backend::is_monitor_mode(device).value());
+    const auto card=fake->get_card(device);
+    OHD_TEST_CHECK(card->up && card->otherbss);
+    OHD_TEST_CHECK(wifi::backend::set_frequency_and_channel_width(device,5745,40));
+    OHD_TEST_CHECK(card->freq_mhz==5745 && card->channel_type==NL80211_CHAN_HT40PLUS);
+    OHD_TEST_CHECK(wifi::backend::set_tx_power(device,2000));
+    OHD_TEST_CHECK(card->tx_power_mBm==2000);
+  }
+  OHD_TEST_CHECK(wifi::backend::get_n_fallbacks()==0);
+  OHD_TEST_CHECK(fake_shell->n_calls==0);
+  // Emulate a channel the driver rejects - falls back to iw (which fails as well)
+  fake->unsupported_frequencies.insert(5180);
+  const auto before=fake->get_card("wlan0")->freq_mhz;
+  OHD_TEST_CHECK(!wifi::backend::set_frequency_and_channel_width("wlan0",5180,20));
+  OHD_TEST_CHECK(fake->get_card("wlan0")->freq_mhz==before);
+  OHD_TEST_CHECK(wifi::backend::get_n_fallbacks()==1);
+  OHD_TEST_CHECK(fake_shell->n_calls==1);
+  OHD_TEST_CHECK(fake_shell->last_freq_mhz==5180);
+  std::cout<<wifi::backend::get_stats_string()<<"\n";
+}
+
+static void test_real_card(const std::string& device,uint32_t frequency){
+  wifi::backend::select(true);
+  if(!wifi::backend::is_netlink_active()){
+    std::cerr<<"nl80211 not available\n";
+    return;
+  }
+  wifi::backend::enable_monitor_mode(device);
+  std::cout<<"Monitor mode:"<<(wifi::backend::is_monitor_mode(device).value_or(false) ? "Y" : "N")<<"\n";
+  for(int i=0;i<10;i++){
+    wifi::backend::set_frequency_and_channel_width(device,frequency,i%2==0 ? 20 : 40);
+  }
+  std::cout<<wifi::backend::get_stats_string()<<"\n";
+}
+
+int main(int argc, char *argv[]) {
+  if(argc>=3){
+    test_real_card(argv[1],std::atoi(argv[2]));
+    return 0;
+  }
+  test_attributes();
+  test_fake();
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -6,20 +6,26 @@
 
 #include <chrono>
 
+#include "internal/OHDLinkStatisticsHelper.h"
 #include "mav_helper.h"
 #include "mavsdk_temporary/XMavlinkParamProvider.h"
+#include "openhd_config.h"
 #include "openhd_temporary_air_or_ground.h"
 #include "openhd_util_time.hpp"
 
 AirTelemetry::AirTelemetry(OHDPlatform platform,std::shared_ptr<openhd::ActionHandler> opt_action_handler): m_platform(platform),MavlinkSystem(OHD_SYS_ID_AIR) {
   m_console = openhd::log::create_or_get("air_tele");
   assert(m_console);
+  m_router=std::make_unique<MavlinkRouter>("air_routing");
+  if(openhd::load_config().DEV_TELEMETRY_EPOLL_REACTOR){
+    m_opt_reactor=std::make_shared<EpollReactor>("air_reactor");
+  }
   m_air_settings =std::make_unique<openhd::telemetry::air::SettingsHolder>(platform);
   m_fc_serial =std::make_unique<SerialEndpointManager>();
   setup_uart();
   m_ohd_main_component =std::make_shared<OHDMainComponent>(
       m_platform,_sys_id,true,opt_action_handler);
-  m_components.push_back(m_ohd_main_component);
+  m_router->add_component(m_ohd_main_component);
   //
   m_generic_mavlink_param_provider =std::make_shared<XMavlinkParamProvider>(_sys_id,MAV_COMP_ID_ONBOARD_COMPUTER);
   if(m_platform.platform_type==PlatformType::RaspberryPi){
@@ -28,25 +34,34 @@ AirTelemetry::AirTelemetry(OHDPlatform platform,std::shared_ptr<openhd::ActionHa
   // NOTE: We don't call set ready yet, since we have to wait until other modules have provided
   // all their paramters.
   m_generic_mavlink_param_provider->add_params(get_all_settings());
-  m_components.push_back(m_generic_mavlink_param_provider);
+  m_router->add_component(m_generic_mavlink_param_provider);
   //TODO should we really enable a mavlink server on air ?
-  m_tcp_server=std::make_unique<TCPEndpoint>(TCPEndpoint::Config{TCPEndpoint::DEFAULT_PORT});//1445
+  m_tcp_server=std::make_unique<TCPEndpoint>(TCPEndpoint::Config{TCPEndpoint::DEFAULT_PORT,m_opt_reactor});//1445
   //m_tcp_server= nullptr;
   if(m_tcp_server){
-    m_tcp_server->registerCallback([this](std::vector<MavlinkMessage> messages) {
+    m_tcp_server->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
       // Technically not correct, but works
       on_messages_ground_unit(messages);
     });
   }
+  if(m_opt_reactor){
+    m_generate_timer_handle=m_opt_reactor->add_timer(std::chrono::milliseconds(500),[this](){
+      generate_and_send_messages();
+    });
+  }
   m_console->debug("Created AirTelemetry");
 }
 
 AirTelemetry::~AirTelemetry() {
-
+  if(m_opt_reactor){
+    m_opt_reactor->remove(m_generate_timer_handle);
+  }
 }
 
 void AirTelemetry::send_messages_fc(const std::vector<MavlinkMessage>& messages) {
   auto [generic,local_only]=split_into_generic_and_local_only(messages,OHD_SYS_ID_AIR);
+  // Don't bother the FC with messages for a system we know is not behind the FC
+  generic=m_router->filter_for_endpoint("fc",generic);
   // NOTE: Remember there is a hack in place for rc channels override in regards to the sender sys id
   m_fc_serial->send_messages_if_enabled(generic);
 }
@@ -65,27 +80,28 @@ void AirTelemetry::on_messages_fc(const std::vector<MavlinkMessage>& messages) {
   //openhd::log::get_default()->debug("on_messages_fc {}",messages.size());
   //debugMavlinkMessage(message.m,"AirTelemetry::onMessageFC");
   // Note: No OpenHD component ever talks to the FC, FC is completely passed through
+  m_router->learn_routes("fc",messages);
   send_messages_ground_unit(messages);
   m_ohd_main_component->check_fc_messages_for_actions(messages);
 }
 
 void AirTelemetry::on_messages_ground_unit(const std::vector<MavlinkMessage>& messages) {
   //openhd::log::get_default()->debug("on_messages_ground_unit {}",messages.size());
+  m_router->learn_routes("ground",messages);
   // filter out heartbeats from the openhd ground unit,we do not need to send them to the FC
   std::vector<MavlinkMessage> filtered_messages_fc;
   for(const auto& msg:messages){
     const mavlink_message_t &m = msg.m;
     if(static_cast<int>(m.msgid) == MAVLINK_MSG_ID_HEARTBEAT && m.sysid == OHD_SYS_ID_GROUND)continue;
+    // same for the link feedback, it is only for OHDMainComponent
+    if(openhd::LinkStatisticsHelper::is_ground_link_feedback_message(msg))continue;
     filtered_messages_fc.push_back(msg);
   }
   send_messages_fc(filtered_messages_fc);
   // any data created by an OpenHD component on the air pi only needs to be sent to the ground pi, the FC cannot do anything with it anyways.
   std::lock_guard<std::mutex> guard(m_components_lock);
-  for(auto& component: m_components){
-    std::vector<MavlinkMessage> responses{};
-    OHDUtil::vec_append(responses,component->process_mavlink_messages(messages));
-    send_messages_ground_unit(responses);
-  }
+  const auto responses=m_router->dispatch_to_components(messages);
+  send_messages_ground_unit(responses);
 }
 
 void AirTelemetry::loop_infinite(bool& terminate,const bool enableExtendedLogging) {
@@ -101,17 +117,30 @@ void AirTelemetry::loop_infinite(bool& terminate,const bool enableExtendedLoggin
       // for debugging, check if any of the endpoints is not alive
       if (enableExtendedLogging && m_wb_endpoint) {
         m_console->debug(m_wb_endpoint->createInfo());
+        const auto scheduler_stats=m_wb_endpoint->get_scheduler_stats_string();
+        if(!scheduler_stats.empty())m_console->debug(scheduler_stats);
       }
-    }
-    // send messages to the ground pi in regular intervals, includes heartbeat.
-    // everything else is handled by the callbacks and their threads
-    {
-      std::lock_guard<std::mutex> guard(m_components_lock);
-      for(auto& component: m_components){
-        const auto messages=component->generate_mavlink_messages();
-        send_messages_ground_unit(messages);
+      if (enableExtendedLogging) {
+        m_console->debug(m_router->get_stats_string());
+      }
+      if (enableExtendedLogging) {
+        const auto serial_stats=m_fc_serial->get_stats_string();
+        if(!serial_stats.empty())m_console->debug(serial_stats);
+      }
+      if (enableExtendedLogging && m_tcp_server) {
+        m_console->debug(m_tcp_server->get_clients_stats_string());
+      }
+      if (enableExtendedLogging && m_opt_reactor) {
+        m_console->debug(m_opt_reactor->get_stats_string());
       }
     }
+    if(m_opt_reactor){
+      // generating is done by the reactor timer
+      std::this_thread::sleep_for(loop_intervall);
+      continue;
+    }
+    // everything else is handled by the callbacks and their threads
+    generate_and_send_messages();
     const auto loopDelta=std::chrono::steady_clock::now()-loopBegin;
     if(loopDelta>loop_intervall){
       // We can't keep up with the wanted loop interval
@@ -125,12 +154,27 @@ void AirTelemetry::loop_infinite(bool& terminate,const bool enableExtendedLoggin
   }
 }
 
+void AirTelemetry::generate_and_send_messages() {
+  std::lock_guard<std::mutex> guard(m_components_lock);
+  for(auto& component: m_router->get_components()){
+    const auto messages=component->generate_mavlink_messages();
+    send_messages_ground_unit(messages);
+  }
+}
+
 std::string AirTelemetry::create_debug(){
   std::stringstream ss;
   //ss<<"AT:\n";
   if (m_wb_endpoint) {
 	ss<< m_wb_endpoint->createInfo();
   }
+  if(m_tcp_server){
+    ss<<m_tcp_server->get_clients_stats_string();
+  }
+  ss<<m_router->get_stats_string();
+  if(m_opt_reactor){
+    ss<<m_opt_reactor->get_stats_string();
+  }
   return ss.str();
 }
 
@@ -152,7 +196,7 @@ void AirTelemetry::add_settings_camera_component(
   param_server->add_params(settings);
   param_server->set_ready();
   std::lock_guard<std::mutex> guard(m_components_lock);
-  m_components.push_back(param_server);
+  m_router->add_component(param_server);
   m_console->debug("Added camera component");
 }
 
@@ -223,17 +267,18 @@ void AirTelemetry::setup_uart() {
     options.baud_rate=m_air_settings->get_settings().fc_uart_baudrate;
     options.flow_control= m_air_settings->get_settings().fc_uart_flow_control;
     options.enable_reading= true;
-    m_fc_serial->configure(options,"fc_ser",[this](std::vector<MavlinkMessage> messages) {
+    m_fc_serial->configure(options,"fc_ser",[this](const std::vector<MavlinkMessage>& messages) {
       this->on_messages_fc(messages);
-    });
+    },m_opt_reactor);
   }else{
     m_fc_serial->disable();
   }
 }
 
 void AirTelemetry::set_link_handle(std::shared_ptr<OHDLink> link) {
-  m_wb_endpoint = std::make_unique<WBEndpoint>(link,"wb_tx");
-  m_wb_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
+  m_wb_endpoint = std::make_unique<WBEndpoint>(link,"wb_tx",m_opt_reactor,
+                                               openhd::load_config().DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND);
+  m_wb_endpoint->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
     on_messages_ground_unit(messages);
   });
 }
@@ -12,6 +12,7 @@
 #include "openhd_link_statistics.hpp"
 #include "openhd_platform.h"
 #include "openhd_settings_imp.hpp"
+#include "routing/MavlinkRouter.h"
 #include "routing/MavlinkSystem.hpp"
 //
 #include "AirTelemetrySettings.h"
@@ -74,8 +75,13 @@ class AirTelemetry : public MavlinkSystem{
   // R.N only on air, and only FC uart settings
   std::vector<openhd::Setting> get_all_settings();
   void setup_uart();
+  // send messages to the ground pi in regular intervals, includes heartbeat.
+  void generate_and_send_messages();
  private:
   const OHDPlatform m_platform;
+  // Optional (DEV_TELEMETRY_EPOLL_REACTOR) - if set, all endpoints and the generate timer run on this reactor
+  std::shared_ptr<EpollReactor> m_opt_reactor;
+  EpollReactor::Handle m_generate_timer_handle=0;
   std::unique_ptr<openhd::telemetry::air::SettingsHolder> m_air_settings;
   std::unique_ptr<SerialEndpointManager> m_fc_serial;
   // send/receive data via wb
@@ -83,7 +89,8 @@ class AirTelemetry : public MavlinkSystem{
   // shared because we also push it onto our components list
   std::shared_ptr<OHDMainComponent> m_ohd_main_component;
   std::mutex m_components_lock;
-  std::vector<std::shared_ptr<MavlinkComponent>> m_components;
+  // dispatches incoming messages only to the component(s) that need them, learns the routes to the other systems
+  std::unique_ptr<MavlinkRouter> m_router;
   std::shared_ptr<XMavlinkParamProvider> m_generic_mavlink_param_provider;
   // rpi only, allow changing gpios via settings
   std::unique_ptr<openhd::telemetry::rpi::GPIOControl> m_opt_gpio_control=nullptr;
@@ -7,7 +7,9 @@
 #include <chrono>
 #include <iostream>
 
+#include "internal/OHDLinkStatisticsHelper.h"
 #include "mav_helper.h"
+#include "openhd_config.h"
 #include "openhd_temporary_air_or_ground.h"
 #include "openhd_util_time.hpp"
 
@@ -16,27 +18,33 @@ GroundTelemetry::GroundTelemetry(OHDPlatform platform,
  _platform(platform),MavlinkSystem(OHD_SYS_ID_GROUND) {
   m_console = openhd::log::create_or_get("ground_tele");
   assert(m_console);
+  m_router=std::make_unique<MavlinkRouter>("ground_routing");
   m_gnd_settings =std::make_unique<openhd::telemetry::ground::SettingsHolder>();
   m_endpoint_tracker=std::make_unique<SerialEndpointManager>();
+  const auto config=openhd::load_config();
+  m_send_link_feedback_to_air=config.DEV_WB_ADAPTIVE_LINK_CONTROLLER;
+  if(config.DEV_TELEMETRY_EPOLL_REACTOR){
+    m_opt_reactor=std::make_shared<EpollReactor>("ground_reactor");
+  }
   setup_uart();
   m_gcs_endpoint =
       std::make_unique<UDPEndpoint2>("GroundStationUDP",OHD_GROUND_CLIENT_UDP_PORT_OUT, OHD_GROUND_CLIENT_UDP_PORT_IN,
                                      // We send data to localhost::14550 and any other external device IPs
                                      "127.0.0.1",
                                      // and we accept udp data from anybody on 14551
-                                     "0.0.0.0");
-  m_gcs_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
+                                     "0.0.0.0",m_opt_reactor);
+  m_gcs_endpoint->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
     on_messages_ground_station_clients(messages);
   });
-  m_tcp_server=std::make_unique<TCPEndpoint>(TCPEndpoint::Config{TCPEndpoint::DEFAULT_PORT});//1445
+  m_tcp_server=std::make_unique<TCPEndpoint>(TCPEndpoint::Config{TCPEndpoint::DEFAULT_PORT,m_opt_reactor});//1445
   //m_tcp_server= nullptr;
   if(m_tcp_server){
-    m_tcp_server->registerCallback([this](std::vector<MavlinkMessage> messages) {
+    m_tcp_server->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
       on_messages_ground_station_clients(messages);
     });
   }
   m_ohd_main_component =std::make_shared<OHDMainComponent>(_platform,_sys_id,false,opt_action_handler);
-  m_components.push_back(m_ohd_main_component);
+  m_router->add_component(m_ohd_main_component);
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
   if(m_gnd_settings->get_settings().enable_rc_over_joystick){
     enable_joystick();
@@ -51,11 +59,19 @@ GroundTelemetry::GroundTelemetry(OHDPlatform platform,
   // all their parameters.
   m_generic_mavlink_param_provider =std::make_shared<XMavlinkParamProvider>(_sys_id,MAV_COMP_ID_ONBOARD_COMPUTER);
   m_generic_mavlink_param_provider->add_params(get_all_settings());
-  m_components.push_back(m_generic_mavlink_param_provider);
+  m_router->add_component(m_generic_mavlink_param_provider);
+  if(m_opt_reactor){
+    m_generate_timer_handle=m_opt_reactor->add_timer(std::chrono::milliseconds(500),[this](){
+      generate_and_send_messages();
+    });
+  }
   m_console->debug("Created GroundTelemetry");
 }
 
 GroundTelemetry::~GroundTelemetry() {
+  if(m_opt_reactor){
+    m_opt_reactor->remove(m_generate_timer_handle);
+  }
   // first, stop all the endpoints that have their own threads
   m_wb_endpoint = nullptr;
   m_gcs_endpoint = nullptr;
@@ -70,6 +86,7 @@ GroundTelemetry::~GroundTelemetry() {
 void GroundTelemetry::on_messages_air_unit(const std::vector<MavlinkMessage>& messages) {
   // All messages we get from the Air pi (they might come from the AirPi itself or the FC connected to the air pi)
   // get forwarded straight to all the client(s) connected to the ground station.
+  m_router->learn_routes("air",messages);
   send_messages_ground_station_clients(messages);
   // Note: No OpenHD component ever talks to another OpenHD component or the FC, so we do not
   // need to do anything else here.
@@ -86,16 +103,16 @@ void GroundTelemetry::on_messages_air_unit(const std::vector<MavlinkMessage>& me
 void GroundTelemetry::on_messages_ground_station_clients(const std::vector<MavlinkMessage>& messages) {
   // All messages from the ground station(s) are forwarded to the air unit, unless they have a target sys id
   // of the ohd ground unit itself
+  m_router->learn_routes("gcs",messages);
   auto [generic,local_only]=split_into_generic_and_local_only(messages,OHD_SYS_ID_GROUND);
-  send_messages_air_unit(generic);
+  // e.g. messages between 2 ground station clients don't need to go over the air
+  send_messages_air_unit(m_router->filter_for_endpoint("air",generic));
   // OpenHD components running on the ground station don't need to talk to the air unit.
   // This is not exactly following the mavlink routing standard, but saves a lot of bandwidth.
   std::lock_guard<std::mutex> guard(m_components_lock);
-  for(auto& component: m_components){
-    const auto responses=component->process_mavlink_messages(messages);
-    // for now, send to the ground station clients only
-    send_messages_ground_station_clients(responses);
-  }
+  const auto responses=m_router->dispatch_to_components(messages);
+  // for now, send to the ground station clients only
+  send_messages_ground_station_clients(responses);
 }
 
 void GroundTelemetry::send_messages_ground_station_clients(const std::vector<MavlinkMessage>& messages) {
@@ -126,30 +143,29 @@ void GroundTelemetry::loop_infinite(bool& terminate,const bool enableExtendedLog
       // for debugging, check if any of the endpoints is not alive
       if (enableExtendedLogging && m_wb_endpoint) {
         m_console->debug(m_wb_endpoint->createInfo());
+        const auto scheduler_stats=m_wb_endpoint->get_scheduler_stats_string();
+        if(!scheduler_stats.empty())m_console->debug(scheduler_stats);
       }
       if (enableExtendedLogging && m_gcs_endpoint) {
         m_console->debug(m_gcs_endpoint->createInfo());
       }
-    }
-    // send messages to the ground station in regular intervals, includes heartbeat.
-    // everything else is handled by the callbacks and their threads
-    {
-      std::lock_guard<std::mutex> guard(m_components_lock);
-      for(auto& component: m_components){
-        assert(component);
-        const auto messages=component->generate_mavlink_messages();
-        send_messages_ground_station_clients(messages);
-        for(const auto& msg:messages){
-          // r.n no ground unit component needs to talk to the air unit directly.
-          // but we send heartbeats to the air pi anyways, just to keep the link active.
-          if(msg.m.msgid==MAVLINK_MSG_ID_HEARTBEAT && msg.m.compid==MAV_COMP_ID_ONBOARD_COMPUTER){
-            // but we send heartbeats to the air pi anyways, just to keep the link active.
-            //m_console->debug("Heartbeat sent to air unit");
-            send_messages_air_unit({msg});
-          }
-        }
+      if (enableExtendedLogging) {
+        m_console->debug(m_router->get_stats_string());
+      }
+      if (enableExtendedLogging && m_tcp_server) {
+        m_console->debug(m_tcp_server->get_clients_stats_string());
+      }
+      if (enableExtendedLogging && m_opt_reactor) {
+        m_console->debug(m_opt_reactor->get_stats_string());
       }
     }
+    if(m_opt_reactor){
+      // generating is done by the reactor timer
+      std::this_thread::sleep_for(loop_intervall);
+      continue;
+    }
+    // everything else is handled by the callbacks and their threads
+    generate_and_send_messages();
     const auto loopDelta=std::chrono::steady_clock::now()-loopBegin;
     if(loopDelta>loop_intervall){
       // We can't keep up with the wanted loop interval
@@ -164,6 +180,27 @@ void GroundTelemetry::loop_infinite(bool& terminate,const bool enableExtendedLog
   }
 }
 
+void GroundTelemetry::generate_and_send_messages() {
+  std::lock_guard<std::mutex> guard(m_components_lock);
+  for(auto& component: m_router->get_components()){
+    assert(component);
+    const auto messages=component->generate_mavlink_messages();
+    send_messages_ground_station_clients(messages);
+    for(const auto& msg:messages){
+      // r.n no ground unit component needs to talk to the air unit directly.
+      // but we send heartbeats to the air pi anyways, just to keep the link active.
+      if(msg.m.msgid==MAVLINK_MSG_ID_HEARTBEAT && msg.m.compid==MAV_COMP_ID_ONBOARD_COMPUTER){
+        // but we send heartbeats to the air pi anyways, just to keep the link active.
+        //m_console->debug("Heartbeat sent to air unit");
+        send_messages_air_unit({msg});
+      }else if(m_send_link_feedback_to_air && openhd::LinkStatisticsHelper::is_ground_link_feedback_message(msg)){
+        // the adaptive link controller on air needs to know how well the video arrives
+        send_messages_air_unit({msg});
+      }
+    }
+  }
+}
+
 std::string GroundTelemetry::create_debug() const {
   std::stringstream ss;
   //ss<<"GT:\n";
@@ -173,6 +210,13 @@ std::string GroundTelemetry::create_debug() const {
   if (m_gcs_endpoint) {
     ss<< m_gcs_endpoint->createInfo();
   }
+  if(m_tcp_server){
+    ss<<m_tcp_server->get_clients_stats_string();
+  }
+  ss<<m_router->get_stats_string();
+  if(m_opt_reactor){
+    ss<<m_opt_reactor->get_stats_string();
+  }
   return ss.str();
 }
 
@@ -285,9 +329,9 @@ void GroundTelemetry::setup_uart() {
     options.baud_rate=m_gnd_settings->get_settings().gnd_uart_baudrate;
     options.flow_control= false;
     options.enable_reading= false;
-    m_endpoint_tracker->configure(options,"gnd_ser",[this](std::vector<MavlinkMessage> messages) {
+    m_endpoint_tracker->configure(options,"gnd_ser",[this](const std::vector<MavlinkMessage>& messages) {
       // We ignore any incoming messages here for now, since it is only for mavlink out via serial
-    });
+    },m_opt_reactor);
   }else{
     m_endpoint_tracker->disable();
   }
@@ -296,8 +340,9 @@ void GroundTelemetry::setup_uart() {
 void GroundTelemetry::set_link_handle(std::shared_ptr<OHDLink> link) {
   // only call this once, we do not support changing the link handle at run time
   assert(m_wb_endpoint== nullptr);
-  m_wb_endpoint = std::make_unique<WBEndpoint>(link,"wb_tx");
-  m_wb_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
+  m_wb_endpoint = std::make_unique<WBEndpoint>(link,"wb_tx",m_opt_reactor,
+                                               openhd::load_config().DEV_WB_TELEMETRY_MAX_BYTES_PER_SECOND);
+  m_wb_endpoint->registerCallback([this](const std::vector<MavlinkMessage>& messages) {
     on_messages_air_unit(messages);
   });
 }
@@ -17,6 +17,7 @@
 #include "openhd_link.hpp"
 #include "openhd_settings_imp.hpp"
 #include "openhd_spdlog.h"
+#include "routing/MavlinkRouter.h"
 
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
 #include "rc/JoystickReader.h"
@@ -64,6 +65,9 @@ class GroundTelemetry :public MavlinkSystem{
   void set_ext_devices_manager(std::shared_ptr<openhd::ExternalDeviceManager> ext_device_manager);
  private:
   const OHDPlatform _platform;
+  // Optional (DEV_TELEMETRY_EPOLL_REACTOR) - if set, all endpoints and the generate timer run on this reactor
+  std::shared_ptr<EpollReactor> m_opt_reactor;
+  EpollReactor::Handle m_generate_timer_handle=0;
   // called every time one or more messages from the air unit are received
   void on_messages_air_unit(const std::vector<MavlinkMessage>& messages);
   // send messages to the air unit, lossy
@@ -74,6 +78,8 @@ class GroundTelemetry :public MavlinkSystem{
   void send_messages_ground_station_clients(const std::vector<MavlinkMessage>& messages);
   std::vector<openhd::Setting> get_all_settings();
   void setup_uart();
+  // send messages to the ground station in regular intervals, includes heartbeat.
+  void generate_and_send_messages();
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
   void enable_joystick();
   void disable_joystick();
@@ -91,9 +97,12 @@ class GroundTelemetry :public MavlinkSystem{
   std::unique_ptr<WBEndpoint> m_wb_endpoint;
   std::shared_ptr<OHDMainComponent> m_ohd_main_component;
   std::mutex m_components_lock;
-  std::vector<std::shared_ptr<MavlinkComponent>> m_components;
+  // dispatches incoming messages only to the component(s) that need them, learns the routes to the other systems
+  std::unique_ptr<MavlinkRouter> m_router;
   std::shared_ptr<XMavlinkParamProvider> m_generic_mavlink_param_provider;
   std::shared_ptr<openhd::ExternalDeviceManager> m_ext_device_manager;
+  // DEV_WB_ADAPTIVE_LINK_CONTROLLER
+  bool m_send_link_feedback_to_air=false;
   //
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
   std::unique_ptr<RcJoystickSender> m_rc_joystick_sender= nullptr;
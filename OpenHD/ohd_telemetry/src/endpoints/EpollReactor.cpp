@@ -0,0 +1,270 @@
+#include "EpollReactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#include "openhd_util_filesystem.h"
+#include "openhd_util_time.hpp"
+
+// epoll data of the eventfd, never a valid handle
+static constexpr uint64_t EVENT_FD_ID=0;
+
+// voluntary + nonvoluntary context switches of one thread (/proc/self/status only has the calling thread's)
+static uint64_t get_thread_context_switches(const std::string& status_file){
+  uint64_t ret=0;
+  std::ifstream status(status_file);
+  std::string line;
+  while(std::getline(status,line)){
+    if(line.rfind("voluntary_ctxt_switches:",0)==0 || line.rfind("nonvoluntary_ctxt_switches:",0)==0){
+      ret+=std::stoull(line.substr(line.find(':')+1));
+    }
+  }
+  return ret;
+}
+
+// Sum of all (currently alive) threads of this process, 0 if unknown
+static uint64_t get_process_context_switches(){
+  uint64_t ret=0;
+  for(const auto& task:OHDFilesystemUtil::getAllEntriesFullPathInDirectory("/proc/self/task")){
+    ret+=get_thread_context_switches(task+"/status");
+  }
+  return ret;
+}
+
+EpollReactor::EpollReactor(const std::string& tag) {
+  m_console=openhd::log::create_or_get(tag);
+  assert(m_console);
+  m_epoll_fd=epoll_create1(EPOLL_CLOEXEC);
+  m_event_fd=eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+  if(m_epoll_fd<0 || m_event_fd<0){
+    m_console->error("Cannot create epoll / eventfd {}",strerror(errno));
+  }
+  epoll_event event{};
+  event.events=EPOLLIN;
+  event.data.u64=EVENT_FD_ID;
+  epoll_ctl(m_epoll_fd,EPOLL_CTL_ADD,m_event_fd,&event);
+  m_last_stats_n_context_switches=get_process_context_switches();
+  m_thread=std::make_unique<std::thread>(&EpollReactor::loop,this);
+}
+
+EpollReactor::~EpollReactor() {
+  m_stop_requested=true;
+  wakeup();
+  if(m_thread){
+    m_thread->join();
+    m_thread.reset();
+  }
+  for(auto& [handle,handler]:m_handlers){
+    if(handler->is_timer)close(handler->fd);
+  }
+  close(m_event_fd);
+  close(m_epoll_fd);
+}
+
+EpollReactor::Handle EpollReactor::add_fd(int fd,uint32_t events,FdCallback cb) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const Handle handle=m_next_handle++;
+  epoll_event event{};
+  event.events=events;
+  event.data.u64=handle;
+  if(epoll_ctl(m_epoll_fd,EPOLL_CTL_ADD,fd,&event)!=0){
+    m_console->warn("Cannot add fd {}: {}",fd,strerror(errno));
+    return 0;
+  }
+  m_handlers[handle]=std::make_shared<Handler>(Handler{fd,false,std::move(cb),nullptr,{},{}});
+  return handle;
+}
+
+bool EpollReactor::modify_fd(Handle handle,uint32_t events) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto it=m_handlers.find(handle);
+  if(it==m_handlers.end())return false;
+  epoll_event event{};
+  event.events=events;
+  event.data.u64=handle;
+  return epoll_ctl(m_epoll_fd,EPOLL_CTL_MOD,it->second->fd,&event)==0;
+}
+
+EpollReactor::Handle EpollReactor::add_timer(std::chrono::milliseconds interval,std::function<void()> cb) {
+  const int timer_fd=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+  if(timer_fd<0){
+    m_console->warn("Cannot create timerfd {}",strerror(errno));
+    return 0;
+  }
+  itimerspec spec{};
+  spec.it_interval.tv_sec=interval.count()/1000;
+  spec.it_interval.tv_nsec=(interval.count()%1000)*1000*1000;
+  spec.it_value=spec.it_interval;
+  timerfd_settime(timer_fd,0,&spec,nullptr);
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const Handle handle=m_next_handle++;
+  epoll_event event{};
+  event.events=EPOLLIN;
+  event.data.u64=handle;
+  if(epoll_ctl(m_epoll_fd,EPOLL_CTL_ADD,timer_fd,&event)!=0){
+    m_console->warn("Cannot add timer {}",strerror(errno));
+    close(timer_fd);
+    return 0;
+  }
+  m_handlers[handle]=std::make_shared<Handler>(Handler{timer_fd,true,nullptr,std::move(cb),interval,
+                                                        std::chrono::steady_clock::now()+interval});
+  return handle;
+}
+
+void EpollReactor::remove(Handle handle) {
+  // Done on the reactor thread, such that the callback is guaranteed to not run concurrently / afterwards
+  run_and_wait([this,handle](){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it=m_handlers.find(handle);
+    if(it==m_handlers.end())return;
+    epoll_ctl(m_epoll_fd,EPOLL_CTL_DEL,it->second->fd,nullptr);
+    if(it->second->is_timer)close(it->second->fd);
+    m_handlers.erase(it);
+  });
+}
+
+void EpollReactor::post(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_posted.push_back(std::move(fn));
+  }
+  wakeup();
+}
+
+void EpollReactor::run_and_wait(const std::function<void()>& fn) {
+  if(is_in_reactor_thread()){
+    fn();
+    return;
+  }
+  std::promise<void> done;
+  auto future=done.get_future();
+  bool posted=false;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    // Once the loop has exited, nobody would ever run it
+    if(!m_loop_exited){
+      m_posted.emplace_back([&fn,&done](){
+        fn();
+        done.set_value();
+      });
+      posted=true;
+    }
+  }
+  if(!posted){
+    // No reactor thread anymore, nothing can run concurrently
+    fn();
+    return;
+  }
+  wakeup();
+  future.wait();
+}
+
+bool EpollReactor::is_in_reactor_thread() const {
+  return std::this_thread::get_id()==m_thread_id;
+}
+
+void EpollReactor::wakeup() {
+  const uint64_t one=1;
+  if(write(m_event_fd,&one,sizeof(one))!=sizeof(one)){
+    // counter overflow, the reactor will wake up anyways
+  }
+}
+
+void EpollReactor::loop() {
+  m_thread_id=std::this_thread::get_id();
+  std::array<epoll_event,32> events{};
+  while (!m_stop_requested){
+    const int n_events=epoll_wait(m_epoll_fd,events.data(),events.size(),-1);
+    if(n_events<0){
+      if(errno==EINTR)continue;
+      m_console->warn("epoll_wait failed {}",strerror(errno));
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    m_n_wakeups++;
+    const auto wakeup_time=std::chrono::steady_clock::now();
+    for(int i=0;i<n_events;i++){
+      if(events[i].data.u64==EVENT_FD_ID){
+        uint64_t tmp;
+        if(read(m_event_fd,&tmp,sizeof(tmp))<0){
+          // nothing to read
+        }
+        run_posted();
+        continue;
+      }
+      dispatch(events[i].data.u64,events[i].events,wakeup_time);
+    }
+  }
+  // Don't leave anyone waiting in run_and_wait() - whatever is posted from now on is run by the caller
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_loop_exited=true;
+  }
+  run_posted();
+}
+
+void EpollReactor::dispatch(Handle handle,uint32_t events,std::chrono::steady_clock::time_point wakeup) {
+  std::shared_ptr<Handler> handler;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it=m_handlers.find(handle);
+    // removed in the meantime
+    if(it==m_handlers.end())return;
+    handler=it->second;
+  }
+  if(handler->is_timer){
+    uint64_t n_expirations=0;
+    if(read(handler->fd,&n_expirations,sizeof(n_expirations))!=sizeof(n_expirations)){
+      return;
+    }
+    m_timer_lateness.record(wakeup-handler->timer_next);
+    handler->timer_next=wakeup+handler->timer_interval;
+    handler->timer_cb();
+  }else{
+    handler->fd_cb(events);
+  }
+  m_n_events++;
+  // One epoll event can be any number of messages (e.g. everything that was read from the UART)
+  m_event_callback_latency.record(std::chrono::steady_clock::now()-wakeup);
+}
+
+void EpollReactor::run_posted() {
+  std::vector<std::function<void()>> posted;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::swap(posted,m_posted);
+  }
+  for(auto& fn:posted){
+    fn();
+    m_n_events++;
+  }
+}
+
+std::string EpollReactor::get_stats_string() {
+  const auto now=std::chrono::steady_clock::now();
+  const double elapsed_s=std::chrono::duration<double>(now-m_last_stats).count();
+  const uint64_t n_wakeups=m_n_wakeups;
+  const uint64_t n_context_switches=get_process_context_switches();
+  std::stringstream ss;
+  ss<<"EpollReactor{wakeups/s:"<<static_cast<int>(static_cast<double>(n_wakeups-m_last_stats_n_wakeups)/elapsed_s)
+     // Threads that exited since the last time are no longer part of the sum
+     <<" process ctx switches/s:"<<static_cast<int>(static_cast<double>(n_context_switches-std::min(n_context_switches,m_last_stats_n_context_switches))/elapsed_s)
+     <<" events:"<<m_n_events<<" epoll event callback latency:"<<m_event_callback_latency.to_string()
+     <<" timer lateness:"<<m_timer_lateness.to_string()<<"}";
+  m_last_stats=now;
+  m_last_stats_n_wakeups=n_wakeups;
+  m_last_stats_n_context_switches=n_context_switches;
+  m_event_callback_latency.reset();
+  m_timer_lateness.reset();
+  return ss.str();
+}
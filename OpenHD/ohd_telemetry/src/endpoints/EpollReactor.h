@@ -0,0 +1,97 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_EPOLLREACTOR_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_EPOLLREACTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_latency_histogram.hpp"
+#include "openhd_spdlog.h"
+
+/**
+ * Single threaded event loop (epoll + timerfd + eventfd), such that all the telemetry endpoints (UDP, TCP, serial),
+ * the data from the WB link and the periodic generate timer of Air/GroundTelemetry can run on one thread instead
+ * of each having its own thread(s) that wake up independently.
+ * All callbacks are called on the reactor thread, one after another - a callback must not block.
+ * Optional, see DEV_TELEMETRY_EPOLL_REACTOR.
+ */
+class EpollReactor{
+ public:
+  explicit EpollReactor(const std::string& tag);
+  ~EpollReactor();
+  EpollReactor(const EpollReactor&)=delete;
+  EpollReactor(EpollReactor&&)=delete;
+  // 0 is never a valid handle
+  using Handle=uint64_t;
+  // called with the epoll events (e.g. EPOLLIN) that are ready
+  using FdCallback=std::function<void(uint32_t events)>;
+  /**
+   * Watch the given fd for the given epoll events (e.g. EPOLLIN), the fd is not owned by the reactor.
+   * @return 0 on failure
+   */
+  Handle add_fd(int fd,uint32_t events,FdCallback cb);
+  bool modify_fd(Handle handle,uint32_t events);
+  // Periodic timer, first called after one interval. Returns 0 on failure.
+  Handle add_timer(std::chrono::milliseconds interval,std::function<void()> cb);
+  /**
+   * Stop watching the fd / stop the timer. Once this returns, the callback is not called anymore
+   * (if called from another thread, this waits until the reactor is done with the current callback).
+   */
+  void remove(Handle handle);
+  // Run fn on the reactor thread (asynchronously)
+  void post(std::function<void()> fn);
+  // Run fn on the reactor thread and wait until it is done. Runs fn directly if called from the reactor thread
+  // or if the reactor thread has already exited.
+  void run_and_wait(const std::function<void()>& fn);
+  [[nodiscard]] bool is_in_reactor_thread()const;
+  /**
+   * Wakeups per second of the reactor thread, process-wide context switches per second and the latency of each
+   * epoll event (from epoll_wait returning to its callback being done) since the last call.
+   * Per epoll event, not per message - one callback might process any number of messages.
+   */
+  std::string get_stats_string();
+ private:
+  struct Handler{
+    int fd;
+    bool is_timer;
+    FdCallback fd_cb;
+    std::function<void()> timer_cb;
+    std::chrono::milliseconds timer_interval;
+    std::chrono::steady_clock::time_point timer_next;
+  };
+  void loop();
+  void dispatch(Handle handle,uint32_t events,std::chrono::steady_clock::time_point wakeup);
+  void run_posted();
+  void wakeup();
+  std::shared_ptr<spdlog::logger> m_console;
+  int m_epoll_fd=-1;
+  // to wake up the reactor thread (post / stop)
+  int m_event_fd=-1;
+  std::atomic<bool> m_stop_requested=false;
+  std::mutex m_mutex;
+  std::map<Handle,std::shared_ptr<Handler>> m_handlers;
+  Handle m_next_handle=1;
+  std::vector<std::function<void()>> m_posted;
+  // set (with m_mutex) once the loop won't run posted work anymore
+  bool m_loop_exited=false;
+  std::unique_ptr<std::thread> m_thread;
+  std::atomic<std::thread::id> m_thread_id{};
+  // Stats
+  std::atomic<uint64_t> m_n_wakeups=0;
+  std::atomic<uint64_t> m_n_events=0;
+  openhd::LatencyHistogram m_event_callback_latency;
+  // how late the timers fire
+  openhd::LatencyHistogram m_timer_lateness;
+  std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+  uint64_t m_last_stats_n_wakeups=0;
+  uint64_t m_last_stats_n_context_switches=0;
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_EPOLLREACTOR_H_
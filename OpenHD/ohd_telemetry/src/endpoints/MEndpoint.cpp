@@ -4,17 +4,55 @@
 
 #include "MEndpoint.h"
 
+#include <array>
+#include <stdexcept>
+
 // WARNING BE CAREFULL TO REMOVE ON RELEASE
 //#define OHD_TELEMETRY_TESTING_ENABLE_PACKET_LOSS
 
+static std::mutex g_channels_used_mutex;
+static std::array<bool,MAVLINK_COMM_NUM_BUFFERS> g_channels_used{};
+
+int MEndpoint::checkoutFreeChannel() {
+  std::lock_guard<std::mutex> lock(g_channels_used_mutex);
+  for(size_t i=0;i<g_channels_used.size();i++){
+    if(!g_channels_used[i]){
+      g_channels_used[i]=true;
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void MEndpoint::checkinChannel(int channel) {
+  std::lock_guard<std::mutex> lock(g_channels_used_mutex);
+  if(channel<0 || channel>=static_cast<int>(g_channels_used.size()))return;
+  g_channels_used[channel]=false;
+}
+
+uint8_t MEndpoint::checkoutFreeChannelOrThrow(const std::string& tag) {
+  // Using a channel >= MAVLINK_COMM_NUM_BUFFERS would write past the static channel status of the mavlink library
+  const int channel=checkoutFreeChannel();
+  if(channel<0){
+    openhd::log::get_default()->error("{} no free mavlink channel",tag);
+    throw std::runtime_error("No free mavlink channel");
+  }
+  return static_cast<uint8_t>(channel);
+}
+
 MEndpoint::MEndpoint(std::string tag,bool debug_mavlink_msg_packet_loss)
     : TAG(std::move(tag)),
-      m_mavlink_channel(checkoutFreeChannel()),
+      m_mavlink_channel(checkoutFreeChannelOrThrow(TAG)),
+      m_parser(m_mavlink_channel),
       m_debug_mavlink_msg_packet_loss(debug_mavlink_msg_packet_loss)
 {
   openhd::log::get_default()->debug("{} using channel:{} debug_mavlink_msg_packet_los:{}",TAG,m_mavlink_channel,m_debug_mavlink_msg_packet_loss);
 }
 
+MEndpoint::~MEndpoint() {
+  checkinChannel(m_mavlink_channel);
+}
+
 void MEndpoint::sendMessages(const std::vector<MavlinkMessage>& messages) {
   if(messages.empty())return;
   m_tx_n_bytes+= get_size(messages);
@@ -52,23 +90,24 @@ std::string MEndpoint::createInfo() const {
 void MEndpoint::parseNewData(const uint8_t* data, const int data_len) {
   //<<TAG<<" received data:"<<data_len<<" "<<MavlinkHelpers::raw_content(data,data_len)<<"\n";
   m_rx_n_bytes+=data_len;
-  std::vector<MavlinkMessage> messages;
-  mavlink_message_t msg;
-  for (int i = 0; i < data_len; i++) {
-    uint8_t res = mavlink_parse_char(m_mavlink_channel, (uint8_t)data[i], &msg, &receiveMavlinkStatus);
-    if (res) {
-      messages.push_back(MavlinkMessage{msg});
-      // From https://github.com/mavlink/c_uart_interface_example/blob/master/serial_port.cpp
-      if ( (m_last_status.packet_rx_drop_count != receiveMavlinkStatus.packet_rx_drop_count) && m_debug_mavlink_msg_packet_loss ){
-        openhd::log::get_default()->warn("DROPPED {} PACKETS",receiveMavlinkStatus.packet_rx_drop_count);
-      }
-      m_last_status = receiveMavlinkStatus;
+  const auto& messages=m_parser.parse(data,data_len);
+  if(m_debug_mavlink_msg_packet_loss && !messages.empty()){
+    // From https://github.com/mavlink/c_uart_interface_example/blob/master/serial_port.cpp
+    const auto packet_rx_drop_count=mavlink_get_channel_status(m_mavlink_channel)->packet_rx_drop_count;
+    if(m_last_packet_rx_drop_count!=packet_rx_drop_count){
+      openhd::log::get_default()->warn("DROPPED {} PACKETS",packet_rx_drop_count);
     }
+    m_last_packet_rx_drop_count=packet_rx_drop_count;
   }
   onNewMavlinkMessages(messages);
 }
 
-void MEndpoint::onNewMavlinkMessages(std::vector<MavlinkMessage> messages) {
+void MEndpoint::parseNewData(MavlinkFrameParser& parser,const uint8_t* data,const int data_len) {
+  m_rx_n_bytes+=data_len;
+  onNewMavlinkMessages(parser.parse(data,data_len));
+}
+
+void MEndpoint::onNewMavlinkMessages(const std::vector<MavlinkMessage>& messages) {
   if(messages.empty())return;
   //openhd::log::create_or_get(TAG)->debug("N messages receive:{}",messages.size());
   lastMessage = std::chrono::steady_clock::now();
@@ -14,6 +14,7 @@
 
 #include "../mav_helper.h"
 #include "../mav_include.h"
+#include "MavlinkFrameParser.h"
 // dirty, pull in header only
 #include "../../../lib/wifibroadcast/src/HelperSources/TimeHelper.hpp"
 #include "openhd_spdlog.h"
@@ -38,6 +39,8 @@ class MEndpoint {
    * @param mavlink_channel the mavlink channel to use for parsing.
    */
   explicit MEndpoint(std::string tag,bool debug_mavlink_msg_packet_loss=false);
+  // returns the mavlink channel
+  virtual ~MEndpoint();
   /**
    * send one or more messages via this endpoint.
    * If the endpoint is silently disconnected, this MUST NOT FAIL/CRASH.
@@ -67,36 +70,37 @@ class MEndpoint {
  protected:
   // parse new data as it comes in, extract mavlink messages and forward them on the registered callback (if it has been registered)
   void parseNewData(const uint8_t *data,int data_len);
+  // same as above, but with a different parser - e.g. one per connected client, such that
+  // the data from the different clients is not mixed up
+  void parseNewData(MavlinkFrameParser& parser,const uint8_t *data,int data_len);
   // this one is special, since mavsdk in this case has already done the message parsing
   void parseNewDataEmulateForMavsdk(mavlink_message_t msg){
-    onNewMavlinkMessages({MavlinkMessage{msg}});
+    const std::vector<MavlinkMessage> messages{MavlinkMessage{msg}};
+    onNewMavlinkMessages(messages);
   }
   // Must be overridden by the implementation
   // Returns true if the message(s) have been properly sent (e.g. a connection exists on connection-based endpoints)
   // false otherwise
   virtual bool sendMessagesImpl(const std::vector<MavlinkMessage>& messages) = 0;
+  // Mavlink channels are static (mavlink_get_channel_status), so each parser should use its own channel.
+  // Based on mavsdk::mavlink_channels - but there are only MAVLINK_COMM_NUM_BUFFERS of them, so they must
+  // be returned via checkinChannel() once no longer used.
+  // Returns -1 if all channels are in use.
+  static int checkoutFreeChannel();
+  static void checkinChannel(int channel);
+  // Throws if all channels are in use
+  static uint8_t checkoutFreeChannelOrThrow(const std::string& tag);
  private:
   MAV_MSG_CALLBACK m_callback = nullptr;
   // increases message count and forwards the messages via the callback if registered.
-  void onNewMavlinkMessages(std::vector<MavlinkMessage> messages);
-  mavlink_status_t receiveMavlinkStatus{};
+  void onNewMavlinkMessages(const std::vector<MavlinkMessage>& messages);
   const uint8_t m_mavlink_channel;
+  MavlinkFrameParser m_parser;
   std::chrono::steady_clock::time_point lastMessage{};
   int m_n_messages_received=0;
   // sendMessage() might be called by different threads.
   std::atomic<int> m_n_messages_sent=0;
   std::atomic<int> m_n_messages_send_failed=0;
-  // I think mavlink channels are static, so each endpoint should use his own channel.
-  // Based on mavsdk::mavlink_channels
-  // It is not clear what the limit of the number of channels is, except UINT8_MAX.
-  static int checkoutFreeChannel(){
-    static std::mutex _channels_used_mutex;
-    static int channel_idx=0;
-    std::lock_guard<std::mutex> lock(_channels_used_mutex);
-    int ret=channel_idx;
-    channel_idx++;
-    return ret;
-  }
  private:
   // Used to measure incoming / outgoing bits per second
   int m_tx_n_bytes=0;
@@ -105,7 +109,7 @@ class MEndpoint {
   BitrateCalculator m_rx_calc{};
  private:
   const bool m_debug_mavlink_msg_packet_loss;
-  mavlink_status_t m_last_status;
+  uint32_t m_last_packet_rx_drop_count=0;
 };
 
 #endif //XMAVLINKSERVICE_MENDPOINT_H
@@ -0,0 +1,173 @@
+#include "MavlinkFrameParser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+// v2: STX + 9 bytes header, v1: STX + 5 bytes header
+static constexpr int V2_HEADER_LEN=MAVLINK_CORE_HEADER_LEN+1;
+static constexpr int V1_HEADER_LEN=MAVLINK_CORE_HEADER_MAVLINK1_LEN+1;
+
+std::string MavlinkFrameParser::Stats::to_string() const {
+  std::stringstream ss;
+  ss<<"MavlinkFrameParser{ok:"<<n_frames_ok<<" bad_crc:"<<n_frames_bad_crc<<" bad_header:"<<n_frames_bad_header
+     <<" skipped_bytes:"<<n_bytes_skipped<<"}";
+  return ss.str();
+}
+
+MavlinkFrameParser::MavlinkFrameParser(uint8_t mavlink_channel): m_mavlink_channel(mavlink_channel) {
+  m_messages.reserve(64);
+  m_partial.reserve(MAVLINK_MAX_PACKET_LEN*2);
+}
+
+const std::vector<MavlinkMessage>& MavlinkFrameParser::parse(const uint8_t *data, int data_len) {
+  m_messages.resize(0);
+  if(data_len<=0)return m_messages;
+  if(mavlink_get_channel_status(m_mavlink_channel)->signing!=nullptr){
+    parse_bytewise(data,data_len);
+    return m_messages;
+  }
+  if(m_partial.empty()){
+    // Common case - parse directly from the given buffer, only copy what's left of a split frame
+    const int consumed=parse_frames(data,data_len);
+    if(consumed<data_len){
+      m_partial.insert(m_partial.end(),data+consumed,data+data_len);
+    }
+  }else{
+    m_partial.insert(m_partial.end(),data,data+data_len);
+    const int consumed=parse_frames(m_partial.data(),static_cast<int>(m_partial.size()));
+    m_partial.erase(m_partial.begin(),m_partial.begin()+consumed);
+  }
+  return m_messages;
+}
+
+int MavlinkFrameParser::parse_frames(const uint8_t *data, int data_len) {
+  const uint8_t* end=data+data_len;
+  // Position of the next v2 / v1 STX, cached such that we don't re-scan for the (rare) v1 STX on each frame
+  const uint8_t* next_stx_v2=nullptr;
+  const uint8_t* next_stx_v1=nullptr;
+  const auto find_next=[end](const uint8_t* pos,uint8_t stx,const uint8_t*& cache){
+    if(cache==nullptr || (cache<pos && cache!=end)){
+      const void* found=memchr(pos,stx,end-pos);
+      cache=found ? static_cast<const uint8_t*>(found) : end;
+    }
+    return cache;
+  };
+  mavlink_status_t* status=mavlink_get_channel_status(m_mavlink_channel);
+  const uint8_t* pos=data;
+  while(pos<end){
+    const uint8_t* stx=std::min(find_next(pos,MAVLINK_STX,next_stx_v2),find_next(pos,MAVLINK_STX_MAVLINK1,next_stx_v1));
+    m_stats.n_bytes_skipped+=stx-pos;
+    pos=stx;
+    if(pos==end)break;
+    int frame_len=0;
+    mavlink_message_t msg;
+    const auto res=decode_frame(pos,static_cast<int>(end-pos),msg,frame_len);
+    if(res==FrameResult::INCOMPLETE){
+      return static_cast<int>(pos-data);
+    }
+    if(res==FrameResult::INVALID){
+      // Not a frame / corrupted frame, resync at the next STX. Counted like mavlink_parse_char does - but mavlink_parse_char
+      // would skip the whole bogus frame (and with it, a valid frame that starts within it)
+      status->parse_error++;
+      status->packet_rx_drop_count++;
+      m_stats.n_bytes_skipped++;
+      pos++;
+      continue;
+    }
+    // Same as mavlink_parse_char on a successfully parsed message
+    if(msg.magic==MAVLINK_STX_MAVLINK1){
+      status->flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    }else{
+      status->flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    }
+    status->current_rx_seq=msg.seq;
+    if(status->packet_rx_success_count==0)status->packet_rx_drop_count=0;
+    status->packet_rx_success_count++;
+    m_stats.n_frames_ok++;
+    m_messages.push_back(MavlinkMessage{msg});
+    pos+=frame_len;
+  }
+  return data_len;
+}
+
+MavlinkFrameParser::FrameResult MavlinkFrameParser::decode_frame(const uint8_t *data, int data_len,mavlink_message_t& out, int &frame_len) {
+  const bool is_v2=data[0]==MAVLINK_STX;
+  const int header_len=is_v2 ? V2_HEADER_LEN : V1_HEADER_LEN;
+  if(data_len<3){
+    return FrameResult::INCOMPLETE;
+  }
+  const uint8_t payload_len=data[1];
+  uint8_t incompat_flags=0;
+  if(is_v2){
+    incompat_flags=data[2];
+    if((incompat_flags & ~MAVLINK_IFLAG_SIGNED)!=0){
+      // we don't know how to handle this frame
+      m_stats.n_frames_bad_header++;
+      return FrameResult::INVALID;
+    }
+  }
+  const bool is_signed=(incompat_flags & MAVLINK_IFLAG_SIGNED)!=0;
+  frame_len=header_len+payload_len+MAVLINK_NUM_CHECKSUM_BYTES+(is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+  if(data_len<frame_len){
+    return FrameResult::INCOMPLETE;
+  }
+  uint32_t msgid;
+  if(is_v2){
+    msgid=data[7] | (data[8]<<8) | (static_cast<uint32_t>(data[9])<<16);
+  }else{
+    msgid=data[5];
+  }
+  const mavlink_msg_entry_t* entry=mavlink_get_msg_entry(msgid);
+  const uint8_t crc_extra=entry ? entry->crc_extra : 0;
+  uint16_t crc;
+  crc_init(&crc);
+  crc_accumulate_buffer(&crc,reinterpret_cast<const char*>(data+1),header_len-1+payload_len);
+  crc_accumulate(crc_extra,&crc);
+  const uint8_t* ck=data+header_len+payload_len;
+  if(ck[0]!=(crc & 0xFF) || ck[1]!=(crc >> 8)){
+    m_stats.n_frames_bad_crc++;
+    return FrameResult::INVALID;
+  }
+  out.magic=data[0];
+  out.len=payload_len;
+  if(is_v2){
+    out.incompat_flags=incompat_flags;
+    out.compat_flags=data[3];
+    out.seq=data[4];
+    out.sysid=data[5];
+    out.compid=data[6];
+  }else{
+    out.incompat_flags=0;
+    out.compat_flags=0;
+    out.seq=data[2];
+    out.sysid=data[3];
+    out.compid=data[4];
+  }
+  out.msgid=msgid;
+  auto* payload=reinterpret_cast<uint8_t*>(out.payload64);
+  std::memcpy(payload,data+header_len,payload_len);
+  // zero-fill the payload to cope with (v2 trimmed) short packets, same as mavlink_parse_char
+  if(entry && payload_len<entry->max_msg_len){
+    std::memset(payload+payload_len,0,entry->max_msg_len-payload_len);
+  }
+  out.checksum=crc;
+  out.ck[0]=ck[0];
+  out.ck[1]=ck[1];
+  if(is_signed){
+    std::memcpy(out.signature,ck+MAVLINK_NUM_CHECKSUM_BYTES,MAVLINK_SIGNATURE_BLOCK_LEN);
+  }
+  return FrameResult::OK;
+}
+
+void MavlinkFrameParser::parse_bytewise(const uint8_t *data, int data_len) {
+  mavlink_message_t msg;
+  mavlink_status_t status;
+  for (int i = 0; i < data_len; i++) {
+    const uint8_t res = mavlink_parse_char(m_mavlink_channel, data[i], &msg, &status);
+    if (res) {
+      m_stats.n_frames_ok++;
+      m_messages.push_back(MavlinkMessage{msg});
+    }
+  }
+}
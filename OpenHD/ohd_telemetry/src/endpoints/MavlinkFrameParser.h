@@ -0,0 +1,68 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_MAVLINKFRAMEPARSER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_MAVLINKFRAMEPARSER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../mav_include.h"
+
+/**
+ * Frame oriented alternative to feeding each byte through mavlink_parse_char.
+ * Searches the next STX (v1 or v2) via memchr, then validates the header / length / CRC of the whole frame
+ * over the contiguous buffer and decodes it in one go.
+ * A frame that is split across 2 calls to parse() (e.g. serial) is kept until the next call.
+ * The mavlink channel status (mavlink_get_channel_status) is updated like mavlink_parse_char does
+ * (rx seq, success / drop count, parse errors, in mavlink1 flag), such that each endpoint still has its own channel
+ * (see MEndpoint::checkoutFreeChannel, the channel is not owned by the parser).
+ * NOTE: Signed frames are only checked if signing is configured on the channel - in this case (never the case for openhd)
+ * we fall back to mavlink_parse_char.
+ * Not thread safe, each endpoint has its own instance.
+ */
+class MavlinkFrameParser{
+ public:
+  explicit MavlinkFrameParser(uint8_t mavlink_channel);
+  /**
+   * Parse new data, returns all the messages that could be parsed (in order).
+   * The returned vector is re-used, it is only valid until the next call to parse().
+   */
+  const std::vector<MavlinkMessage>& parse(const uint8_t* data,int data_len);
+  [[nodiscard]] uint8_t get_mavlink_channel()const{
+    return m_mavlink_channel;
+  }
+  // Discard any incomplete frame, e.g. when the parser is re-used for a new connection
+  void reset(){
+    m_partial.resize(0);
+  }
+  struct Stats{
+    uint64_t n_frames_ok=0;
+    uint64_t n_frames_bad_crc=0;
+    uint64_t n_frames_bad_header=0;
+    // bytes that were not part of any valid frame (garbage / non-mavlink data between frames)
+    uint64_t n_bytes_skipped=0;
+    [[nodiscard]] std::string to_string()const;
+  };
+  [[nodiscard]] const Stats& get_stats()const{
+    return m_stats;
+  }
+ private:
+  // Parse as many frames as possible, returns the n of bytes consumed
+  int parse_frames(const uint8_t* data,int data_len);
+  enum class FrameResult{
+    OK,
+    // need more data to decide
+    INCOMPLETE,
+    // not a valid frame, resync at the next STX
+    INVALID
+  };
+  // Validate and decode the frame starting at data[0] (STX), writes the frame length on OK
+  FrameResult decode_frame(const uint8_t* data,int data_len,mavlink_message_t& out,int& frame_len);
+  void parse_bytewise(const uint8_t* data,int data_len);
+  const uint8_t m_mavlink_channel;
+  std::vector<MavlinkMessage> m_messages;
+  // Start of a frame we didn't get completely yet
+  std::vector<uint8_t> m_partial;
+  Stats m_stats{};
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_MAVLINKFRAMEPARSER_H_
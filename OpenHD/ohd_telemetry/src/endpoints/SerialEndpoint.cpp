@@ -6,6 +6,7 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
@@ -47,12 +48,14 @@ static bool is_serial_fd_still_connected(const int fd){
   return true;
 }
 
-SerialEndpoint::SerialEndpoint(std::string TAG1,SerialEndpoint::HWOptions options1):
-                                                                                       MEndpoint(std::move(TAG1)), m_options(std::move(options1)){
+SerialEndpoint::SerialEndpoint(std::string TAG1,SerialEndpoint::HWOptions options1,std::shared_ptr<EpollReactor> opt_reactor):
+                                                                                       MEndpoint(std::move(TAG1)), m_options(std::move(options1)),
+      m_opt_reactor(std::move(opt_reactor)){
   m_console = openhd::log::create_or_get(TAG);
   assert(m_console);
   //m_limited_rate_logger=std::make_unique<openhd::log::LimitedRateLogger>(m_console,std::chrono::milliseconds(1000));
   m_console->info("created with {}", m_options.to_string());
+  m_writer=std::make_unique<SerialWriter>(TAG,m_options.baud_rate);
   start();
 }
 
@@ -61,48 +64,11 @@ SerialEndpoint::~SerialEndpoint() {
 }
 
 bool SerialEndpoint::sendMessagesImpl(const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers= pack_messages(messages);
-  bool success= true;
-  for(const auto& message_buffer:message_buffers){
-    if(!write_data_serial(message_buffer)){
-      success= false;
-    }
-  }
-  return success;
+  return m_writer->enqueue(messages);
 }
 
-bool SerialEndpoint::write_data_serial(const std::vector<uint8_t> &data){
-  //m_console->debug("Write data serial:{} bytes",data.size());
-  if(m_fd ==-1){
-    // cannot send data at the time, UART not setup / doesn't exist. Limit message to once per second
-    const auto elapsed=std::chrono::steady_clock::now()-m_last_log_cannot_send_no_fd;
-    if(elapsed>std::chrono::seconds(1)){
-      m_console->warn("Cannot send data, no fd");
-      m_last_log_cannot_send_no_fd=std::chrono::steady_clock::now();
-    }
-    return false;
-  }
-  const auto before=std::chrono::steady_clock::now();
-  // If we have a fd, but the write fails, most likely the UART disconnected
-  // but the linux driver hasn't noticed it yet.
-  const auto send_len = static_cast<int>(write(m_fd,data.data(), data.size()));
-  const auto send_delta=std::chrono::steady_clock::now()-before;
-  if(send_delta>std::chrono::milliseconds(100)){
-    const auto send_delta_ms=static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(send_delta).count())/1000.0f;
-    m_console->warn("UART sending data took {}ms",send_delta_ms);
-  }
-  //m_console->debug("Written {} bytes",send_len);
-  //m_console->debug("{}",MEndpoint::get_tx_rx_stats());
-  if (send_len != data.size()) {
-    m_n_failed_writes++;
-    const auto elapsed_since_last_log=std::chrono::steady_clock::now()-m_last_log_serial_write_failed;
-    if(elapsed_since_last_log>MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES){
-      m_console->warn("wrote {} instead of {} bytes,n failed:{}",send_len,data.size(),m_n_failed_writes);
-      m_last_log_serial_write_failed=std::chrono::steady_clock::now();
-    }
-    return false;
-  }
-  return true;
+std::string SerialEndpoint::get_writer_stats_string() {
+  return m_writer->get_stats_string();
 }
 
 int SerialEndpoint::define_from_baudrate(int baudrate) {
@@ -229,8 +195,10 @@ void SerialEndpoint::connect_and_read_loop() {
       continue;
     }
     m_console->debug("Successfully created UART fd for: {}",m_options.to_string());
+    m_writer->set_fd(m_fd);
     receive_data_until_error();
     // cleanup and start over again
+    m_writer->set_fd(-1);
     close(m_fd);
     m_fd =-1;
   }
@@ -293,6 +261,18 @@ void SerialEndpoint::receive_data_until_error() {
 void SerialEndpoint::start() {
   std::lock_guard<std::mutex> lock(m_connect_receive_thread_mutex);
   m_console->debug("start()-begin");
+  if(m_opt_reactor){
+    m_opt_reactor->run_and_wait([this](){
+      if(m_reactor_timer_handle!=0)return;
+      reactor_check_connection();
+      // Same as the thread - check / try to (re-)connect every second
+      m_reactor_timer_handle=m_opt_reactor->add_timer(std::chrono::seconds(1),[this](){
+        reactor_check_connection();
+      });
+    });
+    m_console->debug("start()-end (reactor)");
+    return;
+  }
   if(m_connect_receive_thread != nullptr){
     m_console->debug("Already started");
     return;
@@ -305,6 +285,15 @@ void SerialEndpoint::start() {
 void SerialEndpoint::stop() {
   std::lock_guard<std::mutex> lock(m_connect_receive_thread_mutex);
   m_console->debug("stop()-begin");
+  if(m_opt_reactor){
+    m_opt_reactor->run_and_wait([this](){
+      m_opt_reactor->remove(m_reactor_timer_handle);
+      m_reactor_timer_handle=0;
+      reactor_disconnect();
+    });
+    m_console->debug("stop()-end (reactor)");
+    return;
+  }
   _stop_requested=true;
   if (m_connect_receive_thread && m_connect_receive_thread->joinable()) {
     m_connect_receive_thread->join();
@@ -313,6 +302,77 @@ void SerialEndpoint::stop() {
   m_console->debug("stop()-end");
 }
 
+void SerialEndpoint::reactor_check_connection() {
+  if(m_fd!=-1){
+    if(!is_serial_fd_still_connected(m_fd)){
+      m_console->debug("Serial not connected anymore");
+      reactor_disconnect();
+      return;
+    }
+    if(!m_reactor_got_data){
+      // Same as a poll timeout in receive_data_until_error
+      m_n_failed_reads++;
+      const auto elapsed_since_last_log=std::chrono::steady_clock::now()-m_last_log_serial_read_failed;
+      if(elapsed_since_last_log>=MIN_DELAY_BETWEEN_SERIAL_READ_FAILED_LOG_MESSAGES && m_options.enable_reading){
+        m_last_log_serial_read_failed=std::chrono::steady_clock::now();
+        m_console->warn("{} failed polls(reads)",m_n_failed_reads);
+      }
+    }
+    m_reactor_got_data=false;
+    return;
+  }
+  if(!OHDFilesystemUtil::exists(m_options.linux_filename)){
+    m_console->warn("UART file does not exist");
+    return;
+  }
+  const int fd=setup_port(m_options,m_console);
+  if(fd==-1){
+    m_console->warn("Cannot create uart fd "+ m_options.to_string());
+    return;
+  }
+  // The reactor must never block on a read
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  m_n_failed_reads=0;
+  m_reactor_got_data=false;
+  m_reactor_fd_handle=m_opt_reactor->add_fd(fd,EPOLLIN,[this](uint32_t events){
+    reactor_on_readable(events);
+  });
+  m_fd=fd;
+  m_writer->set_fd(m_fd);
+  m_console->debug("Successfully created UART fd for: {} (reactor)",m_options.to_string());
+}
+
+void SerialEndpoint::reactor_on_readable(uint32_t events) {
+  uint8_t buffer[2048];
+  while (m_fd!=-1){
+    const int recv_len = static_cast<int>(read(m_fd, buffer, sizeof(buffer)));
+    if(recv_len>0){
+      m_reactor_got_data=true;
+      MEndpoint::parseNewData(buffer,recv_len);
+      continue;
+    }
+    if(recv_len<0 && errno!=EAGAIN && errno!=EWOULDBLOCK){
+      m_console->warn("read failure: {} {}",recv_len,GET_ERROR());
+    }
+    break;
+  }
+  if(events & (EPOLLERR | EPOLLHUP)){
+    // The UART most likely disconnected.
+    m_console->warn("Serial error / hangup");
+    reactor_disconnect();
+  }
+}
+
+void SerialEndpoint::reactor_disconnect() {
+  m_opt_reactor->remove(m_reactor_fd_handle);
+  m_reactor_fd_handle=0;
+  if(m_fd!=-1){
+    m_writer->set_fd(-1);
+    close(m_fd);
+    m_fd=-1;
+  }
+}
+
 // based on mavsdk and what linux allows setting
 // if a value is in the map, we allow the user to set it
 static std::map<int,void*> valid_uart_baudrates(){
@@ -348,25 +408,40 @@ void SerialEndpointManager::send_messages_if_enabled(
   }
 }
 
-void SerialEndpointManager::disable() {
+std::string SerialEndpointManager::get_stats_string() {
   std::lock_guard<std::mutex> guard(m_serial_endpoint_mutex);
-  if(m_serial_endpoint !=nullptr) {
-    m_console->info("Stopping already existing FC UART");
-    m_serial_endpoint->stop();
-    m_serial_endpoint.reset();
-    m_serial_endpoint =nullptr;
+  if(m_serial_endpoint){
+    return m_serial_endpoint->get_writer_stats_string();
   }
+  return "";
 }
 
-void SerialEndpointManager::configure(const SerialEndpoint::HWOptions& options,const std::string& tag,MAV_MSG_CALLBACK cb) {
-  std::lock_guard<std::mutex> guard(m_serial_endpoint_mutex);
-  if(m_serial_endpoint !=nullptr) {
-    // Disable the currently running uart configuration, if there is any
+void SerialEndpointManager::disable() {
+  // Stopped and destroyed without holding the lock - stopping waits for the receive thread / reactor, which might
+  // be inside a callback that sends messages via send_messages_if_enabled()
+  std::unique_ptr<SerialEndpoint> to_stop;
+  {
+    std::lock_guard<std::mutex> guard(m_serial_endpoint_mutex);
+    to_stop=std::move(m_serial_endpoint);
+  }
+  if(to_stop !=nullptr) {
     m_console->info("Stopping already existing FC UART");
-    m_serial_endpoint->stop();
-    m_serial_endpoint.reset();
-    m_serial_endpoint =nullptr;
+    to_stop.reset();
+  }
+}
+
+void SerialEndpointManager::configure(const SerialEndpoint::HWOptions& options,const std::string& tag,MAV_MSG_CALLBACK cb,
+                                      std::shared_ptr<EpollReactor> opt_reactor) {
+  // Disable the currently running uart configuration, if there is any
+  disable();
+  auto serial_endpoint=std::make_unique<SerialEndpoint>(tag,options,std::move(opt_reactor));
+  serial_endpoint->registerCallback(std::move(cb));
+  std::unique_ptr<SerialEndpoint> to_stop;
+  {
+    std::lock_guard<std::mutex> guard(m_serial_endpoint_mutex);
+    to_stop=std::move(m_serial_endpoint);
+    m_serial_endpoint=std::move(serial_endpoint);
   }
-  m_serial_endpoint =std::make_unique<SerialEndpoint>(tag,options);
-  m_serial_endpoint->registerCallback(std::move(cb));
+  // Only if configure() was called concurrently
+  to_stop.reset();
 }
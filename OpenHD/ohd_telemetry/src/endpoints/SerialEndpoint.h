@@ -13,7 +13,9 @@
 #include <thread>
 #include <utility>
 
+#include "EpollReactor.h"
 #include "MEndpoint.h"
+#include "SerialWriter.h"
 #include "openhd_spdlog.h"
 
 /**
@@ -42,8 +44,9 @@ class SerialEndpoint : public MEndpoint{
  public:
   /**
    * See @param options1 HWOptions for configurable serial params
+   * @param opt_reactor if set, (re-)connecting and reading is done by the reactor instead of our own thread
    */
-  explicit SerialEndpoint(std::string TAG1, HWOptions options1);
+  explicit SerialEndpoint(std::string TAG1, HWOptions options1,std::shared_ptr<EpollReactor> opt_reactor=nullptr);
   // No copy and move
   SerialEndpoint(const SerialEndpoint&)=delete;
   SerialEndpoint(const SerialEndpoint&&)=delete;
@@ -54,6 +57,8 @@ class SerialEndpoint : public MEndpoint{
   // Stop any UART communication (read and write). Might block for up to 1 second.
   // Does nothing if already stopped.
   void stop();
+  // queue delay / drop stats of the writer
+  std::string get_writer_stats_string();
   // Linux defines what baud rates are available - this does not check if the given baud rate is actually supported by the HW,
   // but checks if it is at least a somewhat sane value
   static bool is_valid_linux_baudrate(int baudrate);
@@ -65,8 +70,10 @@ class SerialEndpoint : public MEndpoint{
   // Receive data until either an error occurs (in this case, the UART most likely disconnected)
   // Or a stop was requested.
   void receive_data_until_error();
-  // Write serial data, returns true on success, false otherwise.
-  [[nodiscard]] bool write_data_serial(const std::vector<uint8_t>& data);
+  // reactor mode, same as connect_and_read_loop / receive_data_until_error
+  void reactor_check_connection();
+  void reactor_on_readable(uint32_t events);
+  void reactor_disconnect();
  private:
   const HWOptions m_options;
   int m_fd =-1;
@@ -74,15 +81,16 @@ class SerialEndpoint : public MEndpoint{
   std::unique_ptr<std::thread> m_connect_receive_thread = nullptr;
   bool _stop_requested=false;
   std::shared_ptr<spdlog::logger> m_console;
-  // Limit warning console logs to not spam the console
-  static constexpr auto MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES=std::chrono::seconds(3);
-  std::chrono::steady_clock::time_point m_last_log_serial_write_failed=std::chrono::steady_clock::now();
-  int m_n_failed_writes =0;
+  // Writing never blocks the caller, the writer has its own thread
+  std::unique_ptr<SerialWriter> m_writer;
   // Limit warning console logs to not spam the console
   static constexpr auto MIN_DELAY_BETWEEN_SERIAL_READ_FAILED_LOG_MESSAGES=std::chrono::seconds(3);
   std::chrono::steady_clock::time_point m_last_log_serial_read_failed=std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point m_last_log_cannot_send_no_fd=std::chrono::steady_clock::now();
   int m_n_failed_reads=0;
+  std::shared_ptr<EpollReactor> m_opt_reactor;
+  EpollReactor::Handle m_reactor_timer_handle=0;
+  EpollReactor::Handle m_reactor_fd_handle=0;
+  bool m_reactor_got_data=false;
   //std::unique_ptr<openhd::log::LimitedRateLogger> m_limited_rate_logger;
 };
 
@@ -97,12 +105,16 @@ class SerialEndpointManager{
   /**
    * (Re-)configure the wrapped serial endpoint. Stops then restarts if serial already exists
    * @param cb the cb that is called regularly with new messages if enabled
+   * @param opt_reactor see SerialEndpoint
    */
-  void configure(const SerialEndpoint::HWOptions& options,const std::string& tag,MAV_MSG_CALLBACK cb);
+  void configure(const SerialEndpoint::HWOptions& options,const std::string& tag,MAV_MSG_CALLBACK cb,
+                 std::shared_ptr<EpollReactor> opt_reactor=nullptr);
   /**
    * Disable (delete) serial, if already existing
    */
   void disable();
+  // stats of the serial writer, empty if disabled
+  std::string get_stats_string();
  private:
   std::unique_ptr<SerialEndpoint> m_serial_endpoint;
   std::mutex m_serial_endpoint_mutex;
@@ -0,0 +1,226 @@
+#include "SerialWriter.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+SerialWriter::SerialWriter(const std::string& tag,int baud_rate)
+    : m_bytes_per_second(bytes_per_second(baud_rate)),
+      m_max_queued_bytes(std::max<size_t>(m_bytes_per_second*MAX_QUEUE_DELAY.count()/1000,MAVLINK_MAX_PACKET_LEN)),
+      // Coalesce up to half of the write ahead - such that we can already queue the next chunk
+      // while the previous one is still on the wire. At low baud rates, that is just one message per write.
+      m_max_chunk_size(m_bytes_per_second*MAX_WRITE_AHEAD.count()/1000/2){
+  m_console=openhd::log::create_or_get(tag+"_writer");
+  assert(m_console);
+  m_console->debug("bytes/s:{} max queued bytes:{} max chunk size:{}",m_bytes_per_second,m_max_queued_bytes,m_max_chunk_size);
+  m_thread=std::make_unique<std::thread>(&SerialWriter::loop,this);
+}
+
+SerialWriter::~SerialWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    m_stop_requested=true;
+  }
+  m_queue_cv.notify_all();
+  m_thread->join();
+}
+
+int SerialWriter::bytes_per_second(int baud_rate) {
+  // 8N1 - start bit, 8 data bits, stop bit
+  return baud_rate/10;
+}
+
+bool SerialWriter::is_priority_message(const MavlinkMessage& msg) {
+  switch (msg.m.msgid) {
+    case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:
+    case MAVLINK_MSG_ID_MANUAL_CONTROL:
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+    case MAVLINK_MSG_ID_COMMAND_INT:
+    case MAVLINK_MSG_ID_COMMAND_ACK:
+    case MAVLINK_MSG_ID_COMMAND_CANCEL:
+    // The FC uses the GCS heartbeat for its failsafe
+    case MAVLINK_MSG_ID_HEARTBEAT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void SerialWriter::set_fd(int fd) {
+  std::lock_guard<std::mutex> lock(m_fd_mutex);
+  m_fd=fd;
+  m_has_fd=fd!=-1;
+}
+
+bool SerialWriter::enqueue(const std::vector<MavlinkMessage>& messages) {
+  if(!m_has_fd){
+    m_n_dropped_no_fd+=messages.size();
+    // cannot send data at the time, UART not setup / doesn't exist. Limit message to once per second
+    const auto elapsed=std::chrono::steady_clock::now()-m_last_log_cannot_send_no_fd;
+    if(elapsed>std::chrono::seconds(1)){
+      m_console->warn("Cannot send data, no fd");
+      m_last_log_cannot_send_no_fd=std::chrono::steady_clock::now();
+    }
+    return false;
+  }
+  const auto now=std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    for(const auto& msg:messages){
+      QueuedMessage queued{msg,msg.get_packed_size(),now};
+      if(!is_priority_message(msg)){
+        m_bulk_queue.push_back(queued);
+        m_queued_bytes+=queued.packed_size;
+        continue;
+      }
+      if(msg.m.msgid==MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE){
+        // Only the latest RC values matter
+        auto it=std::find_if(m_priority_queue.begin(),m_priority_queue.end(),[&msg](const QueuedMessage& other){
+          return other.msg.m.msgid==MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE && other.msg.m.sysid==msg.m.sysid &&
+                 other.msg.m.compid==msg.m.compid;
+        });
+        if(it!=m_priority_queue.end()){
+          // keep the position (and enqueue time) in the queue, just update the values
+          m_queued_bytes+=queued.packed_size-it->packed_size;
+          it->msg=msg;
+          it->packed_size=queued.packed_size;
+          m_n_superseded_rc++;
+          continue;
+        }
+      }
+      m_priority_queue.push_back(queued);
+      m_queued_bytes+=queued.packed_size;
+    }
+    while (m_queued_bytes>m_max_queued_bytes){
+      if(!m_bulk_queue.empty()){
+        drop_oldest(m_bulk_queue,m_n_dropped_bulk);
+      }else{
+        drop_oldest(m_priority_queue,m_n_dropped_priority);
+      }
+    }
+  }
+  m_queue_cv.notify_one();
+  return true;
+}
+
+void SerialWriter::drop_oldest(std::deque<QueuedMessage>& queue,std::atomic<uint64_t>& drop_counter) {
+  assert(!queue.empty());
+  m_queued_bytes-=queue.front().packed_size;
+  queue.pop_front();
+  drop_counter++;
+}
+
+void SerialWriter::fill_chunk(std::vector<uint8_t>& chunk) {
+  const auto now=std::chrono::steady_clock::now();
+  while (!m_priority_queue.empty() || !m_bulk_queue.empty()){
+    const bool priority=!m_priority_queue.empty();
+    auto& queue=priority ? m_priority_queue : m_bulk_queue;
+    const auto& next=queue.front();
+    // A single message is always written, even if it doesn't fit
+    if(!chunk.empty() && chunk.size()+next.packed_size>m_max_chunk_size)return;
+    const auto offset=chunk.size();
+    chunk.resize(offset+next.packed_size);
+    next.msg.pack_into(chunk.data()+offset);
+    (priority ? m_queue_delay_priority : m_queue_delay_bulk).record(now-next.enqueue_time);
+    m_queued_bytes-=next.packed_size;
+    queue.pop_front();
+  }
+}
+
+void SerialWriter::loop() {
+  std::vector<uint8_t> chunk;
+  chunk.reserve(m_max_chunk_size+MAVLINK_MAX_PACKET_LEN);
+  while (true){
+    {
+      std::unique_lock<std::mutex> lock(m_queue_mutex);
+      m_queue_cv.wait(lock,[this](){
+        return m_stop_requested || !m_priority_queue.empty() || !m_bulk_queue.empty();
+      });
+      if(m_stop_requested)return;
+      // Don't write further ahead than MAX_WRITE_AHEAD - the longer we wait, the more recent the data we pick
+      const auto write_ahead=m_wire_free_at-std::chrono::steady_clock::now();
+      if(write_ahead>MAX_WRITE_AHEAD){
+        m_queue_cv.wait_for(lock,write_ahead-MAX_WRITE_AHEAD,[this](){
+          return m_stop_requested;
+        });
+        continue;
+      }
+      chunk.resize(0);
+      fill_chunk(chunk);
+    }
+    write_chunk(chunk);
+  }
+}
+
+void SerialWriter::write_chunk(const std::vector<uint8_t>& chunk) {
+  std::lock_guard<std::mutex> lock(m_fd_mutex);
+  if(m_fd==-1){
+    // The fd was removed after the chunk was taken out of the queue
+    m_n_dropped_chunks_no_fd++;
+    const auto now=std::chrono::steady_clock::now();
+    if(now-m_last_log_dropped_chunk_no_fd>MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES){
+      m_console->warn("Dropped {} bytes, no fd, n dropped chunks:{}",chunk.size(),m_n_dropped_chunks_no_fd);
+      m_last_log_dropped_chunk_no_fd=now;
+    }
+    return;
+  }
+  const auto before=std::chrono::steady_clock::now();
+  size_t offset=0;
+  while (offset<chunk.size()){
+    // If we have a fd, but the write fails, most likely the UART disconnected
+    // but the linux driver hasn't noticed it yet.
+    const auto ret=write(m_fd,chunk.data()+offset,chunk.size()-offset);
+    if(ret<0 && (errno==EAGAIN || errno==EWOULDBLOCK)){
+      // non-blocking fd (reactor) and the tty buffer is full - should not happen with the pacing
+      struct pollfd fds[1];
+      fds[0].fd = m_fd;
+      fds[0].events = POLLOUT;
+      if(poll(fds,1,100)>0)continue;
+    }
+    if(ret<=0){
+      m_n_failed_writes++;
+      const auto elapsed_since_last_log=std::chrono::steady_clock::now()-m_last_log_serial_write_failed;
+      if(elapsed_since_last_log>MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES){
+        m_console->warn("wrote {} instead of {} bytes,n failed:{}",offset,chunk.size(),m_n_failed_writes);
+        m_last_log_serial_write_failed=std::chrono::steady_clock::now();
+      }
+      break;
+    }
+    offset+=ret;
+  }
+  const auto now=std::chrono::steady_clock::now();
+  const auto send_delta=now-before;
+  if(send_delta>std::chrono::milliseconds(100)){
+    const auto send_delta_ms=static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(send_delta).count())/1000.0f;
+    m_console->warn("UART sending data took {}ms",send_delta_ms);
+  }
+  m_n_writes++;
+  m_n_bytes_written+=offset;
+  m_wire_free_at=std::max(m_wire_free_at,now)+std::chrono::microseconds(offset*1000*1000/m_bytes_per_second);
+}
+
+std::string SerialWriter::get_stats_string() {
+  const auto now=std::chrono::steady_clock::now();
+  const double elapsed_s=std::chrono::duration<double>(now-m_last_stats).count();
+  const uint64_t n_bytes_written=m_n_bytes_written;
+  size_t queued_bytes;
+  {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    queued_bytes=m_queued_bytes;
+  }
+  std::stringstream ss;
+  ss<<"SerialWriter{B/s:"<<static_cast<int>(static_cast<double>(n_bytes_written-m_last_stats_n_bytes_written)/elapsed_s)
+     <<" of "<<m_bytes_per_second<<" queued:"<<queued_bytes<<"B writes:"<<m_n_writes
+     <<" dropped bulk:"<<m_n_dropped_bulk<<" priority:"<<m_n_dropped_priority<<" no fd:"<<m_n_dropped_no_fd<<" chunks no fd:"<<m_n_dropped_chunks_no_fd
+     <<" superseded rc:"<<m_n_superseded_rc<<" failed writes:"<<m_n_failed_writes
+     <<" queue delay priority:"<<m_queue_delay_priority.to_string()<<" bulk:"<<m_queue_delay_bulk.to_string()<<"}";
+  m_last_stats=now;
+  m_last_stats_n_bytes_written=n_bytes_written;
+  m_queue_delay_priority.reset();
+  m_queue_delay_bulk.reset();
+  return ss.str();
+}
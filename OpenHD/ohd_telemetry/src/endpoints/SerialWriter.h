@@ -0,0 +1,108 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_SERIALWRITER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_SERIALWRITER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mav_include.h"
+#include "openhd_latency_histogram.hpp"
+#include "openhd_spdlog.h"
+
+/**
+ * Writes mavlink messages to a UART on its own thread, such that the thread(s) routing telemetry never block
+ * on a slow UART (e.g. 57600 baud to the FC).
+ * - Messages are queued (bounded by MAX_QUEUE_DELAY worth of bytes at the given baud rate), then coalesced
+ *   into UART-sized chunks.
+ * - Writes are paced to the baud rate (8N1 - 10 bits per byte), such that the kernel tty buffer never holds more
+ *   than MAX_WRITE_AHEAD of data - otherwise the priority of the messages wouldn't matter anymore once they are
+ *   in the kernel buffer.
+ * - Priority messages (RC_CHANNELS_OVERRIDE, MANUAL_CONTROL, COMMAND_*, HEARTBEAT) are always written before bulk
+ *   (e.g. params, mission). If the queue is full, the oldest bulk messages are dropped first. An RC override that
+ *   hasn't been written yet is replaced by a newer one from the same sender.
+ */
+class SerialWriter{
+ public:
+  SerialWriter(const std::string& tag,int baud_rate);
+  ~SerialWriter();
+  SerialWriter(const SerialWriter&)=delete;
+  SerialWriter(SerialWriter&&)=delete;
+  /**
+   * Set the fd to write to, -1 if there is no fd (UART disconnected). Waits until the current write (if any)
+   * is done, such that the previous fd can be closed safely after this returns.
+   */
+  void set_fd(int fd);
+  /**
+   * Queue the messages for writing, never blocks.
+   * @return false if there is no fd (the messages are discarded)
+   */
+  bool enqueue(const std::vector<MavlinkMessage>& messages);
+  // queue delay, drop counters and throughput since the last call
+  std::string get_stats_string();
+  // Chunks that were already taken out of the queue when the fd was removed (UART disconnected)
+  [[nodiscard]] uint64_t get_n_dropped_chunks_no_fd()const{
+    return m_n_dropped_chunks_no_fd;
+  }
+  static bool is_priority_message(const MavlinkMessage& msg);
+  // Budget in bytes per second of the given baud rate
+  static int bytes_per_second(int baud_rate);
+  static constexpr auto MAX_QUEUE_DELAY=std::chrono::milliseconds(500);
+  static constexpr auto MAX_WRITE_AHEAD=std::chrono::milliseconds(20);
+ private:
+  struct QueuedMessage{
+    MavlinkMessage msg;
+    int packed_size;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
+  void loop();
+  // Takes priority messages first, then bulk, until the chunk is full. Needs m_queue_mutex.
+  void fill_chunk(std::vector<uint8_t>& chunk);
+  // Needs m_queue_mutex
+  void drop_oldest(std::deque<QueuedMessage>& queue,std::atomic<uint64_t>& drop_counter);
+  void write_chunk(const std::vector<uint8_t>& chunk);
+  std::shared_ptr<spdlog::logger> m_console;
+  const int m_bytes_per_second;
+  const size_t m_max_queued_bytes;
+  const size_t m_max_chunk_size;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cv;
+  std::deque<QueuedMessage> m_priority_queue;
+  std::deque<QueuedMessage> m_bulk_queue;
+  size_t m_queued_bytes=0;
+  bool m_stop_requested=false;
+  // Held while writing
+  std::mutex m_fd_mutex;
+  int m_fd=-1;
+  std::atomic<bool> m_has_fd=false;
+  // When the UART is done sending everything we've written so far (estimated from the baud rate).
+  // Only used by the writer thread.
+  std::chrono::steady_clock::time_point m_wire_free_at{};
+  std::unique_ptr<std::thread> m_thread;
+  // Stats
+  openhd::LatencyHistogram m_queue_delay_priority;
+  openhd::LatencyHistogram m_queue_delay_bulk;
+  std::atomic<uint64_t> m_n_dropped_bulk=0;
+  std::atomic<uint64_t> m_n_dropped_priority=0;
+  std::atomic<uint64_t> m_n_superseded_rc=0;
+  std::atomic<uint64_t> m_n_dropped_no_fd=0;
+  std::atomic<uint64_t> m_n_dropped_chunks_no_fd=0;
+  std::atomic<uint64_t> m_n_writes=0;
+  std::atomic<uint64_t> m_n_bytes_written=0;
+  std::atomic<uint64_t> m_n_failed_writes=0;
+  std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+  uint64_t m_last_stats_n_bytes_written=0;
+  // Limit warning console logs to not spam the console
+  static constexpr auto MIN_DELAY_BETWEEN_SERIAL_WRITE_FAILED_LOG_MESSAGES=std::chrono::seconds(3);
+  std::chrono::steady_clock::time_point m_last_log_serial_write_failed=std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point m_last_log_cannot_send_no_fd=std::chrono::steady_clock::now();
+  // Only used by the writer thread
+  std::chrono::steady_clock::time_point m_last_log_dropped_chunk_no_fd{};
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_SERIALWRITER_H_
@@ -5,117 +5,300 @@
 #include "TCPEndpoint.h"
 
 #include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <unistd.h>
+
+#include <algorithm>
 #include <csignal>
 #include <utility>
 
+static constexpr uint32_t CLIENT_EVENTS=EPOLLIN | EPOLLRDHUP;
+
 TCPEndpoint::TCPEndpoint(TCPEndpoint::Config config)
     : MEndpoint("TCPServer"),
       m_config(std::move(config))
 {
   m_console = openhd::log::create_or_get(TAG);
   assert(m_console);
-  m_loop_thread=std::make_unique<std::thread>(&TCPEndpoint::loop, this);
-  m_console->debug("created with {}",m_config.port);
+  assert(m_config.max_n_clients>0);
+  m_reactor=m_config.opt_reactor ? m_config.opt_reactor : std::make_shared<EpollReactor>("tcp_reactor");
+  // created on the first client using the slot
+  m_parsers.resize(m_config.max_n_clients);
+  m_parser_in_use.resize(m_config.max_n_clients,false);
+  m_read_buff=std::make_unique<std::array<uint8_t,READ_BUFF_SIZE>>();
+  m_reactor->run_and_wait([this](){
+    start_server();
+  });
+  m_console->debug("created with {}, max clients:{}",m_config.port,m_config.max_n_clients);
 }
 
 TCPEndpoint::~TCPEndpoint() {
-  keep_alive= false;
-  // this signals the fd to stop if needed
-  //close(server_fd);
-  shutdown(server_fd, SHUT_RDWR);
-  if(m_loop_thread){
-    m_loop_thread->join();
-    m_loop_thread.reset();
+  m_reactor->run_and_wait([this](){
+    m_reactor->remove(m_retry_handle);
+    m_reactor->remove(m_server_handle);
+    close_all_clients();
+    if(server_fd>0)close(server_fd);
+  });
+  // Make sure nothing posted by us (disconnects) runs after we are gone
+  m_reactor->run_and_wait([](){});
+  for(const auto& parser:m_parsers){
+    if(parser)checkinChannel(parser->get_mavlink_channel());
   }
 }
 
 bool TCPEndpoint::sendMessagesImpl(
     const std::vector<MavlinkMessage>& messages) {
-  if(client_socket !=0){
-    auto message_buffers= pack_messages(messages);
-    for(const auto& message_buffer:message_buffers){
-      //send(client_socket, message_buffer.data(), message_buffer.size(), 0);
-      send(client_socket, message_buffer.data(), message_buffer.size(), MSG_NOSIGNAL); //otherwise we might crash if the socket disconnects
+  std::lock_guard<std::mutex> guard(m_clients_mutex);
+  if(m_clients.empty()){
+    return false;
+  }
+  pack_messages_into(messages,[this](const uint8_t* data,int data_len){
+    // Packed and copied once, then shared between all the clients
+    const Chunk chunk=std::make_shared<const std::vector<uint8_t>>(data,data+data_len);
+    for(auto& [id,client]:m_clients){
+      enqueue_and_flush(*client,chunk);
+    }
+  });
+  return true;
+}
+
+void TCPEndpoint::enqueue_and_flush(Client& client,const Chunk& chunk) {
+  if(client.disconnect_pending)return;
+  if(client.queued_bytes+chunk->size()>m_config.max_queue_bytes){
+    if(m_config.slow_client_policy==SlowClientPolicy::DISCONNECT){
+      m_console->warn("Client {} too slow, disconnecting",client.name);
+      m_n_clients_disconnected_slow++;
+      request_disconnect(client);
+      return;
+    }
+    // Drop the oldest data, but never the partially sent chunk - that would break the stream
+    const size_t first_droppable=client.front_offset>0 ? 1 : 0;
+    while(client.queued_bytes+chunk->size()>m_config.max_queue_bytes && client.queue.size()>first_droppable){
+      const auto it=client.queue.begin()+first_droppable;
+      client.queued_bytes-=(*it)->size();
+      client.n_bytes_dropped+=(*it)->size();
+      client.n_chunks_dropped++;
+      client.queue.erase(it);
+    }
+    if(client.queued_bytes+chunk->size()>m_config.max_queue_bytes){
+      client.n_bytes_dropped+=chunk->size();
+      client.n_chunks_dropped++;
+      return;
     }
-    return true;
   }
-  return false;
+  client.queue.push_back(chunk);
+  client.queued_bytes+=chunk->size();
+  client.max_queued_bytes=std::max(client.max_queued_bytes,client.queued_bytes);
+  flush(client);
 }
 
-void TCPEndpoint::loop() {
-  while (keep_alive){
-    m_console->debug("TCPEndpoint::setup_and_allow_connection_once() begin");
-    setup_and_allow_connection_once();
-    m_console->debug("TCPEndpoint::setup_and_allow_connection_once() end");
-    if(keep_alive){
-      // Don't peg cpu on errors
-      std::this_thread::sleep_for(std::chrono::seconds(1));
+void TCPEndpoint::flush(Client& client) {
+  while (!client.queue.empty()){
+    const auto& front=*client.queue.front();
+    const ssize_t ret=send(client.fd,front.data()+client.front_offset,front.size()-client.front_offset,
+                           MSG_NOSIGNAL | MSG_DONTWAIT); //otherwise we might crash if the socket disconnects
+    if(ret<0){
+      if(errno==EAGAIN || errno==EWOULDBLOCK)break;
+      m_console->debug("Send error {} {}",client.name,strerror(errno));
+      request_disconnect(client);
+      return;
     }
+    client.n_bytes_sent+=ret;
+    client.front_offset+=ret;
+    if(client.front_offset==front.size()){
+      client.queued_bytes-=front.size();
+      client.front_offset=0;
+      client.queue.pop_front();
+    }
+  }
+  // Only wake up for writability while there is a backlog
+  const bool want_writable=!client.queue.empty();
+  if(want_writable!=client.waiting_writable){
+    client.waiting_writable=want_writable;
+    m_reactor->modify_fd(client.handle,CLIENT_EVENTS | (want_writable ? EPOLLOUT : 0));
   }
 }
 
-void TCPEndpoint::setup_and_allow_connection_once() {
+void TCPEndpoint::request_disconnect(Client& client) {
+  client.disconnect_pending=true;
+  client.queue.clear();
+  client.queued_bytes=0;
+  client.front_offset=0;
+  const auto id=client.id;
+  m_reactor->post([this,id](){
+    close_client(id);
+  });
+}
+
+int TCPEndpoint::open_server_socket() {
   struct sockaddr_in sockaddr{};
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+  const int fd=socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
     m_console->warn("open socket failed");
-    return ;
+    return -1;
   }
   int opt = 1;
-  if (setsockopt(server_fd, SOL_SOCKET,
+  if (setsockopt(fd, SOL_SOCKET,
                  SO_REUSEADDR | SO_REUSEPORT, &opt,
                  sizeof(opt))) {
     m_console->warn("setsockopt failed");
-    close(server_fd);
-    return ;
+    close(fd);
+    return -1;
   }
   sockaddr.sin_family = AF_INET;
   sockaddr.sin_addr.s_addr = INADDR_ANY;
   sockaddr.sin_port = htons(m_config.port);
 
-  if (bind(server_fd, (struct sockaddr*)&sockaddr,sizeof(sockaddr))< 0) {
+  if (bind(fd, (struct sockaddr*)&sockaddr,sizeof(sockaddr))< 0) {
     m_console->warn("bind failed");
-    close(server_fd);
-    return ;
+    close(fd);
+    return -1;
   }
   // signal readiness to accept clients
-  if (listen(server_fd, 3) < 0) {
+  if (listen(fd, 3) < 0) {
     m_console->warn("listen failed");
-    close(server_fd);
-    return ;
-  }
-  m_console->debug("After listen");
-  const  int addrlen = sizeof(sockaddr);
-  const auto accept_result=accept(server_fd, (struct sockaddr*)&sockaddr,(socklen_t*)&addrlen);
-  if (accept_result < 0) {
-    m_console->debug("accept failed");
-    close(server_fd);
-    return ;
-  }
-  client_socket =accept_result;
-  m_console->debug("accepted client,sockfd:{}, ip:{}, port:{}",client_socket,
-                   inet_ntoa(sockaddr.sin_addr),ntohs(sockaddr.sin_port));
-  // read buffer
-  const auto buff = std::make_unique<std::array<uint8_t,READ_BUFF_SIZE>>();
-  while (keep_alive){
-    // Read from all the client(s)
-    //std::this_thread::sleep_for(std::chrono::seconds(1));
-    //const ssize_t message_length = recv(client_socket, buff->data(), buff->size(), MSG_WAITALL);
-    const ssize_t message_length = read(client_socket, buff->data(), buff->size());
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void TCPEndpoint::start_server() {
+  server_fd=open_server_socket();
+  if(server_fd<0){
+    server_fd=0;
+    // Don't peg cpu on errors - try again in 1 second
+    if(m_retry_handle==0){
+      m_retry_handle=m_reactor->add_timer(std::chrono::seconds(1),[this](){
+        start_server();
+      });
+    }
+    return;
+  }
+  m_reactor->remove(m_retry_handle);
+  m_retry_handle=0;
+  m_server_handle=m_reactor->add_fd(server_fd,EPOLLIN,[this](uint32_t){
+    on_accept();
+  });
+  m_accepting=true;
+  m_console->debug("Listening");
+}
+
+void TCPEndpoint::on_accept() {
+  while (true){
+    const auto free_parser=std::find(m_parser_in_use.begin(),m_parser_in_use.end(),false);
+    if(free_parser==m_parser_in_use.end()){
+      // Stop accepting until a client disconnects, new clients wait in the listen backlog
+      m_console->debug("Max n of clients ({}) reached",m_config.max_n_clients);
+      m_reactor->modify_fd(m_server_handle,0);
+      m_accepting=false;
+      return;
+    }
+    struct sockaddr_in sockaddr{};
+    socklen_t addrlen = sizeof(sockaddr);
+    const int fd=accept4(server_fd,(struct sockaddr*)&sockaddr,&addrlen,SOCK_NONBLOCK);
+    if(fd<0){
+      return;
+    }
+    auto client=std::make_shared<Client>();
+    client->id=m_next_client_id++;
+    client->fd=fd;
+    client->name=fmt::format("{}:{}",inet_ntoa(sockaddr.sin_addr),ntohs(sockaddr.sin_port));
+    client->parser_index=static_cast<int>(free_parser-m_parser_in_use.begin());
+    auto& parser=m_parsers[client->parser_index];
+    if(parser==nullptr){
+      const int channel=checkoutFreeChannel();
+      if(channel<0){
+        m_console->warn("No free mavlink channel, rejecting client {}",client->name);
+        close(fd);
+        continue;
+      }
+      parser=std::make_unique<MavlinkFrameParser>(static_cast<uint8_t>(channel));
+    }
+    std::lock_guard<std::mutex> guard(m_clients_mutex);
+    client->handle=m_reactor->add_fd(fd,CLIENT_EVENTS,[this,client](uint32_t events){
+      on_client_event(client,events);
+    });
+    if(client->handle==0){
+      close(fd);
+      continue;
+    }
+    *free_parser=true;
+    m_parsers[client->parser_index]->reset();
+    m_clients[client->id]=client;
+    m_console->debug("accepted client {}, sockfd:{}, n clients:{}",client->name,fd,m_clients.size());
+  }
+}
+
+void TCPEndpoint::on_client_event(const std::shared_ptr<Client>& client,uint32_t events) {
+  if(events & EPOLLOUT){
+    std::lock_guard<std::mutex> guard(m_clients_mutex);
+    if(!client->disconnect_pending){
+      flush(*client);
+    }
+  }
+  if(!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))){
+    return;
+  }
+  // Read until there is no more data, such that we don't wake up multiple times for one burst.
+  // Not under m_clients_mutex - the callback might send messages back to the clients
+  auto& parser=*m_parsers[client->parser_index];
+  while (true){
+    const ssize_t message_length = read(client->fd, m_read_buff->data(), m_read_buff->size());
     if(message_length<0){
+      if(errno==EAGAIN || errno==EWOULDBLOCK)return;
       m_console->debug("Read error {} {}",message_length,strerror(errno));
       break ;
     }
     if(message_length==0){
-      m_console->debug("Client disconnected");
+      m_console->debug("Client {} disconnected",client->name);
       break ;
     }
-    MEndpoint::parseNewData(buff->data(),message_length);
+    MEndpoint::parseNewData(parser,m_read_buff->data(),message_length);
+  }
+  close_client(client->id);
+}
+
+void TCPEndpoint::close_client(uint64_t client_id) {
+  std::shared_ptr<Client> client;
+  {
+    std::lock_guard<std::mutex> guard(m_clients_mutex);
+    auto it=m_clients.find(client_id);
+    // already closed
+    if(it==m_clients.end())return;
+    client=it->second;
+    m_clients.erase(it);
+  }
+  m_reactor->remove(client->handle);
+  close(client->fd);
+  m_parser_in_use[client->parser_index]=false;
+  m_console->debug("Closed {}",client->to_string());
+  if(!m_accepting && m_server_handle!=0){
+    m_reactor->modify_fd(m_server_handle,EPOLLIN);
+    m_accepting=true;
+  }
+}
+
+void TCPEndpoint::close_all_clients() {
+  std::vector<uint64_t> ids;
+  {
+    std::lock_guard<std::mutex> guard(m_clients_mutex);
+    for(const auto& [id,client]:m_clients)ids.push_back(id);
   }
-  // closing the connected (client) socket(s)
-  close(client_socket);
-  client_socket =0;
-  // closing the listening socket
-  close(server_fd);
+  for(const auto id:ids)close_client(id);
+}
+
+std::string TCPEndpoint::Client::to_string() const {
+  return fmt::format("{}{{backlog:{}B max backlog:{}B sent:{}B dropped:{} chunks / {}B}}",name,queued_bytes,
+                     max_queued_bytes,n_bytes_sent,n_chunks_dropped,n_bytes_dropped);
 }
 
+std::string TCPEndpoint::get_clients_stats_string() {
+  std::lock_guard<std::mutex> guard(m_clients_mutex);
+  std::stringstream ss;
+  ss<<TAG<<" clients:"<<m_clients.size()<<" disconnected (slow):"<<m_n_clients_disconnected_slow<<"\n";
+  for(const auto& [id,client]:m_clients){
+    ss<<" "<<client->to_string()<<"\n";
+  }
+  return ss.str();
+}
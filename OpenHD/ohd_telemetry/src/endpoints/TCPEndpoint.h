@@ -5,6 +5,10 @@
 #ifndef OPENHD_TCPENDPOINT_H
 #define OPENHD_TCPENDPOINT_H
 
+#include <deque>
+#include <map>
+
+#include "EpollReactor.h"
 #include "MEndpoint.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -12,28 +16,88 @@
 
 // Simple TCP Mavlink server
 // Really nice tutorial: https://www.geeksforgeeks.org/socket-programming-in-cc-handling-multiple-clients-on-server-without-multi-threading/
-// R.n only supports up to 1 simultaneously connected client though
-// The implementation for sending data is non-blocking and doesn't actually care if data arrives or not.
+// Supports up to max_n_clients simultaneously connected clients (e.g. a GCS, a logging tool and a tracker script).
+// Sending is non-blocking - each client has its own bounded send queue, such that a slow client cannot stall
+// the other clients (or the caller). Each packed chunk is shared between all the clients (no copy / re-pack per client).
+// Everything (accept, read, writing the backlog of a client) runs on a reactor - either the one given in the config,
+// or our own.
 class TCPEndpoint : public MEndpoint {
  public:
+  // What to do with a client that doesn't read its data fast enough (its send queue is full)
+  enum class SlowClientPolicy{
+    // drop the oldest queued data of this client - the client sees packet loss, but stays connected
+    DROP_OLDEST,
+    // disconnect this client
+    DISCONNECT
+  };
   struct Config{
     // always localhost
     //std::string ip;
     int port;
+    // If set, the server socket and the client(s) are serviced by this reactor instead of our own
+    std::shared_ptr<EpollReactor> opt_reactor=nullptr;
+    int max_n_clients=4;
+    // per client
+    size_t max_queue_bytes=64*1024;
+    SlowClientPolicy slow_client_policy=SlowClientPolicy::DROP_OLDEST;
   };
   explicit TCPEndpoint(Config config);
   ~TCPEndpoint();
   static constexpr int DEFAULT_PORT=5760;
+  // backlog and drop stats of each currently connected client, for debugging
+  std::string get_clients_stats_string();
  private:
+  using Chunk=std::shared_ptr<const std::vector<uint8_t>>;
+  struct Client{
+    uint64_t id;
+    int fd;
+    std::string name;
+    EpollReactor::Handle handle=0;
+    // index into m_parsers
+    int parser_index;
+    std::deque<Chunk> queue;
+    // bytes of the first chunk in the queue that have already been sent
+    size_t front_offset=0;
+    size_t queued_bytes=0;
+    bool waiting_writable=false;
+    bool disconnect_pending=false;
+    // stats
+    uint64_t n_bytes_sent=0;
+    uint64_t n_chunks_dropped=0;
+    uint64_t n_bytes_dropped=0;
+    size_t max_queued_bytes=0;
+    [[nodiscard]] std::string to_string()const;
+  };
   const Config m_config;
   std::shared_ptr<spdlog::logger> m_console;
-  std::unique_ptr<std::thread> m_loop_thread = nullptr;
-  bool keep_alive=true;
+  std::shared_ptr<EpollReactor> m_reactor;
   int server_fd=0;
-  int client_socket =0;
-  static constexpr const size_t READ_BUFF_SIZE = 65507;
-  void loop();
-  void setup_and_allow_connection_once();
+  static constexpr const size_t READ_BUFF_SIZE = 8192;
+  // returns the listening socket, -1 on failure
+  int open_server_socket();
+  // All of these run on the reactor thread
+  void start_server();
+  void on_accept();
+  void on_client_event(const std::shared_ptr<Client>& client,uint32_t events);
+  void close_client(uint64_t client_id);
+  void close_all_clients();
+  // These need m_clients_mutex
+  void enqueue_and_flush(Client& client,const Chunk& chunk);
+  void flush(Client& client);
+  void request_disconnect(Client& client);
+  EpollReactor::Handle m_server_handle=0;
+  EpollReactor::Handle m_retry_handle=0;
+  bool m_accepting=false;
+  std::mutex m_clients_mutex;
+  std::map<uint64_t,std::shared_ptr<Client>> m_clients;
+  uint64_t m_next_client_id=0;
+  // One parser (mavlink channel) per client slot, such that the data of different clients is not mixed up
+  // and we don't use up a new mavlink channel for each connect. Created on first use, the channels are
+  // returned on destruction.
+  std::vector<std::unique_ptr<MavlinkFrameParser>> m_parsers;
+  std::vector<bool> m_parser_in_use;
+  std::unique_ptr<std::array<uint8_t,READ_BUFF_SIZE>> m_read_buff;
+  uint64_t m_n_clients_disconnected_slow=0;
   bool sendMessagesImpl(const std::vector<MavlinkMessage>& messages) override;
 };
 
@@ -4,15 +4,39 @@
 
 #include "UDPEndpoint2.h"
 
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
 #include <utility>
 
-UDPEndpoint2::UDPEndpoint2(const std::string &TAG,int senderPort,int receiverPort,std::string senderIp,std::string receiverIp)
+UDPEndpoint2::UDPEndpoint2(const std::string &TAG,int senderPort,int receiverPort,std::string senderIp,std::string receiverIp,
+                           std::shared_ptr<EpollReactor> opt_reactor)
     : MEndpoint(TAG),
       SEND_PORT(senderPort), RECV_PORT(receiverPort),
       SENDER_IP(std::move(senderIp)),
-      RECV_IP(std::move(receiverIp)){
+      RECV_IP(std::move(receiverIp)),
+      m_opt_reactor(std::move(opt_reactor)){
   m_console = openhd::log::create_or_get(TAG);
   assert(m_console);
+  if(m_opt_reactor){
+    m_reactor_socket=socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    int enable = 1;
+    setsockopt(m_reactor_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(RECV_PORT);
+    inet_aton(RECV_IP.c_str(),&addr.sin_addr);
+    if (bind(m_reactor_socket, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+      m_console->warn("Cannot bind {}:{} {}",RECV_IP,RECV_PORT,strerror(errno));
+    }
+    m_reactor_handle=m_opt_reactor->add_fd(m_reactor_socket,EPOLLIN,[this](uint32_t){
+      reactor_on_readable();
+    });
+    return;
+  }
   const auto cb = [this](const uint8_t *payload, const std::size_t payloadSize)mutable {
     this->parseNewData(payload, (int)payloadSize);
   };
@@ -21,21 +45,50 @@ UDPEndpoint2::UDPEndpoint2(const std::string &TAG,int senderPort,int receiverPor
 }
 
 UDPEndpoint2::~UDPEndpoint2() {
+  if(m_opt_reactor){
+    m_opt_reactor->remove(m_reactor_handle);
+    close(m_reactor_socket);
+    return;
+  }
   m_receiver_sender->stopBackground();
 }
 
 bool UDPEndpoint2::sendMessagesImpl(const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers= pack_messages(messages);
   const auto other_ips=get_all_curr_dest_ips();
-  for(const auto& message_buffer:message_buffers){
-    m_receiver_sender->forwardPacketViaUDP(SENDER_IP,SEND_PORT,message_buffer.data(), message_buffer.size());
+  pack_messages_into(messages,[this,&other_ips](const uint8_t* data,int data_len){
+    if(m_opt_reactor){
+      reactor_send(SENDER_IP,SEND_PORT,data,data_len);
+      for(const auto& ip:other_ips){
+        reactor_send(ip,SEND_PORT,data,data_len);
+      }
+      return;
+    }
+    m_receiver_sender->forwardPacketViaUDP(SENDER_IP,SEND_PORT,data,data_len);
     for(const auto& ip:other_ips){
-      m_receiver_sender->forwardPacketViaUDP(ip,SEND_PORT,message_buffer.data(),message_buffer.size());
+      m_receiver_sender->forwardPacketViaUDP(ip,SEND_PORT,data,data_len);
     }
-  }
+  });
   return true;
 }
 
+void UDPEndpoint2::reactor_on_readable() {
+  uint8_t buff[65507];
+  // Read until there is no more data, such that we don't wake up multiple times for one burst
+  while (true){
+    const ssize_t message_length=recv(m_reactor_socket,buff,sizeof(buff),MSG_DONTWAIT);
+    if(message_length<=0)return;
+    parseNewData(buff,static_cast<int>(message_length));
+  }
+}
+
+void UDPEndpoint2::reactor_send(const std::string &ip, int port, const uint8_t *data,int data_len) {
+  struct sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_aton(ip.c_str(),&addr.sin_addr);
+  sendto(m_reactor_socket,data,data_len,0,(struct sockaddr *)&addr,sizeof(addr));
+}
+
 void UDPEndpoint2::addAnotherDestIpAddress(const std::string& ip) {
   std::lock_guard<std::mutex> lock(m_sender_mutex);
   m_console->debug("addAnotherDestIpAddress {}",ip);
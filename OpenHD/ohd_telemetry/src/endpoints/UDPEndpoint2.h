@@ -9,6 +9,7 @@
 #include <thread>
 // dirty, pull in header only
 #include "../../../lib/wifibroadcast/src/HelperSources/SocketHelper.hpp"
+#include "EpollReactor.h"
 #include "MEndpoint.h"
 
 /**
@@ -20,8 +21,12 @@
  */
 class UDPEndpoint2 : public MEndpoint {
  public:
+  /**
+   * @param opt_reactor if set, the socket is serviced by the reactor instead of the UDPReceiver thread
+   */
   UDPEndpoint2(const std::string& TAG,int senderPort, int receiverPort,
-			  std::string senderIp=SocketHelper::ADDRESS_LOCALHOST,std::string receiverIp=SocketHelper::ADDRESS_LOCALHOST);
+			  std::string senderIp=SocketHelper::ADDRESS_LOCALHOST,std::string receiverIp=SocketHelper::ADDRESS_LOCALHOST,
+                          std::shared_ptr<EpollReactor> opt_reactor=nullptr);
   ~UDPEndpoint2();
   // Delete copy and move
   UDPEndpoint2(const UDPEndpoint2&)=delete;
@@ -41,6 +46,12 @@ class UDPEndpoint2 : public MEndpoint {
   std::mutex m_sender_mutex;
   std::map<std::string,void*> m_other_dest_ips{};
   std::vector<std::string> get_all_curr_dest_ips();
+  // reactor mode - we listen and send on the same socket, like UDPReceiver does
+  std::shared_ptr<EpollReactor> m_opt_reactor;
+  int m_reactor_socket=-1;
+  EpollReactor::Handle m_reactor_handle=0;
+  void reactor_on_readable();
+  void reactor_send(const std::string& ip,int port,const uint8_t* data,int data_len);
 };
 
 #endif //OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_UDPENDPOINT2_H_
@@ -6,34 +6,68 @@
 
 #include <utility>
 
-WBEndpoint::WBEndpoint(std::shared_ptr<OHDLink> link,std::string TAG)
+WBEndpoint::WBEndpoint(std::shared_ptr<OHDLink> link,std::string TAG,std::shared_ptr<EpollReactor> opt_reactor,
+                       int scheduler_max_bytes_per_second)
     : MEndpoint(std::move(TAG)),
-    m_link_handle(std::move(link)){
+    m_link_handle(std::move(link)),
+    m_opt_reactor(std::move(opt_reactor)){
   //assert(m_tx_rx_handle);
   if(!m_link_handle){
     openhd::log::get_default()->warn("WBEndpoint-tx rx handle is missing (no telemetry connection between air and ground)");
   }else{
     auto cb=[this](std::shared_ptr<std::vector<uint8_t>> data){
+      if(m_opt_reactor){
+        // The link doesn't expose a fd we could watch, so hand the data over instead
+        m_opt_reactor->post([this,data](){
+          MEndpoint::parseNewData(data->data(),data->size());
+        });
+        return;
+      }
       MEndpoint::parseNewData(data->data(),data->size());
     };
     m_link_handle->register_on_receive_telemetry_data_cb(cb);
+    if(scheduler_max_bytes_per_second>0){
+      WBTelemetryScheduler::Config config{};
+      config.max_bytes_per_second=scheduler_max_bytes_per_second;
+      m_opt_scheduler=std::make_unique<WBTelemetryScheduler>(MEndpoint::TAG,config,[this](std::shared_ptr<std::vector<uint8_t>> data){
+        m_link_handle->transmit_telemetry_data(std::move(data));
+      });
+    }
   }
 }
 
 WBEndpoint::~WBEndpoint() {
+  // stop sending before anything else
+  m_opt_scheduler.reset();
   if(m_link_handle){
     m_link_handle->register_on_receive_telemetry_data_cb(nullptr);
   }
+  if(m_opt_reactor){
+    // Make sure no data posted before the cb was removed is parsed afterwards
+    m_opt_reactor->run_and_wait([](){});
+  }
 }
 
 bool WBEndpoint::sendMessagesImpl(const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers= pack_messages(messages);
-  for(const auto& message_buffer:message_buffers){
-    if(m_link_handle){
-      auto shared=std::make_shared<std::vector<uint8_t>>(message_buffer);
-      std::lock_guard<std::mutex> guard(m_send_messages_mutex);
-      m_link_handle->transmit_telemetry_data(shared);
-    }
+  if(!m_link_handle){
+    return true;
   }
+  if(m_opt_scheduler){
+    m_opt_scheduler->enqueue(messages);
+    return true;
+  }
+  pack_messages_into(messages,[this](const uint8_t* data,int data_len){
+    // The link takes ownership, so this is the only copy / allocation per chunk
+    auto shared=std::make_shared<std::vector<uint8_t>>(data,data+data_len);
+    std::lock_guard<std::mutex> guard(m_send_messages_mutex);
+    m_link_handle->transmit_telemetry_data(shared);
+  });
   return true;
 }
+
+std::string WBEndpoint::get_scheduler_stats_string() {
+  if(m_opt_scheduler){
+    return m_opt_scheduler->get_stats_string();
+  }
+  return "";
+}
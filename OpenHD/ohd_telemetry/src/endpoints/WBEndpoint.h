@@ -5,18 +5,28 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBENDPOINT_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBENDPOINT_H_
 
+#include "EpollReactor.h"
 #include "MEndpoint.h"
+#include "WBTelemetryScheduler.h"
 #include "openhd_link.hpp"
 
 // Abstraction for sending / receiving data on/from the link between air and ground unit
 class WBEndpoint : public MEndpoint  {
  public:
-  explicit WBEndpoint(std::shared_ptr<OHDLink> link,std::string TAG);
+  // if opt_reactor is set, received data is parsed on the reactor thread instead of the link rx thread.
+  // if scheduler_max_bytes_per_second is >0, outgoing messages go through a WBTelemetryScheduler with that budget,
+  // otherwise they are forwarded to the link directly.
+  explicit WBEndpoint(std::shared_ptr<OHDLink> link,std::string TAG,std::shared_ptr<EpollReactor> opt_reactor=nullptr,
+                      int scheduler_max_bytes_per_second=0);
   ~WBEndpoint();
+  // empty if there is no scheduler
+  std::string get_scheduler_stats_string();
  private:
   std::shared_ptr<OHDLink> m_link_handle;
   bool sendMessagesImpl(const std::vector<MavlinkMessage>& messages) override;
   std::mutex m_send_messages_mutex;
+  std::shared_ptr<EpollReactor> m_opt_reactor;
+  std::unique_ptr<WBTelemetryScheduler> m_opt_scheduler;
 };
 
 #endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBENDPOINT_H_
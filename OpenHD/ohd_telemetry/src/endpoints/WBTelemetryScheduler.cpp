@@ -0,0 +1,257 @@
+#include "WBTelemetryScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <utility>
+
+WBTelemetryScheduler::Priority WBTelemetryScheduler::classify(const MavlinkMessage& msg) {
+  switch (msg.m.msgid) {
+    case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:
+    case MAVLINK_MSG_ID_MANUAL_CONTROL:
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+    case MAVLINK_MSG_ID_COMMAND_INT:
+    case MAVLINK_MSG_ID_COMMAND_ACK:
+    case MAVLINK_MSG_ID_COMMAND_CANCEL:
+    case MAVLINK_MSG_ID_HEARTBEAT:
+      return Priority::CONTROL;
+    case MAVLINK_MSG_ID_ATTITUDE:
+    case MAVLINK_MSG_ID_ATTITUDE_QUATERNION:
+    case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+    case MAVLINK_MSG_ID_LOCAL_POSITION_NED:
+    case MAVLINK_MSG_ID_VFR_HUD:
+    case MAVLINK_MSG_ID_ALTITUDE:
+    case MAVLINK_MSG_ID_GPS_RAW_INT:
+    case MAVLINK_MSG_ID_RC_CHANNELS:
+    case MAVLINK_MSG_ID_RC_CHANNELS_RAW:
+    case MAVLINK_MSG_ID_SERVO_OUTPUT_RAW:
+    case MAVLINK_MSG_ID_RAW_IMU:
+    case MAVLINK_MSG_ID_SCALED_IMU:
+    case MAVLINK_MSG_ID_SCALED_IMU2:
+    case MAVLINK_MSG_ID_SCALED_IMU3:
+    case MAVLINK_MSG_ID_SCALED_PRESSURE:
+      return Priority::HIGH_RATE;
+    case MAVLINK_MSG_ID_PARAM_VALUE:
+    case MAVLINK_MSG_ID_PARAM_EXT_VALUE:
+    case MAVLINK_MSG_ID_MISSION_ITEM:
+    case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+    case MAVLINK_MSG_ID_LOG_ENTRY:
+    case MAVLINK_MSG_ID_LOG_DATA:
+    case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+    case MAVLINK_MSG_ID_ENCAPSULATED_DATA:
+      return Priority::BULK;
+    default:
+      return Priority::DEFAULT;
+  }
+}
+
+std::string WBTelemetryScheduler::priority_as_string(WBTelemetryScheduler::Priority priority) {
+  switch (priority) {
+    case Priority::CONTROL:
+      return "control";
+    case Priority::HIGH_RATE:
+      return "high_rate";
+    case Priority::DEFAULT:
+      return "default";
+    case Priority::BULK:
+      return "bulk";
+  }
+  return "unknown";
+}
+
+void WBTelemetryScheduler::TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+  const double elapsed_s=std::chrono::duration<double>(now-last_refill).count();
+  tokens=std::min(max_tokens,tokens+elapsed_s*bytes_per_second);
+  last_refill=now;
+}
+
+std::chrono::steady_clock::duration WBTelemetryScheduler::TokenBucket::time_until_tokens() const {
+  if(has_tokens())return std::chrono::steady_clock::duration::zero();
+  // +1 byte, such that the bucket is non-empty when we wake up
+  const double seconds=(1-tokens)/bytes_per_second;
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+WBTelemetryScheduler::WBTelemetryScheduler(const std::string& tag,WBTelemetryScheduler::Config config,
+                                           WBTelemetryScheduler::SEND_CB send_cb)
+    : m_config(config),
+      m_send_cb(std::move(send_cb)),
+      // 2 seconds worth of data at the max rate
+      m_max_queued_bytes(std::max<size_t>(m_config.max_bytes_per_second*2,MAVLINK_PACK_MAX_MTU)) {
+  m_console=openhd::log::create_or_get(tag+"_sched");
+  assert(m_console);
+  assert(m_config.max_bytes_per_second>0);
+  const auto now=std::chrono::steady_clock::now();
+  m_total_bucket=TokenBucket{static_cast<double>(m_config.max_bytes_per_second),static_cast<double>(m_config.max_burst_bytes),
+                             static_cast<double>(m_config.max_burst_bytes),now};
+  // CONTROL is never limited by its own bucket
+  for(int i=1;i<N_PRIORITIES;i++){
+    const double share=m_config.max_share[i];
+    m_classes[i].opt_bucket=std::make_unique<TokenBucket>(TokenBucket{m_config.max_bytes_per_second*share,
+                                                                       m_config.max_burst_bytes*share,
+                                                                       m_config.max_burst_bytes*share,now});
+  }
+  m_console->debug("max bytes/s:{} max burst:{} max queued bytes:{}",m_config.max_bytes_per_second,m_config.max_burst_bytes,
+                   m_max_queued_bytes);
+  m_thread=std::make_unique<std::thread>(&WBTelemetryScheduler::loop,this);
+}
+
+WBTelemetryScheduler::~WBTelemetryScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop_requested=true;
+  }
+  m_cv.notify_all();
+  m_thread->join();
+}
+
+void WBTelemetryScheduler::enqueue(const std::vector<MavlinkMessage>& messages) {
+  const auto now=std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(const auto& msg:messages){
+      const auto priority=classify(msg);
+      auto& cls=m_classes[static_cast<int>(priority)];
+      QueuedMessage queued{msg,msg.get_packed_size(),now};
+      if(priority==Priority::HIGH_RATE){
+        // Only the latest value matters
+        auto it=std::find_if(cls.queue.begin(),cls.queue.end(),[&msg](const QueuedMessage& other){
+          return other.msg.m.msgid==msg.m.msgid && other.msg.m.sysid==msg.m.sysid && other.msg.m.compid==msg.m.compid;
+        });
+        if(it!=cls.queue.end()){
+          // keep the position in the queue, but the data (and therefore its age) is new
+          m_queued_bytes+=queued.packed_size-it->packed_size;
+          *it=queued;
+          cls.stats.n_superseded++;
+          continue;
+        }
+      }
+      cls.queue.push_back(queued);
+      m_queued_bytes+=queued.packed_size;
+    }
+    // Drop from the lowest priority class first
+    for(int i=N_PRIORITIES-1;i>=0 && m_queued_bytes>m_max_queued_bytes;i--){
+      auto& cls=m_classes[i];
+      while (!cls.queue.empty() && m_queued_bytes>m_max_queued_bytes){
+        m_queued_bytes-=cls.queue.front().packed_size;
+        cls.queue.pop_front();
+        cls.stats.n_dropped_overflow++;
+      }
+    }
+  }
+  m_cv.notify_one();
+}
+
+bool WBTelemetryScheduler::has_queued_messages() const {
+  return std::any_of(m_classes.begin(),m_classes.end(),[](const Class& cls){
+    return !cls.queue.empty();
+  });
+}
+
+void WBTelemetryScheduler::drop_stale(std::chrono::steady_clock::time_point now) {
+  for(int i=0;i<N_PRIORITIES;i++){
+    auto& cls=m_classes[i];
+    while (!cls.queue.empty() && now-cls.queue.front().enqueue_time>m_config.max_queue_delay[i]){
+      m_queued_bytes-=cls.queue.front().packed_size;
+      cls.queue.pop_front();
+      cls.stats.n_dropped_stale++;
+    }
+  }
+}
+
+int WBTelemetryScheduler::next_class() const {
+  for(int i=0;i<N_PRIORITIES;i++){
+    const auto& cls=m_classes[i];
+    if(cls.queue.empty())continue;
+    if(static_cast<Priority>(i)==Priority::CONTROL)return i;
+    if(!m_total_bucket.has_tokens())return -1;
+    if(cls.opt_bucket->has_tokens())return i;
+  }
+  return -1;
+}
+
+std::chrono::steady_clock::duration WBTelemetryScheduler::time_until_next_class() const {
+  auto ret=std::chrono::steady_clock::duration::max();
+  for(const auto& cls:m_classes){
+    if(cls.queue.empty() || !cls.opt_bucket)continue;
+    ret=std::min(ret,std::max(m_total_bucket.time_until_tokens(),cls.opt_bucket->time_until_tokens()));
+  }
+  return ret;
+}
+
+void WBTelemetryScheduler::fill_chunk(std::vector<uint8_t>& chunk,std::chrono::steady_clock::time_point now) {
+  while (true){
+    const int index=next_class();
+    if(index<0)return;
+    auto& cls=m_classes[index];
+    const auto& next=cls.queue.front();
+    // A single message is always sent, even if it doesn't fit
+    if(!chunk.empty() && chunk.size()+next.packed_size>MAVLINK_PACK_MAX_MTU)return;
+    const auto offset=chunk.size();
+    chunk.resize(offset+next.packed_size);
+    next.msg.pack_into(chunk.data()+offset);
+    m_total_bucket.tokens-=next.packed_size;
+    if(cls.opt_bucket)cls.opt_bucket->tokens-=next.packed_size;
+    cls.stats.queue_delay.record(now-next.enqueue_time);
+    cls.stats.n_sent++;
+    cls.stats.n_bytes_sent+=next.packed_size;
+    m_queued_bytes-=next.packed_size;
+    cls.queue.pop_front();
+  }
+}
+
+void WBTelemetryScheduler::loop() {
+  while (true){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock,[this](){
+      return m_stop_requested || has_queued_messages();
+    });
+    if(m_stop_requested)return;
+    const auto now=std::chrono::steady_clock::now();
+    m_total_bucket.refill(now);
+    for(auto& cls:m_classes){
+      if(cls.opt_bucket)cls.opt_bucket->refill(now);
+    }
+    drop_stale(now);
+    // The link takes ownership, so this is the only copy / allocation per chunk
+    auto chunk=std::make_shared<std::vector<uint8_t>>();
+    chunk->reserve(MAVLINK_PACK_MAX_MTU+MAVLINK_MAX_PACKET_LEN);
+    fill_chunk(*chunk,now);
+    if(chunk->empty()){
+      if(!has_queued_messages())continue;
+      // Out of budget - wait until there are tokens again (or a CONTROL message comes in)
+      const auto wait=time_until_next_class();
+      m_cv.wait_for(lock,wait,[this](){
+        return m_stop_requested || !m_classes[static_cast<int>(Priority::CONTROL)].queue.empty();
+      });
+      continue;
+    }
+    lock.unlock();
+    m_send_cb(chunk);
+  }
+}
+
+std::string WBTelemetryScheduler::get_stats_string() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const auto now=std::chrono::steady_clock::now();
+  const double elapsed_s=std::chrono::duration<double>(now-m_last_stats).count();
+  std::stringstream ss;
+  ss<<"WBTelemetryScheduler{budget:"<<m_config.max_bytes_per_second<<"B/s queued:"<<m_queued_bytes<<"B\n";
+  for(int i=0;i<N_PRIORITIES;i++){
+    auto& cls=m_classes[i];
+    auto& stats=cls.stats;
+    ss<<" "<<priority_as_string(static_cast<Priority>(i))<<" B/s:"<<static_cast<int>(static_cast<double>(stats.n_bytes_sent)/elapsed_s)
+       <<" sent:"<<stats.n_sent<<" queued:"<<cls.queue.size()<<" superseded:"<<stats.n_superseded
+       <<" dropped stale:"<<stats.n_dropped_stale<<" overflow:"<<stats.n_dropped_overflow
+       <<" queue delay:"<<stats.queue_delay.to_string()<<"\n";
+    stats.queue_delay.reset();
+    stats.n_sent=0;
+    stats.n_bytes_sent=0;
+    stats.n_superseded=0;
+    stats.n_dropped_stale=0;
+    stats.n_dropped_overflow=0;
+  }
+  ss<<"}";
+  m_last_stats=now;
+  return ss.str();
+}
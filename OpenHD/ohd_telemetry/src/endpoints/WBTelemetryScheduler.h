@@ -0,0 +1,121 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBTELEMETRYSCHEDULER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBTELEMETRYSCHEDULER_H_
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mav_include.h"
+#include "openhd_latency_histogram.hpp"
+#include "openhd_spdlog.h"
+
+/**
+ * Sits in front of the wifibroadcast telemetry tx, such that a param dump / log download / mission upload
+ * cannot delay RC override / heartbeat / command traffic on a low MCS link (the link itself has a small, FIFO
+ * packet queue and no idea what is inside the packets).
+ * - Messages are classified by their id into priority classes, higher priority classes are always sent first.
+ * - The total n of bytes per second is limited by a token bucket (max_bytes_per_second, max_burst_bytes), and each
+ *   class by its own bucket with a share of that rate - CONTROL is never limited / delayed (but it still takes its
+ *   bytes from the total budget).
+ * - HIGH_RATE streams (e.g. ATTITUDE at 10Hz+) are only useful while fresh: a queued message is replaced by
+ *   a newer one with the same sys id, comp id and msg id, and they have a short max queue delay.
+ * - Messages that waited longer than the max queue delay of their class are dropped, if the queue is full
+ *   the oldest messages of the lowest priority class are dropped first.
+ */
+class WBTelemetryScheduler{
+ public:
+  enum class Priority{
+    // RC override, manual control, commands and heartbeats
+    CONTROL=0,
+    // Telemetry streams that are sent at a high rate, where only the most recent value matters
+    HIGH_RATE,
+    // Everything else
+    DEFAULT,
+    // Param, mission, log and file transfers - a lot of data, but (retried by the protocol) not time critical
+    BULK
+  };
+  static constexpr int N_PRIORITIES=4;
+  static Priority classify(const MavlinkMessage& msg);
+  static std::string priority_as_string(Priority priority);
+  struct Config{
+    int max_bytes_per_second=16*1000;
+    int max_burst_bytes=4*1024;
+    // share of max_bytes_per_second each class may use at most (CONTROL is never limited)
+    std::array<float,N_PRIORITIES> max_share{1.0f,0.7f,1.0f,1.0f};
+    std::array<std::chrono::milliseconds,N_PRIORITIES> max_queue_delay{
+        std::chrono::milliseconds(500),std::chrono::milliseconds(200),
+        std::chrono::milliseconds(1000),std::chrono::milliseconds(3000)};
+  };
+  // Called (on the scheduler thread) with chunks of up to MAVLINK_PACK_MAX_MTU bytes
+  typedef std::function<void(std::shared_ptr<std::vector<uint8_t>> data)> SEND_CB;
+  WBTelemetryScheduler(const std::string& tag,Config config,SEND_CB send_cb);
+  ~WBTelemetryScheduler();
+  WBTelemetryScheduler(const WBTelemetryScheduler&)=delete;
+  WBTelemetryScheduler(WBTelemetryScheduler&&)=delete;
+  // Never blocks
+  void enqueue(const std::vector<MavlinkMessage>& messages);
+  // per class queue delay and drop stats since the last call
+  std::string get_stats_string();
+ private:
+  struct TokenBucket{
+    double bytes_per_second;
+    double max_tokens;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+    void refill(std::chrono::steady_clock::time_point now);
+    // A message may be sent as long as the bucket is not empty, the bucket might go negative (debt) afterwards.
+    // Like that, messages bigger than the bucket are no special case.
+    [[nodiscard]] bool has_tokens()const{
+      return tokens>0;
+    }
+    [[nodiscard]] std::chrono::steady_clock::duration time_until_tokens()const;
+  };
+  struct QueuedMessage{
+    MavlinkMessage msg;
+    int packed_size;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
+  struct ClassStats{
+    openhd::LatencyHistogram queue_delay;
+    uint64_t n_sent=0;
+    uint64_t n_bytes_sent=0;
+    uint64_t n_superseded=0;
+    uint64_t n_dropped_stale=0;
+    uint64_t n_dropped_overflow=0;
+  };
+  struct Class{
+    std::deque<QueuedMessage> queue;
+    std::unique_ptr<TokenBucket> opt_bucket;
+    ClassStats stats;
+  };
+  void loop();
+  // All the following need m_mutex
+  void drop_stale(std::chrono::steady_clock::time_point now);
+  // Takes the highest priority messages the buckets allow for until the chunk is full
+  void fill_chunk(std::vector<uint8_t>& chunk,std::chrono::steady_clock::time_point now);
+  // Index of the highest priority class that has a message and may send, -1 if none
+  int next_class()const;
+  [[nodiscard]] std::chrono::steady_clock::duration time_until_next_class()const;
+  [[nodiscard]] bool has_queued_messages()const;
+  std::shared_ptr<spdlog::logger> m_console;
+  const Config m_config;
+  const SEND_CB m_send_cb;
+  const size_t m_max_queued_bytes;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  TokenBucket m_total_bucket;
+  std::array<Class,N_PRIORITIES> m_classes;
+  size_t m_queued_bytes=0;
+  bool m_stop_requested=false;
+  std::unique_ptr<std::thread> m_thread;
+  std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ENDPOINTS_WBTELEMETRYSCHEDULER_H_
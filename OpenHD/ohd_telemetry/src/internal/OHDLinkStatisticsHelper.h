@@ -5,6 +5,8 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_OHDLINKSTATISTICSHELPER_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_OHDLINKSTATISTICSHELPER_H_
 
+#include <cstring>
+
 #include "../mav_include.h"
 #include "openhd_link_statistics.hpp"
 
@@ -98,6 +100,28 @@ static MavlinkMessage pack_vid_gnd(const uint8_t system_id,const uint8_t compone
   return msg;
 }
 
+// Video latency percentiles (only if latency tracing is enabled). The openhd stats messages have no fields for them,
+// so they are sent as NAMED_VALUE_INT (one per percentile, value in us, name e.g. "VL0AIR_P50") - consumers of the
+// stats messages are not affected.
+static void pack_latency(const uint8_t system_id,const uint8_t component_id,const std::string& name_prefix,
+                         const openhd::link_statistics::LatencyPercentilesUs& latency,std::vector<MavlinkMessage>& out){
+  if(latency.is_empty())return;
+  const std::pair<const char*,int32_t> percentiles[3]={{"_P50",latency.p50_us},{"_P95",latency.p95_us},{"_P99",latency.p99_us}};
+  for(const auto& [suffix,value]:percentiles){
+    MavlinkMessage msg;
+    // not null terminated if it uses all 10 chars
+    char name[MAVLINK_MSG_NAMED_VALUE_INT_FIELD_NAME_LEN]={};
+    std::strncpy(name,(name_prefix+suffix).c_str(),sizeof(name));
+    mavlink_msg_named_value_int_pack(system_id,component_id,&msg.m,0,name,value);
+    out.push_back(msg);
+  }
+}
+
+// The ground unit's own video / card stats, sent (also) to the air unit if the adaptive link controller is enabled
+static bool is_ground_link_feedback_message(const MavlinkMessage& msg){
+  return msg.m.sysid==OHD_SYS_ID_GROUND && msg.m.compid==MAV_COMP_ID_ONBOARD_COMPUTER &&
+         (msg.m.msgid==MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND || msg.m.msgid==MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_CARD);
+}
 
 }
 #endif //OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_OHDLINKSTATISTICSHELPER_H_
@@ -4,12 +4,14 @@
 
 #include "OHDMainComponent.h"
 
+#include <algorithm>
 #include <iostream>
 #include <openhd_global_constants.hpp>
 #include <utility>
 
 #include "OHDLinkStatisticsHelper.h"
 #include "OnboardComputerStatusProvider.h"
+#include "openhd_config.h"
 #include "openhd_reboot_util.h"
 
 OHDMainComponent::OHDMainComponent(
@@ -19,7 +21,13 @@ OHDMainComponent::OHDMainComponent(
 	MavlinkComponent(parent_sys_id,MAV_COMP_ID_ONBOARD_COMPUTER) {
   m_console = openhd::log::create_or_get("t_main_c");
   assert(m_console);
-  m_onboard_computer_status_provider=std::make_unique<OnboardComputerStatusProvider>(m_platform);
+  auto status_interval=std::chrono::milliseconds(openhd::load_config().DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS);
+  if(status_interval<OnboardComputerStatusProvider::MIN_SAMPLE_INTERVAL){
+    m_console->warn("DEV_ONBOARD_COMPUTER_STATUS_INTERVAL_MS {} too low, using {}",status_interval.count(),
+                    OnboardComputerStatusProvider::MIN_SAMPLE_INTERVAL.count());
+    status_interval=OnboardComputerStatusProvider::MIN_SAMPLE_INTERVAL;
+  }
+  m_onboard_computer_status_provider=std::make_unique<OnboardComputerStatusProvider>(m_platform,status_interval);
   // suppress the warning until we get the first actually updated stats
   m_last_link_stats.is_air=RUNS_ON_AIR;
   if(m_opt_action_handler){
@@ -126,6 +134,12 @@ std::vector<MavlinkMessage> OHDMainComponent::process_mavlink_messages(std::vect
         }
       }
         break ;
+      case MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_CARD:
+      case MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND:{
+        if(RUNS_ON_AIR && openhd::LinkStatisticsHelper::is_ground_link_feedback_message(msg)){
+          handle_ground_link_feedback(msg);
+        }
+      }break;
       default:
         break;
     }
@@ -133,6 +147,28 @@ std::vector<MavlinkMessage> OHDMainComponent::process_mavlink_messages(std::vect
   return ret;
 }
 
+void OHDMainComponent::handle_ground_link_feedback(const MavlinkMessage& msg) {
+  if(msg.m.msgid==MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_CARD){
+    mavlink_openhd_stats_monitor_mode_wifi_card_t card;
+    mavlink_msg_openhd_stats_monitor_mode_wifi_card_decode(&msg.m,&card);
+    if(card.card_index<m_ground_cards_rssi.size()){
+      m_ground_cards_rssi[card.card_index]=card.rx_rssi;
+    }
+    return;
+  }
+  mavlink_openhd_stats_wb_video_ground_t video;
+  mavlink_msg_openhd_stats_wb_video_ground_decode(&msg.m,&video);
+  // only the primary video stream is used for rate control
+  if(video.link_index!=0 || !m_opt_action_handler)return;
+  openhd::link_statistics::GroundLinkFeedback feedback{};
+  feedback.link_index=video.link_index;
+  feedback.count_blocks_total=video.count_blocks_total;
+  feedback.count_blocks_lost=video.count_blocks_lost;
+  feedback.count_blocks_recovered=video.count_blocks_recovered;
+  feedback.best_rx_rssi=*std::max_element(m_ground_cards_rssi.begin(),m_ground_cards_rssi.end());
+  m_opt_action_handler->action_ground_link_feedback_handle(feedback);
+}
+
 std::vector<MavlinkMessage> OHDMainComponent::generate_mav_wb_stats(){
   //m_console->debug("OHDMainComponent::generate_mav_wb_stats");
   std::vector<MavlinkMessage> ret;
@@ -161,11 +197,15 @@ std::vector<MavlinkMessage> OHDMainComponent::generate_mav_wb_stats(){
     for(const auto& stats : latest_stats.stats_wb_video_air){
       ret.push_back(openhd::LinkStatisticsHelper::pack_vid_air(
           m_sys_id, m_comp_id, stats));
+      openhd::LinkStatisticsHelper::pack_latency(m_sys_id,m_comp_id,"VL"+std::to_string(stats.link_index)+"AIR",
+                                                 stats.curr_latency_air_total,ret);
     }
   }else{
     for(const auto& ground_video: latest_stats.stats_wb_video_ground){
       ret.push_back(openhd::LinkStatisticsHelper::pack_vid_gnd(
           m_sys_id, m_comp_id, ground_video));
+      openhd::LinkStatisticsHelper::pack_latency(m_sys_id,m_comp_id,"VL"+std::to_string(ground_video.link_index)+"GND",
+                                                 ground_video.curr_latency_receive_to_forward,ret);
     }
   }
   return ret;
@@ -71,6 +71,10 @@ class OHDMainComponent : public MavlinkComponent{
   MavlinkMessage ack_command(uint8_t source_sys_id,uint8_t source_comp_id,uint16_t command_id);
   std::shared_ptr<spdlog::logger> m_console;
   std::unique_ptr<LastKnowPosition> m_last_known_position= nullptr;
+  // Air only, forward the link feedback sent by the ground to the wb link
+  void handle_ground_link_feedback(const MavlinkMessage& msg);
+  // rssi per ground card, from the last card stats message(s)
+  std::array<int8_t,4> m_ground_cards_rssi{INT8_MIN,INT8_MIN,INT8_MIN,INT8_MIN};
 };
 
 #endif //XMAVLINKSERVICE_INTERNALTELEMETRY_H
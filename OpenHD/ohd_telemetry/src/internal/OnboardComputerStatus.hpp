@@ -5,173 +5,200 @@
 #ifndef XMAVLINKSERVICE_SYSTEMREADUTIL_H
 #define XMAVLINKSERVICE_SYSTEMREADUTIL_H
 
-#include <chrono>
-#include <fstream>
-#include <iostream>
-#include <regex>
-#include <sstream>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
-#include "ina219.h"
-#include "mav_include.h"
-#include "openhd_spdlog.h"
-#include "openhd_util.h"
-#include "openhd_util_filesystem.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
 
 // Namespace for util methods regarding onboard computer status
+// Everything is read directly from procfs / sysfs (and the VideoCore mailbox on rpi) - no popen / regex, such that
+// sampling the status once per second costs close to nothing even on a rpi zero.
+// All the readers take the root of the filesystem as an argument, such that they can be tested against a fake procfs / sysfs.
 namespace OnboardComputerStatus {
 
-// from https://github.com/OpenHD/Open.HD/blob/35b6b10fbeda43cd06bbfbd90e2daf29629c2f8a/openhd-status/src/statusmicroservice.cpp#L165
-// Return the CPU/SOC temperature of the system or 0 if not available
-// Unit: Degree ?
-static int readTemperature() {
-  auto temp_file_opt=OHDFilesystemUtil::opt_read_file("/sys/class/thermal/thermal_zone0/temp", false);
-  if(!temp_file_opt.has_value())return 0;
-  auto temp=OHDUtil::string_to_int(temp_file_opt.value());
-  if(!temp.has_value())return 0;
-  return temp.value() / 1000;
+// Reads the whole file into buf and 0-terminates it, returns the n of bytes read or -1 on error.
+// procfs / sysfs files are generated on read, and the ones we are interested in are small (or we only need the beginning).
+static int read_small_file(const std::string& filename,char* buf,size_t buf_size){
+  const int fd=open(filename.c_str(),O_RDONLY | O_CLOEXEC);
+  if(fd<0)return -1;
+  size_t total=0;
+  while (total<buf_size-1){
+    const auto n=read(fd,buf+total,buf_size-1-total);
+    if(n<=0)break;
+    total+=n;
+  }
+  close(fd);
+  buf[total]='\0';
+  return static_cast<int>(total);
 }
 
-// Stuff that works only on rpi
-namespace rpi {
-
-// copy and paste from QOpenHD, I think we can get the under-voltage warning on rpi this way.
-static int readUnderVoltError() {
-  auto undervolt_opt=OHDFilesystemUtil::opt_read_file("/tmp/undervolt", false);
-  if(!undervolt_opt.has_value())return 0;
-  auto value=OHDUtil::string_to_int(undervolt_opt.value());;
-  if(!value.has_value())return 0;
-  return value.value();
+// For sysfs files that contain a single integer
+static std::optional<long> read_long_from_file(const std::string& filename){
+  char buf[64];
+  if(read_small_file(filename,buf,sizeof(buf))<=0)return std::nullopt;
+  char* end;
+  const long ret=std::strtol(buf,&end,10);
+  if(end==buf)return std::nullopt;
+  return ret;
 }
 
-// https://www.elinux.org/RPI_vcgencmd_usage
-//
-// most vcgen commands return "blablabla=wanted"
-// where wanted is what we are acutally after
-static std::string everything_after_equal(const std::string &unparsed) {
-  //x.substr(x.find(":") + 1);
-  const auto npos = unparsed.find("=");
-  if (npos != std::string::npos) {
-	return unparsed.substr(npos + 1);
-  }
-  openhd::log::get_default()->warn("everything_after_equal - no equal sign found");
-  return unparsed;
+// Return the CPU/SOC temperature of the system (thermal zone 0, on rpi that is the same sensor vcgencmd measure_temp reads)
+// Unit: Degree, 0 if not available
+static int read_temperature_degree(const std::string& root=""){
+  const auto milli_degree=read_long_from_file(root+"/sys/class/thermal/thermal_zone0/temp");
+  if(!milli_degree.has_value())return 0;
+  return static_cast<int>(lround(static_cast<double>(milli_degree.value())/1000.0));
 }
 
-static float vcgencmd_result_parse_float(const std::string& result){
-  const auto tmp = rpi::everything_after_equal(result);
-  return OHDUtil::string_to_float(tmp).value_or(0);
-}
-static long vcgencmd_result_parse_long(const std::string& result){
-  const auto tmp = rpi::everything_after_equal(result);
-  return OHDUtil::string_to_long(tmp).value_or(0);
+// Current clock of the first CPU core in MHz, 0 if not available (e.g. no cpufreq driver)
+static int read_cpu_frequency_mhz(const std::string& root=""){
+  const auto khz=read_long_from_file(root+"/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq");
+  if(!khz.has_value())return 0;
+  return static_cast<int>(khz.value()/1000);
 }
 
-static int8_t read_temperature_soc_degree() {
-  int8_t ret = -1;
-  const auto vcgencmd_measure_temp_opt = OHDUtil::run_command_out("vcgencmd measure_temp");
-  //const auto vcgencmd_measure_temp_opt=std::optional<std::string>("temp=47.2'C");
-  if (!vcgencmd_measure_temp_opt.has_value()) {
-	return ret;
+// Accumulated time (in USER_HZ) the CPU(s) spent since boot, from the first ("cpu ") line in /proc/stat.
+// The CPU usage is the delta of 2 samples.
+struct CpuTimes{
+  uint64_t busy=0;
+  uint64_t total=0;
+};
+static std::optional<CpuTimes> read_cpu_times(const std::string& root=""){
+  // We only need the first line
+  char buf[256];
+  if(read_small_file(root+"/proc/stat",buf,sizeof(buf))<=0)return std::nullopt;
+  if(std::strncmp(buf,"cpu ",4)!=0)return std::nullopt;
+  // user nice system idle iowait irq softirq steal (guest and guest_nice are already included in user and nice)
+  uint64_t values[8]={};
+  int n_values=0;
+  const char* curr=buf+4;
+  while (n_values<8){
+    char* end;
+    const auto value=std::strtoull(curr,&end,10);
+    if(end==curr)break;
+    values[n_values++]=value;
+    curr=end;
   }
-  const auto tmp_float = vcgencmd_result_parse_float(vcgencmd_measure_temp_opt.value());
-  return static_cast<int8_t>(lround(tmp_float));
-}
-static constexpr auto VCGENCMD_CLOCK_CPU="arm";
-static constexpr auto VCGENCMD_CLOCK_ISP="isp";
-static constexpr auto VCGENCMD_CLOCK_H264="h264";
-static constexpr auto VCGENCMD_CLOCK_CORE="core";
-static constexpr auto VCGENCMD_CLOCK_V3D="v3d";
-// See https://elinux.org/RPI_vcgencmd_usage
-// Shows clock frequency, clock can be one of arm, core, h264, isp, v3d, uart, pwm, emmc, pixel, vec, hdmi, dpi.
-// NOTE: vcgencmd returns values in hertz, use the "mhz" util for more easy to read values.
-static int vcgencmd_measure_clock(const std::string& which){
-  int ret = -1;
-  const auto vcgencmd_result = OHDUtil::run_command_out(fmt::format("vcgencmd measure_clock {}",which));
-  if (!vcgencmd_result.has_value()) {
-	return ret;
+  if(n_values<4)return std::nullopt;
+  CpuTimes ret{};
+  for(int i=0;i<n_values;i++){
+    ret.total+=values[i];
   }
-  const auto tmp2 = vcgencmd_result_parse_long(vcgencmd_result.value());
-  return static_cast<int>(tmp2);
-}
-static int read_curr_frequency_mhz(const std::string& which){
-  return static_cast<uint16_t>(vcgencmd_measure_clock(which)/1000/1000);
+  // idle + iowait
+  const uint64_t idle=values[3]+values[4];
+  ret.busy=ret.total-idle;
+  return ret;
 }
 
+// CPU usage in percent (all cores) in between the 2 samples
+static int calculate_cpu_usage_percent(const CpuTimes& prev,const CpuTimes& curr){
+  if(curr.total<=prev.total || curr.busy<prev.busy)return 0;
+  const auto busy=static_cast<double>(curr.busy-prev.busy);
+  const auto total=static_cast<double>(curr.total-prev.total);
+  return static_cast<int>(lround(100.0*busy/total));
 }
 
-// really stupid, but for now the best solution I came up with
-// loosely based on https://stackoverflow.com/questions/9229333/how-to-get-overall-cpu-usage-e-g-57-on-linux
-// NOTE: top -v returns procps-ng on both pi4 and my ubuntu laptop
-// Also note, we want the CPU usage from all processes - not only -p 1
-// 28.July 2022: This seems to work on both rpi4 and my ubuntu pc.
-// Also, I am pretty sure we can use -bn1 - top should report from "the last refresh."
-static std::optional<int> read_cpuload_once_blocking(){
-  auto res_opt=OHDUtil::run_command_out(R"lit(top -bn1 | grep -i '^%cpu')lit"); // ???? cat /proc/loadavg
-  // The result from that should look like this: %Cpu(s): 31,0 us,  2,0 sy,  0,0 ni, 67,0 id,  0,0 wa,  0,0 hi,  0,0 si,  0,0 st
-  // Where "67.0 id" is what we are after - "time spent in the kernel idle handler"
-  // from that, we can deduce the usage
-  if(!res_opt.has_value()){
-    return std::nullopt;
-  }
-  const std::string res=res_opt.value();
-  //std::cout<<"read_cpuload_once_blocking res:{"<<res<<"}\n";
-  std::smatch result;
-  const std::regex r1{"ni,(.*) id"};
-  auto res1 = std::regex_search(res, result, r1);
-  if(!res1 || result.size()<1){
-    return std::nullopt;
-  }
-  const std::string intermediate1=result[0];
-  //std::cout<<"Intermediate:{"<<intermediate1<<"}\n";
-  if(intermediate1.length()<3){
-    return std::nullopt;
-  }
-  std::regex begin("ni,");
-  const auto intermediate2=std::regex_replace(intermediate1, begin, "");
-  //std::cout<<"Intermediate2:{"<<intermediate2<<"}\n";
-  const auto cpu_idle_perc=std::atof(intermediate2.c_str());
-  //std::cout<<"cpu_idle_perc:{"<<cpu_idle_perc<<"}\n";
-  const auto cpu_idle_perc_int=static_cast<int>(lround(cpu_idle_perc));
-  return 100-cpu_idle_perc_int;
-}
-
-// Taken from ChatGPT
 struct RamUsage{
   double ram_usage_perc;
   int ram_total_mb;
 };
-static RamUsage calculate_memory_usage_percent(){
-  try {
-	std::ifstream meminfo("/proc/meminfo");
-	std::string line;
-	std::regex pattern("\\s+");
-	long long total_memory = 0;
-	long long free_memory = 0;
-	long long used_memory = 0;
-	while (std::getline(meminfo, line)) {
-	  std::vector<std::string> fields;
-	  auto words_begin = std::sregex_token_iterator(line.begin(), line.end(), pattern, -1);
-	  auto words_end = std::sregex_token_iterator();
-	  for (auto i = words_begin; i != words_end; ++i) {
-		fields.push_back(*i);
-	  }
-	  if (fields[0] == "MemTotal:") {
-		total_memory = std::stoll(fields[1]);
-	  } else if (fields[0] == "MemFree:") {
-		free_memory = std::stoll(fields[1]);
-	  }
-	}
-	meminfo.close();
-	used_memory = total_memory - free_memory;
-	double memory_usage = 100.0 * used_memory / total_memory;
-	/*std::cout << "Total Memory: " << total_memory / 1024 << " MB" << std::endl;
-	std::cout << "Used Memory: " << used_memory / 1024 << " MB" << std::endl;
-	std::cout << "Free Memory: " << free_memory / 1024 << " MB" << std::endl;
-	std::cout << "Memory Usage: " << memory_usage << "%" << std::endl;*/
-	return RamUsage{memory_usage,(int)total_memory};
-  }catch (std::exception& e){
-	return RamUsage{0,0};
+// Memory that is in use (not available for allocation without swapping, MemAvailable if the kernel provides it)
+static std::optional<RamUsage> read_memory_usage(const std::string& root=""){
+  // MemTotal, MemFree and MemAvailable are the first lines
+  char buf[512];
+  if(read_small_file(root+"/proc/meminfo",buf,sizeof(buf))<=0)return std::nullopt;
+  long long total_kb=-1;
+  long long free_kb=-1;
+  long long available_kb=-1;
+  const char* line=buf;
+  while (line!=nullptr && *line!='\0'){
+    long long* dest=nullptr;
+    size_t key_len=0;
+    if(std::strncmp(line,"MemTotal:",9)==0){
+      dest=&total_kb;
+      key_len=9;
+    }else if(std::strncmp(line,"MemFree:",8)==0){
+      dest=&free_kb;
+      key_len=8;
+    }else if(std::strncmp(line,"MemAvailable:",13)==0){
+      dest=&available_kb;
+      key_len=13;
+    }
+    if(dest!=nullptr){
+      *dest=std::strtoll(line+key_len,nullptr,10);
+    }
+    line=std::strchr(line,'\n');
+    if(line!=nullptr)line++;
+  }
+  if(total_kb<=0 || free_kb<0)return std::nullopt;
+  const long long used_kb=total_kb-(available_kb>=0 ? available_kb : free_kb);
+  return RamUsage{100.0*static_cast<double>(used_kb)/static_cast<double>(total_kb),static_cast<int>(total_kb/1024)};
+}
+
+// Stuff that works only on rpi
+namespace rpi {
+
+// The values vcgencmd reports come from the VideoCore firmware - instead of running vcgencmd (fork + exec per value)
+// we ask the firmware directly, via the mailbox property interface (/dev/vcio).
+// See https://github.com/raspberrypi/firmware/wiki/Mailbox-property-interface
+class VCMailbox{
+ public:
+  VCMailbox(){
+    m_fd=open("/dev/vcio",O_RDWR | O_CLOEXEC);
   }
+  ~VCMailbox(){
+    if(m_fd>=0)close(m_fd);
+  }
+  VCMailbox(const VCMailbox&)=delete;
+  VCMailbox(VCMailbox&&)=delete;
+  [[nodiscard]] bool is_open()const{
+    return m_fd>=0;
+  }
+  // Clock ids, same as vcgencmd measure_clock arm / core / v3d / h264 / isp
+  static constexpr uint32_t CLOCK_ID_ARM=3;
+  static constexpr uint32_t CLOCK_ID_CORE=4;
+  static constexpr uint32_t CLOCK_ID_V3D=5;
+  static constexpr uint32_t CLOCK_ID_H264=6;
+  static constexpr uint32_t CLOCK_ID_ISP=7;
+  // Like vcgencmd measure_clock, but in MHz. 0 if not available
+  int read_clock_measured_mhz(uint32_t clock_id){
+    // response: clock id, rate in Hz
+    const auto rate_hz=get_property(TAG_GET_CLOCK_RATE_MEASURED,clock_id,1);
+    if(!rate_hz.has_value())return 0;
+    return static_cast<int>(rate_hz.value()/1000/1000);
+  }
+ private:
+  static constexpr uint32_t TAG_GET_CLOCK_RATE_MEASURED=0x00030047;
+  static constexpr uint32_t MBOX_REQUEST=0;
+  static constexpr uint32_t MBOX_RESPONSE_SUCCESS=0x80000000;
+  // Single tag with one u32 request and up to 2 u32 response values, returns the response value at response_index
+  std::optional<uint32_t> get_property(uint32_t tag,uint32_t request_value,int response_index){
+    if(m_fd<0)return std::nullopt;
+    alignas(16) uint32_t buf[8];
+    buf[0]=sizeof(buf);
+    buf[1]=MBOX_REQUEST;
+    buf[2]=tag;
+    // size of the value buffer
+    buf[3]=8;
+    // size of the request
+    buf[4]=4;
+    buf[5]=request_value;
+    buf[6]=0;
+    // end tag
+    buf[7]=0;
+    if(ioctl(m_fd,_IOWR(100,0,char*),buf)<0)return std::nullopt;
+    if(buf[1]!=MBOX_RESPONSE_SUCCESS || (buf[4] & MBOX_RESPONSE_SUCCESS)==0)return std::nullopt;
+    return buf[5+response_index];
+  }
+  int m_fd=-1;
+};
+
 }
 
 }
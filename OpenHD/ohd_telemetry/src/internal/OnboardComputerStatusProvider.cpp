@@ -4,7 +4,14 @@
 
 #include "OnboardComputerStatusProvider.h"
 
-#include "OnboardComputerStatus.hpp"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <utility>
+
+#include "openhd_spdlog.h"
 #include "openhd_util_filesystem.h"
 
 //INA219 stuff
@@ -16,22 +23,37 @@ constexpr uint8_t BUS_ADC = ADC_12BIT;
 constexpr uint8_t SHUNT_ADC = ADC_12BIT;
 //INA219 stuff
 
-OnboardComputerStatusProvider::OnboardComputerStatusProvider(OHDPlatform platform)
+OnboardComputerStatusProvider::OnboardComputerStatusProvider(OHDPlatform platform,std::chrono::milliseconds sample_interval,
+                                                             std::string root)
     : m_platform(platform),
+      m_sample_interval(sample_interval),
+      m_root(std::move(root)),
       m_ina_219(SHUNT_OHMS, MAX_EXPECTED_AMPS)
 {
   ina219_log_warning_once();
   if(!m_ina_219.has_any_error){
     m_ina_219.configure(RANGE, GAIN, BUS_ADC, SHUNT_ADC);
   }
-  m_calculate_cpu_usage_thread=std::make_unique<std::thread>(&OnboardComputerStatusProvider::calculate_cpu_usage_until_terminate, this);
-  m_calculate_other_thread=std::make_unique<std::thread>(&OnboardComputerStatusProvider::calculate_other_until_terminate, this);
+  if(m_platform.platform_type==PlatformType::RaspberryPi){
+    m_opt_vc_mailbox=std::make_unique<OnboardComputerStatus::rpi::VCMailbox>();
+    if(!m_opt_vc_mailbox->is_open()){
+      openhd::log::get_default()->warn("Cannot open /dev/vcio - no rpi clocks");
+    }
+  }
+  if(m_sample_interval.count()>0){
+    m_thread=std::make_unique<std::thread>(&OnboardComputerStatusProvider::loop, this);
+  }
 }
 
 OnboardComputerStatusProvider::~OnboardComputerStatusProvider() {
-  terminate= true;
-  m_calculate_cpu_usage_thread->join();
-  m_calculate_other_thread->join();
+  {
+    std::lock_guard<std::mutex> lock(m_terminate_mutex);
+    m_terminate= true;
+  }
+  m_terminate_cv.notify_all();
+  if(m_thread){
+    m_thread->join();
+  }
 }
 
 mavlink_onboard_computer_status_t OnboardComputerStatusProvider::get_current_status() {
@@ -39,79 +61,79 @@ mavlink_onboard_computer_status_t OnboardComputerStatusProvider::get_current_sta
   return m_curr_onboard_computer_status;
 }
 
-void OnboardComputerStatusProvider::calculate_cpu_usage_until_terminate() {
-  while (!terminate){
-    const auto before=std::chrono::steady_clock::now();
-    const auto value=OnboardComputerStatus::read_cpuload_once_blocking();
-    const auto read_time=std::chrono::steady_clock::now()-before;
-    if(value.has_value()){
-      // lock mutex and write out
-      std::lock_guard<std::mutex> lock(m_curr_onboard_computer_status_mutex);
-      m_curr_onboard_computer_status.cpu_cores[0]=value.value();
-    }
-    //std::cout<<"Took:"<<std::chrono::duration_cast<std::chrono::milliseconds>(read_time).count()<<"\n";
-    // top can block up to X seconds, but in case it doesn't make sure we don't neccessarily waste cpu here
-    const auto minimum_delay=std::chrono::seconds(1);
-    if(read_time<minimum_delay){
-      std::this_thread::sleep_for((minimum_delay-read_time));
-    }
+void OnboardComputerStatusProvider::loop() {
+  // Lowest priority (on linux, this applies to the calling thread only) - but not SCHED_IDLE,
+  // we want to report the CPU usage also (especially) when the CPU is fully loaded.
+  if(setpriority(PRIO_PROCESS,static_cast<id_t>(syscall(SYS_gettid)),19)!=0){
+    openhd::log::get_default()->debug("Cannot lower priority of status thread");
+  }
+  std::unique_lock<std::mutex> lock(m_terminate_mutex);
+  while (!m_terminate){
+    lock.unlock();
+    sample_once();
+    lock.lock();
+    m_terminate_cv.wait_for(lock,m_sample_interval,[this](){
+      return m_terminate;
+    });
   }
 }
 
-void OnboardComputerStatusProvider::calculate_other_until_terminate() {
-  while (!terminate){
-    // We always sleep for 1 second
-    // just to make sure to not hog too much cpu here.
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    int8_t curr_temperature_core=0;
-    int curr_clock_cpu=0;
-    int curr_clock_isp=0;
-    int curr_clock_h264=0;
-    int curr_clock_core=0;
-    int curr_clock_v3d=0;
-    int curr_ina219_voltage=0;
-    int curr_ina219_current=0;
+void OnboardComputerStatusProvider::sample_once() {
+  int curr_cpu_usage=0;
+  int8_t curr_temperature_core=0;
+  int curr_clock_cpu=0;
+  int curr_clock_isp=0;
+  int curr_clock_h264=0;
+  int curr_clock_core=0;
+  int curr_clock_v3d=0;
+  int curr_ina219_voltage=0;
+  int curr_ina219_current=0;
 
-    const int curr_space_left=OHDFilesystemUtil::get_remaining_space_in_mb();
-    const auto curr_ram_usage=OnboardComputerStatus::calculate_memory_usage_percent();
-    ina219_log_warning_once();
-    if(!m_ina_219.has_any_error){
-      float voltage = roundf(m_ina_219.voltage() * 1000);
-      float current = roundf(m_ina_219.current() * 1000) / 1000;
-      curr_ina219_voltage=voltage;
-      curr_ina219_current=current;
-    }
-    if(m_platform.platform_type==PlatformType::RaspberryPi){
-      curr_temperature_core=(int8_t)OnboardComputerStatus::rpi::read_temperature_soc_degree();
-      // temporary, until we have our own message
-      curr_clock_cpu=OnboardComputerStatus::rpi::read_curr_frequency_mhz(OnboardComputerStatus::rpi::VCGENCMD_CLOCK_CPU);
-      curr_clock_isp=OnboardComputerStatus::rpi::read_curr_frequency_mhz(OnboardComputerStatus::rpi::VCGENCMD_CLOCK_ISP);
-      curr_clock_h264=OnboardComputerStatus::rpi::read_curr_frequency_mhz(OnboardComputerStatus::rpi::VCGENCMD_CLOCK_H264);
-      curr_clock_core=OnboardComputerStatus::rpi::read_curr_frequency_mhz(OnboardComputerStatus::rpi::VCGENCMD_CLOCK_CORE);
-      curr_clock_v3d=OnboardComputerStatus::rpi::read_curr_frequency_mhz(OnboardComputerStatus::rpi::VCGENCMD_CLOCK_V3D);
-
-    }else{
-      const auto cpu_temp=(int8_t)OnboardComputerStatus::readTemperature();
-      curr_temperature_core=cpu_temp;
-    }
-    {
-      // lock mutex and write out
-      std::lock_guard<std::mutex> lock(m_curr_onboard_computer_status_mutex);
-      m_curr_onboard_computer_status.temperature_core[0]=curr_temperature_core;
-      // temporary, until we have our own message
-      m_curr_onboard_computer_status.storage_type[0]=curr_clock_cpu;
-      m_curr_onboard_computer_status.storage_type[1]=curr_clock_isp;
-      m_curr_onboard_computer_status.storage_type[2]=curr_clock_h264;
-      m_curr_onboard_computer_status.storage_type[3]=curr_clock_core;
-      m_curr_onboard_computer_status.storage_usage[0]=curr_clock_v3d;
-      m_curr_onboard_computer_status.storage_usage[1]=curr_space_left;
-      m_curr_onboard_computer_status.storage_usage[2]=curr_ina219_voltage;
-      m_curr_onboard_computer_status.storage_usage[3]=curr_ina219_current;
-      m_curr_onboard_computer_status.ram_usage=static_cast<uint32_t>(curr_ram_usage.ram_usage_perc);
-      m_curr_onboard_computer_status.ram_total=curr_ram_usage.ram_total_mb;
-    }
+  const auto cpu_times=OnboardComputerStatus::read_cpu_times(m_root);
+  if(cpu_times.has_value() && m_last_cpu_times.has_value()){
+    curr_cpu_usage=OnboardComputerStatus::calculate_cpu_usage_percent(m_last_cpu_times.value(),cpu_times.value());
+  }
+  m_last_cpu_times=cpu_times;
+  const int curr_space_left=OHDFilesystemUtil::get_remaining_space_in_mb();
+  const auto curr_ram_usage=OnboardComputerStatus::read_memory_usage(m_root).value_or(OnboardComputerStatus::RamUsage{0,0});
+  ina219_log_warning_once();
+  if(!m_ina_219.has_any_error){
+    float voltage = roundf(m_ina_219.voltage() * 1000);
+    float current = roundf(m_ina_219.current() * 1000) / 1000;
+    curr_ina219_voltage=voltage;
+    curr_ina219_current=current;
+  }
+  curr_temperature_core=static_cast<int8_t>(OnboardComputerStatus::read_temperature_degree(m_root));
+  if(m_opt_vc_mailbox && m_opt_vc_mailbox->is_open()){
+    using OnboardComputerStatus::rpi::VCMailbox;
+    // temporary, until we have our own message
+    curr_clock_cpu=m_opt_vc_mailbox->read_clock_measured_mhz(VCMailbox::CLOCK_ID_ARM);
+    curr_clock_isp=m_opt_vc_mailbox->read_clock_measured_mhz(VCMailbox::CLOCK_ID_ISP);
+    curr_clock_h264=m_opt_vc_mailbox->read_clock_measured_mhz(VCMailbox::CLOCK_ID_H264);
+    curr_clock_core=m_opt_vc_mailbox->read_clock_measured_mhz(VCMailbox::CLOCK_ID_CORE);
+    curr_clock_v3d=m_opt_vc_mailbox->read_clock_measured_mhz(VCMailbox::CLOCK_ID_V3D);
+  }else{
+    curr_clock_cpu=OnboardComputerStatus::read_cpu_frequency_mhz(m_root);
+  }
+  {
+    // lock mutex and write out
+    std::lock_guard<std::mutex> lock(m_curr_onboard_computer_status_mutex);
+    m_curr_onboard_computer_status.cpu_cores[0]=curr_cpu_usage;
+    m_curr_onboard_computer_status.temperature_core[0]=curr_temperature_core;
+    // temporary, until we have our own message
+    m_curr_onboard_computer_status.storage_type[0]=curr_clock_cpu;
+    m_curr_onboard_computer_status.storage_type[1]=curr_clock_isp;
+    m_curr_onboard_computer_status.storage_type[2]=curr_clock_h264;
+    m_curr_onboard_computer_status.storage_type[3]=curr_clock_core;
+    m_curr_onboard_computer_status.storage_usage[0]=curr_clock_v3d;
+    m_curr_onboard_computer_status.storage_usage[1]=curr_space_left;
+    m_curr_onboard_computer_status.storage_usage[2]=curr_ina219_voltage;
+    m_curr_onboard_computer_status.storage_usage[3]=curr_ina219_current;
+    m_curr_onboard_computer_status.ram_usage=static_cast<uint32_t>(curr_ram_usage.ram_usage_perc);
+    m_curr_onboard_computer_status.ram_total=curr_ram_usage.ram_total_mb;
   }
 }
+
 std::vector<MavlinkMessage>
 OnboardComputerStatusProvider::get_current_status_as_mavlink_message(const uint8_t sys_id,const uint8_t comp_id) {
   MavlinkMessage msg;
@@ -5,44 +5,58 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_ONBOARDCOMPUTERSTATUSPROVIDER_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_ONBOARDCOMPUTERSTATUSPROVIDER_H_
 
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
 
 #include "../mav_include.h"
+#include "OnboardComputerStatus.hpp"
 #include "ina219.h"
 #include "openhd_platform.h"
 
-// We need one thread for the CPU usage (workaround) and
-// for some reason, running all those vcgencmd's on rpi for figuring out the current clock
-// speed can also block for a significant amount of time (significant enough that it is a bad idea
-// to call them from the "main" telemetry thread.
-// This class decouples these data generation steps from the main telemetry thread. We do not care
+// Samples the onboard computer status (CPU usage, temperature, clocks, RAM, free space, ina219 power) on one low priority
+// thread at a fixed interval and decouples that from the main telemetry thread. We do not care
 // about latency at all on these statistics, so we can easily do those stats using a
-// producer / consumer pattern
+// producer / consumer pattern.
+// The CPU usage is the delta of /proc/stat in between 2 samples (e.g. the average over the last interval).
 class OnboardComputerStatusProvider {
  public:
-  explicit OnboardComputerStatusProvider(OHDPlatform platform);
+  /**
+   * @param sample_interval how often the values are updated (see MIN_SAMPLE_INTERVAL).
+   * 0 - no sampling thread, the values are only updated on sample_once() (for testing)
+   * @param root root of the filesystem procfs / sysfs are read from, for testing
+   */
+  explicit OnboardComputerStatusProvider(OHDPlatform platform,
+                                         std::chrono::milliseconds sample_interval=std::chrono::seconds(1),
+                                         std::string root="");
   ~OnboardComputerStatusProvider();
+  // Sampling more often only costs CPU, and the CPU usage of a very short interval is meaningless
+  static constexpr auto MIN_SAMPLE_INTERVAL=std::chrono::milliseconds(100);
+  // Called by the sampling thread each interval. Only call it manually without a sampling thread (sample_interval 0)
+  void sample_once();
   // Thread-safe, should never block for a significant amount of time
   mavlink_onboard_computer_status_t get_current_status();
   // utility for OHDMainComponent,also thread-safe
   std::vector<MavlinkMessage> get_current_status_as_mavlink_message(uint8_t sys_id,uint8_t comp_id);
  private:
   const OHDPlatform m_platform;
+  const std::chrono::milliseconds m_sample_interval;
+  const std::string m_root;
   std::mutex m_curr_onboard_computer_status_mutex;
   mavlink_onboard_computer_status_t m_curr_onboard_computer_status{};
   // Power monitoring via ina219. Optional, not hot swappable, if there is no ina219, a warning is logged once and then no values are read anymore
   INA219 m_ina_219;
   bool m_ina219_warning_logged= false;
-  // One thread for calculating the CPU usage
-  std::unique_ptr<std::thread> m_calculate_cpu_usage_thread;
-  std::unique_ptr<std::thread> m_calculate_other_thread;
-  bool terminate= false;
-  // Note: we need to run this in its own thread, such that "top" can do its magic over a longer duration
-  void calculate_cpu_usage_until_terminate();
-  // Extra thread for "the rest"
-  void calculate_other_until_terminate();
+  // Only on rpi, for the clocks that are not exposed via sysfs
+  std::unique_ptr<OnboardComputerStatus::rpi::VCMailbox> m_opt_vc_mailbox;
+  std::optional<OnboardComputerStatus::CpuTimes> m_last_cpu_times;
+  std::unique_ptr<std::thread> m_thread;
+  std::mutex m_terminate_mutex;
+  std::condition_variable m_terminate_cv;
+  bool m_terminate= false;
+  void loop();
   void ina219_log_warning_once();
 };
 
@@ -203,30 +203,22 @@ struct MTarget{
     return sys_id!=0;
   }
 };
+// Works for all message types that have a target_system / target_component field, using the offsets from the
+// generated message metadata (no decode of the message needed).
 static MTarget get_target_from_message_if_available(const mavlink_message_t& msg){
-  //if(msg.incompat_flags)
-  if(msg.msgid==MAVLINK_MSG_ID_COMMAND_LONG){
-    mavlink_command_long_t command;
-    mavlink_msg_command_long_decode(&msg,&command);
-    return {command.target_system,command.target_component};
+  const mavlink_msg_entry_t* entry=mavlink_get_msg_entry(msg.msgid);
+  if(entry==nullptr || !(entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM)){
+    // 0 == broadcast
+    return {0,0};
   }
-  if(msg.msgid==MAVLINK_MSG_ID_PARAM_EXT_SET){
-    mavlink_param_ext_set_t tmp;
-    mavlink_msg_param_ext_set_decode(&msg,&tmp);
-    return {tmp.target_system,tmp.target_component};
+  // NOTE: the payload is zero-filled up to max_msg_len by the parser, so a trimmed (v2) target field reads as 0
+  const auto* payload=reinterpret_cast<const uint8_t*>(msg.payload64);
+  const uint16_t target_sys_id=payload[entry->target_system_ofs];
+  uint16_t target_comp_id=0;
+  if(entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT){
+    target_comp_id=payload[entry->target_component_ofs];
   }
-  if(msg.msgid==MAVLINK_MSG_ID_PARAM_EXT_REQUEST_READ){
-    mavlink_param_ext_request_read_t tmp;
-    mavlink_msg_param_ext_request_read_decode(&msg,&tmp);
-    return {tmp.target_system,tmp.target_component};
-  }
-  if(msg.msgid==MAVLINK_MSG_ID_PARAM_EXT_REQUEST_LIST){
-    mavlink_param_ext_request_list_t tmp;
-    mavlink_msg_param_ext_request_list_decode(&msg,&tmp);
-    return {tmp.target_system,tmp.target_component};
-  }
-  // 0 == broadcast
-  return {0,0};
+  return {target_sys_id,target_comp_id};
 }
 
 // The optimization we want to achieve is to "consume" messages with a given target sys and comp id
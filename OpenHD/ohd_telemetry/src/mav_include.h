@@ -10,9 +10,14 @@ extern "C" {
 #include <openhd/mavlink.h>
 }
 
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <vector>
 #include <functional>
 #include <chrono>
+#include <sstream>
+#include <string>
 
 // OpenHD mavlink sys IDs
 // Any mavlink message generated by openhd on the ground unit uses this sys id
@@ -29,53 +34,123 @@ static constexpr auto OHD_SYS_ID_FC=1;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_OUT = 14550;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_IN = 14551;
 
+// Counters for the (hot) mavlink -> raw bytes path, see MavlinkMessage / pack_messages_into
+// Only used for statistics - relaxed increments, no ordering with anything else
+struct MavlinkPackStats{
+  std::atomic<uint64_t> n_messages_packed{0};
+  std::atomic<uint64_t> n_bytes_copied{0};
+  // heap allocations done by the pack functions themselves
+  std::atomic<uint64_t> n_allocations{0};
+  [[nodiscard]] std::string to_string()const{
+    const uint64_t n_messages=n_messages_packed;
+    const double n_allocations_per_message=n_messages==0 ? 0 : static_cast<double>(n_allocations)/static_cast<double>(n_messages);
+    const double n_bytes_copied_per_message=n_messages==0 ? 0 : static_cast<double>(n_bytes_copied)/static_cast<double>(n_messages);
+    std::stringstream ss;
+    ss<<"MavlinkPackStats{messages:"<<n_messages<<" bytes copied/msg:"<<n_bytes_copied_per_message
+       <<" allocations/msg:"<<n_allocations_per_message<<"}";
+    return ss.str();
+  }
+  void reset(){
+    n_messages_packed=0;
+    n_bytes_copied=0;
+    n_allocations=0;
+  }
+};
+// One instance for the whole process (inline, not static - every translation unit sees the same counters)
+inline MavlinkPackStats& get_mavlink_pack_stats(){
+  static MavlinkPackStats stats{};
+  return stats;
+}
+
 struct MavlinkMessage {
   mavlink_message_t m{};
+  /**
+   * The n of bytes pack() / pack_into() will write, computed from the header only.
+   * Same as mavlink_msg_to_send_buffer - v2 payloads are sent with trailing zeroes trimmed (at least 1 byte),
+   * v1 payloads as they are.
+   */
+  [[nodiscard]] int get_packed_size()const{
+    if(m.magic==MAVLINK_STX_MAVLINK1){
+      return MAVLINK_CORE_HEADER_MAVLINK1_LEN+1+m.len+MAVLINK_NUM_CHECKSUM_BYTES;
+    }
+    const auto* payload=reinterpret_cast<const uint8_t*>(m.payload64);
+    int payload_len=m.len;
+    while(payload_len>1 && payload[payload_len-1]==0){
+      payload_len--;
+    }
+    const int signature_len=(m.incompat_flags & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0;
+    return MAVLINK_CORE_HEADER_LEN+1+payload_len+MAVLINK_NUM_CHECKSUM_BYTES+signature_len;
+  }
+  /**
+   * Serialize directly into the given buffer, which must have at least get_packed_size()
+   * (or MAVLINK_MAX_PACKET_LEN to be safe) bytes left. Returns the n of bytes written.
+   */
+  int pack_into(uint8_t* buf)const{
+    const int size=mavlink_msg_to_send_buffer(buf, &m);
+    auto& stats=get_mavlink_pack_stats();
+    stats.n_messages_packed.fetch_add(1,std::memory_order_relaxed);
+    stats.n_bytes_copied.fetch_add(size,std::memory_order_relaxed);
+    return size;
+  }
+  // Allocates - prefer pack_into / pack_messages_into on hot paths
   [[nodiscard]] std::vector<uint8_t> pack() const {
 	std::vector<uint8_t> buf(MAVLINK_MAX_PACKET_LEN);
-	auto size = mavlink_msg_to_send_buffer(buf.data(), &m);
+	auto size = pack_into(buf.data());
 	buf.resize(size);
+	get_mavlink_pack_stats().n_allocations.fetch_add(1,std::memory_order_relaxed);
 	return buf;
   }
 };
 
 // It is more efficient to aggregate / keep mavlink messages in chunks instead of using a wb packet for each of them.
-static std::vector<std::vector<uint8_t>> pack_messages(const std::vector<MavlinkMessage>& messages,uint32_t max_mtu=1024){
-  std::vector<std::vector<uint8_t>> ret;
-  /*for(const auto& msg:messages){
-    ret.emplace_back(msg.pack());
-  }
-  return ret;*/
-  std::vector<uint8_t> buff{};
-  buff.reserve(max_mtu);
+static constexpr uint32_t MAVLINK_PACK_MAX_MTU=1024;
+
+/**
+ * Serializes the messages in one pass, back to back into chunks of up to max_mtu bytes
+ * (a message bigger than max_mtu gets its own chunk). Each frame is written exactly once, directly
+ * into a stack buffer - no heap allocation.
+ * on_chunk(const uint8_t* data,int data_len) is called for each chunk in order, the data is only valid for
+ * the duration of the callback.
+ */
+template<class ON_CHUNK>
+static void pack_messages_into(const std::vector<MavlinkMessage>& messages,ON_CHUNK on_chunk,uint32_t max_mtu=MAVLINK_PACK_MAX_MTU){
+  assert(max_mtu<=MAVLINK_PACK_MAX_MTU);
+  std::array<uint8_t,MAVLINK_PACK_MAX_MTU+MAVLINK_MAX_PACKET_LEN> buff;
+  int buff_len=0;
   for(const auto& msg:messages){
-    auto data=msg.pack();
-    if(buff.size()+data.size()<=max_mtu){
-      buff.insert(buff.end(), data.begin(), data.end());
-    }else{
-      if(!buff.empty()){
-        ret.push_back(buff);
-        buff.resize(0);
-      }
-      buff.insert(buff.end(), data.begin(), data.end());
+    if(buff_len>0 && buff_len+msg.get_packed_size()>static_cast<int>(max_mtu)){
+      on_chunk(buff.data(),buff_len);
+      buff_len=0;
     }
+    buff_len+=msg.pack_into(buff.data()+buff_len);
   }
-  if(!buff.empty()){
-    ret.push_back(buff);
+  if(buff_len>0){
+    on_chunk(buff.data(),buff_len);
   }
+}
+
+// Same chunks as pack_messages_into, but as owned buffers (one allocation per chunk).
+static std::vector<std::vector<uint8_t>> pack_messages(const std::vector<MavlinkMessage>& messages,uint32_t max_mtu=MAVLINK_PACK_MAX_MTU){
+  std::vector<std::vector<uint8_t>> ret;
+  pack_messages_into(messages,[&ret](const uint8_t* data,int data_len){
+    ret.emplace_back(data,data+data_len);
+    get_mavlink_pack_stats().n_allocations.fetch_add(1,std::memory_order_relaxed);
+  },max_mtu);
   return ret;
 }
 
+// The n of bytes the messages take on the wire, without packing them
 static int get_size(const std::vector<MavlinkMessage>& messages){
   int ret=0;
   for(const auto& message:messages){
-    ret+=message.pack().size();
+    ret+=message.get_packed_size();
   }
   return ret;
 }
 
 // For registering a callback that is called every time component X receives one or more mavlink messages
-typedef std::function<void(const std::vector<MavlinkMessage> messages)> MAV_MSG_CALLBACK;
+// The messages are only valid for the duration of the callback
+typedef std::function<void(const std::vector<MavlinkMessage>& messages)> MAV_MSG_CALLBACK;
 
 static int64_t get_time_microseconds(){
   const auto time=std::chrono::steady_clock::now().time_since_epoch();
@@ -4,13 +4,17 @@
 
 #include "XMavlinkParamProvider.h"
 
+#include "openhd_util.h"
 
-XMavlinkParamProvider::XMavlinkParamProvider(uint8_t sys_id, uint8_t comp_id,bool create_heartbeats):
-	MavlinkComponent(sys_id,comp_id),_create_heartbeats(create_heartbeats){
+
+XMavlinkParamProvider::XMavlinkParamProvider(uint8_t sys_id, uint8_t comp_id,bool create_heartbeats,std::shared_ptr<mavsdk::Time> time):
+	MavlinkComponent(sys_id,comp_id),_create_heartbeats(create_heartbeats),
+	_time(time ? std::move(time) : std::make_shared<mavsdk::Time>()){
   _sender=std::make_shared<mavsdk::SenderWrapper>(*this);
   _mavlink_message_handler=std::make_shared<mavsdk::MavlinkMessageHandler>();
   _mavlink_parameter_receiver=
-	  std::make_shared<mavsdk::MavlinkParameterReceiver>(*_sender,*_mavlink_message_handler);
+	  std::make_shared<mavsdk::MavlinkParameterReceiver>(*_sender,*_mavlink_message_handler,
+          mavsdk::MavlinkParameterReceiver::DEFAULT_BROADCAST_BYTES_PER_SECOND,_time);
 }
 
 void XMavlinkParamProvider::add_param(const openhd::Setting& setting) {
@@ -43,16 +47,22 @@ void XMavlinkParamProvider::set_ready() {
 
 std::vector<MavlinkMessage> XMavlinkParamProvider:: process_mavlink_messages(std::vector<MavlinkMessage> messages){
   std::lock_guard<std::mutex> lock(_mutex);
+  bool any_param_message=false;
   for(const auto& msg:messages){
+    if(msg.m.msgid==MAVLINK_MSG_ID_HEARTBEAT){
+      if(mavlink_msg_heartbeat_get_type(&msg.m)==MAV_TYPE_GCS && on_gcs_heartbeat(msg.m.sysid)){
+        any_param_message=true;
+      }
+      continue;
+    }
+    // The router only hands out the messages the handler(s) are registered for
     _mavlink_message_handler->process_message(msg.m);
+    any_param_message=true;
   }
-  for(int i=0;i<100;i++){
-    _mavlink_parameter_receiver->do_work();
+  if(!any_param_message){
+    return {};
   }
-  auto msges=_sender->messages;
-  //std::cout<<"XMavlinkParamProvider::process_mavlink_message:"<<msges.size()<<"\n";
-  _sender->messages.clear();
-  return msges;
+  return do_work_and_take_messages();
 }
 
 std::vector<MavlinkMessage> XMavlinkParamProvider::generate_mavlink_messages() {
@@ -60,6 +70,56 @@ std::vector<MavlinkMessage> XMavlinkParamProvider::generate_mavlink_messages() {
   if(_create_heartbeats){
 	ret.push_back(MavlinkComponent::create_heartbeat());
   }
+  // A (long) param list request is paced, the rest is sent here
+  std::lock_guard<std::mutex> lock(_mutex);
+  OHDUtil::vec_append(ret,do_work_and_take_messages());
+  return ret;
+}
+
+std::vector<MavlinkMessage> XMavlinkParamProvider::do_work_and_take_messages() {
+  if(!_mavlink_parameter_receiver->has_pending_work()){
+    return {};
+  }
+  _mavlink_parameter_receiver->do_work();
+  std::vector<MavlinkMessage> ret;
+  std::swap(ret,_sender->messages);
+  return ret;
+}
+
+std::vector<uint32_t> XMavlinkParamProvider::get_subscribed_message_ids() const {
+  // Whatever the MavlinkParameterReceiver registered its handlers for (in its constructor),
+  // and heartbeats to find out when a GCS re-connects
+  auto ret=_mavlink_message_handler->get_registered_message_ids();
+  ret.push_back(MAVLINK_MSG_ID_HEARTBEAT);
   return ret;
 }
 
+uint32_t XMavlinkParamProvider::get_param_set_version() {
+  return _mavlink_parameter_receiver->get_param_set_version();
+}
+
+void XMavlinkParamProvider::broadcast_params_changed_since(uint32_t version,bool extended) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _mavlink_parameter_receiver->broadcast_parameters_changed_since(version,extended);
+}
+
+bool XMavlinkParamProvider::on_gcs_heartbeat(const uint8_t gcs_sys_id) {
+  const auto now=_time->steady_time();
+  const auto curr_version=_mavlink_parameter_receiver->get_param_set_version();
+  auto it=_gcs_connections.find(gcs_sys_id);
+  if(it==_gcs_connections.end()){
+    // First time we see this GCS - it requests the full param list itself
+    _gcs_connections[gcs_sys_id]=GcsConnection{now,curr_version};
+    return false;
+  }
+  auto& connection=it->second;
+  bool broadcast=false;
+  if(now-connection.last_heartbeat>GCS_RECONNECT_TIMEOUT && connection.param_set_version!=curr_version){
+    // Changed (e.g. by another GCS) while it was gone, it still has the rest
+    _mavlink_parameter_receiver->broadcast_parameters_changed_since(connection.param_set_version,false);
+    broadcast=true;
+  }
+  connection.last_heartbeat=now;
+  connection.param_set_version=curr_version;
+  return broadcast;
+}
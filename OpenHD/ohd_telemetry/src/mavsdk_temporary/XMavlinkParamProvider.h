@@ -5,6 +5,8 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_MAV_PARAM_XMAVLINKPARAMPROVIDER_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_MAV_PARAM_XMAVLINKPARAMPROVIDER_H_
 
+#include <chrono>
+#include <map>
 #include <memory>
 #include <utility>
 
@@ -20,7 +22,9 @@ class XMavlinkParamProvider :public MavlinkComponent{
  public:
   // !!!! Note : no params are active until set_ready() is called
   // This way, there is no parameter invariance, but it is easy to forget to call set_read() !!!
-  explicit XMavlinkParamProvider(uint8_t sys_id,uint8_t comp_id,bool create_heartbeats=false);
+  // @param time see MavlinkParameterReceiver, only for testing
+  explicit XMavlinkParamProvider(uint8_t sys_id,uint8_t comp_id,bool create_heartbeats=false,
+                                 std::shared_ptr<mavsdk::Time> time=nullptr);
   void add_param(const openhd::Setting& setting);
   // only usable when manually_set_ready is true
   void add_params(const std::vector<openhd::Setting>& settings);
@@ -29,14 +33,35 @@ class XMavlinkParamProvider :public MavlinkComponent{
   std::vector<MavlinkMessage> process_mavlink_messages(std::vector<MavlinkMessage> messages)override;
   // override from component
   std::vector<MavlinkMessage> generate_mavlink_messages() override;
+  // override from component
+  [[nodiscard]] std::vector<uint32_t> get_subscribed_message_ids()const override;
+  // See MavlinkParameterReceiver - instead of a full param list download, a (re-connecting) client that still has
+  // all the params up to a version only needs the ones changed since then. They are sent via generate_mavlink_messages().
+  // Done automatically for a GCS whose heartbeat re-appears after GCS_RECONNECT_TIMEOUT (see on_gcs_heartbeat).
+  uint32_t get_param_set_version();
+  void broadcast_params_changed_since(uint32_t version,bool extended=false);
+  // A GCS that didn't send a heartbeat for this long is considered disconnected
+  static constexpr auto GCS_RECONNECT_TIMEOUT=std::chrono::seconds(5);
  private:
   // mavsdk
   std::shared_ptr<mavsdk::SenderWrapper> _sender;
   std::shared_ptr<mavsdk::MavlinkMessageHandler> _mavlink_message_handler;
   std::shared_ptr<mavsdk::MavlinkParameterReceiver> _mavlink_parameter_receiver;
+  // Needs _mutex. Only does something if the receiver has pending responses.
+  std::vector<MavlinkMessage> do_work_and_take_messages();
+  // Needs _mutex. Returns true if the GCS re-connected and the params it missed are broadcast.
+  bool on_gcs_heartbeat(uint8_t gcs_sys_id);
  private:
   std::mutex _mutex{};
   const bool _create_heartbeats;
+  std::shared_ptr<mavsdk::Time> _time;
+  struct GcsConnection{
+    mavsdk::dl_time_t last_heartbeat;
+    // The GCS got all the params up to this version (changes while it is connected are broadcast / acked)
+    uint32_t param_set_version;
+  };
+  // by sys id of the GCS, needs _mutex
+  std::map<uint8_t,GcsConnection> _gcs_connections;
 };
 
 #endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_MAV_PARAM_XMAVLINKPARAMPROVIDER_H_
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <mutex>
 #include "mavlink_message_handler.h"
 
@@ -52,6 +53,19 @@ void MavlinkMessageHandler::unregister_all(const void* cookie)
     }
 }
 
+std::vector<uint32_t> MavlinkMessageHandler::get_registered_message_ids()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<uint32_t> ret;
+    for (const auto& entry : _table) {
+        if (std::find(ret.begin(), ret.end(), entry.msg_id) == ret.end()) {
+            ret.push_back(entry.msg_id);
+        }
+    }
+    return ret;
+}
+
 void MavlinkMessageHandler::process_message(const mavlink_message_t& message)
 {
     std::lock_guard<std::mutex> lock(_mutex);
@@ -30,6 +30,8 @@ public:
     void unregister_all(const void* cookie);
     void process_message(const mavlink_message_t& message);
     void update_component_id(uint16_t msg_id, uint8_t cmp_id, const void* cookie);
+    // All the message ids at least one callback is registered for
+    std::vector<uint32_t> get_registered_message_ids();
 
 private:
     std::mutex _mutex{};
@@ -1,13 +1,21 @@
 #include "mavlink_parameter_receiver.h"
+#include <algorithm>
 #include <cassert>
 
 namespace mavsdk {
 
 MavlinkParameterReceiver::MavlinkParameterReceiver(
     Sender& sender,
-    MavlinkMessageHandler& message_handler) :
+    MavlinkMessageHandler& message_handler,
+    int broadcast_bytes_per_second,
+    std::shared_ptr<Time> time) :
     _sender(sender),
-    _message_handler(message_handler)
+    _message_handler(message_handler),
+    _broadcast_bytes_per_second(broadcast_bytes_per_second),
+    // start with a full bucket
+    _broadcast_tokens(broadcast_bytes_per_second/2.0),
+    _time(time ? std::move(time) : std::make_shared<Time>()),
+    _broadcast_last_refill(_time->steady_time())
 {
     // Populate the parameter set before the first communication, if provided by the user.
     /*if(optional_param_values.has_value()){
@@ -79,14 +87,13 @@ MavlinkParameterReceiver::provide_server_param(const std::string &name,const T &
 	  return Result::ParamValueTooLong;
 	}
   }
-  auto tmp=[param_value,change_callback](std::string id,ParamValue changed_value){
-	assert(changed_value.is_same_type(param_value));
-	if(change_callback== nullptr){
-	  return true;
-	}
-	const T changed_value_typed=changed_value.get<T>();
-	return change_callback(id,changed_value_typed);
-  };
+  // The set only calls this with a value of the same type
+  MavlinkParameterSet::ChangeCallback tmp=nullptr;
+  if(change_callback){
+	tmp=[change_callback](const std::string& id,const ParamValue& changed_value){
+	  return change_callback(id,changed_value.get<T>());
+	};
+  }
   // Param set makes sure we cannot add the same parameter more than once and keeps the type safe
   if(_param_set.add_new_parameter(name,param_value,tmp)){
 	return Result::Success;
@@ -351,34 +358,83 @@ void MavlinkParameterReceiver::process_param_ext_request_list(const mavlink_mess
 
 void MavlinkParameterReceiver::broadcast_all_parameters(const bool extended) {
     std::lock_guard<std::mutex> lock(_all_params_mutex);
-    const auto elapsed=std::chrono::steady_clock::now()-m_last_broadcast_all_request;
+    const auto elapsed=_time->steady_time()-m_last_broadcast_all_request;
     if(elapsed<std::chrono::seconds(1)){
       return;
     }
-    m_last_broadcast_all_request=std::chrono::steady_clock::now();
+    m_last_broadcast_all_request=_time->steady_time();
     const auto all_params= _param_set.list_all_parameters(extended);
     LogDebug() << "broadcast_all_parameters "<<(extended ? "Ext" : "")<<": " << all_params.size();
-    for(const auto& parameter:all_params){
-        LogDebug() << "sending param:"<<parameter;
+    // A new request list restarts the broadcast instead of sending (some of) the parameters twice
+    enqueue_broadcast(all_params,extended,true);
+}
+
+void MavlinkParameterReceiver::broadcast_parameters_changed_since(const uint32_t version,const bool extended) {
+    std::lock_guard<std::mutex> lock(_all_params_mutex);
+    const auto changed_params=_param_set.list_parameters_changed_since(version,extended);
+    LogDebug() << "broadcast_parameters_changed_since "<<version<<(extended ? " Ext" : "")<<": " << changed_params.size();
+    enqueue_broadcast(changed_params,extended,false);
+}
+
+uint32_t MavlinkParameterReceiver::get_param_set_version()
+{
+    return _param_set.get_version();
+}
+
+void MavlinkParameterReceiver::enqueue_broadcast(const std::vector<MavlinkParameterSet::Parameter>& params,const bool extended,
+                                                 const bool clear_queue) {
+    const auto param_count=_param_set.get_current_parameters_count(extended);
+    LockedQueue<WorkItem>::Guard broadcast_queue_guard(_broadcast_queue);
+    if(clear_queue){
+        while (broadcast_queue_guard.get_front()) {
+            broadcast_queue_guard.pop_front();
+        }
+    }
+    for(const auto& parameter:params){
         auto new_work = std::make_shared<WorkItem>(parameter.param_id,parameter.value,
-            WorkItemValue{parameter.param_index,static_cast<uint16_t>(all_params.size()),extended});
-        _work_queue.push_back(new_work);
+            WorkItemValue{parameter.param_index,param_count,extended});
+        broadcast_queue_guard.push_back(new_work);
     }
 }
 
 void MavlinkParameterReceiver::do_work()
 {
-    LockedQueue<WorkItem>::Guard work_queue_guard(_work_queue);
-    auto work = work_queue_guard.get_front();
-    if (!work) {
-        return;
+    {
+        LockedQueue<WorkItem>::Guard work_queue_guard(_work_queue);
+        while (auto work = work_queue_guard.get_front()) {
+            send_work_item(*work);
+            work_queue_guard.pop_front();
+        }
     }
-    const auto param_id_message_buffer=MavlinkParameterSet::param_id_to_message_buffer(work->param_id);
+    const auto now=_time->steady_time();
+    const double elapsed_s=std::chrono::duration<double>(now-_broadcast_last_refill).count();
+    _broadcast_last_refill=now;
+    // At most half a second worth of burst
+    _broadcast_tokens=std::min(_broadcast_bytes_per_second/2.0,_broadcast_tokens+elapsed_s*_broadcast_bytes_per_second);
+    LockedQueue<WorkItem>::Guard broadcast_queue_guard(_broadcast_queue);
+    while (_broadcast_tokens>0) {
+        auto work = broadcast_queue_guard.get_front();
+        if (!work) {
+            break;
+        }
+        _broadcast_tokens-=send_work_item(*work);
+        broadcast_queue_guard.pop_front();
+    }
+}
+
+bool MavlinkParameterReceiver::has_pending_work()
+{
+    return _work_queue.size()>0 || _broadcast_queue.size()>0;
+}
+
+int MavlinkParameterReceiver::send_work_item(const WorkItem& work)
+{
+    const auto param_id_message_buffer=MavlinkParameterSet::param_id_to_message_buffer(work.param_id);
     mavlink_message_t mavlink_message;
-    if(std::holds_alternative<WorkItemValue>(work->work_item_variant)){
-        const auto& specific=std::get<WorkItemValue>(work->work_item_variant);
+    if(std::holds_alternative<WorkItemValue>(work.work_item_variant)){
+        const auto& specific=std::get<WorkItemValue>(work.work_item_variant);
         if (specific.extended) {
-            const auto buf = work->param_value.get_128_bytes();
+            const auto buf = work.param_value.get_128_bytes();
             //mavlink_msg_param_ext_value_encode()
             mavlink_msg_param_ext_value_pack(
                 _sender.get_own_system_id(),
@@ -386,15 +442,15 @@ void MavlinkParameterReceiver::do_work()
                 &mavlink_message,
                 param_id_message_buffer.data(),
                 buf.data(),
-                work->param_value.get_mav_param_ext_type(),
+                work.param_value.get_mav_param_ext_type(),
                 specific.param_count,
                 specific.param_index);
         } else {
             float param_value;
             if (_sender.autopilot() == Sender::Autopilot::ArduPilot) {
-                param_value = work->param_value.get_4_float_bytes_cast();
+                param_value = work.param_value.get_4_float_bytes_cast();
             } else {
-                param_value = work->param_value.get_4_float_bytes_bytewise();
+                param_value = work.param_value.get_4_float_bytes_bytewise();
             }
             mavlink_msg_param_value_pack(
                 _sender.get_own_system_id(),
@@ -402,34 +458,28 @@ void MavlinkParameterReceiver::do_work()
                 &mavlink_message,
                 param_id_message_buffer.data(),
                 param_value,
-                work->param_value.get_mav_param_type(),
+                work.param_value.get_mav_param_type(),
                 specific.param_count,
                 specific.param_index);
         }
-        if (!_sender.send_message(mavlink_message)) {
-            LogErr() << "Error: Send message failed";
-            work_queue_guard.pop_front();
-            return;
-        }
-        work_queue_guard.pop_front();
     }else{
-        const auto& specific=std::get<WorkItemAck>(work->work_item_variant);
-        auto buf = work->param_value.get_128_bytes();
+        const auto& specific=std::get<WorkItemAck>(work.work_item_variant);
+        auto buf = work.param_value.get_128_bytes();
         mavlink_msg_param_ext_ack_pack(
             _sender.get_own_system_id(),
             _sender.get_own_component_id(),
             &mavlink_message,
             param_id_message_buffer.data(),
             buf.data(),
-            work->param_value.get_mav_param_ext_type(),
+            work.param_value.get_mav_param_ext_type(),
             specific.param_ack);
-        if (!_sender.send_message(mavlink_message)) {
-            LogErr() << "Error: Send message failed";
-            work_queue_guard.pop_front();
-            return;
-        }
-        work_queue_guard.pop_front();
     }
+    if (!_sender.send_message(mavlink_message)) {
+        LogErr() << "Error: Send message failed";
+        return 0;
+    }
+    // The pack functions already trimmed the payload (v2)
+    return MAVLINK_CORE_HEADER_LEN+1+mavlink_message.len+MAVLINK_NUM_CHECKSUM_BYTES;
 }
 
 std::ostream& operator<<(std::ostream& str, const MavlinkParameterReceiver::Result& result)
@@ -501,9 +551,17 @@ MavlinkParameterReceiver::update_existing_server_param(const std::string& name,
     std::lock_guard<std::mutex> lock(_all_params_mutex);
     ParamValue param_value;
     param_value.set(value);
+    const auto version_before=_param_set.get_version();
     auto res= _param_set.update_existing_parameter(name,param_value);
-    if(res==MavlinkParameterSet::UpdateExistingParamResult::SUCCESS)return MavlinkParameterReceiver::Result::Success;
-    return MavlinkParameterReceiver::Result::NotFound;
+    if(res!=MavlinkParameterSet::UpdateExistingParamResult::SUCCESS)return MavlinkParameterReceiver::Result::NotFound;
+    // Changed by us and not by a client - let the client(s) know (like a param set, the change is broadcast).
+    // Only the changed parameter is sent, not the whole set.
+    for(const auto& parameter:_param_set.list_parameters_changed_since(version_before,false)){
+        auto new_work = std::make_shared<WorkItem>(parameter.param_id,parameter.value,
+            WorkItemValue{parameter.param_index,_param_set.get_current_parameters_count(false),false});
+        _work_queue.push_back(new_work);
+    }
+    return MavlinkParameterReceiver::Result::Success;
 }
 
 } // namespace mavsdk
\ No newline at end of file
@@ -6,8 +6,11 @@
 #include "locked_queue.h"
 #include "mavlink_parameter_subscription.h"
 #include "mavlink_parameter_set.h"
+#include "mavsdk_time.h"
 
+#include <chrono>
 #include <map>
+#include <memory>
 #include <string>
 #include <list>
 #include <utility>
@@ -33,9 +36,15 @@ namespace mavsdk {
 class MavlinkParameterReceiver{
 public:
     MavlinkParameterReceiver() = delete;
+    // Responses to a "request list" are paced to this budget by default, such that a param list download doesn't
+    // saturate a low bandwidth link (each param value is only 30..60 bytes, but there are many of them).
+    static constexpr int DEFAULT_BROADCAST_BYTES_PER_SECOND=8000;
     explicit MavlinkParameterReceiver(
         Sender& parent,
-        MavlinkMessageHandler& message_handler);//,
+        MavlinkMessageHandler& message_handler,
+        int broadcast_bytes_per_second=DEFAULT_BROADCAST_BYTES_PER_SECOND,
+        // The pacing and the request list throttle use this time source (e.g. FakeTime in the tests), steady clock if not set
+        std::shared_ptr<Time> time=nullptr);//,
         // by providing all the parameters on construction you can populate the parameter set
         // before the server starts reacting to clients, removing this issue:
         // https://mavlink.io/en/services/parameter.html#parameters_invariant
@@ -98,7 +107,23 @@ public:
     std::pair<Result, int32_t> retrieve_server_param_int(const std::string& name);
     std::pair<Result, std::string> retrieve_server_param_custom(const std::string& name);
 
+    /**
+     * Sends the pending responses - all responses to read / set requests, and as many responses to a
+     * "request list" as the broadcast budget allows for (the rest is sent on the next call(s)).
+     * Cheap if there is nothing to do.
+     */
     void do_work();
+    // true if there are responses left to send
+    [[nodiscard]] bool has_pending_work();
+
+    /**
+     * The version of the parameter set, increases each time a parameter is added or changed.
+     * A client that remembers the version when it last had all the parameters (e.g. a GCS that reconnects)
+     * only needs the ones changed since then, see broadcast_parameters_changed_since.
+     */
+    uint32_t get_param_set_version();
+    // Broadcasts (paced, like a request list) all the parameters that were added / changed after the given version.
+    void broadcast_parameters_changed_since(uint32_t version,bool extended);
 
     friend std::ostream& operator<<(std::ostream&, const Result&);
 
@@ -143,6 +168,8 @@ private:
     void process_param_ext_request_list(const mavlink_message_t& message);
     // broadcast all current parameters. If extended=false, string parameters are ignored.
     void broadcast_all_parameters(bool extended);
+    // Adds the given parameters to _broadcast_queue, optionally replacing what is already queued
+    void enqueue_broadcast(const std::vector<MavlinkParameterSet::Parameter>& params,bool extended,bool clear_queue);
 
     // These are specific depending on the work item type.
     // note that ack needs fewer arguments.
@@ -169,7 +196,17 @@ private:
             param_id(std::move(param_id1)),param_value(std::move(param_value1)),work_item_variant(std::move(work_item_variant1)){
         };
     };
+    // Responses to read / set requests, sent as soon as possible
     LockedQueue<WorkItem> _work_queue{};
+    // Responses to a request list, paced to the broadcast budget
+    LockedQueue<WorkItem> _broadcast_queue{};
+    // Sends the response, returns the n of bytes (on the wire) or 0 on failure
+    int send_work_item(const WorkItem& work);
+    // Token bucket for _broadcast_queue, only touched in do_work()
+    const double _broadcast_bytes_per_second;
+    double _broadcast_tokens;
+    std::shared_ptr<Time> _time;
+    dl_time_t _broadcast_last_refill;
     /**
      * See: https://mavlink.io/en/services/parameter.html#multi-system-and-multi-component-support
      * @return true if the message should be processed by this server, false otherwise.
@@ -189,7 +226,7 @@ private:
 	const bool enable_log_target_mismatch=false;
     // not following the mavlink standard
     // have a minimum delay in between "broadcast all param(s)" requests
-    std::chrono::steady_clock::time_point m_last_broadcast_all_request=std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point m_last_broadcast_all_request{};
 };
 
 } // namespace mavsdk
\ No newline at end of file
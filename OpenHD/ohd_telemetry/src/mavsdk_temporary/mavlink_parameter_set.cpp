@@ -1,10 +1,11 @@
 #include "mavlink_parameter_set.h"
 
+#include <algorithm>
 #include <utility>
 
 namespace mavsdk {
 
-bool MavlinkParameterSet::add_new_parameter(const std::string& param_id, ParamValue value,std::function<bool(std::string id,ParamValue requested_value)> change_callback)
+bool MavlinkParameterSet::add_new_parameter(const std::string& param_id, ParamValue value,ChangeCallback change_callback)
 {
     std::lock_guard<std::mutex> lock(_all_params_mutex);
     if(!validate_param_id(param_id)){
@@ -13,7 +14,11 @@ bool MavlinkParameterSet::add_new_parameter(const std::string& param_id, ParamVa
         }
         return false;
     }
-    if(_param_id_to_idx.find(param_id) != _param_id_to_idx.end()) {
+    const auto key=param_id_to_message_buffer(param_id);
+    const auto it=std::lower_bound(_sorted_index.begin(),_sorted_index.end(),key,[](const auto& entry,const ParamIdKey& other){
+        return entry.first<other;
+    });
+    if(it!=_sorted_index.end() && it->first==key) {
         // this parameter does already exist, we cannot add it as a new one.
         return false;
     }
@@ -21,11 +26,12 @@ bool MavlinkParameterSet::add_new_parameter(const std::string& param_id, ParamVa
         // not enough space for this parameter
         return false;
     }
-    InternalParameter parameter{param_id,std::move(value),std::move(change_callback)};
-    _all_params.push_back(parameter);
+    _version++;
+    _sorted_index.insert(it,{key,static_cast<uint16_t>(_all_params.size())});
+    _all_params.push_back(InternalParameter{param_id,std::move(value),std::move(change_callback),_version});
+    const auto& parameter=_all_params.back();
     // just don't think about it.
     _param_index_to_hidden_extended.push_back(param_count_non_extended);
-    _param_id_to_idx[param_id]=static_cast<uint16_t>(_param_id_to_idx.size());
     if(!parameter.value.needs_extended()){
         param_count_non_extended++;
     }
@@ -33,20 +39,40 @@ bool MavlinkParameterSet::add_new_parameter(const std::string& param_id, ParamVa
         LogDebug()<<"Added parameter: "<<parameter;
     }
     assert(_all_params.size()==_param_index_to_hidden_extended.size());
-    assert(_all_params.size()== _param_id_to_idx.size());
+    assert(_all_params.size()== _sorted_index.size());
     return true;
 }
 
+std::optional<uint16_t> MavlinkParameterSet::find_index(const std::string &param_id) const {
+  if(!validate_param_id(param_id)){
+	return {};
+  }
+  const auto key=param_id_to_message_buffer(param_id);
+  const auto it=std::lower_bound(_sorted_index.begin(),_sorted_index.end(),key,[](const auto& entry,const ParamIdKey& other){
+	return entry.first<other;
+  });
+  if(it==_sorted_index.end() || it->first!=key){
+	return {};
+  }
+  return it->second;
+}
+
+MavlinkParameterSet::Parameter MavlinkParameterSet::to_parameter(const uint16_t index,const bool extended) const {
+  const auto& param=_all_params[index];
+  const auto param_index_actual = extended ? index : _param_index_to_hidden_extended[index];
+  return MavlinkParameterSet::Parameter{param.param_id, param_index_actual, param.value, param.version};
+}
+
 MavlinkParameterSet::UpdateExistingParamResult MavlinkParameterSet::update_existing_parameter(const std::string &param_id,
 																							  const ParamValue &value) {
   std::lock_guard<std::mutex> lock(_all_params_mutex);
-  if (_param_id_to_idx.find(param_id) == _param_id_to_idx.end()) {
+  const auto opt_index=find_index(param_id);
+  if (!opt_index.has_value()) {
 	// this parameter does not exist yet.
 	LogDebug() << "MavlinkParameterSet::update_existing_parameter " << param_id << " does not exist";
 	return UpdateExistingParamResult::MISSING_PARAM;
   }
-  const auto index = _param_id_to_idx.at(param_id);
-  const auto parameter = _all_params.at(index);
+  auto& parameter = _all_params[opt_index.value()];
   if (!parameter.value.is_same_type(value)) {
 	// We cannot mutate the parameter type.
 	LogDebug() << "Cannot mutate the type of " << param_id << " from " << parameter.value.typestr() << " to "
@@ -68,20 +94,34 @@ MavlinkParameterSet::UpdateExistingParamResult MavlinkParameterSet::update_exist
 	  return UpdateExistingParamResult::REJECTED;
 	}
   }
-  _all_params.at(index).value.update_value_typesafe(value);
+  parameter.value.update_value_typesafe(value);
+  _version++;
+  parameter.version=_version;
   return UpdateExistingParamResult::SUCCESS;
 }
 
 std::vector<MavlinkParameterSet::Parameter> MavlinkParameterSet::list_all_parameters(const bool supports_extended) {
+  return list_parameters_changed_since(0,supports_extended);
+}
+
+uint32_t MavlinkParameterSet::get_version() {
+  std::lock_guard<std::mutex> lock(_all_params_mutex);
+  return _version;
+}
+
+std::vector<MavlinkParameterSet::Parameter> MavlinkParameterSet::list_parameters_changed_since(const uint32_t version,
+																							   const bool supports_extended) {
   std::lock_guard<std::mutex> lock(_all_params_mutex);
   std::vector<MavlinkParameterSet::Parameter> ret;
-  uint16_t index = 0;
-  for (const auto &param: _all_params) {
-	if (param.value.needs_extended() && !supports_extended) {
+  if(version==0){
+	ret.reserve(supports_extended ? _all_params.size() : param_count_non_extended);
+  }
+  for (size_t i=0;i<_all_params.size();i++) {
+	const auto &param=_all_params[i];
+	if (param.version<=version || (param.value.needs_extended() && !supports_extended)) {
 	  continue;
 	}
-	ret.emplace_back(MavlinkParameterSet::Parameter{param.param_id, index, param.value});
-	index++;
+	ret.push_back(to_parameter(static_cast<uint16_t>(i),supports_extended));
   }
   return ret;
 }
@@ -90,7 +130,7 @@ std::map<std::string, ParamValue> MavlinkParameterSet::create_copy_as_map() {
   std::lock_guard<std::mutex> lock(_all_params_mutex);
   std::map<std::string, ParamValue> ret;
   for (const auto &param: _all_params) {
-	ret[param.param_id] = param.value;
+	ret.emplace_hint(ret.end(),param.param_id,param.value);
   }
   return ret;
 }
@@ -107,18 +147,16 @@ uint16_t MavlinkParameterSet::get_current_parameters_count(bool extended) {
 std::optional<MavlinkParameterSet::Parameter> MavlinkParameterSet::lookup_parameter(const std::string &param_id,
 																					bool extended) {
   std::lock_guard<std::mutex> lock(_all_params_mutex);
-  if (_param_id_to_idx.find(param_id) == _param_id_to_idx.end()) {
+  const auto opt_index=find_index(param_id);
+  if (!opt_index.has_value()) {
 	// param does not exist
 	return {};
   }
-  const auto param_index = _param_id_to_idx.at(param_id);
-  const auto param = _all_params.at(param_index);
-  if (param.value.needs_extended() && !extended) {
+  if (_all_params[opt_index.value()].value.needs_extended() && !extended) {
 	// param exists, but needs extended
 	return {};
   }
-  const auto param_index_actual = extended ? param_index : _param_index_to_hidden_extended.at(param_index);
-  return MavlinkParameterSet::Parameter{param.param_id, param_index_actual, param.value};
+  return to_parameter(opt_index.value(),extended);
 }
 
 std::optional<MavlinkParameterSet::Parameter> MavlinkParameterSet::lookup_parameter(const uint16_t param_index,
@@ -128,13 +166,11 @@ std::optional<MavlinkParameterSet::Parameter> MavlinkParameterSet::lookup_parame
 	// param des not exist
 	return {};
   }
-  const auto param = _all_params.at(param_index);
-  if (param.value.needs_extended() && !extended) {
+  if (_all_params[param_index].value.needs_extended() && !extended) {
 	// param exists, but needs extended
 	return {};
   }
-  const auto param_index_actual = extended ? param_index : _param_index_to_hidden_extended.at(param_index);
-  return MavlinkParameterSet::Parameter{param.param_id, param_index_actual, param.value};
+  return to_parameter(param_index,extended);
 }
 
 std::optional<MavlinkParameterSet::Parameter> MavlinkParameterSet::lookup_parameter(const MavlinkParameterSet::ParamIdentifier &identifier,
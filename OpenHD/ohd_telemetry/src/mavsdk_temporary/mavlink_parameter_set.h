@@ -1,6 +1,7 @@
 #pragma once
 
 #include "param_value.h"
+#include <array>
 #include <map>
 #include <mutex>
 #include <vector>
@@ -15,14 +16,20 @@ namespace mavsdk{
 // This restriction makes sense when viewed from both a mavlink parameter server and client perspective:
 // Changing the type (not value) of a parameter (aka a Setting) most likely was a programming mistake
 // and would easily lead to bugs / crashes.
+// The parameters are stored in one contiguous vector (in the order they were added, which is also their index),
+// looked up by id via a sorted index of the fixed size (16 byte) param ids.
+// Each parameter remembers the version of the set when it was last changed, such that the parameters changed since a given
+// version can be listed without keeping a copy of the whole set around.
 class MavlinkParameterSet{
 public:
+    // called with the param id and the requested value, return false to reject the change.
+    using ChangeCallback=std::function<bool(const std::string& id,const ParamValue& requested_value)>;
     /**
      * add a new parameter to the parameter set, as long as the parameter does not exist yet, there is space available and
      * the param_id is not empty.
      * @return true on success, false otherwise.
      */
-    bool add_new_parameter(const std::string& param_id,ParamValue value,std::function<bool(std::string id,ParamValue requested_value)> change_callback=nullptr);
+    bool add_new_parameter(const std::string& param_id,ParamValue value,ChangeCallback change_callback=nullptr);
     /**
      * Possible return codes for performing a update operation on an existing parameter.
      */
@@ -37,6 +44,7 @@ public:
     /**
      * update the value of an already existing parameter, as long as current and provided type match.
      * Does not add the parameter as a new parameter if missing.
+     * On SUCCESS, the version of the set is increased.
      * @return one of the results above.
      */
     UpdateExistingParamResult update_existing_parameter(const std::string& param_id,const ParamValue& value);
@@ -49,8 +57,17 @@ public:
         const uint16_t param_index;
         // value of this parameter.
         ParamValue value;
+        // version of the set when this parameter was added / last changed
+        uint32_t version=0;
     };
     std::vector<Parameter> list_all_parameters(bool supports_extended);
+    /**
+     * The version of the set, increased with each parameter that is added or changed. Starts at 0 (empty set),
+     * such that list_parameters_changed_since(0,...) is the same as list_all_parameters(...).
+     */
+    [[nodiscard]] uint32_t get_version();
+    // all the parameters added / changed after the given version (ordered by index, not by version)
+    std::vector<Parameter> list_parameters_changed_since(uint32_t version,bool supports_extended);
     std::map<std::string, ParamValue> create_copy_as_map();
     // lookup a parameter using the unique string id
     std::optional<Parameter> lookup_parameter(const std::string& param_id,bool extended);
@@ -86,15 +103,22 @@ private:
         const std::string param_id;
         // value of this parameter.
         ParamValue value;
-	  	std::function<bool(std::string id,ParamValue requested_value)> change_callback;
+        ChangeCallback change_callback;
+        uint32_t version;
     };
     friend std::ostream& operator<<(std::ostream& strm, const MavlinkParameterSet::InternalParameter& obj);
     std::mutex _all_params_mutex{};
     // list of all the parameters added,not checked for extended/non-extended protocol
     std::vector<InternalParameter> _all_params;
-    // if an element exists in this map, since we never remove parameters, it is guaranteed that the returned index is
-    // inside the _all_params range.
-    std::map<std::string,uint16_t> _param_id_to_idx;
+    // The param id as it is sent in the messages (0-padded, not necessarily 0-terminated), compared bytewise.
+    using ParamIdKey=std::array<char,PARAM_ID_LEN>;
+    // sorted by key, for binary search. Since we never remove parameters, it is guaranteed that an index
+    // in here is inside the _all_params range.
+    std::vector<std::pair<ParamIdKey,uint16_t>> _sorted_index;
+    // needs _all_params_mutex
+    [[nodiscard]] std::optional<uint16_t> find_index(const std::string& param_id)const;
+    [[nodiscard]] Parameter to_parameter(uint16_t index,bool extended)const;
+    uint32_t _version=0;
     // This really messed up my brain,but no other way around - we need to be able to convert a parameter index from the
     // extended perspective into the non-extended perspective.
     std::vector<uint16_t> _param_index_to_hidden_extended;
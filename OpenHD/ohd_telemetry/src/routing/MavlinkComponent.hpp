@@ -33,6 +33,14 @@ class MavlinkComponent{
    * This is for fire and forget messages. For example, a component might return the heartbeat(s) here.
    */
   virtual std::vector<MavlinkMessage> generate_mavlink_messages()=0;
+  /**
+   * The message ids this component wants to process, used by the MavlinkRouter to only hand a component
+   * the messages it can do something with (and that are targeted at it / broadcast).
+   * Empty (default) means all messages.
+   */
+  [[nodiscard]] virtual std::vector<uint32_t> get_subscribed_message_ids()const{
+    return {};
+  }
  protected:
   // These are protected, and MUST be called in the implementation(s) process message method if the component
   // supports them. For example, one might not want a component to respond to any ping messages.
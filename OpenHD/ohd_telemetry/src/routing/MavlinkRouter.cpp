@@ -0,0 +1,154 @@
+#include "MavlinkRouter.h"
+
+#include <sstream>
+
+#include "openhd_util.h"
+
+static uint16_t route_key(uint8_t sys_id,uint8_t comp_id){
+  return static_cast<uint16_t>(sys_id)<<8 | comp_id;
+}
+
+MavlinkRouter::MavlinkRouter(const std::string& tag) {
+  m_console=openhd::log::create_or_get(tag);
+  assert(m_console);
+}
+
+void MavlinkRouter::add_component(std::shared_ptr<MavlinkComponent> component) {
+  assert(component);
+  std::lock_guard<std::mutex> guard(m_components_mutex);
+  const size_t index=m_components.size();
+  const auto msg_ids=component->get_subscribed_message_ids();
+  if(msg_ids.empty()){
+    m_components_all_messages.push_back(index);
+  }else{
+    for(const auto msg_id:msg_ids){
+      m_components_by_msg_id[msg_id].push_back(index);
+    }
+  }
+  m_console->debug("Added component {}:{} subscribed to {} message ids",component->m_sys_id,component->m_comp_id,
+                   msg_ids.empty() ? "all" : std::to_string(msg_ids.size()));
+  m_components.push_back(ComponentRoute{std::move(component)});
+}
+
+void MavlinkRouter::learn_routes(const std::string& endpoint_name,const std::vector<MavlinkMessage>& messages) {
+  std::lock_guard<std::mutex> guard(m_routes_mutex);
+  for(const auto& msg:messages){
+    if(msg.m.msgid!=MAVLINK_MSG_ID_HEARTBEAT)continue;
+    auto& route=m_endpoint_routes[route_key(msg.m.sysid,msg.m.compid)];
+    if(route.endpoint_name!=endpoint_name){
+      m_console->debug("Route sys:{} comp:{} via {}",msg.m.sysid,msg.m.compid,endpoint_name);
+      route.endpoint_name=endpoint_name;
+    }
+    route.last_heartbeat=std::chrono::steady_clock::now();
+    route.n_heartbeats++;
+  }
+}
+
+MavlinkRouter::EndpointRoute* MavlinkRouter::find_route(const MTarget& target) {
+  if(!target.has_target())return nullptr;
+  if(target.comp_id!=0){
+    auto it=m_endpoint_routes.find(route_key(target.sys_id,target.comp_id));
+    if(it!=m_endpoint_routes.end())return &it->second;
+  }
+  // Any component of the target system
+  auto it=m_endpoint_routes.lower_bound(route_key(target.sys_id,0));
+  if(it!=m_endpoint_routes.end() && (it->first>>8)==target.sys_id){
+    return &it->second;
+  }
+  return nullptr;
+}
+
+std::optional<std::string> MavlinkRouter::get_endpoint_for_target(const MTarget& target) {
+  std::lock_guard<std::mutex> guard(m_routes_mutex);
+  const auto route=find_route(target);
+  if(route==nullptr)return std::nullopt;
+  return route->endpoint_name;
+}
+
+std::vector<MavlinkMessage> MavlinkRouter::filter_for_endpoint(const std::string& endpoint_name,const std::vector<MavlinkMessage>& messages) {
+  std::vector<MavlinkMessage> ret;
+  ret.reserve(messages.size());
+  std::lock_guard<std::mutex> guard(m_routes_mutex);
+  for(const auto& msg:messages){
+    auto route=find_route(get_target_from_message_if_available(msg.m));
+    if(route==nullptr){
+      // Broadcast, or we haven't seen this target yet - forward it just in case
+      ret.push_back(msg);
+    }else if(route->endpoint_name==endpoint_name){
+      route->n_messages_routed++;
+      ret.push_back(msg);
+    }else{
+      route->n_messages_dropped++;
+    }
+  }
+  return ret;
+}
+
+bool MavlinkRouter::is_target_of(const MTarget& target,const MavlinkComponent& component) {
+  // System level only - like before the router, each component checks the target component id itself
+  // (e.g. OHDMainComponent handles commands for other components of its system, too)
+  return !target.has_target() || target.sys_id==component.m_sys_id;
+}
+
+std::vector<MavlinkMessage> MavlinkRouter::dispatch_to_components(const std::vector<MavlinkMessage>& messages) {
+  std::lock_guard<std::mutex> guard(m_components_mutex);
+  for(const auto& msg:messages){
+    m_n_dispatched_messages++;
+    const auto target=get_target_from_message_if_available(msg.m);
+    size_t n_deliveries=0;
+    const auto deliver=[this,&msg,&target,&n_deliveries](size_t index){
+      auto& route=m_components[index];
+      if(is_target_of(target,*route.component)){
+        route.batch.push_back(msg);
+        n_deliveries++;
+      }
+    };
+    auto it=m_components_by_msg_id.find(msg.m.msgid);
+    if(it!=m_components_by_msg_id.end()){
+      for(const auto index:it->second)deliver(index);
+    }
+    for(const auto index:m_components_all_messages)deliver(index);
+    m_n_skipped_deliveries+=m_components.size()-n_deliveries;
+  }
+  // Call each component once, in the order they were added
+  std::vector<MavlinkMessage> responses;
+  for(auto& route:m_components){
+    if(route.batch.empty())continue;
+    route.n_messages_dispatched+=route.batch.size();
+    route.n_calls++;
+    OHDUtil::vec_append(responses,route.component->process_mavlink_messages(route.batch));
+    route.batch.resize(0);
+  }
+  return responses;
+}
+
+std::vector<std::shared_ptr<MavlinkComponent>> MavlinkRouter::get_components() {
+  std::lock_guard<std::mutex> guard(m_components_mutex);
+  std::vector<std::shared_ptr<MavlinkComponent>> ret;
+  ret.reserve(m_components.size());
+  for(const auto& route:m_components){
+    ret.push_back(route.component);
+  }
+  return ret;
+}
+
+std::string MavlinkRouter::get_stats_string() {
+  std::stringstream ss;
+  {
+    std::lock_guard<std::mutex> guard(m_components_mutex);
+    ss<<"MavlinkRouter{dispatched:"<<m_n_dispatched_messages<<" skipped deliveries:"<<m_n_skipped_deliveries<<"\n";
+    for(const auto& route:m_components){
+      ss<<" component "<<static_cast<int>(route.component->m_sys_id)<<":"<<static_cast<int>(route.component->m_comp_id)
+         <<" messages:"<<route.n_messages_dispatched<<" calls:"<<route.n_calls<<"\n";
+    }
+  }
+  std::lock_guard<std::mutex> guard(m_routes_mutex);
+  const auto now=std::chrono::steady_clock::now();
+  for(const auto& [key,route]:m_endpoint_routes){
+    const auto last_heartbeat_ms=std::chrono::duration_cast<std::chrono::milliseconds>(now-route.last_heartbeat).count();
+    ss<<" route "<<(key>>8)<<":"<<(key & 0xFF)<<" via "<<route.endpoint_name<<" heartbeats:"<<route.n_heartbeats
+       <<" (last "<<last_heartbeat_ms<<"ms ago) routed:"<<route.n_messages_routed<<" dropped:"<<route.n_messages_dropped<<"\n";
+  }
+  ss<<"}";
+  return ss.str();
+}
@@ -0,0 +1,88 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MavlinkComponent.hpp"
+#include "mav_helper.h"
+#include "openhd_spdlog.h"
+
+/**
+ * Routes messages by (sys id, comp id) instead of handing every message to every component / endpoint.
+ * 1) Local components: Each component declares which message ids it processes (MavlinkComponent::get_subscribed_message_ids),
+ * a message is only dispatched to a component if it subscribed to the message id and the message is either
+ * broadcast or targeted at the component's system (target resolved for all message types from the mavlink metadata, see
+ * get_target_from_message_if_available). Filtering by component id is left to the components.
+ * Components that don't get any message are not called at all.
+ * 2) Endpoints: The (sys id, comp id) -> endpoint route is learned from the heartbeats received on each endpoint,
+ * such that targeted messages are only forwarded to the endpoint the target is reachable over (mavlink routing standard).
+ * Messages for targets we have not seen yet are still forwarded.
+ * Thread safe, the components are not called concurrently.
+ */
+class MavlinkRouter{
+ public:
+  explicit MavlinkRouter(const std::string& tag);
+  void add_component(std::shared_ptr<MavlinkComponent> component);
+  /**
+   * Call with all the messages received on the given endpoint, learns / refreshes the route(s) from heartbeats.
+   */
+  void learn_routes(const std::string& endpoint_name,const std::vector<MavlinkMessage>& messages);
+  // The endpoint (name) the given target system was last seen on, nullopt if unknown
+  std::optional<std::string> get_endpoint_for_target(const MTarget& target);
+  /**
+   * @return all the messages that should be forwarded over the given endpoint - broadcast messages, messages for
+   * a target that is (or might be) reachable over this endpoint. Targeted messages for a system that is known to be
+   * reachable over another endpoint are dropped.
+   */
+  std::vector<MavlinkMessage> filter_for_endpoint(const std::string& endpoint_name,const std::vector<MavlinkMessage>& messages);
+  /**
+   * Hand the messages to the local component(s) that are interested in them.
+   * @return the responses of all components, in order.
+   */
+  std::vector<MavlinkMessage> dispatch_to_components(const std::vector<MavlinkMessage>& messages);
+  // All the components added, in the order they were added
+  std::vector<std::shared_ptr<MavlinkComponent>> get_components();
+  // per route / per component counters
+  std::string get_stats_string();
+ private:
+  struct ComponentRoute{
+    std::shared_ptr<MavlinkComponent> component;
+    // re-used, messages for this component in the current dispatch
+    std::vector<MavlinkMessage> batch;
+    uint64_t n_messages_dispatched=0;
+    uint64_t n_calls=0;
+  };
+  struct EndpointRoute{
+    std::string endpoint_name;
+    std::chrono::steady_clock::time_point last_heartbeat;
+    uint64_t n_heartbeats=0;
+    // targeted messages forwarded to / dropped for this route
+    uint64_t n_messages_routed=0;
+    uint64_t n_messages_dropped=0;
+  };
+  // nullptr if no route to the target is known, m_routes_mutex must be held
+  EndpointRoute* find_route(const MTarget& target);
+  static bool is_target_of(const MTarget& target,const MavlinkComponent& component);
+  std::shared_ptr<spdlog::logger> m_console;
+  std::mutex m_components_mutex;
+  std::vector<ComponentRoute> m_components;
+  // msg id -> indices into m_components
+  std::unordered_map<uint32_t,std::vector<size_t>> m_components_by_msg_id;
+  // components that want all messages
+  std::vector<size_t> m_components_all_messages;
+  uint64_t m_n_dispatched_messages=0;
+  // (message,component) pairs we didn't need to hand out compared to broadcasting each message to each component
+  uint64_t m_n_skipped_deliveries=0;
+  std::mutex m_routes_mutex;
+  // key: sys id << 8 | comp id
+  std::map<uint16_t,EndpointRoute> m_endpoint_routes;
+};
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
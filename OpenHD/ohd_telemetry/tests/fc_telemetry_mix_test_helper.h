@@ -0,0 +1,154 @@
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_TESTS_FC_TELEMETRY_MIX_TEST_HELPER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_TESTS_FC_TELEMETRY_MIX_TEST_HELPER_H_
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/mav_include.h"
+
+// For benchmarks - mavlink messages / raw data that look like what an ArduPilot FC sends with the default stream rates
+// (SRx_ params), or data captured from a real FC.
+namespace fc_telemetry_mix_test_helper{
+
+// Roughly one second worth of FC telemetry, ordered like ArduPilot sends it (message type - messages per second)
+static std::vector<MavlinkMessage> create_one_second(const int sys_id=1,const int comp_id=1){
+  std::vector<MavlinkMessage> ret;
+  const auto add=[&ret](const mavlink_message_t& msg){
+    ret.push_back(MavlinkMessage{msg});
+  };
+  for(int i=0;i<10;i++){
+    const uint32_t time_boot_ms=i*100;
+    mavlink_message_t msg;
+    {
+      mavlink_attitude_t attitude{};
+      attitude.time_boot_ms=time_boot_ms;
+      attitude.roll=0.1f*i;
+      attitude.pitch=-0.05f*i;
+      attitude.yaw=1.2f;
+      mavlink_msg_attitude_encode(sys_id,comp_id,&msg,&attitude);
+      add(msg);
+    }
+    if(i%2==0){
+      mavlink_global_position_int_t position{};
+      position.time_boot_ms=time_boot_ms;
+      position.lat=473977420+i;
+      position.lon=85455940+i;
+      position.alt=488000;
+      position.relative_alt=12000+i*10;
+      position.hdg=9000;
+      mavlink_msg_global_position_int_encode(sys_id,comp_id,&msg,&position);
+      add(msg);
+      mavlink_vfr_hud_t vfr_hud{};
+      vfr_hud.airspeed=12.5f;
+      vfr_hud.groundspeed=11.2f;
+      vfr_hud.heading=90;
+      vfr_hud.throttle=45;
+      vfr_hud.alt=120.0f;
+      mavlink_msg_vfr_hud_encode(sys_id,comp_id,&msg,&vfr_hud);
+      add(msg);
+      mavlink_rc_channels_t rc_channels{};
+      rc_channels.time_boot_ms=time_boot_ms;
+      rc_channels.chancount=16;
+      rc_channels.chan1_raw=1500;
+      rc_channels.chan2_raw=1500;
+      rc_channels.chan3_raw=1100;
+      rc_channels.chan4_raw=1500;
+      rc_channels.rssi=255;
+      mavlink_msg_rc_channels_encode(sys_id,comp_id,&msg,&rc_channels);
+      add(msg);
+      mavlink_servo_output_raw_t servo_output_raw{};
+      servo_output_raw.time_usec=time_boot_ms*1000;
+      servo_output_raw.servo1_raw=1200;
+      servo_output_raw.servo2_raw=1300;
+      servo_output_raw.servo3_raw=1400;
+      servo_output_raw.servo4_raw=1500;
+      mavlink_msg_servo_output_raw_encode(sys_id,comp_id,&msg,&servo_output_raw);
+      add(msg);
+      mavlink_gps_raw_int_t gps_raw_int{};
+      gps_raw_int.time_usec=time_boot_ms*1000;
+      gps_raw_int.fix_type=3;
+      gps_raw_int.lat=473977420+i;
+      gps_raw_int.lon=85455940+i;
+      gps_raw_int.satellites_visible=14;
+      mavlink_msg_gps_raw_int_encode(sys_id,comp_id,&msg,&gps_raw_int);
+      add(msg);
+      mavlink_raw_imu_t raw_imu{};
+      raw_imu.time_usec=time_boot_ms*1000;
+      raw_imu.xacc=10;
+      raw_imu.zacc=-1000;
+      mavlink_msg_raw_imu_encode(sys_id,comp_id,&msg,&raw_imu);
+      add(msg);
+    }
+    if(i%5==0){
+      mavlink_sys_status_t sys_status{};
+      sys_status.voltage_battery=16400;
+      sys_status.current_battery=1200;
+      sys_status.battery_remaining=87;
+      mavlink_msg_sys_status_encode(sys_id,comp_id,&msg,&sys_status);
+      add(msg);
+      mavlink_nav_controller_output_t nav_controller_output{};
+      nav_controller_output.wp_dist=120;
+      mavlink_msg_nav_controller_output_encode(sys_id,comp_id,&msg,&nav_controller_output);
+      add(msg);
+      mavlink_scaled_pressure_t scaled_pressure{};
+      scaled_pressure.time_boot_ms=time_boot_ms;
+      scaled_pressure.press_abs=1013.25f;
+      scaled_pressure.temperature=2500;
+      mavlink_msg_scaled_pressure_encode(sys_id,comp_id,&msg,&scaled_pressure);
+      add(msg);
+      mavlink_vibration_t vibration{};
+      vibration.time_usec=time_boot_ms*1000;
+      vibration.vibration_x=0.5f;
+      mavlink_msg_vibration_encode(sys_id,comp_id,&msg,&vibration);
+      add(msg);
+      mavlink_power_status_t power_status{};
+      power_status.Vcc=5000;
+      mavlink_msg_power_status_encode(sys_id,comp_id,&msg,&power_status);
+      add(msg);
+    }
+  }
+  mavlink_message_t msg;
+  mavlink_msg_heartbeat_pack(sys_id,comp_id,&msg,MAV_TYPE_QUADROTOR,MAV_AUTOPILOT_ARDUPILOTMEGA,MAV_MODE_FLAG_CUSTOM_MODE_ENABLED,5,MAV_STATE_ACTIVE);
+  add(msg);
+  mavlink_battery_status_t battery_status{};
+  battery_status.current_consumed=450;
+  battery_status.battery_remaining=87;
+  mavlink_msg_battery_status_encode(sys_id,comp_id,&msg,&battery_status);
+  add(msg);
+  mavlink_system_time_t system_time{};
+  system_time.time_boot_ms=1000;
+  mavlink_msg_system_time_encode(sys_id,comp_id,&msg,&system_time);
+  add(msg);
+  return ret;
+}
+
+static std::vector<MavlinkMessage> create_n_seconds(int n_seconds){
+  std::vector<MavlinkMessage> ret;
+  for(int i=0;i<n_seconds;i++){
+    auto tmp=create_one_second();
+    ret.insert(ret.end(),tmp.begin(),tmp.end());
+  }
+  return ret;
+}
+
+static std::vector<uint8_t> serialize(const std::vector<MavlinkMessage>& messages){
+  std::vector<uint8_t> ret;
+  for(const auto& msg:messages){
+    const auto data=msg.pack();
+    ret.insert(ret.end(),data.begin(),data.end());
+  }
+  return ret;
+}
+
+// Raw bytes as received from a FC (e.g. cat /dev/ttyACM0 > capture.bin). Empty if the file cannot be read.
+static std::vector<uint8_t> read_capture(const std::string& filename){
+  std::ifstream file(filename,std::ios::binary);
+  if(!file.is_open())return {};
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+}
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_TESTS_FC_TELEMETRY_MIX_TEST_HELPER_H_
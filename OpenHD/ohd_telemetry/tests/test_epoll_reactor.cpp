@@ -0,0 +1,63 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "../src/endpoints/EpollReactor.h"
+#include "openhd_test_check.hpp"
+
+// Checks timers, fds and posted work all run on the (same) reactor thread, and prints the reactor stats
+// (wakeups / context switches per second, epoll event callback latency).
+
+int main(int argc, char *argv[]) {
+  EpollReactor reactor("test_reactor");
+  std::atomic<int> n_timer_calls=0;
+  std::atomic<int> n_bytes_read=0;
+  std::atomic<int> n_posted_calls=0;
+  const auto timer_handle=reactor.add_timer(std::chrono::milliseconds(10),[&reactor,&n_timer_calls](){
+    OHD_TEST_CHECK(reactor.is_in_reactor_thread());
+    n_timer_calls++;
+  });
+  OHD_TEST_CHECK(timer_handle!=0);
+  int pipe_fds[2];
+  if(pipe(pipe_fds)!=0){
+    std::cerr<<"Cannot create pipe\n";
+    return 1;
+  }
+  const auto fd_handle=reactor.add_fd(pipe_fds[0],EPOLLIN,[&reactor,&pipe_fds,&n_bytes_read](uint32_t events){
+    OHD_TEST_CHECK(reactor.is_in_reactor_thread());
+    uint8_t buff[64];
+    const auto ret=read(pipe_fds[0],buff,sizeof(buff));
+    if(ret>0)n_bytes_read+=static_cast<int>(ret);
+  });
+  OHD_TEST_CHECK(fd_handle!=0);
+  for(int i=0;i<100;i++){
+    const uint8_t data[10]{};
+    const auto written=write(pipe_fds[1],data,sizeof(data));
+    OHD_TEST_CHECK(written==sizeof(data));
+    reactor.post([&n_posted_calls](){
+      n_posted_calls++;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  int value=0;
+  reactor.run_and_wait([&value](){
+    value=1;
+  });
+  OHD_TEST_CHECK(value==1);
+  // no callbacks once removed
+  reactor.remove(timer_handle);
+  reactor.remove(fd_handle);
+  const int n_timer_calls_after_remove=n_timer_calls;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  OHD_TEST_CHECK(n_timer_calls==n_timer_calls_after_remove);
+  std::cout<<"Timer calls:"<<n_timer_calls<<" bytes read:"<<n_bytes_read<<" posted calls:"<<n_posted_calls<<"\n";
+  OHD_TEST_CHECK(n_timer_calls>=50);
+  OHD_TEST_CHECK(n_bytes_read==1000);
+  OHD_TEST_CHECK(n_posted_calls==100);
+  std::cout<<reactor.get_stats_string()<<"\n";
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "../src/endpoints/MavlinkFrameParser.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Checks MavlinkFrameParser produces exactly the same messages as mavlink_parse_char and
+// benchmarks both (messages per second), feeding the data in chunks like serial (small) or UDP / WB (large) would.
+// Also checks the parser resyncs on garbage that contains the STX bytes and on frames with a bad CRC, without losing
+// the valid frames that follow.
+// Usage:
+// test_mavlink_frame_parser -> synthetic ArduPilot stream
+// test_mavlink_frame_parser capture.bin -> raw data captured from a FC (e.g. cat /dev/ttyACM0 > capture.bin)
+
+// What MEndpoint::parseNewData used to do
+static std::vector<MavlinkMessage> parse_bytewise(uint8_t channel,const uint8_t* data,int data_len){
+  std::vector<MavlinkMessage> messages;
+  mavlink_message_t msg;
+  mavlink_status_t status;
+  for (int i = 0; i < data_len; i++) {
+    uint8_t res = mavlink_parse_char(channel, data[i], &msg, &status);
+    if (res) {
+      messages.push_back(MavlinkMessage{msg});
+    }
+  }
+  return messages;
+}
+
+static bool equal(const MavlinkMessage& m1,const MavlinkMessage& m2){
+  return m1.m.msgid==m2.m.msgid && m1.m.seq==m2.m.seq && m1.m.sysid==m2.m.sysid && m1.m.compid==m2.m.compid &&
+         m1.m.len==m2.m.len && m1.m.checksum==m2.m.checksum &&
+         std::memcmp(m1.m.payload64,m2.m.payload64,m1.m.len)==0;
+}
+
+static void check_same_result(const std::vector<uint8_t>& data,int chunk_size){
+  MavlinkFrameParser parser(MAVLINK_COMM_1);
+  std::vector<MavlinkMessage> result_bytewise;
+  std::vector<MavlinkMessage> result_parser;
+  for(size_t offset=0;offset<data.size();offset+=chunk_size){
+    const int len=std::min(chunk_size,static_cast<int>(data.size()-offset));
+    auto tmp=parse_bytewise(MAVLINK_COMM_0,data.data()+offset,len);
+    result_bytewise.insert(result_bytewise.end(),tmp.begin(),tmp.end());
+    const auto& tmp2=parser.parse(data.data()+offset,len);
+    result_parser.insert(result_parser.end(),tmp2.begin(),tmp2.end());
+  }
+  OHD_TEST_CHECK(result_bytewise.size()==result_parser.size());
+  for(size_t i=0;i<result_bytewise.size();i++){
+    OHD_TEST_CHECK(equal(result_bytewise[i],result_parser[i]));
+  }
+  const auto status_bytewise=mavlink_get_channel_status(MAVLINK_COMM_0);
+  const auto status_parser=mavlink_get_channel_status(MAVLINK_COMM_1);
+  OHD_TEST_CHECK(status_bytewise->current_rx_seq==status_parser->current_rx_seq);
+  std::cout<<"chunk size:"<<chunk_size<<" n messages:"<<result_parser.size()<<" "<<parser.get_stats().to_string()<<"\n";
+}
+
+// Garbage with the v2 / v1 STX bytes in it, that looks like the begin of frames that run into the next (valid) frame
+static const std::vector<uint8_t> k_garbage_with_stx{'b','o','o','t',MAVLINK_STX,0x09,0x00,MAVLINK_STX_MAVLINK1,0x21,0x13,
+                                                    MAVLINK_STX,MAVLINK_STX_MAVLINK1,MAVLINK_STX};
+
+// Unlike mavlink_parse_char (which skips the whole bogus frame), the parser resyncs at the next STX after a frame
+// turned out invalid - all valid frames have to be parsed, regardless of how the data is split up.
+static void check_resync(int chunk_size){
+  const auto messages=fc_telemetry_mix_test_helper::create_one_second();
+  std::vector<uint8_t> data=k_garbage_with_stx;
+  const auto append=[&data](const std::vector<uint8_t>& tmp){
+    data.insert(data.end(),tmp.begin(),tmp.end());
+  };
+  append(fc_telemetry_mix_test_helper::serialize({messages.at(0)}));
+  // Corrupted CRC, directly followed by a valid frame
+  auto bad_crc=fc_telemetry_mix_test_helper::serialize({messages.at(1)});
+  bad_crc.back()^=0xFF;
+  append(bad_crc);
+  append(fc_telemetry_mix_test_helper::serialize({messages.at(2)}));
+  append(k_garbage_with_stx);
+  append(fc_telemetry_mix_test_helper::serialize(std::vector<MavlinkMessage>(messages.begin()+3,messages.end())));
+  std::vector<MavlinkMessage> expected=messages;
+  expected.erase(expected.begin()+1);
+  MavlinkFrameParser parser(MAVLINK_COMM_2);
+  std::vector<MavlinkMessage> result;
+  for(size_t offset=0;offset<data.size();offset+=chunk_size){
+    const int len=std::min(chunk_size,static_cast<int>(data.size()-offset));
+    const auto& tmp=parser.parse(data.data()+offset,len);
+    result.insert(result.end(),tmp.begin(),tmp.end());
+  }
+  OHD_TEST_CHECK(result.size()==expected.size());
+  for(size_t i=0;i<result.size();i++){
+    OHD_TEST_CHECK(equal(result[i],expected[i]));
+  }
+  OHD_TEST_CHECK(parser.get_stats().n_frames_ok==expected.size());
+  OHD_TEST_CHECK(parser.get_stats().n_frames_bad_crc>=1);
+  std::cout<<"resync chunk size:"<<chunk_size<<" "<<parser.get_stats().to_string()<<"\n";
+}
+
+template<class PARSE_FN>
+static double benchmark_messages_per_second(const std::vector<uint8_t>& data,int chunk_size,PARSE_FN parse_fn){
+  const auto begin=std::chrono::steady_clock::now();
+  uint64_t n_messages=0;
+  static constexpr int N_ITERATIONS=50;
+  for(int i=0;i<N_ITERATIONS;i++){
+    for(size_t offset=0;offset<data.size();offset+=chunk_size){
+      const int len=std::min(chunk_size,static_cast<int>(data.size()-offset));
+      n_messages+=parse_fn(data.data()+offset,len);
+    }
+  }
+  const auto delta=std::chrono::steady_clock::now()-begin;
+  return static_cast<double>(n_messages)/std::chrono::duration<double>(delta).count();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> data;
+  if(argc>1){
+    data=fc_telemetry_mix_test_helper::read_capture(argv[1]);
+    if(data.empty()){
+      std::cerr<<"Cannot read "<<argv[1]<<"\n";
+      return -1;
+    }
+  }else{
+    data=fc_telemetry_mix_test_helper::serialize(fc_telemetry_mix_test_helper::create_n_seconds(30));
+    // Some non-mavlink data in between (e.g. FC boot messages)
+    const std::string garbage="ArduCopter V4.3.0 (boot)";
+    data.insert(data.end(),garbage.begin(),garbage.end());
+    const auto tmp=fc_telemetry_mix_test_helper::serialize(fc_telemetry_mix_test_helper::create_n_seconds(30));
+    data.insert(data.end(),tmp.begin(),tmp.end());
+  }
+  std::cout<<"N bytes:"<<data.size()<<"\n";
+  for(const int chunk_size:{1,7,64,1024}){
+    check_same_result(data,chunk_size);
+  }
+  for(const int chunk_size:{1,7,64,1024}){
+    check_resync(chunk_size);
+  }
+  for(const int chunk_size:{64,1024}){
+    const auto mps_bytewise=benchmark_messages_per_second(data,chunk_size,[](const uint8_t* data,int data_len){
+      return parse_bytewise(MAVLINK_COMM_2,data,data_len).size();
+    });
+    MavlinkFrameParser parser(MAVLINK_COMM_3);
+    const auto mps_parser=benchmark_messages_per_second(data,chunk_size,[&parser](const uint8_t* data,int data_len){
+      return parser.parse(data,data_len).size();
+    });
+    std::cout<<"chunk size:"<<chunk_size<<" mavlink_parse_char:"<<static_cast<int>(mps_bytewise)<<" msg/s MavlinkFrameParser:"
+              <<static_cast<int>(mps_parser)<<" msg/s speedup:"<<mps_parser/mps_bytewise<<"\n";
+  }
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Checks pack_messages_into produces exactly the same chunks as the previous (pack() + concatenate) implementation,
+// that get_size matches the packed size and benchmarks both on a FC telemetry mix (ns per message, heap allocations per message).
+
+// Counts all heap allocations of this process
+static uint64_t n_heap_allocations=0;
+void* operator new(std::size_t size){
+  n_heap_allocations++;
+  void* p=std::malloc(size);
+  if(p==nullptr)throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p)noexcept{
+  std::free(p);
+}
+void operator delete(void* p,std::size_t)noexcept{
+  std::free(p);
+}
+
+// What pack_messages used to do
+static std::vector<std::vector<uint8_t>> pack_messages_legacy(const std::vector<MavlinkMessage>& messages,uint32_t max_mtu=1024){
+  std::vector<std::vector<uint8_t>> ret;
+  std::vector<uint8_t> buff{};
+  buff.reserve(max_mtu);
+  for(const auto& msg:messages){
+    auto data=msg.pack();
+    if(buff.size()+data.size()<=max_mtu){
+      buff.insert(buff.end(), data.begin(), data.end());
+    }else{
+      if(!buff.empty()){
+        ret.push_back(buff);
+        buff.resize(0);
+      }
+      buff.insert(buff.end(), data.begin(), data.end());
+    }
+  }
+  if(!buff.empty()){
+    ret.push_back(buff);
+  }
+  return ret;
+}
+
+static void check_same_result(const std::vector<MavlinkMessage>& messages,uint32_t max_mtu){
+  const auto legacy=pack_messages_legacy(messages,max_mtu);
+  std::vector<std::vector<uint8_t>> chunks;
+  pack_messages_into(messages,[&chunks](const uint8_t* data,int data_len){
+    chunks.emplace_back(data,data+data_len);
+  },max_mtu);
+  OHD_TEST_CHECK(legacy==chunks);
+  OHD_TEST_CHECK(pack_messages(messages,max_mtu)==chunks);
+  int total_size=0;
+  for(const auto& chunk:chunks){
+    total_size+=static_cast<int>(chunk.size());
+  }
+  OHD_TEST_CHECK(get_size(messages)==total_size);
+  for(const auto& msg:messages){
+    OHD_TEST_CHECK(msg.get_packed_size()==static_cast<int>(msg.pack().size()));
+  }
+  std::cout<<"MTU:"<<max_mtu<<" n messages:"<<messages.size()<<" n chunks:"<<chunks.size()<<" n bytes:"<<total_size<<"\n";
+}
+
+struct BenchmarkResult{
+  double ns_per_message;
+  double allocations_per_message;
+};
+
+template<class PACK_FN>
+static BenchmarkResult benchmark(const std::vector<MavlinkMessage>& messages,PACK_FN pack_fn){
+  static constexpr int N_ITERATIONS=200;
+  // Like MEndpoint::sendMessages is called - a couple of messages at a time
+  static constexpr int N_MESSAGES_PER_CALL=8;
+  std::vector<std::vector<MavlinkMessage>> batches;
+  for(size_t i=0;i<messages.size();i+=N_MESSAGES_PER_CALL){
+    const auto end=std::min(messages.size(),i+N_MESSAGES_PER_CALL);
+    batches.emplace_back(messages.begin()+i,messages.begin()+end);
+  }
+  uint64_t n_bytes=0;
+  const auto allocations_before=n_heap_allocations;
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<N_ITERATIONS;i++){
+    for(const auto& batch:batches){
+      n_bytes+=pack_fn(batch);
+    }
+  }
+  const auto delta=std::chrono::steady_clock::now()-begin;
+  const auto n_allocations=n_heap_allocations-allocations_before;
+  const double n_messages=static_cast<double>(messages.size())*N_ITERATIONS;
+  OHD_TEST_CHECK(n_bytes>0);
+  return {std::chrono::duration<double,std::nano>(delta).count()/n_messages,static_cast<double>(n_allocations)/n_messages};
+}
+
+int main(int argc, char *argv[]) {
+  const auto messages=fc_telemetry_mix_test_helper::create_n_seconds(10);
+  for(const uint32_t max_mtu:{64u,512u,1024u}){
+    check_same_result(messages,max_mtu);
+  }
+  const auto legacy=benchmark(messages,[](const std::vector<MavlinkMessage>& batch){
+    size_t n_bytes=0;
+    for(const auto& chunk:pack_messages_legacy(batch)){
+      n_bytes+=chunk.size();
+    }
+    return n_bytes;
+  });
+  get_mavlink_pack_stats().reset();
+  const auto single_pass=benchmark(messages,[](const std::vector<MavlinkMessage>& batch){
+    size_t n_bytes=0;
+    pack_messages_into(batch,[&n_bytes](const uint8_t* data,int data_len){
+      n_bytes+=data_len;
+    });
+    return n_bytes;
+  });
+  std::cout<<get_mavlink_pack_stats().to_string()<<"\n";
+  const auto get_size_begin=std::chrono::steady_clock::now();
+  int total_size=0;
+  for(int i=0;i<200;i++){
+    total_size+=get_size(messages);
+  }
+  const auto get_size_ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-get_size_begin).count()/(200.0*messages.size());
+  std::cout<<"pack_messages (legacy): "<<legacy.ns_per_message<<" ns/msg, "<<legacy.allocations_per_message<<" allocations/msg\n";
+  std::cout<<"pack_messages_into:     "<<single_pass.ns_per_message<<" ns/msg, "<<single_pass.allocations_per_message<<" allocations/msg\n";
+  std::cout<<"get_size: "<<get_size_ns<<" ns/msg ("<<total_size<<")\n";
+  OHD_TEST_CHECK(single_pass.allocations_per_message==0);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <iostream>
+
+#include "../src/routing/MavlinkRouter.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Checks the MavlinkRouter dispatches targeted messages only to the component(s) of the right system and benchmarks
+// the dispatch cost per message compared to handing each message to each component, as components are added
+// (e.g. one param server per camera).
+
+// Similar to XMavlinkParamProvider - only does something with param messages, but has to look at each message
+class DummyParamComponent : public MavlinkComponent{
+ public:
+  DummyParamComponent(uint8_t sys_id,uint8_t comp_id): MavlinkComponent(sys_id,comp_id){}
+  std::vector<MavlinkMessage> process_mavlink_messages(std::vector<MavlinkMessage> messages)override{
+    for(const auto& msg:messages){
+      n_messages_inspected++;
+      if(msg.m.msgid==MAVLINK_MSG_ID_PARAM_REQUEST_LIST){
+        const auto target=get_target_from_message_if_available(msg.m);
+        if(target.sys_id==m_sys_id && (target.comp_id==0 || target.comp_id==m_comp_id)){
+          n_param_requests_handled++;
+        }
+      }
+    }
+    return {};
+  }
+  std::vector<MavlinkMessage> generate_mavlink_messages()override{
+    return {};
+  }
+  [[nodiscard]] std::vector<uint32_t> get_subscribed_message_ids()const override{
+    return {MAVLINK_MSG_ID_PARAM_REQUEST_LIST};
+  }
+  int n_messages_inspected=0;
+  int n_param_requests_handled=0;
+};
+
+static MavlinkMessage create_param_request_list(uint8_t target_sys_id,uint8_t target_comp_id){
+  MavlinkMessage msg;
+  mavlink_msg_param_request_list_pack(QOPENHD_SYS_ID,MAV_COMP_ID_MISSIONPLANNER,&msg.m,target_sys_id,target_comp_id);
+  return msg;
+}
+
+static void test_dispatch(){
+  MavlinkRouter router("test_routing");
+  auto comp1=std::make_shared<DummyParamComponent>(OHD_SYS_ID_AIR,MAV_COMP_ID_ONBOARD_COMPUTER);
+  auto comp2=std::make_shared<DummyParamComponent>(OHD_SYS_ID_AIR,MAV_COMP_ID_CAMERA);
+  router.add_component(comp1);
+  router.add_component(comp2);
+  std::vector<MavlinkMessage> messages=fc_telemetry_mix_test_helper::create_one_second();
+  messages.push_back(create_param_request_list(OHD_SYS_ID_AIR,MAV_COMP_ID_CAMERA));
+  messages.push_back(create_param_request_list(OHD_SYS_ID_AIR,0));
+  messages.push_back(create_param_request_list(OHD_SYS_ID_FC,0));
+  router.dispatch_to_components(messages);
+  // FC telemetry and the request for the FC never reach the components. The request for the camera reaches
+  // both (same system), the component id is checked by the component itself.
+  OHD_TEST_CHECK(comp1->n_messages_inspected==2);
+  OHD_TEST_CHECK(comp1->n_param_requests_handled==1);
+  OHD_TEST_CHECK(comp2->n_messages_inspected==2);
+  OHD_TEST_CHECK(comp2->n_param_requests_handled==2);
+  // Endpoint routes are learned from heartbeats
+  router.learn_routes("fc",fc_telemetry_mix_test_helper::create_one_second(OHD_SYS_ID_FC,MAV_COMP_ID_AUTOPILOT1));
+  OHD_TEST_CHECK(router.get_endpoint_for_target({OHD_SYS_ID_FC,0}).value()=="fc");
+  OHD_TEST_CHECK(!router.get_endpoint_for_target({QOPENHD_SYS_ID,0}).has_value());
+  OHD_TEST_CHECK(router.filter_for_endpoint("fc",{create_param_request_list(OHD_SYS_ID_FC,0)}).size()==1);
+  OHD_TEST_CHECK(router.filter_for_endpoint("ground",{create_param_request_list(OHD_SYS_ID_FC,0)}).empty());
+  std::cout<<router.get_stats_string()<<"\n";
+}
+
+static void benchmark(int n_components){
+  std::vector<MavlinkMessage> messages=fc_telemetry_mix_test_helper::create_n_seconds(10);
+  for(int i=0;i<10;i++){
+    messages.push_back(create_param_request_list(OHD_SYS_ID_AIR,MAV_COMP_ID_CAMERA+i%n_components));
+  }
+  std::vector<std::shared_ptr<DummyParamComponent>> components;
+  MavlinkRouter router("test_routing");
+  for(int i=0;i<n_components;i++){
+    auto component=std::make_shared<DummyParamComponent>(OHD_SYS_ID_AIR,MAV_COMP_ID_CAMERA+i);
+    components.push_back(component);
+    router.add_component(component);
+  }
+  static constexpr int N_ITERATIONS=100;
+  const auto ns_per_message=[&messages](std::chrono::steady_clock::duration delta){
+    return std::chrono::duration<double,std::nano>(delta).count()/(static_cast<double>(messages.size())*N_ITERATIONS);
+  };
+  // What AirTelemetry / GroundTelemetry used to do
+  auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<N_ITERATIONS;i++){
+    for(auto& component:components){
+      component->process_mavlink_messages(messages);
+    }
+  }
+  const auto ns_broadcast=ns_per_message(std::chrono::steady_clock::now()-begin);
+  begin=std::chrono::steady_clock::now();
+  for(int i=0;i<N_ITERATIONS;i++){
+    router.dispatch_to_components(messages);
+  }
+  const auto ns_router=ns_per_message(std::chrono::steady_clock::now()-begin);
+  std::cout<<"N components:"<<n_components<<" broadcast:"<<ns_broadcast<<" ns/msg router:"<<ns_router<<" ns/msg\n";
+}
+
+int main(int argc, char *argv[]) {
+  test_dispatch();
+  for(const int n_components:{1,2,4,8,16}){
+    benchmark(n_components);
+  }
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "../src/internal/OnboardComputerStatusProvider.h"
+#include "openhd_test_check.hpp"
+#include "openhd_util_filesystem.h"
+
+// Runs the onboard computer status readers / provider against a fake procfs / sysfs in a temporary directory
+// (the provider without its sampling thread, sampled explicitly), then measures how much the sampling costs on the real one.
+
+// Some lines from a real /proc/stat, /proc/meminfo (rpi zero 2)
+static void write_proc_stat(const std::string& root,int user,int idle){
+  OHDFilesystemUtil::write_file(root+"/proc/stat",
+             "cpu  "+std::to_string(user)+" 0 100 "+std::to_string(idle)+" 50 0 10 0 0 0\n"
+             "cpu0 1000 0 25 100000 12 0 3 0 0 0\n"
+             "intr 123456 0 0 0\n");
+}
+
+static std::string create_fake_root(){
+  char root_template[]="/tmp/openhd_test_procfs_XXXXXX";
+  OHD_TEST_CHECK(mkdtemp(root_template)!=nullptr);
+  const std::string root=root_template;
+  OHDFilesystemUtil::create_directories(root+"/proc");
+  OHDFilesystemUtil::create_directories(root+"/sys/class/thermal/thermal_zone0");
+  OHDFilesystemUtil::create_directories(root+"/sys/devices/system/cpu/cpu0/cpufreq");
+  write_proc_stat(root,1000,100000);
+  OHDFilesystemUtil::write_file(root+"/proc/meminfo",
+             "MemTotal:         439788 kB\n"
+             "MemFree:          120224 kB\n"
+             "MemAvailable:     329856 kB\n"
+             "Buffers:           21592 kB\n"
+             "Cached:           206188 kB\n");
+  OHDFilesystemUtil::write_file(root+"/sys/class/thermal/thermal_zone0/temp","47236\n");
+  OHDFilesystemUtil::write_file(root+"/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq","1000000\n");
+  return root;
+}
+
+static void test_readers(const std::string& root){
+  OHD_TEST_CHECK(OnboardComputerStatus::read_temperature_degree(root)==47);
+  OHD_TEST_CHECK(OnboardComputerStatus::read_cpu_frequency_mhz(root)==1000);
+  const auto ram=OnboardComputerStatus::read_memory_usage(root);
+  OHD_TEST_CHECK(ram.has_value());
+  OHD_TEST_CHECK(ram->ram_total_mb==429);
+  // (439788-329856)/439788
+  OHD_TEST_CHECK(static_cast<int>(ram->ram_usage_perc)==24);
+  const auto before=OnboardComputerStatus::read_cpu_times(root);
+  OHD_TEST_CHECK(before.has_value());
+  OHD_TEST_CHECK(before->total==1000+100+100000+50+10);
+  // 300 busy, 700 idle
+  write_proc_stat(root,1300,100700);
+  const auto after=OnboardComputerStatus::read_cpu_times(root);
+  OHD_TEST_CHECK(OnboardComputerStatus::calculate_cpu_usage_percent(before.value(),after.value())==30);
+  // Missing files
+  OHD_TEST_CHECK(OnboardComputerStatus::read_temperature_degree(root+"/missing")==0);
+  OHD_TEST_CHECK(!OnboardComputerStatus::read_cpu_times(root+"/missing").has_value());
+  OHD_TEST_CHECK(!OnboardComputerStatus::read_memory_usage(root+"/missing").has_value());
+  std::cout<<"Readers OK\n";
+}
+
+static void test_provider(const std::string& root){
+  write_proc_stat(root,1000,100000);
+  OHDPlatform platform{PlatformType::PC};
+  // No sampling thread
+  OnboardComputerStatusProvider provider(platform,std::chrono::milliseconds(0),root);
+  provider.sample_once();
+  // No cpu usage yet (needs 2 samples), but everything else
+  auto status=provider.get_current_status();
+  OHD_TEST_CHECK(status.cpu_cores[0]==0);
+  OHD_TEST_CHECK(status.temperature_core[0]==47);
+  // 800 busy, 200 idle
+  write_proc_stat(root,1800,100200);
+  provider.sample_once();
+  status=provider.get_current_status();
+  OHD_TEST_CHECK(status.cpu_cores[0]==80);
+  OHD_TEST_CHECK(status.temperature_core[0]==47);
+  OHD_TEST_CHECK(status.storage_type[0]==1000);
+  OHD_TEST_CHECK(status.ram_usage==24);
+  OHD_TEST_CHECK(status.ram_total==429);
+  std::cout<<"Provider OK\n";
+}
+
+static void benchmark_sampling(){
+  const int n_samples=1000;
+  auto last=OnboardComputerStatus::read_cpu_times();
+  int cpu_usage=0;
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<n_samples;i++){
+    const auto curr=OnboardComputerStatus::read_cpu_times();
+    if(curr.has_value() && last.has_value()){
+      cpu_usage=OnboardComputerStatus::calculate_cpu_usage_percent(last.value(),curr.value());
+    }
+    last=curr;
+    OnboardComputerStatus::read_memory_usage();
+    OnboardComputerStatus::read_temperature_degree();
+    OnboardComputerStatus::read_cpu_frequency_mhz();
+  }
+  const auto elapsed=std::chrono::steady_clock::now()-begin;
+  std::cout<<"One sample (cpu, ram, temperature, clock): "
+           <<std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()/n_samples<<"us, cpu usage:"<<cpu_usage<<"%\n";
+}
+
+int main(int argc, char *argv[]) {
+  const auto root=create_fake_root();
+  test_readers(root);
+  test_provider(root);
+  OHDFilesystemUtil::safe_delete_directory(root);
+  benchmark_sampling();
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "../src/mavsdk_temporary/XMavlinkParamProvider.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Benchmarks the param server (XMavlinkParamProvider):
+// 1) The per message overhead - both for messages it has nothing to do with and for param requests.
+// 2) How long a full param list download takes over a simulated lossy link, where the GCS re-requests the missing
+// params by index after a timeout (like QGroundControl / mavsdk do). Simulated time (FakeTime), such that the result
+// doesn't depend on the machine / scheduling.
+// 3) That a client that reconnects only gets the params changed since the version it last had - also when it is
+// detected by a GCS heartbeat re-appearing.
+
+static constexpr int N_PARAMS=200;
+
+static std::shared_ptr<XMavlinkParamProvider> create_provider(std::shared_ptr<mavsdk::Time> time=nullptr){
+  auto ret=std::make_shared<XMavlinkParamProvider>(OHD_SYS_ID_AIR,MAV_COMP_ID_ONBOARD_COMPUTER,false,std::move(time));
+  std::vector<openhd::Setting> settings;
+  for(int i=0;i<N_PARAMS;i++){
+    settings.push_back(openhd::Setting{"TEST_PARAM_"+std::to_string(i),openhd::IntSetting{i}});
+  }
+  ret->add_params(settings);
+  ret->set_ready();
+  return ret;
+}
+
+static MavlinkMessage create_param_request_list(){
+  MavlinkMessage msg;
+  mavlink_msg_param_request_list_pack(QOPENHD_SYS_ID,MAV_COMP_ID_MISSIONPLANNER,&msg.m,OHD_SYS_ID_AIR,MAV_COMP_ID_ONBOARD_COMPUTER);
+  return msg;
+}
+
+static MavlinkMessage create_param_request_read(int index){
+  MavlinkMessage msg;
+  mavlink_msg_param_request_read_pack(QOPENHD_SYS_ID,MAV_COMP_ID_MISSIONPLANNER,&msg.m,OHD_SYS_ID_AIR,MAV_COMP_ID_ONBOARD_COMPUTER,
+                                      "",static_cast<int16_t>(index));
+  return msg;
+}
+
+static MavlinkMessage create_param_set_int(const std::string& param_id,int32_t value){
+  MavlinkMessage msg;
+  // int params are sent bytewise in the float field
+  float value_bytewise;
+  std::memcpy(&value_bytewise,&value,sizeof(value));
+  mavlink_msg_param_set_pack(QOPENHD_SYS_ID,MAV_COMP_ID_MISSIONPLANNER,&msg.m,OHD_SYS_ID_AIR,MAV_COMP_ID_ONBOARD_COMPUTER,
+                             param_id.c_str(),value_bytewise,MAV_PARAM_TYPE_INT32);
+  return msg;
+}
+
+static MavlinkMessage create_gcs_heartbeat(uint8_t sys_id){
+  MavlinkMessage msg;
+  mavlink_msg_heartbeat_pack(sys_id,MAV_COMP_ID_MISSIONPLANNER,&msg.m,MAV_TYPE_GCS,MAV_AUTOPILOT_INVALID,0,0,0);
+  return msg;
+}
+
+static double ns_per_message(std::chrono::steady_clock::duration elapsed,size_t n_messages){
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())/static_cast<double>(n_messages);
+}
+
+static void benchmark_per_message_overhead(){
+  auto provider=create_provider();
+  const auto messages=fc_telemetry_mix_test_helper::create_n_seconds(100);
+  const int n_runs=10;
+  auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<n_runs;i++){
+    const auto responses=provider->process_mavlink_messages(messages);
+    OHD_TEST_CHECK(responses.empty());
+  }
+  std::cout<<"Non param messages: "<<ns_per_message(std::chrono::steady_clock::now()-begin,messages.size()*n_runs)<<" ns/msg\n";
+  // Like the messages come in from a UART at a low rate
+  begin=std::chrono::steady_clock::now();
+  for(const auto& msg:messages){
+    const auto responses=provider->process_mavlink_messages({msg});
+    OHD_TEST_CHECK(responses.empty());
+  }
+  std::cout<<"Non param messages, one per call: "<<ns_per_message(std::chrono::steady_clock::now()-begin,messages.size())<<" ns/msg\n";
+  std::vector<MavlinkMessage> read_requests;
+  for(int i=0;i<N_PARAMS;i++){
+    read_requests.push_back(create_param_request_read(i));
+  }
+  begin=std::chrono::steady_clock::now();
+  for(int i=0;i<n_runs;i++){
+    const auto responses=provider->process_mavlink_messages(read_requests);
+    // Responses to single reads are not paced
+    OHD_TEST_CHECK(responses.size()==N_PARAMS);
+  }
+  std::cout<<"Param request read: "<<ns_per_message(std::chrono::steady_clock::now()-begin,read_requests.size()*n_runs)<<" ns/msg\n";
+}
+
+// Returns how long (simulated) it took until the GCS had all the params
+static std::chrono::steady_clock::duration benchmark_param_list_download(float loss_percentage){
+  auto time=std::make_shared<mavsdk::FakeTime>();
+  auto provider=create_provider(time);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(0,100);
+  std::vector<bool> received(N_PARAMS,false);
+  int n_received=0;
+  int n_lost=0;
+  int n_re_requested=0;
+  uint64_t n_bytes=0;
+  const auto on_responses=[&](const std::vector<MavlinkMessage>& responses){
+    for(const auto& msg:responses){
+      if(msg.m.msgid!=MAVLINK_MSG_ID_PARAM_VALUE)continue;
+      n_bytes+=msg.get_packed_size();
+      if(dist(rng)<loss_percentage){
+        n_lost++;
+        continue;
+      }
+      mavlink_param_value_t value;
+      mavlink_msg_param_value_decode(&msg.m,&value);
+      OHD_TEST_CHECK(value.param_count==N_PARAMS);
+      if(!received[value.param_index]){
+        received[value.param_index]=true;
+        n_received++;
+      }
+    }
+  };
+  const auto begin=time->steady_time();
+  auto last_generate=begin;
+  auto last_progress=begin;
+  int last_n_received=0;
+  on_responses(provider->process_mavlink_messages({create_param_request_list()}));
+  while (n_received<N_PARAMS){
+    time->sleep_for(std::chrono::milliseconds(10));
+    const auto now=time->steady_time();
+    // Same interval as the telemetry loop
+    if(now-last_generate>=std::chrono::milliseconds(500)){
+      last_generate=now;
+      on_responses(provider->generate_mavlink_messages());
+    }
+    if(n_received!=last_n_received){
+      last_n_received=n_received;
+      last_progress=now;
+    }
+    if(now-last_progress>std::chrono::seconds(1)){
+      std::vector<MavlinkMessage> requests;
+      for(int i=0;i<N_PARAMS;i++){
+        if(!received[i])requests.push_back(create_param_request_read(i));
+      }
+      n_re_requested+=static_cast<int>(requests.size());
+      on_responses(provider->process_mavlink_messages(requests));
+      last_progress=now;
+    }
+    OHD_TEST_CHECK(now-begin<std::chrono::seconds(60));
+  }
+  const auto elapsed=time->steady_time()-begin;
+  std::cout<<"Param list download, loss "<<loss_percentage<<"%: "<<std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+           <<"ms, "<<n_bytes<<" bytes, lost:"<<n_lost<<" re-requested:"<<n_re_requested<<"\n";
+  return elapsed;
+}
+
+static void test_params_changed_since(){
+  auto provider=create_provider();
+  const auto version_connected=provider->get_param_set_version();
+  // Nothing changed - nothing to send
+  provider->broadcast_params_changed_since(version_connected);
+  OHD_TEST_CHECK(provider->generate_mavlink_messages().empty());
+  // (Another) client changes some params while the first one is disconnected, each one is acked
+  const std::vector<int> changed_indices{3,42,199};
+  for(const auto index:changed_indices){
+    const auto responses=provider->process_mavlink_messages({create_param_set_int("TEST_PARAM_"+std::to_string(index),1000+index)});
+    OHD_TEST_CHECK(responses.size()==1);
+  }
+  OHD_TEST_CHECK(provider->get_param_set_version()==version_connected+changed_indices.size());
+  // Setting the same value again is not a change
+  provider->process_mavlink_messages({create_param_set_int("TEST_PARAM_3",1003)});
+  OHD_TEST_CHECK(provider->get_param_set_version()==version_connected+changed_indices.size());
+  // The first client reconnects
+  provider->broadcast_params_changed_since(version_connected);
+  const auto responses=provider->generate_mavlink_messages();
+  OHD_TEST_CHECK(responses.size()==changed_indices.size());
+  for(size_t i=0;i<responses.size();i++){
+    mavlink_param_value_t value;
+    mavlink_msg_param_value_decode(&responses[i].m,&value);
+    OHD_TEST_CHECK(value.param_index==changed_indices[i]);
+    OHD_TEST_CHECK(value.param_count==N_PARAMS);
+    int32_t value_int;
+    std::memcpy(&value_int,&value.param_value,sizeof(value_int));
+    OHD_TEST_CHECK(value_int==1000+changed_indices[i]);
+  }
+  std::cout<<"Params changed since: "<<responses.size()<<" instead of "<<N_PARAMS<<" params\n";
+}
+
+static void test_gcs_reconnect(){
+  auto time=std::make_shared<mavsdk::FakeTime>();
+  auto provider=create_provider(time);
+  const auto subscribed=provider->get_subscribed_message_ids();
+  OHD_TEST_CHECK(std::find(subscribed.begin(),subscribed.end(),MAVLINK_MSG_ID_HEARTBEAT)!=subscribed.end());
+  const uint8_t gcs_a=QOPENHD_SYS_ID;
+  const uint8_t gcs_b=QOPENHD_SYS_ID+1;
+  OHD_TEST_CHECK(provider->process_mavlink_messages({create_gcs_heartbeat(gcs_a),create_gcs_heartbeat(gcs_b)}).empty());
+  // While both are connected, a change is acked - nothing else is sent on the next heartbeat
+  time->sleep_for(std::chrono::seconds(1));
+  OHD_TEST_CHECK(provider->process_mavlink_messages({create_param_set_int("TEST_PARAM_1",1001)}).size()==1);
+  OHD_TEST_CHECK(provider->process_mavlink_messages({create_gcs_heartbeat(gcs_a),create_gcs_heartbeat(gcs_b)}).empty());
+  OHD_TEST_CHECK(provider->generate_mavlink_messages().empty());
+  // A is gone, B changes some params
+  const std::vector<int> changed_indices{5,7};
+  for(int i=0;i<10;i++){
+    time->sleep_for(std::chrono::seconds(1));
+    OHD_TEST_CHECK(provider->process_mavlink_messages({create_gcs_heartbeat(gcs_b)}).empty());
+    if(i<static_cast<int>(changed_indices.size())){
+      const auto index=changed_indices[i];
+      OHD_TEST_CHECK(provider->process_mavlink_messages({create_param_set_int("TEST_PARAM_"+std::to_string(index),2000+index)}).size()==1);
+    }
+  }
+  // A is back, it only gets what it missed
+  time->sleep_for(std::chrono::seconds(1));
+  auto responses=provider->process_mavlink_messages({create_gcs_heartbeat(gcs_a)});
+  OHD_TEST_CHECK(responses.size()==changed_indices.size());
+  for(size_t i=0;i<responses.size();i++){
+    mavlink_param_value_t value;
+    mavlink_msg_param_value_decode(&responses[i].m,&value);
+    OHD_TEST_CHECK(value.param_index==changed_indices[i]);
+  }
+  OHD_TEST_CHECK(provider->generate_mavlink_messages().empty());
+  // Nothing changed while A is gone again - nothing to send on re-connect
+  time->sleep_for(std::chrono::seconds(10));
+  OHD_TEST_CHECK(provider->process_mavlink_messages({create_gcs_heartbeat(gcs_a)}).empty());
+  OHD_TEST_CHECK(provider->generate_mavlink_messages().empty());
+  std::cout<<"GCS reconnect: "<<responses.size()<<" instead of "<<N_PARAMS<<" params\n";
+}
+
+int main(int argc, char *argv[]) {
+  benchmark_per_message_overhead();
+  test_params_changed_since();
+  test_gcs_reconnect();
+  const auto elapsed_no_loss=benchmark_param_list_download(0);
+  // paced to the budget, but not slower than that
+  OHD_TEST_CHECK(elapsed_no_loss<std::chrono::seconds(2));
+  benchmark_param_list_download(10);
+  benchmark_param_list_download(30);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "../src/endpoints/MavlinkFrameParser.h"
+#include "../src/endpoints/SerialEndpoint.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Writes a lot more bulk telemetry than 57600 baud can carry plus RC overrides at 50Hz to a pty
+// (instead of a real UART), and checks the writer sticks to the baud budget, drops bulk instead of
+// RC and the RC overrides don't have to wait behind the bulk.
+// Then removes the fd (UART disconnected) while data is still queued and checks what's left is dropped and counted.
+
+static constexpr int BAUD_RATE=57600;
+
+static void test_fd_removed(int master){
+  const int slave=open(ptsname(master),O_RDWR | O_NOCTTY);
+  OHD_TEST_CHECK(slave>=0);
+  SerialWriter writer("test_drop",BAUD_RATE);
+  writer.set_fd(slave);
+  const auto bulk=fc_telemetry_mix_test_helper::create_one_second();
+  // More than MAX_QUEUE_DELAY worth of data
+  OHD_TEST_CHECK(writer.enqueue(bulk));
+  OHD_TEST_CHECK(writer.enqueue(bulk));
+  writer.set_fd(-1);
+  close(slave);
+  // Nothing is queued anymore once disconnected
+  OHD_TEST_CHECK(!writer.enqueue(bulk));
+  // What was already queued is written out by the writer thread (paced) - and dropped, since there is no fd
+  const auto begin=std::chrono::steady_clock::now();
+  while (writer.get_n_dropped_chunks_no_fd()==0 && std::chrono::steady_clock::now()-begin<std::chrono::seconds(2)){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const auto stats=writer.get_stats_string();
+  std::cout<<stats<<"\n";
+  OHD_TEST_CHECK(writer.get_n_dropped_chunks_no_fd()>0);
+  OHD_TEST_CHECK(stats.find("chunks no fd:0")==std::string::npos);
+}
+
+int main(int argc, char *argv[]) {
+  const int master=posix_openpt(O_RDWR | O_NOCTTY);
+  if(master<0 || grantpt(master)!=0 || unlockpt(master)!=0){
+    std::cerr<<"Cannot create pty\n";
+    return 1;
+  }
+  SerialEndpoint::HWOptions options{};
+  options.linux_filename=ptsname(master);
+  options.baud_rate=BAUD_RATE;
+  options.enable_reading=false;
+  SerialEndpoint endpoint("test_ser",options);
+  // wait for the endpoint to open the pty
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  std::atomic<bool> stop=false;
+  std::atomic<uint64_t> n_bytes_received=0;
+  std::atomic<int> n_rc_received=0;
+  openhd::LatencyHistogram rc_latency;
+  std::array<std::atomic<int64_t>,1000> rc_send_time_us{};
+  const auto now_us=[](){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  };
+  std::thread reader([&](){
+    MavlinkFrameParser parser(10);
+    uint8_t buff[1024];
+    struct pollfd fds[1];
+    fds[0].fd = master;
+    fds[0].events = POLLIN;
+    while (!stop){
+      if(poll(fds,1,100)<=0)continue;
+      const auto ret=read(master,buff,sizeof(buff));
+      if(ret<=0)continue;
+      n_bytes_received+=ret;
+      for(const auto& msg:parser.parse(buff,static_cast<int>(ret))){
+        if(msg.m.msgid!=MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE)continue;
+        const auto index=mavlink_msg_rc_channels_override_get_chan1_raw(&msg.m);
+        rc_latency.record(std::chrono::microseconds(now_us()-rc_send_time_us[index]));
+        n_rc_received++;
+      }
+    }
+  });
+  const auto bulk=fc_telemetry_mix_test_helper::create_one_second();
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<150;i++){
+    // ~10x what the UART can carry
+    endpoint.sendMessages(bulk);
+    std::array<uint16_t,18> channels{};
+    channels[0]=i;
+    rc_send_time_us[i]=now_us();
+    endpoint.sendMessages({rc_channels_override_from_array(QOPENHD_SYS_ID,1,channels,OHD_SYS_ID_FC,0)});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const auto elapsed_s=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+  const auto bytes_per_second=static_cast<double>(n_bytes_received)/elapsed_s;
+  std::cout<<endpoint.get_writer_stats_string()<<"\n";
+  stop=true;
+  reader.join();
+  std::cout<<"Received:"<<static_cast<int>(bytes_per_second)<<" B/s (budget "<<SerialWriter::bytes_per_second(BAUD_RATE)
+           <<" B/s) rc overrides:"<<n_rc_received<<"/150 rc latency:"<<rc_latency.to_string()<<"\n";
+  // The pty itself would accept much more
+  OHD_TEST_CHECK(bytes_per_second<SerialWriter::bytes_per_second(BAUD_RATE)*1.1);
+  OHD_TEST_CHECK(bytes_per_second>SerialWriter::bytes_per_second(BAUD_RATE)*0.8);
+  // No RC override is dropped (at most one gets superseded) and none waits behind the bulk
+  OHD_TEST_CHECK(n_rc_received>=145);
+  OHD_TEST_CHECK(rc_latency.percentile_us(95)<100*1000);
+  test_fd_removed(master);
+  close(master);
+  std::cout<<"Done\n";
+  return 0;
+}
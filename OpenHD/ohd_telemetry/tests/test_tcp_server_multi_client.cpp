@@ -0,0 +1,120 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "../src/endpoints/TCPEndpoint.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Connects 2 fast clients and one client that never reads to the TCP server, and floods it with FC telemetry.
+// The fast clients need to keep getting data while the slow client backs up (drop oldest / disconnect).
+// Also checks the mavlink channels of the endpoint / its clients are returned, such that re-creating the endpoint
+// doesn't run out of channels.
+
+static constexpr int TEST_PORT=5770;
+
+static int connect_client(bool small_rcvbuf){
+  const int fd=socket(AF_INET,SOCK_STREAM,0);
+  if(small_rcvbuf){
+    // such that the client backs up quickly - needs to be set before connecting
+    int rcvbuf=4096;
+    setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&rcvbuf,sizeof(rcvbuf));
+  }
+  struct sockaddr_in addr{};
+  addr.sin_family=AF_INET;
+  addr.sin_port=htons(TEST_PORT);
+  inet_aton("127.0.0.1",&addr.sin_addr);
+  if(connect(fd,(struct sockaddr*)&addr,sizeof(addr))!=0){
+    std::cerr<<"Cannot connect "<<strerror(errno)<<"\n";
+    return -1;
+  }
+  return fd;
+}
+
+static void test(TCPEndpoint::SlowClientPolicy policy){
+  TCPEndpoint::Config config{TEST_PORT};
+  config.slow_client_policy=policy;
+  config.max_queue_bytes=16*1024;
+  TCPEndpoint server(config);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::atomic<bool> stop=false;
+  std::atomic<uint64_t> fast_clients_n_bytes[2]{0,0};
+  std::vector<std::thread> fast_clients;
+  for(int i=0;i<2;i++){
+    fast_clients.emplace_back([&stop,&fast_clients_n_bytes,i](){
+      const int fd=connect_client(false);
+      OHD_TEST_CHECK(fd>=0);
+      struct timeval tv{0,100*1000};
+      setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+      uint8_t buff[4096];
+      while (!stop){
+        const auto ret=recv(fd,buff,sizeof(buff),0);
+        if(ret>0)fast_clients_n_bytes[i]+=ret;
+      }
+      close(fd);
+    });
+  }
+  const int slow_client=connect_client(true);
+  OHD_TEST_CHECK(slow_client>=0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const auto messages=fc_telemetry_mix_test_helper::create_one_second();
+  uint64_t n_bytes_sent=0;
+  // a few MB/s, for 3 seconds - enough to fill up the socket buffers of the slow client
+  for(int i=0;i<3000;i++){
+    server.sendMessages(messages);
+    n_bytes_sent+=get_size(messages);
+    if(i%1000==0){
+      std::cout<<server.get_clients_stats_string();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::cout<<server.get_clients_stats_string();
+  stop=true;
+  for(auto& thread:fast_clients)thread.join();
+  std::cout<<"Sent:"<<n_bytes_sent<<"B fast clients received:"<<fast_clients_n_bytes[0]<<"B,"<<fast_clients_n_bytes[1]<<"B\n";
+  // The fast clients keep up, only the slow client loses data / gets disconnected
+  OHD_TEST_CHECK(fast_clients_n_bytes[0]==n_bytes_sent && fast_clients_n_bytes[1]==n_bytes_sent);
+  if(policy==TCPEndpoint::SlowClientPolicy::DISCONNECT){
+    // Whatever made it into the socket buffer, then the server closed the connection
+    struct timeval tv{1,0};
+    setsockopt(slow_client,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    uint8_t buff[4096];
+    ssize_t ret;
+    while ((ret=recv(slow_client,buff,sizeof(buff),0))>0){}
+    OHD_TEST_CHECK(ret==0 || errno==ECONNRESET);
+  }
+  close(slow_client);
+}
+
+static void test_channels_recycled(){
+  const auto messages=fc_telemetry_mix_test_helper::create_one_second();
+  for(int i=0;i<2*MAVLINK_COMM_NUM_BUFFERS;i++){
+    TCPEndpoint server(TCPEndpoint::Config{TEST_PORT});
+    const int fd=connect_client(false);
+    OHD_TEST_CHECK(fd>=0);
+    struct timeval tv{0,10*1000};
+    setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    // Once data arrives, the client was accepted (and got a parser / channel)
+    uint8_t buff[4096];
+    int n_tries=0;
+    while (recv(fd,buff,sizeof(buff),0)<=0){
+      OHD_TEST_CHECK(n_tries++<500);
+      server.sendMessages(messages);
+    }
+    close(fd);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::cout<<"Channels recycled\n";
+  test_channels_recycled();
+  std::cout<<"Drop oldest\n";
+  test(TCPEndpoint::SlowClientPolicy::DROP_OLDEST);
+  std::cout<<"Disconnect\n";
+  test(TCPEndpoint::SlowClientPolicy::DISCONNECT);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+
+#include "../src/endpoints/MavlinkFrameParser.h"
+#include "../src/endpoints/WBTelemetryScheduler.h"
+#include "fc_telemetry_mix_test_helper.h"
+#include "openhd_test_check.hpp"
+
+// Sends FC telemetry, a param dump (~10x what the budget allows for) and RC overrides at 50Hz through the scheduler
+// and checks the budget is not exceeded, the RC overrides are neither dropped nor delayed by the param dump and
+// the high rate streams are superseded instead of queued up.
+
+static constexpr int BUDGET_BYTES_PER_SECOND=8000;
+
+static std::vector<MavlinkMessage> create_param_dump(int n_params){
+  std::vector<MavlinkMessage> ret;
+  for(int i=0;i<n_params;i++){
+    mavlink_message_t msg;
+    mavlink_msg_param_value_pack(1,1,&msg,"TEST_PARAM",static_cast<float>(i),MAV_PARAM_TYPE_REAL32,n_params,i);
+    ret.push_back(MavlinkMessage{msg});
+  }
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  std::mutex mutex;
+  uint64_t n_bytes_sent=0;
+  int n_rc_received=0;
+  int n_attitude_received=0;
+  openhd::LatencyHistogram rc_latency;
+  std::array<std::chrono::steady_clock::time_point,1000> rc_send_time{};
+  MavlinkFrameParser parser(10);
+  WBTelemetryScheduler::Config config{};
+  config.max_bytes_per_second=BUDGET_BYTES_PER_SECOND;
+  config.max_burst_bytes=1024;
+  WBTelemetryScheduler scheduler("test",config,[&](std::shared_ptr<std::vector<uint8_t>> data){
+    OHD_TEST_CHECK(data->size()<=MAVLINK_PACK_MAX_MTU);
+    std::lock_guard<std::mutex> lock(mutex);
+    n_bytes_sent+=data->size();
+    for(const auto& msg:parser.parse(data->data(),static_cast<int>(data->size()))){
+      if(msg.m.msgid==MAVLINK_MSG_ID_ATTITUDE)n_attitude_received++;
+      if(msg.m.msgid!=MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE)continue;
+      const auto index=mavlink_msg_rc_channels_override_get_chan1_raw(&msg.m);
+      rc_latency.record(std::chrono::steady_clock::now()-rc_send_time[index]);
+      n_rc_received++;
+    }
+  });
+  const auto fc_telemetry=fc_telemetry_mix_test_helper::create_one_second();
+  const auto param_dump=create_param_dump(1000);
+  const auto begin=std::chrono::steady_clock::now();
+  for(int i=0;i<150;i++){
+    if(i%50==0){
+      scheduler.enqueue(fc_telemetry);
+      scheduler.enqueue(param_dump);
+    }
+    std::array<uint16_t,18> channels{};
+    channels[0]=i;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      rc_send_time[i]=std::chrono::steady_clock::now();
+    }
+    scheduler.enqueue({rc_channels_override_from_array(QOPENHD_SYS_ID,1,channels,OHD_SYS_ID_FC,0)});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const auto elapsed_s=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+  std::cout<<scheduler.get_stats_string()<<"\n";
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto bytes_per_second=static_cast<double>(n_bytes_sent)/elapsed_s;
+  std::cout<<"Sent:"<<static_cast<int>(bytes_per_second)<<" B/s (budget "<<BUDGET_BYTES_PER_SECOND<<" B/s) rc overrides:"
+           <<n_rc_received<<"/150 rc latency:"<<rc_latency.to_string()<<" attitude:"<<n_attitude_received<<"/30\n";
+  // CONTROL may overdraw the budget a bit, the burst is allowed on top
+  OHD_TEST_CHECK(bytes_per_second<BUDGET_BYTES_PER_SECOND*1.1+config.max_burst_bytes/elapsed_s);
+  // The param dump used whatever was left over
+  OHD_TEST_CHECK(bytes_per_second>BUDGET_BYTES_PER_SECOND*0.8);
+  OHD_TEST_CHECK(n_rc_received==150);
+  OHD_TEST_CHECK(rc_latency.percentile_us(95)<10*1000);
+  // 10 ATTITUDE messages per burst, enqueued at once - only the latest one per burst is sent
+  OHD_TEST_CHECK(n_attitude_received<=3);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -661,9 +661,9 @@ static std::string createOutputAppSink(){
 }
 
 // Needs to match below
-static std::string file_suffix_for_video_codec(const VideoCodec videoCodec){
+static std::string file_suffix_for_video_codec(const VideoCodec videoCodec,const bool fragmented_mp4=false){
   if(videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265){
-    return ".mkv";
+    return fragmented_mp4 ? ".mp4" : ".mkv";
   }else{
     return ".avi";
   }
@@ -676,7 +676,9 @@ static std::string file_suffix_for_video_codec(const VideoCodec videoCodec){
 // .mkv supports h264 and h265, but no mjpeg. It is the default in OBS though, so we decided to use .mkv
 // for h264 and h265 and .avi for mjpeg
 // in case the gst pipeline is not stopped properly
-static std::string createRecordingForVideoCodec(const VideoCodec videoCodec,const std::string& out_filename) {
+// fragmented .mp4 (a fragment each second) is readable up to the last fragment on crash, and doesn't need to be demuxed
+// afterwards - optional for h264 and h265 (DEV_AIR_RECORDING_FRAGMENTED_MP4)
+static std::string createRecordingForVideoCodec(const VideoCodec videoCodec,const std::string& out_filename,const bool fragmented_mp4=false) {
   std::stringstream ss;
   // don't forget the white space before the " t." !
   ss << " t. ! queue ! ";
@@ -689,7 +691,9 @@ static std::string createRecordingForVideoCodec(const VideoCodec videoCodec,cons
     ss << "jpegparse ! ";
   }
   //ss <<"mp4mux ! filesink location="<<out_filename;
-  if(videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265){
+  if((videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265) && fragmented_mp4){
+    ss <<"mp4mux fragment-duration=1000 ! filesink location="<<out_filename;
+  }else if(videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265){
     ss <<"matroskamux ! filesink location="<<out_filename;
   }else{
     ss <<"avimux ! filesink location="<<out_filename;
@@ -0,0 +1,116 @@
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_BUILDER_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_BUILDER_H_
+
+#include <gst/gst.h>
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gst_helper.hpp"
+
+namespace openhd{
+
+/**
+ * Builds a gstreamer pipeline by creating and linking the elements directly, instead of writing a pipeline string
+ * and handing it to gst_parse_launch. This saves parsing the string and resolving each element factory on every (re-)start
+ * (factories are looked up once per process), and gives us handles to the elements (e.g. the encoder) for changing
+ * them at run time.
+ * Elements are linked in the order they are added (like "a ! b ! c"), use continue_from() to start a new branch from a tee.
+ * Errors are sticky - once an element cannot be created / linked, all following calls are no-ops and
+ * release_pipeline() returns nullptr.
+ * A launch-like description of what has been built is kept for logging / debugging (it can be run with gst-launch-1.0).
+ */
+class GstPipelineBuilder{
+ public:
+  // key, value as they'd be written in a pipeline string (e.g. "speed-preset","ultrafast")
+  typedef std::vector<std::pair<std::string,std::string>> Properties;
+  explicit GstPipelineBuilder(const std::string& pipeline_name="pipeline");
+  // Adds elements to an existing (e.g. running) pipeline / bin instead, the first one is linked to link_from (if not nullptr).
+  GstPipelineBuilder(GstElement* existing_pipeline,GstElement* link_from);
+  ~GstPipelineBuilder();
+  GstPipelineBuilder(const GstPipelineBuilder&)=delete;
+  GstPipelineBuilder(GstPipelineBuilder&&)=delete;
+  // The construction time of all the elements added after this call is accounted to this stage (e.g. "source", "rtp")
+  void begin_stage(const std::string& stage_name);
+  // Create an element of the given factory (optionally with a name), set its properties and link it to the previous element.
+  // Returns the element (owned by the pipeline) or nullptr on error.
+  GstElement* add(const std::string& factory_name,const std::string& name="",const Properties& properties={});
+  // capsfilter, e.g. "video/x-raw, format=I420,width=640,height=480,framerate=30/1"
+  GstElement* add_caps_filter(const std::string& caps,const std::string& name="");
+  // For pipeline parts that have no typed builder (yet) - parses the description (e.g. "v4l2src ! video/x-h264")
+  // into a bin with ghost pads. A trailing "! " is ignored.
+  GstElement* add_from_description(const std::string& description);
+  // The next element is linked to the given element (e.g. a tee) instead of the previous one.
+  void continue_from(GstElement* element);
+  // Links the last element to an element that is already in the pipeline
+  bool link_to(GstElement* element);
+  // All the elements created by this builder, in the order they were added
+  [[nodiscard]] const std::vector<GstElement*>& get_added_elements()const;
+  // Returns an element (owned by the pipeline) by name, also searches bins created by add_from_description.
+  [[nodiscard]] GstElement* get_element(const std::string& name)const;
+  [[nodiscard]] bool has_error()const;
+  [[nodiscard]] const std::string& get_error()const;
+  [[nodiscard]] std::string get_description()const;
+  // per stage construction time, e.g. "source:1.2ms rtp:0.4ms total:1.6ms"
+  [[nodiscard]] std::string get_stage_timings_string()const;
+  [[nodiscard]] std::chrono::nanoseconds get_total_construction_time()const;
+  // Hands over ownership of the pipeline, nullptr on error. The builder cannot be used afterwards.
+  GstElement* release_pipeline();
+ private:
+  void set_error(std::string error);
+  // Adds the (floating) element to the pipeline and links it to the previous one
+  bool add_and_link(GstElement* element);
+  void account_time(std::chrono::steady_clock::time_point begin);
+  GstElement* m_pipeline;
+  // The element the next one is linked to
+  GstElement* m_tail=nullptr;
+  std::map<std::string,GstElement*> m_named_elements;
+  std::vector<GstElement*> m_added_elements;
+  std::stringstream m_description;
+  std::string m_error;
+  std::vector<std::pair<std::string,std::chrono::nanoseconds>> m_stage_timings;
+};
+
+// Handles to the elements of a running pipeline that are of interest at run time. Owned by the pipeline,
+// nullptr if the element doesn't exist (e.g. the encoder is inside the camera) or was not built with the builder.
+struct GstPipelineHandles{
+  GstElement* encoder=nullptr;
+  GstElement* parser=nullptr;
+  GstElement* payloader=nullptr;
+  GstElement* appsink=nullptr;
+  // The tee the recording branch is attached to
+  GstElement* tee=nullptr;
+  // The caps filter right after the source - only if the source was built with the builder (e.g. the dummy camera)
+  GstElement* caps_filter=nullptr;
+};
+
+}
+
+// Typed counterparts to the string based pipeline parts in gst_helper.hpp - each one creates exactly the same elements,
+// with the same properties as its string counterpart.
+namespace OHDGstHelper{
+
+// See createSwEncoder, the encoder is named "swencoder"
+GstElement* add_sw_encoder(openhd::GstPipelineBuilder& builder,const CommonEncoderParams& common_encoder_params);
+// See createDummyStream (videotestsrc), returns the encoder. The caps filter is named "source_caps"
+GstElement* add_dummy_stream(openhd::GstPipelineBuilder& builder,const CameraSettings& settings);
+// Raw caps of the dummy camera (videotestsrc) for the given settings
+std::string create_dummy_stream_caps(const CameraSettings& settings);
+// See create_parse_and_rtp_packetize, the parser is named "out_parser" and the payloader "out_rtppay"
+void add_parse_and_rtp_packetize(openhd::GstPipelineBuilder& builder,VideoCodec videoCodec);
+// See createOutputAppSink, named "out_appsink"
+GstElement* add_output_appsink(openhd::GstPipelineBuilder& builder);
+// The tee ("t") the recording branch is attached to at run time (see GstRecordingBranch). Unlike the string pipeline,
+// it is always part of the pipeline and doesn't fail if nothing is attached.
+GstElement* add_recording_tee(openhd::GstPipelineBuilder& builder);
+// See createRecordingForVideoCodec, needs to be linked to a tee (see GstRecordingBranch)
+void add_recording_for_video_codec(openhd::GstPipelineBuilder& builder,VideoCodec videoCodec,const std::string& out_filename,
+                                   bool fragmented_mp4=false);
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_BUILDER_H_
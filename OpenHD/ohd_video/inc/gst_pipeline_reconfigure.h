@@ -0,0 +1,101 @@
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_RECONFIGURE_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_RECONFIGURE_H_
+
+#include <gst/gst.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "camera_settings.hpp"
+#include "gst_pipeline_builder.h"
+#include "openhd_latency_histogram.hpp"
+
+// Applying a changed camera setting without tearing down and re-building the whole pipeline (which means a video
+// blackout of up to multiple seconds), by only changing the part of the (running) pipeline that is affected.
+namespace openhd{
+
+// Ordered by cost - a change that needs multiple of them is classified as the most expensive one
+enum class ReconfigureType{
+  // Nothing in the pipeline needs to change
+  NONE=0,
+  // Encoder bitrate property, while playing
+  BITRATE,
+  // Attach / detach the air recording branch to / from the tee
+  RECORDING,
+  // Resolution / framerate - new caps on the source caps filter, the pipeline renegotiates
+  CAPS,
+  // Codec / keyframe interval / mjpeg quality - encoder, parser and payloader are replaced while the source is blocked
+  ENCODER,
+  // Stop, cleanup, rebuild and start the whole pipeline
+  FULL_RESTART
+};
+static constexpr int N_RECONFIGURE_TYPES=6;
+std::string reconfigure_type_to_string(ReconfigureType type);
+
+// What needs to be done to get from the currently applied to the new settings.
+// Doesn't look at air_recording - if recording is active also depends on the arming state, see GStreamerStream.
+ReconfigureType classify_settings_change(const CameraSettings& applied,const CameraSettings& next);
+
+/**
+ * Blocks the data flow (buffers and serialized events) on a pad of a playing pipeline, such that the elements
+ * downstream of it can be changed. The pad is unblocked when this object is destroyed.
+ */
+class ScopedPadBlock{
+ public:
+  explicit ScopedPadBlock(GstPad* pad);
+  ~ScopedPadBlock();
+  ScopedPadBlock(const ScopedPadBlock&)=delete;
+  ScopedPadBlock(ScopedPadBlock&&)=delete;
+  // Returns true once the streaming thread is blocked on the pad, false if nothing came along within the timeout
+  // (e.g. the pipeline is not playing).
+  bool wait_blocked(std::chrono::milliseconds timeout);
+  // Shared with the probe
+  struct State;
+ private:
+  GstPad* m_pad;
+  gulong m_probe_id;
+  std::shared_ptr<State> m_state;
+};
+
+// The element linked to the first linked src pad of the given element (also works for request pads, e.g. tee)
+// with a reference, or nullptr.
+GstElement* get_downstream_element(GstElement* element);
+
+// Sets new caps on the (source) caps filter of a playing pipeline, the source (and encoder) renegotiate.
+bool hot_change_caps(GstElement* caps_filter,const std::string& caps);
+
+// Replaces everything in between the source caps filter and the appsink (encoder, tee, queue, parser, payloader) by a new
+// sw encoder (+ tee, if there was one) + parse + rtp packetize for the given settings while the pipeline is playing,
+// and sets the source caps. Nothing must be linked to the tee.
+// The data flow is blocked at the caps filter while doing so - the source and appsink are not touched.
+// Updates the handles on success. On failure, the pipeline needs to be rebuilt.
+bool hot_replace_encoder(GstElement* pipeline,GstPipelineHandles& handles,const CameraSettings& settings,
+                         const std::string& source_caps,
+                         std::chrono::milliseconds block_timeout=std::chrono::milliseconds(1000));
+
+/**
+ * Measures the video blackout of each change - the time from when we start applying the change until the first
+ * rtp fragment comes out of the appsink again.
+ * begin() is called from the thread applying the change, on_fragment() from the thread the fragments come in on.
+ */
+class ReconfigureBlackoutTracker{
+ public:
+  void begin(ReconfigureType type);
+  // Cheap (one atomic load) unless a change is pending. Returns the type of the change that is complete with this fragment.
+  std::optional<ReconfigureType> on_fragment();
+  [[nodiscard]] const LatencyHistogram& get_blackout(ReconfigureType type)const;
+  // blackout per change type, only for the types that happened
+  [[nodiscard]] std::string to_string()const;
+ private:
+  std::atomic<int> m_pending_type{-1};
+  std::atomic<int64_t> m_begin_us{0};
+  std::array<LatencyHistogram,N_RECONFIGURE_TYPES> m_blackout;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_GST_PIPELINE_RECONFIGURE_H_
@@ -0,0 +1,49 @@
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_GST_RECORDING_BRANCH_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_GST_RECORDING_BRANCH_H_
+
+#include <gst/gst.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "camera_enums.hpp"
+
+namespace openhd{
+
+/**
+ * The air recording part of the pipeline (queue ! parse ! mux ! filesink) as a bin that is attached to / detached from
+ * a tee (allow-not-linked=true) while the pipeline is playing - such that recording can be started / stopped
+ * (e.g. on arm / disarm) without restarting the pipeline, and therefore without a gap on the downlink.
+ * The recording always starts with a keyframe (delta frames are dropped until the first one, which is requested from
+ * the encoder on attach), and detach() sends EOS through the branch, such that the muxer finalizes the file.
+ */
+class GstRecordingBranch{
+ public:
+  // Adds the branch to the (not necessarily playing) pipeline and links it to the tee, nullptr on error.
+  // See OHDGstHelper::add_recording_for_video_codec for fragmented_mp4
+  static std::unique_ptr<GstRecordingBranch> attach(GstElement* pipeline,GstElement* tee,VideoCodec codec,const std::string& filename,
+                                                    bool fragmented_mp4=false);
+  // If not detached, the branch stays part of the pipeline and goes away with it (file is not finalized)
+  ~GstRecordingBranch();
+  GstRecordingBranch(const GstRecordingBranch&)=delete;
+  GstRecordingBranch(GstRecordingBranch&&)=delete;
+  // Unlinks the branch from the tee, waits (at most eos_timeout) until the muxer has finalized the file and removes it
+  // from the pipeline. Returns false if the file could not be finalized in time (it is removed anyways).
+  bool detach(std::chrono::milliseconds eos_timeout=std::chrono::milliseconds(1000));
+  [[nodiscard]] const std::string& get_filename()const{return m_filename;}
+ private:
+  GstRecordingBranch(GstElement* pipeline,GstElement* tee,GstElement* bin,GstElement* filesink,GstPad* tee_pad,std::string filename);
+  GstElement* m_pipeline;
+  GstElement* m_tee;
+  // Owned by the pipeline
+  GstElement* m_bin;
+  GstElement* m_filesink;
+  GstPad* m_tee_pad;
+  const std::string m_filename;
+  bool m_detached=false;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_GST_RECORDING_BRANCH_H_
@@ -5,32 +5,65 @@
 #ifndef OPENHD_GST_RECORDING_DEMUXER_H
 #define OPENHD_GST_RECORDING_DEMUXER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <set>
 #include <string>
 
 // Simple util class / namespace for demuxing .mkv air recording files
-// uses gstreamer & command line util
+// into .mp4 (in process, using gstreamer).
+// Also remuxes the raw rtp air recordings of the PrerollRingRecorder (.h264.rtp / .h265.rtp / .mjpeg.rtp, RFC 4571)
+// into .mp4.
+// The files are demuxed one after another by a small pool of low priority (nice / idle io) worker threads, such that
+// several recordings after landing don't compete with the live link.
+// Jobs are resumable - the .mkv / .rtp is only deleted once the .mp4 has been fully written (as .mp4.part, then renamed).
+// If a job is interrupted (shutdown / crash), it is simply started again the next time.
 class GstRecordingDemuxer {
  public:
+  explicit GstRecordingDemuxer(int n_workers=1);
+  // Aborts the currently running job(s) - they are resumed on the next demux_all_remaining_files_async()
   ~GstRecordingDemuxer();
-  // Find all files that end in .mkv in the openhd videos (air recording) directory and then spawns a new thread to demux the file
-  // (unless it is already being demuxed)
-  void demux_all_remaining_mkv_files_async();
-  // demux a specific .mkv file (async) unless it is already being demuxed
+  GstRecordingDemuxer(const GstRecordingDemuxer&)=delete;
+  GstRecordingDemuxer(GstRecordingDemuxer&&)=delete;
+  // Find all files that end in .mkv / .rtp in the openhd videos (air recording) directory and queue them for demuxing
+  // (unless they are already queued / being demuxed)
+  void demux_all_remaining_files_async();
+  // demux a specific .mkv / .rtp file (async) unless it is already being demuxed
   // thread-safe
-  void demux_mkv_file_async_threadsafe(std::string filename);
+  void demux_file_async_threadsafe(std::string filename);
+  // Waits until all queued jobs are done, returns false on timeout
+  bool wait_until_idle(std::chrono::milliseconds timeout);
+  // e.g. "Demuxer{queued:1 active:[/home/openhd/Videos/x.mkv 42%] done:3 failed:0}"
+  std::string get_status();
+  // n of jobs that were finished successfully / that failed (not counting aborted ones) so far
+  int get_n_done_jobs();
+  int get_n_failed_jobs();
   static GstRecordingDemuxer& instance();
  private:
-  struct DeMuxOperation{
+  void loop_worker();
+  // false if failed / aborted
+  bool demux_mkv(const std::string& in_file,std::atomic<int>& progress_perc);
+  bool remux_rtp(const std::string& in_file,std::atomic<int>& progress_perc);
+  struct ActiveJob{
     std::string filename;
-    std::shared_ptr<std::thread> thread;
+    std::atomic<int> progress_perc{0};
   };
-  std::vector<DeMuxOperation> m_demux_ops{};
-  // makes sure we spawn exactly one demux thread per file
-  std::mutex m_demux_ops_mutex;
+  std::mutex m_jobs_mutex;
+  std::condition_variable m_jobs_cv;
+  std::deque<std::string> m_queued_jobs;
+  std::vector<std::shared_ptr<ActiveJob>> m_active_jobs;
+  // queued or active jobs - makes sure we don't demux the same file twice at the same time
+  std::set<std::string> m_known_files;
+  int m_n_done=0;
+  int m_n_failed=0;
+  std::atomic<bool> m_terminate=false;
+  std::vector<std::unique_ptr<std::thread>> m_workers;
 };
 
 #endif  // OPENHD_GST_RECORDING_DEMUXER_H
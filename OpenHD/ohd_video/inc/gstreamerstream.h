@@ -12,9 +12,14 @@
 #include "camera_settings.hpp"
 #include "camerastream.h"
 #include "gst_bitrate_controll_wrapper.hpp"
+#include "gst_pipeline_builder.h"
+#include "gst_pipeline_reconfigure.h"
+#include "gst_recording_branch.h"
+#include "openhd_buffer_pool.hpp"
+#include "openhd_latency_histogram.hpp"
 #include "openhd_platform.h"
 #include "openhd_spdlog.h"
-//#include "gst_recorder.h"
+#include "preroll_ring_recorder.h"
 
 // Implementation of OHD CameraStream for pretty much everything, using
 // gstreamer.
@@ -22,6 +27,11 @@
 // executing this pipeline. This makes development easy (since you can just test the pipeline(s) manually
 // using gst-launch and add settings and more this way) but you are encouraged to use other approach(es) if they
 // better fit your needs (see CameraStream.h)
+// With DEV_GST_PIPELINE_BUILDER, the pipeline is built element by element instead (see GstPipelineBuilder).
+namespace openhd{
+struct AppsinkPushDelivery;
+}
+
 class GStreamerStream : public CameraStream {
  public:
   GStreamerStream(PlatformType platform,std::shared_ptr<CameraHolder> camera_holder,
@@ -45,12 +55,24 @@ class GStreamerStream : public CameraStream {
   void setup_ip_camera();
   void setup_sw_dummy_camera();
   void setup_custom_unmanaged_camera();
+  // Alternative to gst_parse_launch (DEV_GST_PIPELINE_BUILDER) - builds the pipeline element by element, the camera part
+  // is only parsed for camera types that have no typed builder yet. Fills m_pipeline_handles, returns nullptr on error.
+  GstElement* build_pipeline(const std::string& camera_pipeline_part);
   /**
    * Stop and cleanup the pipeline (if running), then re-build and re-start it.
    */
   void stop_cleanup_restart();
   // Utils when settings are changed (most of them require a full restart of the pipeline)
   void restart_after_new_setting();
+  // What needs to be done to apply the new settings to the current pipeline
+  openhd::ReconfigureType classify_reconfigure(const CameraSettings& settings);
+  // Apply the new settings without a full restart, returns false if that is not possible
+  bool try_hot_reconfigure(openhd::ReconfigureType type,const CameraSettings& settings);
+  // If air recording should be part of the pipeline (setting and arming state)
+  [[nodiscard]] bool should_record()const;
+  // Attach / detach the recording branch to / from the tee of the running pipeline (see GstRecordingBranch)
+  bool start_recording_branch(VideoCodec codec);
+  bool stop_recording_branch();
   void restartIfStopped() override;
   void handle_change_bitrate_request(openhd::ActionHandler::LinkBitrateInformation lb) override;
   // this is called when the FC reports itself as armed / disarmed
@@ -63,6 +85,17 @@ class GStreamerStream : public CameraStream {
   // Set gst state to GST_STATE_NULL and properly cleanup the pipeline.
   void cleanup_pipe();
   std::string createDebug() override;
+  // Only for testing - select pull (dedicated thread) or push (appsink callback) mode. Takes effect on the next setup()
+  void dirty_set_appsink_push_mode(bool push_mode);
+  // Only for testing - select gst_parse_launch or GstPipelineBuilder. Takes effect on the next setup()
+  void dirty_set_use_pipeline_builder(bool use_pipeline_builder);
+  // Only for testing - gaps in between frames handed to the link (kept across restarts) and blackout per change type
+  const openhd::LatencyHistogram& get_frame_interval_histogram()const{
+    return m_frame_interval_histogram;
+  }
+  const openhd::ReconfigureBlackoutTracker& get_blackout_tracker()const{
+    return m_blackout_tracker;
+  }
  private:
   // We cannot create the debug state while performing a restart
   std::mutex m_pipeline_mutex;
@@ -73,9 +106,22 @@ class GStreamerStream : public CameraStream {
   std::optional<GstBitrateControlElement> m_bitrate_ctrl_element=std::nullopt;
   // The pipeline that is started in the end
   std::stringstream m_pipeline_content;
+  // See DEV_GST_PIPELINE_BUILDER
+  bool m_use_pipeline_builder=false;
+  openhd::GstPipelineHandles m_pipeline_handles{};
+  // How long building the pipeline took (per stage), for debugging
+  std::string m_pipeline_build_timings;
+  // The settings / recording state the current pipeline was built for, to find out what changed
+  CameraSettings m_applied_settings{};
+  bool m_applied_recording=false;
+  openhd::ReconfigureBlackoutTracker m_blackout_tracker;
   // If a pipeline is started with air recording enabled, the file name the recording is written to is stored here
   // otherwise, it is set to std::nullopt
   std::optional<std::string> m_opt_curr_recording_filename=std::nullopt;
+  // See DEV_AIR_RECORDING_FRAGMENTED_MP4 - record to fragmented .mp4 instead of .mkv (no demuxing needed afterwards)
+  bool m_recording_fragmented_mp4=false;
+  // Only with the pipeline builder - recording is started / stopped without restarting the pipeline
+  std::unique_ptr<openhd::GstRecordingBranch> m_recording_branch;
   // To reduce the time on the param callback(s) - they need to return immediately to not block the param server
   void restart_async();
   std::mutex m_async_thread_mutex;
@@ -89,21 +135,43 @@ class GStreamerStream : public CameraStream {
   // This is needed for variable rf link bitrate(s)
   // returns true on success, false otherwise
   bool try_dynamically_change_bitrate(int bitrate_kbits);
+  // Same, but m_pipeline_mutex needs to be held by the caller
+  bool try_dynamically_change_bitrate_locked(int bitrate_kbits);
   std::atomic<int> m_curr_dynamic_bitrate_kbits =-1;
  private:
   // The stuff here is to pull the data out of the gstreamer pipeline, such that we can forward it to the WB link
   void on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts);
   std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  // See DEV_VIDEO_LATENCY_TRACING - time the first fragment of the current frame was received
+  bool m_enable_latency_tracing=false;
+  std::chrono::steady_clock::time_point m_frame_first_fragment_time{};
   void on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments);
+  // Time in between frames handed to the link - gaps show up in max (e.g. when recording is started / stopped).
+  // Not reset on restart, such that the gap of a full restart is included.
+  openhd::LatencyHistogram m_frame_interval_histogram;
+  std::optional<std::chrono::steady_clock::time_point> m_last_frame_time;
   // pull samples (fragments) out of the gstreamer pipeline
   GstElement *m_app_sink_element = nullptr;
   bool m_pull_samples_run=false;
   std::unique_ptr<std::thread> m_pull_samples_thread;
   void loop_pull_samples();
+  // Alternative to the pull thread - data is forwarded directly from the gstreamer streaming thread.
+  // Selected by DEV_GST_APPSINK_PUSH_MODE in the hardware.config
+  bool m_appsink_push_mode=false;
+  std::unique_ptr<openhd::AppsinkPushDelivery> m_appsink_push_delivery;
+  // How late fragments arrive at the appsink (relative to their pts) - for comparing pull and push mode
+  openhd::LatencyHistogram m_appsink_delay_histogram;
+  // Fragments pulled out of the appsink are recycled instead of allocated for each rtp packet.
+  // Lives as long as the stream (not the pipeline), such that the pool stays warm across restarts.
+  std::shared_ptr<openhd::BufferPool> m_fragment_pool=openhd::BufferPool::create();
   std::shared_ptr<openhd::ActionHandler> m_opt_action_handler=nullptr;
  private:
-  // Not working yet, keep the old approach
-  //std::unique_ptr<GstVideoRecorder> m_gst_video_recorder=nullptr;
+  // Only set if DEV_AIR_RECORDING_PREROLL_S>0 - then AIR_RECORDING_AUTO_ARM_DISARM records the rtp frames from here
+  // (including the seconds before arming) instead of adding a recording branch to the pipeline.
+  std::unique_ptr<openhd::PrerollRingRecorder> m_preroll_recorder=nullptr;
+  std::chrono::milliseconds m_preroll{0};
+  // Grows the pre-roll ring if needed for the (new) bitrate, and logs how much pre-roll it holds
+  void update_preroll_ring_size(int bitrate_kbits);
 };
 
 #endif
@@ -8,6 +8,7 @@
 #include "../../lib/wifibroadcast/src/HelperSources/SocketHelper.hpp"
 #include "openhd_external_device.hpp"
 #include "openhd_link.hpp"
+#include "udp_batch_forwarder.h"
 
 // The ground just stupidly forwards video (rtp fragments, to be exact) via UDP
 // for QOpenHD and/or more device(s) to decode and display.
@@ -34,6 +35,11 @@ class OHDVideoGround{
   std::shared_ptr<OHDLink> m_link_handle;
   std::unique_ptr<SocketHelper::UDPMultiForwarder> m_primary_video_forwarder;
   std::unique_ptr<SocketHelper::UDPMultiForwarder> m_secondary_video_forwarder;
+  // Used instead of the UDPMultiForwarder(s) above if DEV_VIDEO_GROUND_BATCH_FORWARDER is enabled
+  std::unique_ptr<openhd::UDPBatchForwarder> m_primary_video_batch_forwarder;
+  std::unique_ptr<openhd::UDPBatchForwarder> m_secondary_video_batch_forwarder;
+  void add_forwarder(int stream_index,const std::string& client_addr,int port);
+  void remove_forwarder(int stream_index,const std::string& client_addr,int port);
   /**
    * Forward video to all device(s) consuming video.
    * Called by the ohd link handle (aka only wb right now)
@@ -0,0 +1,139 @@
+#ifndef OPENHD_PREROLL_RING_RECORDER_H
+#define OPENHD_PREROLL_RING_RECORDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera_enums.hpp"
+#include "openhd_video_frame.h"
+
+namespace openhd{
+
+/**
+ * Air recording that also captures the seconds before it was started (e.g. before arming):
+ * The last N seconds of the encoded (rtp) video are kept in a fixed size memory ring, starting with a keyframe.
+ * When recording is started, the ring is flushed to disk, and all following frames are written too (until stopped).
+ * The frames are stored exactly like they are written to disk (rtp packets, each prefixed by its 2 byte big endian size,
+ * RFC 4571) - a dedicated thread writes them out of the ring with large sequential writes (>= WRITE_CHUNK_SIZE,
+ * or at least every WRITE_INTERVAL).
+ * Feeding frames never allocates and never waits for the disk - if the disk cannot keep up, frames are dropped (and counted).
+ * The ring is sized for a bitrate (see calculate_ring_size), and grown (request_ring_size) if the bitrate goes up.
+ * While recording, the file is written as X.part and renamed to X once it is complete.
+ * GStreamerStream then remuxes it to .mp4 (GstRecordingDemuxer). Until then, it can be played with e.g.
+ * gst-launch-1.0 filesrc location=X.h264.rtp ! "application/x-rtp-stream,media=video,clock-rate=90000,encoding-name=H264" !
+ *   rtpstreamdepay ! rtph264depay ! h264parse ! avdec_h264 ! autovideosink sync=false
+ */
+class PrerollRingRecorder{
+ public:
+  struct Stats{
+    uint64_t n_frames=0;
+    uint64_t n_bytes_in=0;
+    // Ring full while recording (disk too slow) / frame bigger than the ring / waiting for a keyframe
+    uint64_t n_frames_dropped=0;
+    // Older than the pre-roll, or to make space
+    uint64_t n_frames_evicted=0;
+    uint64_t n_bytes_written=0;
+    uint64_t n_writes=0;
+    std::chrono::nanoseconds write_time{0};
+    // Allocated on construction / when the ring is grown
+    uint64_t n_bytes_allocated=0;
+    [[nodiscard]] std::string to_string()const;
+  };
+  // @param preroll how much video is kept before recording is started
+  // @param ring_size_bytes size of the ring (see calculate_ring_size)
+  PrerollRingRecorder(std::chrono::milliseconds preroll,size_t ring_size_bytes);
+  // Stops recording (the file is completed)
+  ~PrerollRingRecorder();
+  PrerollRingRecorder(const PrerollRingRecorder&)=delete;
+  PrerollRingRecorder(PrerollRingRecorder&&)=delete;
+  // Called for each frame, from the thread that produces them
+  void on_new_frame(const FragmentedVideoFrame& frame,VideoCodec codec);
+  // Grows the ring (it never shrinks) to at least the given size, keeping the current pre-roll.
+  // The new ring is allocated on the calling thread - or, while recording, on the write thread once the recording is complete.
+  void request_ring_size(size_t ring_size_bytes);
+  size_t get_ring_size();
+  // Called (on the write thread) each time a recording is complete, with the final file name
+  void set_on_recording_complete(std::function<void(const std::string& filename)> cb);
+  // Writes the pre-roll (from its first keyframe on) and all following frames to the given file, until stop_recording().
+  // Never blocks (e.g. called from the FC arming callback) - the start is queued on the write thread, which opens the file
+  // and takes the pre-roll once the previous recording (if any) is completed.
+  // Returns false if already recording / a start is queued.
+  bool start_recording(const std::string& filename);
+  // Returns once a queued start_recording() has been processed by the write thread,
+  // false if nothing was queued or the file could not be opened.
+  bool wait_until_recording_started();
+  // Also cancels a queued start. The file is completed in the background, unless wait_until_written is set
+  void stop_recording(bool wait_until_written=false);
+  // On demand - write (only) the current pre-roll to the given file, returns once it is written
+  bool save_preroll(const std::string& filename);
+  bool is_recording();
+  Stats get_stats();
+  // Ring size that holds the given pre-roll at the given (max) bitrate, plus some slack for the disk
+  static size_t calculate_ring_size(std::chrono::milliseconds preroll,int max_bitrate_kbits);
+  // The other way around - how much pre-roll a ring of the given size holds at the given bitrate
+  static std::chrono::milliseconds calculate_preroll(size_t ring_size_bytes,int bitrate_kbits);
+  // e.g. ".h264.rtp"
+  static std::string file_suffix_for_video_codec(VideoCodec codec);
+  static constexpr size_t WRITE_CHUNK_SIZE=256*1024;
+  static constexpr auto WRITE_INTERVAL=std::chrono::milliseconds(500);
+ private:
+  struct FrameEntry{
+    // position of the first byte in the ring (monotonic, not wrapped)
+    uint64_t begin;
+    uint32_t size;
+    int64_t time_us;
+    bool keyframe;
+  };
+  // m_mutex needs to be held for all of these
+  FrameEntry& frame_at(size_t index);
+  // returns false if the oldest frame is not written to disk yet
+  bool evict_oldest_frame();
+  void evict_expired_frames(int64_t now_us);
+  static void copy_into_ring(std::vector<uint8_t>& ring,uint64_t pos,const uint8_t* data,size_t size);
+  static size_t calculate_n_frame_entries(size_t ring_size_bytes);
+  // Swaps in a ring of m_requested_ring_size (if larger) unless the write thread is / might be writing out of the ring.
+  // Allocates without holding the lock.
+  void grow_ring_if_requested(std::unique_lock<std::mutex>& lock);
+  void loop_write();
+  // on the write thread, opens the file of the queued start and sets up the flush from the pre-roll on
+  void start_pending_recording(std::unique_lock<std::mutex>& lock);
+  // writes [begin,end) of the ring to the file, without holding m_mutex
+  bool write_to_file(int fd,uint64_t begin,uint64_t end,uint64_t& n_writes);
+  const int64_t m_preroll_us;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<uint8_t> m_ring;
+  // ring of frames in m_ring, oldest first
+  std::vector<FrameEntry> m_frames;
+  size_t m_frames_head=0;
+  size_t m_n_frames=0;
+  // oldest byte in use / next byte to be written by on_new_frame (monotonic)
+  uint64_t m_read_pos=0;
+  uint64_t m_write_pos=0;
+  // recording - next byte to be written to the file
+  int m_fd=-1;
+  bool m_stop_requested=false;
+  // start_recording() - processed by the write thread once m_fd<0
+  std::optional<std::string> m_pending_filename;
+  // the file currently recorded to (without .part)
+  std::string m_curr_filename;
+  size_t m_requested_ring_size=0;
+  std::function<void(const std::string& filename)> m_on_recording_complete;
+  bool m_wait_for_keyframe=false;
+  uint64_t m_flush_pos=0;
+  bool m_terminate=false;
+  Stats m_stats{};
+  std::unique_ptr<std::thread> m_write_thread;
+};
+
+}
+
+#endif  // OPENHD_PREROLL_RING_RECORDER_H
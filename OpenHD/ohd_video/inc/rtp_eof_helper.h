@@ -18,6 +18,11 @@ bool h264_end_block(const uint8_t *payload, std::size_t payloadSize);
 bool h265_end_block(const uint8_t *payload, std::size_t payloadSize);
 bool mjpeg_end_block(const uint8_t *payload, std::size_t payloadSize);
 
+// returns true if this rtp packet is (part of) a keyframe - IDR / IRAP slice or parameter set (which we only get
+// in front of a keyframe, see config-interval=-1)
+bool h264_is_keyframe(const uint8_t *payload, std::size_t payloadSize);
+bool h265_is_keyframe(const uint8_t *payload, std::size_t payloadSize);
+
 }
 
 #endif  // OPENHD_OPENHD_OHD_VIDEO_INC_RTP_EOF_HELPER_H_
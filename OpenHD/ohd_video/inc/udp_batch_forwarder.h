@@ -0,0 +1,107 @@
+#ifndef OPENHD_OPENHD_OHD_VIDEO_INC_UDP_BATCH_FORWARDER_H_
+#define OPENHD_OPENHD_OHD_VIDEO_INC_UDP_BATCH_FORWARDER_H_
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+namespace openhd{
+
+/**
+ * Drop-in replacement for SocketHelper::UDPMultiForwarder (addForwarder / removeForwarder / forwardPacketViaUDP)
+ * for the ground video output.
+ * Instead of one sendto() per packet per destination, packets are accumulated and flushed with one sendmmsg() per destination.
+ * On top, consecutive packets of the same size (which is pretty much every rtp fragment except the last one of a frame)
+ * are sent as one UDP GSO (UDP_SEGMENT) "super datagram" if the kernel supports it.
+ * A batch is flushed when
+ * 1) a packet with the rtp marker bit set arrives (last fragment of a frame - the decoder cannot do anything with
+ * the previous fragments of the frame without it anyways, so this adds (close to) no latency)
+ * 2) the batch is full
+ * 3) the oldest packet in the batch has been waiting for longer than max_delay (e.g. on packet loss / non-rtp data)
+ */
+class UDPBatchForwarder{
+ public:
+  struct Options{
+    // max n of packets per batch. Also the max n of GSO segments per datagram.
+    int max_batch_size=64;
+    // max time a packet might wait in the batch
+    std::chrono::microseconds max_delay=std::chrono::milliseconds(2);
+    // use UDP GSO if the kernel supports it
+    bool enable_gso=true;
+    bool flush_on_rtp_marker=true;
+  };
+  struct DestinationStats{
+    std::string ip;
+    int port=0;
+    uint64_t n_packets=0;
+    uint64_t n_bytes=0;
+    uint64_t n_syscalls=0;
+    uint64_t n_errors=0;
+    [[nodiscard]] std::string to_string()const;
+  };
+  explicit UDPBatchForwarder(Options options);
+  UDPBatchForwarder():UDPBatchForwarder(Options{}){};
+  ~UDPBatchForwarder();
+  UDPBatchForwarder(const UDPBatchForwarder&)=delete;
+  UDPBatchForwarder(UDPBatchForwarder&&)=delete;
+  // Does nothing if the destination already exists
+  void addForwarder(const std::string& ip,int port);
+  void removeForwarder(const std::string& ip,int port);
+  // Enqueue the packet (copied) for all destinations, might flush
+  void forwardPacketViaUDP(const uint8_t *packet,std::size_t packet_len);
+  // Send all enqueued packets now
+  void flush();
+  [[nodiscard]] std::vector<DestinationStats> get_destination_stats();
+  [[nodiscard]] std::string get_stats_string();
+  [[nodiscard]] bool is_gso_active()const{
+    return m_gso_active;
+  }
+ private:
+  struct Destination{
+    sockaddr_in addr{};
+    DestinationStats stats;
+  };
+  struct PacketRef{
+    size_t offset;
+    uint16_t len;
+  };
+  void flush_locked();
+  void send_batch_to(Destination& destination);
+  void loop_flush_timeout();
+  static bool kernel_supports_gso(int fd);
+ private:
+  const Options m_options;
+  std::shared_ptr<spdlog::logger> m_console;
+  int m_socket_fd=-1;
+  std::atomic<bool> m_gso_active=false;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<Destination> m_destinations;
+  // All packets of the current batch are stored back to back in one buffer (needed for GSO)
+  std::vector<uint8_t> m_batch_buffer;
+  std::vector<PacketRef> m_batch_packets;
+  std::chrono::steady_clock::time_point m_batch_first_packet_time{};
+  // re-used for each flush, sized for the worst case (one message per packet)
+  std::vector<mmsghdr> m_msgs;
+  std::vector<iovec> m_iovs;
+  std::vector<size_t> m_msg_n_packets;
+  std::vector<std::array<char,CMSG_SPACE(sizeof(uint16_t))>> m_controls;
+  bool m_flush_thread_run=true;
+  std::unique_ptr<std::thread> m_flush_thread;
+};
+
+}
+
+#endif  // OPENHD_OPENHD_OHD_VIDEO_INC_UDP_BATCH_FORWARDER_H_
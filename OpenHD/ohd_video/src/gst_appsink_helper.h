@@ -8,6 +8,11 @@
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 
+#include <atomic>
+#include <optional>
+
+#include "openhd_buffer_pool.hpp"
+#include "openhd_latency_histogram.hpp"
 #include "openhd_spdlog.h"
 
 namespace openhd{
@@ -25,6 +30,21 @@ static std::shared_ptr<std::vector<uint8_t>> gst_copy_buffer(GstBuffer* buffer){
   return ret;
 }
 
+// Same as above, but the returned buffer is taken from (and later returned to) the given pool instead of being allocated.
+// gst_buffer_extract also saves us the map / unmap.
+static std::shared_ptr<std::vector<uint8_t>> gst_copy_buffer(GstBuffer* buffer,BufferPool& pool){
+  assert(buffer);
+  const auto buff_size = gst_buffer_get_size(buffer);
+  auto ret = pool.acquire(buff_size);
+  const auto n_copied=gst_buffer_extract(buffer,0,ret->data(),buff_size);
+  if(n_copied!=buff_size){
+    // Should never happen - but a pooled buffer might hold (old) data past what was copied, never forward that
+    openhd::log::get_default()->warn("gst_copy_buffer: copied {} of {} bytes",n_copied,buff_size);
+    ret->resize(n_copied);
+  }
+  return ret;
+}
+
 static void gst_debug_buffer(GstBuffer* buffer){
   assert(buffer);
   const auto now=std::chrono::steady_clock::now().time_since_epoch().count();
@@ -70,36 +90,116 @@ void gst_debug_sample(GstSample* sample){
   openhd::log::get_default()->debug("{}",ss.str());
 }
 
+typedef std::function<void(std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts)> APPSINK_FRAGMENT_CB;
+
+// How late a buffer arrives at the appsink, measured as the difference between the current pipeline running time
+// and the buffer pts. Includes the time spent in the encoder / packetizer, but the interesting part
+// is the difference between the pull and push delivery mode.
+static std::optional<std::chrono::nanoseconds> gst_buffer_running_time_delay(GstElement* element,GstBuffer* buffer){
+  if(!GST_BUFFER_PTS_IS_VALID(buffer))return std::nullopt;
+  GstClock* clock=gst_element_get_clock(element);
+  if(clock==nullptr)return std::nullopt;
+  const GstClockTime now=gst_clock_get_time(clock);
+  gst_object_unref(clock);
+  const GstClockTime base_time=gst_element_get_base_time(element);
+  if(now<base_time)return std::nullopt;
+  const GstClockTime running_time=now-base_time;
+  if(running_time<GST_BUFFER_PTS(buffer))return std::nullopt;
+  return std::chrono::nanoseconds(running_time-GST_BUFFER_PTS(buffer));
+}
+
+// Copy the sample data and forward it - shared by the pull and push (callback) delivery mode
+static void gst_forward_appsink_sample(GstElement *app_sink_element,GstSample* sample,const APPSINK_FRAGMENT_CB& out_cb,
+                                       const std::shared_ptr<BufferPool>& opt_pool,LatencyHistogram* opt_delay_histogram){
+  //openhd::log::get_default()->debug("Got sample");
+  //auto buffer_list=gst_sample_get_buffer_list(sample);
+  //openhd::log::get_default()->debug("Got sample {}", gst_buffer_list_length(buffer_list));
+  //gst_debug_sample(sample);
+  GstBuffer* buffer = gst_sample_get_buffer(sample);
+  if (buffer) {
+    //openhd::gst_debug_buffer(buffer);
+    if(opt_delay_histogram){
+      const auto delay=gst_buffer_running_time_delay(app_sink_element,buffer);
+      if(delay.has_value())opt_delay_histogram->record(delay.value());
+    }
+    auto buff_copy=opt_pool ? openhd::gst_copy_buffer(buffer,*opt_pool) : openhd::gst_copy_buffer(buffer);
+    //openhd::log::get_default()->debug("Got buffer size {}", buff_copy->size());
+    out_cb(buff_copy,buffer->dts);
+  }
+}
+
 // based on https://github.com/Samsung/kv2streamer/blob/master/kv2streamer-lib/gst-wrapper/GstAppSinkPipeline.cpp
 /**
  * Helper to pull data out of a gstreamer pipeline
  * @param keep_looping if set to false, method returns after max timeout_ns
  * @param app_sink_element the Gst App Sink to pull data from
  * @param out_cb fragments are forwarded via this cb
+ * @param opt_pool if set, the fragment buffers are taken from this pool (recommended, avoids one allocation per fragment)
+ * @param opt_delay_histogram if set, the delay of each buffer (see gst_buffer_running_time_delay) is recorded
  */
-static void loop_pull_appsink_samples(bool& keep_looping,GstElement *app_sink_element,
-                                      const std::function<void(std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts)>& out_cb){
+static void loop_pull_appsink_samples(bool& keep_looping,GstElement *app_sink_element,const APPSINK_FRAGMENT_CB& out_cb,
+                                      const std::shared_ptr<BufferPool>& opt_pool=nullptr,
+                                      LatencyHistogram* opt_delay_histogram=nullptr){
   assert(app_sink_element);
   assert(out_cb);
   const uint64_t timeout_ns=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(100)).count();
   while (keep_looping){
     GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(app_sink_element),timeout_ns);
     if (sample) {
-      //openhd::log::get_default()->debug("Got sample");
-      //auto buffer_list=gst_sample_get_buffer_list(sample);
-      //openhd::log::get_default()->debug("Got sample {}", gst_buffer_list_length(buffer_list));
-      //gst_debug_sample(sample);
-      GstBuffer* buffer = gst_sample_get_buffer(sample);
-      if (buffer) {
-        //openhd::gst_debug_buffer(buffer);
-        auto buff_copy=openhd::gst_copy_buffer(buffer);
-        //openhd::log::get_default()->debug("Got buffer size {}", buff_copy->size());
-        out_cb(buff_copy,buffer->dts);
-      }
+      gst_forward_appsink_sample(app_sink_element,sample,out_cb,opt_pool,opt_delay_histogram);
       gst_sample_unref(sample);
     }
   }
 }
 
+/**
+ * Alternative to loop_pull_appsink_samples - instead of polling the appsink from a dedicated thread,
+ * the data is forwarded directly from the gstreamer streaming thread via the appsink "new-sample" callback.
+ * Saves the thread hop (and the 100ms polling) per fragment.
+ * The instance must outlive the pipeline (or at least until the pipeline has been set to GST_STATE_NULL,
+ * which guarantees the streaming thread(s) are stopped and no callback is in flight anymore).
+ */
+struct AppsinkPushDelivery{
+  APPSINK_FRAGMENT_CB out_cb;
+  std::shared_ptr<BufferPool> opt_pool=nullptr;
+  LatencyHistogram* opt_delay_histogram=nullptr;
+  GstElement *app_sink_element=nullptr;
+  // Set to false before tearing down the pipeline - samples that still come in are dropped
+  std::atomic<bool> enabled=false;
+};
+
+static GstFlowReturn appsink_push_on_new_sample(GstAppSink *appsink,gpointer user_data){
+  auto* delivery=static_cast<AppsinkPushDelivery*>(user_data);
+  // Non-blocking, there is a sample since we were called
+  GstSample* sample=gst_app_sink_pull_sample(appsink);
+  if(sample==nullptr){
+    return GST_FLOW_EOS;
+  }
+  if(delivery->enabled){
+    gst_forward_appsink_sample(delivery->app_sink_element,sample,delivery->out_cb,delivery->opt_pool,delivery->opt_delay_histogram);
+  }
+  gst_sample_unref(sample);
+  return GST_FLOW_OK;
+}
+
+static void appsink_install_push_delivery(GstElement *app_sink_element,AppsinkPushDelivery& delivery){
+  assert(app_sink_element);
+  assert(delivery.out_cb);
+  delivery.app_sink_element=app_sink_element;
+  GstAppSinkCallbacks callbacks{};
+  callbacks.new_sample=appsink_push_on_new_sample;
+  gst_app_sink_set_callbacks(GST_APP_SINK(app_sink_element),&callbacks,&delivery,nullptr);
+  delivery.enabled=true;
+}
+
+// Stop forwarding - note that a callback might still be in flight until the pipeline has been set to GST_STATE_NULL
+static void appsink_remove_push_delivery(GstElement *app_sink_element,AppsinkPushDelivery& delivery){
+  delivery.enabled=false;
+  if(app_sink_element){
+    GstAppSinkCallbacks callbacks{};
+    gst_app_sink_set_callbacks(GST_APP_SINK(app_sink_element),&callbacks,nullptr,nullptr);
+  }
+}
+
 }
 #endif  // OPENHD_OPENHD_OHD_VIDEO_SRC_GST_APPSINK_HELPER_H_
@@ -0,0 +1,320 @@
+#include "gst_pipeline_builder.h"
+
+#include <mutex>
+
+#include "openhd_spdlog.h"
+#include "openhd_util.h"
+#include "openhd_util_time.hpp"
+
+// Looking up a factory goes through the registry (and loads the plugin the first time), we do that only once per
+// factory name and keep the factory for the lifetime of the process.
+static GstElementFactory* find_factory_cached(const std::string& factory_name){
+  static std::mutex mutex;
+  static std::map<std::string,GstElementFactory*> factories;
+  std::lock_guard<std::mutex> guard(mutex);
+  auto it=factories.find(factory_name);
+  if(it!=factories.end()){
+    return it->second;
+  }
+  GstElementFactory* factory=gst_element_factory_find(factory_name.c_str());
+  if(factory!=nullptr){
+    factories.emplace(factory_name,factory);
+  }
+  return factory;
+}
+
+openhd::GstPipelineBuilder::GstPipelineBuilder(const std::string& pipeline_name) {
+  m_pipeline=gst_pipeline_new(pipeline_name.c_str());
+  gst_object_ref_sink(m_pipeline);
+}
+
+openhd::GstPipelineBuilder::GstPipelineBuilder(GstElement* existing_pipeline,GstElement* link_from) {
+  assert(existing_pipeline);
+  m_pipeline=GST_ELEMENT(gst_object_ref(existing_pipeline));
+  if(link_from!=nullptr){
+    continue_from(link_from);
+  }
+}
+
+openhd::GstPipelineBuilder::~GstPipelineBuilder() {
+  if(m_pipeline){
+    gst_object_unref(m_pipeline);
+  }
+}
+
+void openhd::GstPipelineBuilder::begin_stage(const std::string& stage_name) {
+  m_stage_timings.emplace_back(stage_name,std::chrono::nanoseconds(0));
+}
+
+GstElement* openhd::GstPipelineBuilder::add(const std::string& factory_name,const std::string& name,const Properties& properties) {
+  if(has_error())return nullptr;
+  const auto begin=std::chrono::steady_clock::now();
+  GstElementFactory* factory=find_factory_cached(factory_name);
+  if(factory==nullptr){
+    set_error(fmt::format("No such element [{}]",factory_name));
+    return nullptr;
+  }
+  GstElement* element=gst_element_factory_create(factory,name.empty() ? nullptr : name.c_str());
+  if(element==nullptr){
+    set_error(fmt::format("Cannot create [{}]",factory_name));
+    return nullptr;
+  }
+  m_description<<factory_name;
+  if(!name.empty()){
+    m_description<<" name="<<name;
+  }
+  // Same as gst_parse_launch does - the value is deserialized to the type of the property (int, enum nick, ...)
+  for(const auto& property:properties){
+    if(g_object_class_find_property(G_OBJECT_GET_CLASS(element),property.first.c_str())==nullptr){
+      gst_object_unref(gst_object_ref_sink(element));
+      set_error(fmt::format("[{}] has no property [{}]",factory_name,property.first));
+      return nullptr;
+    }
+    gst_util_set_object_arg(G_OBJECT(element),property.first.c_str(),property.second.c_str());
+    m_description<<" "<<property.first<<"="<<property.second;
+  }
+  m_description<<" ! ";
+  if(!add_and_link(element)){
+    return nullptr;
+  }
+  if(!name.empty()){
+    m_named_elements[name]=element;
+  }
+  account_time(begin);
+  return element;
+}
+
+GstElement* openhd::GstPipelineBuilder::add_caps_filter(const std::string& caps,const std::string& name) {
+  if(has_error())return nullptr;
+  const auto begin=std::chrono::steady_clock::now();
+  GstCaps* gst_caps=gst_caps_from_string(caps.c_str());
+  if(gst_caps==nullptr){
+    set_error(fmt::format("Invalid caps [{}]",caps));
+    return nullptr;
+  }
+  GstElementFactory* factory=find_factory_cached("capsfilter");
+  GstElement* element=factory==nullptr ? nullptr : gst_element_factory_create(factory,name.empty() ? nullptr : name.c_str());
+  if(element==nullptr){
+    gst_caps_unref(gst_caps);
+    set_error("Cannot create capsfilter");
+    return nullptr;
+  }
+  g_object_set(element,"caps",gst_caps,NULL);
+  gst_caps_unref(gst_caps);
+  m_description<<caps<<" ! ";
+  if(!add_and_link(element)){
+    return nullptr;
+  }
+  if(!name.empty()){
+    m_named_elements[name]=element;
+  }
+  account_time(begin);
+  return element;
+}
+
+GstElement* openhd::GstPipelineBuilder::add_from_description(const std::string& description) {
+  if(has_error())return nullptr;
+  const auto begin=std::chrono::steady_clock::now();
+  std::string bin_description=description;
+  while (!bin_description.empty() && (bin_description.back()==' ' || bin_description.back()=='!')){
+    bin_description.pop_back();
+  }
+  GError* error=nullptr;
+  GstElement* bin=gst_parse_bin_from_description(bin_description.c_str(),TRUE,&error);
+  if(error!=nullptr){
+    set_error(fmt::format("Cannot parse [{}]: {}",bin_description,error->message));
+    g_error_free(error);
+    if(bin!=nullptr){
+      gst_object_unref(gst_object_ref_sink(bin));
+    }
+    return nullptr;
+  }
+  m_description<<bin_description<<" ! ";
+  if(!add_and_link(bin)){
+    return nullptr;
+  }
+  account_time(begin);
+  return bin;
+}
+
+void openhd::GstPipelineBuilder::continue_from(GstElement* element) {
+  if(has_error())return;
+  assert(element);
+  m_tail=element;
+  m_description<<" "<<GST_ELEMENT_NAME(element)<<". ! ";
+}
+
+bool openhd::GstPipelineBuilder::link_to(GstElement* element) {
+  if(has_error())return false;
+  assert(element);
+  if(m_tail==nullptr || !gst_element_link(m_tail,element)){
+    set_error(fmt::format("Cannot link to [{}]",GST_ELEMENT_NAME(element)));
+    return false;
+  }
+  m_description<<GST_ELEMENT_NAME(element)<<". ! ";
+  m_tail=element;
+  return true;
+}
+
+const std::vector<GstElement*>& openhd::GstPipelineBuilder::get_added_elements() const {
+  return m_added_elements;
+}
+
+GstElement* openhd::GstPipelineBuilder::get_element(const std::string& name) const {
+  auto it=m_named_elements.find(name);
+  if(it!=m_named_elements.end()){
+    return it->second;
+  }
+  if(m_pipeline==nullptr)return nullptr;
+  GstElement* ret=gst_bin_get_by_name(GST_BIN(m_pipeline),name.c_str());
+  if(ret!=nullptr){
+    // The pipeline keeps it alive
+    gst_object_unref(ret);
+  }
+  return ret;
+}
+
+bool openhd::GstPipelineBuilder::has_error() const {
+  return !m_error.empty();
+}
+
+const std::string& openhd::GstPipelineBuilder::get_error() const {
+  return m_error;
+}
+
+std::string openhd::GstPipelineBuilder::get_description() const {
+  auto ret=m_description.str();
+  // The last element is not linked to anything
+  if(OHDUtil::endsWith(ret," ! ")){
+    ret.resize(ret.size()-3);
+  }
+  return ret;
+}
+
+std::string openhd::GstPipelineBuilder::get_stage_timings_string() const {
+  std::stringstream ss;
+  for(const auto& stage:m_stage_timings){
+    ss<<stage.first<<":"<<openhd::util::time::R(stage.second)<<" ";
+  }
+  ss<<"total:"<<openhd::util::time::R(get_total_construction_time());
+  return ss.str();
+}
+
+std::chrono::nanoseconds openhd::GstPipelineBuilder::get_total_construction_time() const {
+  std::chrono::nanoseconds ret{0};
+  for(const auto& stage:m_stage_timings){
+    ret+=stage.second;
+  }
+  return ret;
+}
+
+GstElement* openhd::GstPipelineBuilder::release_pipeline() {
+  if(has_error()){
+    openhd::log::get_default()->warn("Not releasing pipeline, error: {}",m_error);
+    return nullptr;
+  }
+  GstElement* ret=m_pipeline;
+  m_pipeline=nullptr;
+  m_tail=nullptr;
+  m_named_elements.clear();
+  m_added_elements.clear();
+  return ret;
+}
+
+void openhd::GstPipelineBuilder::set_error(std::string error) {
+  openhd::log::get_default()->warn("GstPipelineBuilder: {}",error);
+  m_error=std::move(error);
+}
+
+bool openhd::GstPipelineBuilder::add_and_link(GstElement* element) {
+  assert(m_pipeline);
+  // The bin takes ownership of the floating reference
+  gst_bin_add(GST_BIN(m_pipeline),element);
+  m_added_elements.push_back(element);
+  if(m_tail!=nullptr && !gst_element_link(m_tail,element)){
+    set_error(fmt::format("Cannot link [{}] to [{}]",GST_ELEMENT_NAME(m_tail),GST_ELEMENT_NAME(element)));
+    return false;
+  }
+  m_tail=element;
+  return true;
+}
+
+void openhd::GstPipelineBuilder::account_time(std::chrono::steady_clock::time_point begin) {
+  if(m_stage_timings.empty()){
+    begin_stage("default");
+  }
+  m_stage_timings.back().second+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-begin);
+}
+
+GstElement* OHDGstHelper::add_sw_encoder(openhd::GstPipelineBuilder& builder,const CommonEncoderParams& common_encoder_params) {
+  const auto bitrate=std::to_string(common_encoder_params.h26X_bitrate_kbits);
+  const auto keyframe_interval=std::to_string(common_encoder_params.h26X_keyframe_interval);
+  if(common_encoder_params.videoCodec==VideoCodec::H264){
+    // See createSwEncoder for why sliced-threads=0 threads=2
+    return builder.add("x264enc","swencoder",{{"bitrate",bitrate},{"speed-preset","ultrafast"},{"tune","zerolatency"},
+                                                {"key-int-max",keyframe_interval},{"sliced-threads","0"},{"threads","2"}});
+  }else if(common_encoder_params.videoCodec==VideoCodec::H265){
+    return builder.add("x265enc","swencoder",{{"bitrate",bitrate},{"speed-preset","ultrafast"},{"tune","zerolatency"},
+                                                {"key-int-max",keyframe_interval}});
+  }
+  assert(common_encoder_params.videoCodec==VideoCodec::MJPEG);
+  return builder.add("jpegenc","",{{"quality",std::to_string(common_encoder_params.mjpeg_quality_percent)}});
+}
+
+GstElement* OHDGstHelper::add_dummy_stream(openhd::GstPipelineBuilder& builder,const CameraSettings& settings) {
+  builder.add("videotestsrc","videotestsrc");
+  builder.add_caps_filter(create_dummy_stream_caps(settings),"source_caps");
+  return add_sw_encoder(builder,extract_common_encoder_params(settings));
+}
+
+std::string OHDGstHelper::create_dummy_stream_caps(const CameraSettings& settings) {
+  return fmt::format("video/x-raw, format=I420,width={},height={},framerate={}/1",
+                     settings.streamed_video_format.width, settings.streamed_video_format.height,
+                     settings.streamed_video_format.framerate);
+}
+
+void OHDGstHelper::add_parse_and_rtp_packetize(openhd::GstPipelineBuilder& builder,VideoCodec videoCodec) {
+  builder.add("queue");
+  // config-interval=-1 = makes 100% sure each keyframe has SPS and PPS
+  if(videoCodec==VideoCodec::H264){
+    builder.add("h264parse","out_parser",{{"config-interval","-1"}});
+    builder.add("rtph264pay","out_rtppay",{{"mtu","1024"}});
+  }else if(videoCodec==VideoCodec::H265){
+    builder.add("h265parse","out_parser",{{"config-interval","-1"}});
+    builder.add("rtph265pay","out_rtppay",{{"mtu","1024"}});
+  }else{
+    assert(videoCodec==VideoCodec::MJPEG);
+    builder.add("jpegparse","out_parser");
+    builder.add("rtpjpegpay","out_rtppay",{{"mtu","1024"}});
+  }
+}
+
+GstElement* OHDGstHelper::add_output_appsink(openhd::GstPipelineBuilder& builder) {
+  return builder.add("appsink","out_appsink",{{"drop","true"}});
+}
+
+GstElement* OHDGstHelper::add_recording_tee(openhd::GstPipelineBuilder& builder) {
+  return builder.add("tee","t",{{"allow-not-linked","true"}});
+}
+
+void OHDGstHelper::add_recording_for_video_codec(openhd::GstPipelineBuilder& builder,VideoCodec videoCodec,const std::string& out_filename,
+                                                 bool fragmented_mp4) {
+  builder.add("queue");
+  if(videoCodec==VideoCodec::H264){
+    builder.add("h264parse");
+  }else if(videoCodec==VideoCodec::H265){
+    builder.add("h265parse");
+  }else{
+    assert(videoCodec==VideoCodec::MJPEG);
+    builder.add("jpegparse");
+  }
+  // .mkv (or fragmented .mp4) for h264 / h265, .avi for mjpeg - see createRecordingForVideoCodec
+  if((videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265) && fragmented_mp4){
+    builder.add("mp4mux","",{{"fragment-duration","1000"}});
+  }else if(videoCodec==VideoCodec::H264 || videoCodec==VideoCodec::H265){
+    builder.add("matroskamux");
+  }else{
+    builder.add("avimux");
+  }
+  builder.add("filesink","",{{"location",out_filename}});
+}
@@ -0,0 +1,229 @@
+#include "gst_pipeline_reconfigure.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+std::string openhd::reconfigure_type_to_string(ReconfigureType type) {
+  switch (type) {
+    case ReconfigureType::NONE: return "none";
+    case ReconfigureType::BITRATE: return "bitrate";
+    case ReconfigureType::RECORDING: return "recording";
+    case ReconfigureType::CAPS: return "caps";
+    case ReconfigureType::ENCODER: return "encoder";
+    case ReconfigureType::FULL_RESTART: return "full_restart";
+  }
+  return "unknown";
+}
+
+openhd::ReconfigureType openhd::classify_settings_change(const CameraSettings& applied,const CameraSettings& next) {
+  // Everything apart from what we can change on a playing pipeline needs to be the same
+  CameraSettings normalized=next;
+  normalized.streamed_video_format=applied.streamed_video_format;
+  normalized.h26x_bitrate_kbits=applied.h26x_bitrate_kbits;
+  normalized.h26x_keyframe_interval=applied.h26x_keyframe_interval;
+  normalized.mjpeg_quality_percent=applied.mjpeg_quality_percent;
+  normalized.air_recording=applied.air_recording;
+  const nlohmann::json j_applied=applied;
+  const nlohmann::json j_normalized=normalized;
+  if(j_applied!=j_normalized){
+    return ReconfigureType::FULL_RESTART;
+  }
+  // Not part of the json (not persisted)
+  if(applied.recordingFormat.videoCodec!=next.recordingFormat.videoCodec || !(applied.recordingFormat==next.recordingFormat) ||
+      applied.recordingKBits!=next.recordingKBits || applied.recordingQP!=next.recordingQP ||
+      applied.recordingRCMode!=next.recordingRCMode){
+    return ReconfigureType::FULL_RESTART;
+  }
+  const auto& applied_format=applied.streamed_video_format;
+  const auto& next_format=next.streamed_video_format;
+  const bool is_mjpeg=next_format.videoCodec==VideoCodec::MJPEG;
+  if(applied_format.videoCodec!=next_format.videoCodec){
+    return ReconfigureType::ENCODER;
+  }
+  if(!is_mjpeg && applied.h26x_keyframe_interval!=next.h26x_keyframe_interval){
+    return ReconfigureType::ENCODER;
+  }
+  if(is_mjpeg && applied.mjpeg_quality_percent!=next.mjpeg_quality_percent){
+    return ReconfigureType::ENCODER;
+  }
+  // Note: VideoFormat::operator== doesn't check the codec
+  if(!(applied_format==next_format)){
+    return ReconfigureType::CAPS;
+  }
+  // MJPEG has no bitrate
+  if(!is_mjpeg && applied.h26x_bitrate_kbits!=next.h26x_bitrate_kbits){
+    return ReconfigureType::BITRATE;
+  }
+  return ReconfigureType::NONE;
+}
+
+bool openhd::hot_change_caps(GstElement* caps_filter,const std::string& caps) {
+  assert(caps_filter);
+  GstCaps* new_caps=gst_caps_from_string(caps.c_str());
+  if(new_caps==nullptr){
+    openhd::log::get_default()->warn("Invalid caps [{}]",caps);
+    return false;
+  }
+  GstCaps* curr_caps=nullptr;
+  g_object_get(caps_filter,"caps",&curr_caps,NULL);
+  const bool unchanged=curr_caps!=nullptr && gst_caps_is_equal(curr_caps,new_caps);
+  if(!unchanged){
+    // The caps filter asks upstream to renegotiate
+    g_object_set(caps_filter,"caps",new_caps,NULL);
+  }
+  if(curr_caps!=nullptr)gst_caps_unref(curr_caps);
+  gst_caps_unref(new_caps);
+  return true;
+}
+
+// Shared with the probe callback (streaming thread), freed by gstreamer when the probe is removed
+struct openhd::ScopedPadBlock::State{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool blocked=false;
+};
+
+static GstPadProbeReturn on_pad_blocked(GstPad* pad,GstPadProbeInfo* info,gpointer user_data){
+  auto state=*static_cast<std::shared_ptr<openhd::ScopedPadBlock::State>*>(user_data);
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->blocked=true;
+  state->cv.notify_all();
+  // Keep blocking until the probe is removed
+  return GST_PAD_PROBE_OK;
+}
+
+static void free_pad_block_state(gpointer user_data){
+  delete static_cast<std::shared_ptr<openhd::ScopedPadBlock::State>*>(user_data);
+}
+
+openhd::ScopedPadBlock::ScopedPadBlock(GstPad* pad):m_pad(GST_PAD(gst_object_ref(pad))),m_state(std::make_shared<State>()) {
+  m_probe_id=gst_pad_add_probe(m_pad,GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,on_pad_blocked,
+                               new std::shared_ptr<State>(m_state),free_pad_block_state);
+}
+
+openhd::ScopedPadBlock::~ScopedPadBlock() {
+  gst_pad_remove_probe(m_pad,m_probe_id);
+  gst_object_unref(m_pad);
+}
+
+bool openhd::ScopedPadBlock::wait_blocked(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  return m_state->cv.wait_for(lock,timeout,[this](){return m_state->blocked;});
+}
+
+GstElement* openhd::get_downstream_element(GstElement* element) {
+  GstElement* ret=nullptr;
+  GstIterator* it=gst_element_iterate_src_pads(element);
+  GValue item=G_VALUE_INIT;
+  while (ret==nullptr && gst_iterator_next(it,&item)==GST_ITERATOR_OK){
+    auto* pad=GST_PAD(g_value_get_object(&item));
+    GstPad* peer=gst_pad_get_peer(pad);
+    if(peer!=nullptr){
+      ret=gst_pad_get_parent_element(peer);
+      gst_object_unref(peer);
+    }
+    g_value_reset(&item);
+  }
+  g_value_unset(&item);
+  gst_iterator_free(it);
+  return ret;
+}
+
+bool openhd::hot_replace_encoder(GstElement* pipeline,GstPipelineHandles& handles,const CameraSettings& settings,
+                                 const std::string& source_caps,std::chrono::milliseconds block_timeout) {
+  assert(pipeline && handles.caps_filter && handles.appsink);
+  auto console=openhd::log::get_default();
+  GstPad* block_pad=gst_element_get_static_pad(handles.caps_filter,"src");
+  if(block_pad==nullptr)return false;
+  // The source streaming thread is blocked once it pushes the next buffer, until we return
+  ScopedPadBlock block(block_pad);
+  gst_object_unref(block_pad);
+  if(!block.wait_blocked(block_timeout)){
+    console->warn("hot_replace_encoder: source not blocked after {}ms",block_timeout.count());
+    return false;
+  }
+  // Everything in between the caps filter and the appsink
+  std::vector<GstElement*> old_elements;
+  GstElement* curr=get_downstream_element(handles.caps_filter);
+  while (curr!=nullptr && curr!=handles.appsink){
+    old_elements.push_back(curr);
+    curr=get_downstream_element(curr);
+  }
+  if(curr==nullptr || old_elements.empty()){
+    console->warn("hot_replace_encoder: unexpected pipeline layout");
+    if(curr!=nullptr)gst_object_unref(curr);
+    for(auto* element:old_elements)gst_object_unref(element);
+    return false;
+  }
+  gst_object_unref(curr);
+  // Nothing flows into them anymore - this also stops the queue thread
+  for(auto* element:old_elements){
+    gst_element_set_state(element,GST_STATE_NULL);
+  }
+  for(auto* element:old_elements){
+    // Unlinks all its pads
+    gst_bin_remove(GST_BIN(pipeline),element);
+    gst_object_unref(element);
+  }
+  const bool with_tee=handles.tee!=nullptr;
+  handles.encoder=nullptr;
+  handles.tee=nullptr;
+  handles.parser=nullptr;
+  handles.payloader=nullptr;
+  hot_change_caps(handles.caps_filter,source_caps);
+  GstPipelineBuilder builder(pipeline,handles.caps_filter);
+  GstElement* encoder=OHDGstHelper::add_sw_encoder(builder,OHDGstHelper::extract_common_encoder_params(settings));
+  GstElement* tee=with_tee ? OHDGstHelper::add_recording_tee(builder) : nullptr;
+  OHDGstHelper::add_parse_and_rtp_packetize(builder,settings.streamed_video_format.videoCodec);
+  builder.link_to(handles.appsink);
+  if(builder.has_error()){
+    console->warn("hot_replace_encoder: {}",builder.get_error());
+    return false;
+  }
+  // Downstream first, such that each element is ready to receive data when its upstream element starts pushing
+  const auto& added=builder.get_added_elements();
+  for(auto it=added.rbegin();it!=added.rend();++it){
+    gst_element_sync_state_with_parent(*it);
+  }
+  handles.encoder=encoder;
+  handles.tee=tee;
+  handles.parser=builder.get_element("out_parser");
+  handles.payloader=builder.get_element("out_rtppay");
+  console->debug("hot_replace_encoder: replaced {} elements with [{}]",old_elements.size(),builder.get_description());
+  return true;
+}
+
+void openhd::ReconfigureBlackoutTracker::begin(ReconfigureType type) {
+  const auto now_us=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  m_begin_us.store(now_us,std::memory_order_relaxed);
+  m_pending_type.store(static_cast<int>(type),std::memory_order_release);
+}
+
+std::optional<openhd::ReconfigureType> openhd::ReconfigureBlackoutTracker::on_fragment() {
+  if(m_pending_type.load(std::memory_order_relaxed)<0)return std::nullopt;
+  const int type=m_pending_type.exchange(-1,std::memory_order_acq_rel);
+  if(type<0)return std::nullopt;
+  const auto now_us=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  m_blackout[type].record_us(now_us-m_begin_us.load(std::memory_order_relaxed));
+  return static_cast<ReconfigureType>(type);
+}
+
+const openhd::LatencyHistogram& openhd::ReconfigureBlackoutTracker::get_blackout(ReconfigureType type) const {
+  return m_blackout[static_cast<int>(type)];
+}
+
+std::string openhd::ReconfigureBlackoutTracker::to_string() const {
+  std::stringstream ss;
+  ss<<"Blackout{";
+  for(int i=0;i<N_RECONFIGURE_TYPES;i++){
+    if(m_blackout[i].count()==0)continue;
+    ss<<reconfigure_type_to_string(static_cast<ReconfigureType>(i))<<":"<<m_blackout[i].to_string()<<" ";
+  }
+  ss<<"}";
+  return ss.str();
+}
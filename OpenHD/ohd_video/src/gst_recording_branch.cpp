@@ -0,0 +1,142 @@
+#include "gst_recording_branch.h"
+
+#include <gst/video/video.h>
+
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+
+#include "gst_pipeline_builder.h"
+#include "gst_pipeline_reconfigure.h"
+#include "openhd_spdlog.h"
+
+// A recording should start with a keyframe, drop everything before the first one
+static GstPadProbeReturn drop_until_keyframe(GstPad* pad,GstPadProbeInfo* info,gpointer user_data){
+  GstBuffer* buffer=GST_PAD_PROBE_INFO_BUFFER(info);
+  if(GST_BUFFER_FLAG_IS_SET(buffer,GST_BUFFER_FLAG_DELTA_UNIT)){
+    return GST_PAD_PROBE_DROP;
+  }
+  return GST_PAD_PROBE_REMOVE;
+}
+
+// Shared with the probe callback (streaming thread), freed by gstreamer when the probe is removed
+struct EosState{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool eos=false;
+};
+
+static GstPadProbeReturn on_eos_at_sink(GstPad* pad,GstPadProbeInfo* info,gpointer user_data){
+  if(GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info))==GST_EVENT_EOS){
+    auto state=*static_cast<std::shared_ptr<EosState>*>(user_data);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->eos=true;
+    state->cv.notify_all();
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void free_eos_state(gpointer user_data){
+  delete static_cast<std::shared_ptr<EosState>*>(user_data);
+}
+
+static GstPad* request_tee_src_pad(GstElement* tee){
+#if GST_CHECK_VERSION(1,20,0)
+  return gst_element_request_pad_simple(tee,"src_%u");
+#else
+  return gst_element_get_request_pad(tee,"src_%u");
+#endif
+}
+
+openhd::GstRecordingBranch::GstRecordingBranch(GstElement* pipeline,GstElement* tee,GstElement* bin,GstElement* filesink,
+                                                GstPad* tee_pad,std::string filename)
+    :m_pipeline(pipeline),m_tee(tee),m_bin(bin),m_filesink(filesink),m_tee_pad(tee_pad),m_filename(std::move(filename)) {}
+
+std::unique_ptr<openhd::GstRecordingBranch> openhd::GstRecordingBranch::attach(GstElement* pipeline,GstElement* tee,VideoCodec codec,
+                                                                               const std::string& filename,bool fragmented_mp4) {
+  assert(pipeline && tee);
+  auto console=openhd::log::get_default();
+  GstElement* bin=gst_bin_new("recording_bin");
+  GstElement* filesink;
+  GstElement* first;
+  {
+    GstPipelineBuilder builder(bin,nullptr);
+    OHDGstHelper::add_recording_for_video_codec(builder,codec,filename,fragmented_mp4);
+    if(builder.has_error()){
+      console->warn("Cannot create recording branch: {}",builder.get_error());
+      gst_object_unref(gst_object_ref_sink(bin));
+      return nullptr;
+    }
+    first=builder.get_added_elements().front();
+    filesink=builder.get_added_elements().back();
+  }
+  // Otherwise the filesink would wait for preroll when added to the playing pipeline
+  g_object_set(filesink,"async",FALSE,nullptr);
+  GstPad* first_sink_pad=gst_element_get_static_pad(first,"sink");
+  GstPad* ghost_pad=gst_ghost_pad_new("sink",first_sink_pad);
+  gst_object_unref(first_sink_pad);
+  gst_pad_set_active(ghost_pad,TRUE);
+  gst_element_add_pad(bin,ghost_pad);
+  gst_bin_add(GST_BIN(pipeline),bin);
+  gst_element_sync_state_with_parent(bin);
+  GstPad* tee_pad=request_tee_src_pad(tee);
+  if(tee_pad==nullptr || gst_pad_link(tee_pad,ghost_pad)!=GST_PAD_LINK_OK){
+    console->warn("Cannot link recording branch to tee");
+    if(tee_pad!=nullptr){
+      gst_element_release_request_pad(tee,tee_pad);
+      gst_object_unref(tee_pad);
+    }
+    gst_element_set_state(bin,GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline),bin);
+    return nullptr;
+  }
+  gst_pad_add_probe(tee_pad,GST_PAD_PROBE_TYPE_BUFFER,drop_until_keyframe,nullptr,nullptr);
+  // Don't wait for the next regular keyframe. Fails (harmless) if the pipeline is not playing yet,
+  // the first frame is a keyframe anyways then.
+  gst_pad_send_event(tee_pad,gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE,TRUE,0));
+  console->debug("Recording branch attached, writing to {}",filename);
+  return std::unique_ptr<GstRecordingBranch>(new GstRecordingBranch(pipeline,tee,bin,filesink,tee_pad,filename));
+}
+
+openhd::GstRecordingBranch::~GstRecordingBranch() {
+  gst_object_unref(m_tee_pad);
+}
+
+bool openhd::GstRecordingBranch::detach(std::chrono::milliseconds eos_timeout) {
+  if(m_detached)return true;
+  m_detached=true;
+  auto console=openhd::log::get_default();
+  GstPad* ghost_pad=gst_element_get_static_pad(m_bin,"sink");
+  {
+    // Unlink between two buffers. If nothing comes along (pipeline not playing), nothing is pushed through the pad
+    // either, and it is safe to unlink anyways.
+    ScopedPadBlock block(m_tee_pad);
+    if(!block.wait_blocked(eos_timeout)){
+      console->debug("Recording branch: tee not blocked after {}ms",eos_timeout.count());
+    }
+    gst_pad_unlink(m_tee_pad,ghost_pad);
+  }
+  // tee ignores the now unlinked pad (allow-not-linked) until it is released
+  gst_element_release_request_pad(m_tee,m_tee_pad);
+  // EOS travels through the queue and lets the muxer write its index / headers, wait for it at the filesink
+  GstPad* filesink_pad=gst_element_get_static_pad(m_filesink,"sink");
+  auto state=std::make_shared<EosState>();
+  const gulong probe_id=gst_pad_add_probe(filesink_pad,GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,on_eos_at_sink,
+                                          new std::shared_ptr<EosState>(state),free_eos_state);
+  gst_pad_send_event(ghost_pad,gst_event_new_eos());
+  bool finalized;
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    finalized=state->cv.wait_for(lock,eos_timeout,[&state](){return state->eos;});
+  }
+  gst_pad_remove_probe(filesink_pad,probe_id);
+  gst_object_unref(filesink_pad);
+  gst_object_unref(ghost_pad);
+  gst_element_set_state(m_bin,GST_STATE_NULL);
+  gst_bin_remove(GST_BIN(m_pipeline),m_bin);
+  if(!finalized){
+    console->warn("Recording {} not finalized after {}ms",m_filename,eos_timeout.count());
+  }
+  console->debug("Recording branch detached");
+  return finalized;
+}
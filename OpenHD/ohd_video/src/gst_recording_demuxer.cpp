@@ -4,87 +4,402 @@
 
 #include "gst_recording_demuxer.h"
 
+#include <gst/gst.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <optional>
+#include <sstream>
 #include <string>
 
 #include "openhd_util_filesystem.h"
 #include "openhd_util.h"
 #include "openhd_spdlog.h"
 #include "air_recording_helper.hpp"
+#include "gst_helper.hpp"
 
 static std::string create_gst_demux_pipeline(const std::string& in_file,const std::string& out_file){
   return fmt::format("filesrc location={} ! matroskademux  ! qtmux ! filesink location={}",in_file,out_file);
 }
 
-static bool run_gst_pipeline(const std::string& pipeline){
-  return true;
+// Lowest cpu priority and idle io class (on linux, both apply to the calling thread only).
+// Demuxing is not time critical at all, but the live video / telemetry is.
+static void lower_current_thread_priority(){
+  const auto tid=static_cast<id_t>(syscall(SYS_gettid));
+  if(setpriority(PRIO_PROCESS,tid,19)!=0){
+    openhd::log::get_default()->debug("Cannot lower priority of demux thread");
+  }
+  // No glibc wrapper for ioprio_set - IOPRIO_WHO_PROCESS=1, IOPRIO_CLASS_IDLE=3
+  static constexpr int IOPRIO_CLASS_SHIFT=13;
+  if(syscall(SYS_ioprio_set,1,tid,3<<IOPRIO_CLASS_SHIFT)!=0){
+    openhd::log::get_default()->debug("Cannot set idle io priority of demux thread");
+  }
 }
 
+// Called from each streaming thread gstreamer creates for the demux pipeline, when the thread starts
+static GstBusSyncReply on_demux_sync_message(GstBus* bus,GstMessage* msg,gpointer user_data){
+  if(GST_MESSAGE_TYPE(msg)==GST_MESSAGE_STREAM_STATUS){
+    GstStreamStatusType type;
+    GstElement* owner;
+    gst_message_parse_stream_status(msg,&type,&owner);
+    if(type==GST_STREAM_STATUS_TYPE_ENTER){
+      lower_current_thread_priority();
+    }
+  }
+  return GST_BUS_PASS;
+}
 
-// NOTE: Requires gstreamer to be installed !
 // Takes a .mkv (matroska) file as input and converts it into more manageable
 // .mp4
-
-static void demux_mkv(const std::string& in_file){
-  //if(true) return ;
+bool GstRecordingDemuxer::demux_mkv(const std::string& in_file,std::atomic<int>& progress_perc){
   auto console=openhd::log::create_or_get("gst_demuxer");
   console->debug("Demuxing {}", in_file);
-  assert(OHDFilesystemUtil::exists(in_file));
+  if(!OHDFilesystemUtil::exists(in_file)){
+    console->warn("Cannot demux {}, does not exist",in_file);
+    return false;
+  }
   assert(OHDUtil::endsWith(in_file,".mkv"));
   assert(in_file.size()>=4);
   const std::string file_without_suffix= in_file.substr(0, in_file.size()-4);
   const std::string out_file_mp4=file_without_suffix+".mp4";
+  // Written to a temporary file first, such that a .mp4 is always complete
+  const std::string out_file_part=out_file_mp4+".part";
   console->debug("New file name: {}",out_file_mp4);
-  // convert the file
-  OHDUtil::run_command("gst-launch-1.0", {create_gst_demux_pipeline(in_file,out_file_mp4)});
-  if(!OHDFilesystemUtil::exists(out_file_mp4)){
-    // conversion probably not successful
-    console->warn("Cannot convert {} to {}", in_file,out_file_mp4);
-    return ;
+  if(OHDFilesystemUtil::exists(out_file_mp4) && OHDFilesystemUtil::get_file_size_bytes(out_file_mp4)>0){
+    // Interrupted after the .mp4 was complete, but before the .mkv was deleted
+    console->debug("{} already demuxed",in_file);
+    OHDFilesystemUtil::remove_if_existing(in_file);
+    return true;
   }
-  if(OHDFilesystemUtil::get_file_size_bytes(out_file_mp4)==0){
-    // something must have gone wrong during conversion
-    console->warn("Cannot demux,{} is empty",out_file_mp4);
-    OHDFilesystemUtil::remove_if_existing(out_file_mp4);
-    return ;
+  // Left over from an interrupted job
+  OHDFilesystemUtil::remove_if_existing(out_file_part);
+  GError *error = nullptr;
+  GstElement* pipeline=gst_parse_launch(create_gst_demux_pipeline(in_file,out_file_part).c_str(),&error);
+  if(error){
+    console->warn("Cannot create demux pipeline: {}",error->message);
+    g_error_free(error);
+    if(pipeline)gst_object_unref(pipeline);
+    return false;
+  }
+  GstBus* bus=gst_element_get_bus(pipeline);
+  gst_bus_set_sync_handler(bus,on_demux_sync_message,nullptr,nullptr);
+  const long in_size=OHDFilesystemUtil::get_file_size_bytes(in_file);
+  gst_element_set_state(pipeline,GST_STATE_PLAYING);
+  bool success=false;
+  int last_logged_perc=0;
+  while (!m_terminate){
+    GstMessage* msg=gst_bus_timed_pop_filtered(bus,500*GST_MSECOND,static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if(msg!=nullptr){
+      success=GST_MESSAGE_TYPE(msg)==GST_MESSAGE_EOS;
+      if(!success){
+        GError* gerror=nullptr;
+        gchar* debug_info=nullptr;
+        gst_message_parse_error(msg,&gerror,&debug_info);
+        console->warn("Cannot demux {}: {}",in_file,gerror ? gerror->message : "?");
+        if(gerror)g_error_free(gerror);
+        g_free(debug_info);
+      }
+      gst_message_unref(msg);
+      break;
+    }
+    // Remuxing doesn't change the size much, good enough as an estimate
+    if(in_size>0){
+      const auto out_size=OHDFilesystemUtil::get_file_size_bytes(out_file_part);
+      progress_perc=static_cast<int>(std::min(99L,std::max(0L,out_size)*100/in_size));
+      if(progress_perc>=last_logged_perc+25){
+        last_logged_perc=progress_perc;
+        console->debug("Demuxing {} {}%",in_file,last_logged_perc);
+      }
+    }
   }
+  gst_element_set_state(pipeline,GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline);
+  if(!success || OHDFilesystemUtil::get_file_size_bytes(out_file_part)<=0){
+    // conversion not successful / aborted - the .mkv is kept (and demuxed again next time)
+    if(success){
+      console->warn("Cannot demux,{} is empty",out_file_mp4);
+    }
+    OHDFilesystemUtil::remove_if_existing(out_file_part);
+    return false;
+  }
+  if(std::rename(out_file_part.c_str(),out_file_mp4.c_str())!=0){
+    console->warn("Cannot rename {}",out_file_part);
+    OHDFilesystemUtil::remove_if_existing(out_file_part);
+    return false;
+  }
+  progress_perc=100;
   // Now we can safely delete the old file
   OHDFilesystemUtil::remove_if_existing(in_file);
   // and make the new file rw everybody
   OHDFilesystemUtil::make_file_read_write_everyone(out_file_mp4);
   console->debug("Demuxing {} done", in_file);
+  return true;
 }
 
-// Returns all files ending in .mkv in the video recordings directory
-static std::vector<std::string> get_all_mkv_video_files(){
+// The pipeline for the raw rtp recordings (PrerollRingRecorder) - the rtp packets are pushed into appsrc,
+// such that the timestamps can be taken from the rtp packets.
+static std::string create_gst_rtp_remux_pipeline(const std::string& encoding_name,const std::string& out_file){
+  std::stringstream ss;
+  ss<<"appsrc name=src format=time ! ";
+  if(encoding_name=="H264"){
+    ss<<"rtph264depay ! h264parse ! ";
+  }else if(encoding_name=="H265"){
+    ss<<"rtph265depay ! h265parse ! ";
+  }else{
+    ss<<"rtpjpegdepay ! ";
+  }
+  ss<<"qtmux ! filesink location="<<out_file;
+  return ss.str();
+}
+
+static constexpr guint64 MAX_RTP_REMUX_QUEUED_BYTES=1024*1024;
+
+// e.g. X.h264.rtp -> H264
+static std::optional<std::string> rtp_encoding_name_from_filename(const std::string& filename){
+  if(OHDUtil::endsWith(filename,".h264.rtp"))return "H264";
+  if(OHDUtil::endsWith(filename,".h265.rtp"))return "H265";
+  if(OHDUtil::endsWith(filename,".mjpeg.rtp"))return "JPEG";
+  return std::nullopt;
+}
+
+// Reads the next RFC 4571 framed rtp packet (2 byte big endian size, then the packet), false on EOF / truncated packet
+// (e.g. power loss while recording - everything up to the last complete packet is kept)
+static bool read_rfc4571_packet(FILE* file,std::vector<uint8_t>& packet){
+  uint8_t size_bytes[2];
+  if(std::fread(size_bytes,1,2,file)!=2)return false;
+  const size_t size=(static_cast<size_t>(size_bytes[0])<<8) | size_bytes[1];
+  packet.resize(size);
+  return size>=12 && std::fread(packet.data(),1,size,file)==size;
+}
+
+static uint32_t get_rtp_timestamp(const std::vector<uint8_t>& packet){
+  return (static_cast<uint32_t>(packet[4])<<24) | (static_cast<uint32_t>(packet[5])<<16) |
+         (static_cast<uint32_t>(packet[6])<<8) | packet[7];
+}
+
+// Same as demux_mkv, but for the raw rtp recordings of the PrerollRingRecorder
+bool GstRecordingDemuxer::remux_rtp(const std::string& in_file,std::atomic<int>& progress_perc){
+  auto console=openhd::log::create_or_get("gst_demuxer");
+  console->debug("Remuxing {}", in_file);
+  const auto encoding_name=rtp_encoding_name_from_filename(in_file);
+  if(!encoding_name.has_value()){
+    console->warn("Cannot remux {}, unknown codec",in_file);
+    return false;
+  }
+  // X.h264.rtp -> X.mp4
+  const std::string file_without_suffix=in_file.substr(0,in_file.rfind('.',in_file.size()-5));
+  const std::string out_file_mp4=file_without_suffix+".mp4";
+  const std::string out_file_part=out_file_mp4+".part";
+  if(OHDFilesystemUtil::exists(out_file_mp4) && OHDFilesystemUtil::get_file_size_bytes(out_file_mp4)>0){
+    console->debug("{} already remuxed",in_file);
+    OHDFilesystemUtil::remove_if_existing(in_file);
+    return true;
+  }
+  OHDFilesystemUtil::remove_if_existing(out_file_part);
+  FILE* file=std::fopen(in_file.c_str(),"rb");
+  if(file==nullptr){
+    console->warn("Cannot remux {}, does not exist",in_file);
+    return false;
+  }
+  std::vector<uint8_t> packet;
+  if(!read_rfc4571_packet(file,packet)){
+    // Recording stopped before the first keyframe - nothing to keep
+    console->warn("Cannot remux {}, no rtp packets",in_file);
+    std::fclose(file);
+    OHDFilesystemUtil::remove_if_existing(in_file);
+    return false;
+  }
+  GError *error = nullptr;
+  GstElement* pipeline=gst_parse_launch(create_gst_rtp_remux_pipeline(encoding_name.value(),out_file_part).c_str(),&error);
+  if(error){
+    console->warn("Cannot create remux pipeline: {}",error->message);
+    g_error_free(error);
+    if(pipeline)gst_object_unref(pipeline);
+    std::fclose(file);
+    return false;
+  }
+  GstElement* appsrc=gst_bin_get_by_name(GST_BIN(pipeline),"src");
+  GstCaps* caps=gst_caps_new_simple("application/x-rtp","media",G_TYPE_STRING,"video","clock-rate",G_TYPE_INT,90000,
+                                    "encoding-name",G_TYPE_STRING,encoding_name.value().c_str(),
+                                    "payload",G_TYPE_INT,packet[1] & 0x7F,nullptr);
+  g_object_set(appsrc,"caps",caps,nullptr);
+  gst_caps_unref(caps);
+  GstBus* bus=gst_element_get_bus(pipeline);
+  gst_bus_set_sync_handler(bus,on_demux_sync_message,nullptr,nullptr);
+  const long in_size=OHDFilesystemUtil::get_file_size_bytes(in_file);
+  gst_element_set_state(pipeline,GST_STATE_PLAYING);
+  // 90kHz rtp timestamps, relative to the first packet (and unwrapped)
+  const uint32_t first_rtp_timestamp=get_rtp_timestamp(packet);
+  uint32_t last_rtp_timestamp=first_rtp_timestamp;
+  int64_t rtp_timestamp=0;
+  long n_bytes_read=0;
+  int last_logged_perc=0;
+  bool pushed_all=false;
+  bool pipeline_error=false;
+  while (!m_terminate && !pipeline_error){
+    // Don't let appsrc queue up the whole file, but don't block in push-buffer either (it would never return
+    // after a pipeline error / on terminate)
+    guint64 queued_bytes=0;
+    g_object_get(appsrc,"current-level-bytes",&queued_bytes,nullptr);
+    if(queued_bytes>=MAX_RTP_REMUX_QUEUED_BYTES){
+      GstMessage* msg=gst_bus_timed_pop_filtered(bus,10*GST_MSECOND,GST_MESSAGE_ERROR);
+      if(msg!=nullptr){
+        GError* gerror=nullptr;
+        gchar* debug_info=nullptr;
+        gst_message_parse_error(msg,&gerror,&debug_info);
+        console->warn("Cannot remux {}: {}",in_file,gerror ? gerror->message : "?");
+        if(gerror)g_error_free(gerror);
+        g_free(debug_info);
+        gst_message_unref(msg);
+        pipeline_error=true;
+      }
+      continue;
+    }
+    const uint32_t curr_rtp_timestamp=get_rtp_timestamp(packet);
+    rtp_timestamp+=static_cast<int32_t>(curr_rtp_timestamp-last_rtp_timestamp);
+    last_rtp_timestamp=curr_rtp_timestamp;
+    GstBuffer* buffer=gst_buffer_new_allocate(nullptr,packet.size(),nullptr);
+    gst_buffer_fill(buffer,0,packet.data(),packet.size());
+    GST_BUFFER_PTS(buffer)=gst_util_uint64_scale(std::max(rtp_timestamp,static_cast<int64_t>(0)),GST_SECOND,90000);
+    GstFlowReturn ret;
+    g_signal_emit_by_name(appsrc,"push-buffer",buffer,&ret);
+    gst_buffer_unref(buffer);
+    if(ret!=GST_FLOW_OK)break;
+    n_bytes_read+=2+static_cast<long>(packet.size());
+    if(in_size>0){
+      progress_perc=static_cast<int>(std::min(99L,n_bytes_read*100/in_size));
+      if(progress_perc>=last_logged_perc+25){
+        last_logged_perc=progress_perc;
+        console->debug("Remuxing {} {}%",in_file,last_logged_perc);
+      }
+    }
+    if(!read_rfc4571_packet(file,packet)){
+      pushed_all=true;
+      break;
+    }
+  }
+  std::fclose(file);
+  bool success=false;
+  if(pushed_all){
+    GstFlowReturn ret;
+    g_signal_emit_by_name(appsrc,"end-of-stream",&ret);
+  }
+  // On error / terminate, there is no EOS - the .rtp is kept
+  while (pushed_all && !m_terminate){
+    GstMessage* msg=gst_bus_timed_pop_filtered(bus,500*GST_MSECOND,static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if(msg!=nullptr){
+      success=GST_MESSAGE_TYPE(msg)==GST_MESSAGE_EOS;
+      if(!success){
+        GError* gerror=nullptr;
+        gchar* debug_info=nullptr;
+        gst_message_parse_error(msg,&gerror,&debug_info);
+        console->warn("Cannot remux {}: {}",in_file,gerror ? gerror->message : "?");
+        if(gerror)g_error_free(gerror);
+        g_free(debug_info);
+      }
+      gst_message_unref(msg);
+      break;
+    }
+  }
+  gst_element_set_state(pipeline,GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(appsrc);
+  gst_object_unref(pipeline);
+  if(!success || OHDFilesystemUtil::get_file_size_bytes(out_file_part)<=0){
+    if(success){
+      console->warn("Cannot remux,{} is empty",out_file_mp4);
+    }
+    OHDFilesystemUtil::remove_if_existing(out_file_part);
+    return false;
+  }
+  if(std::rename(out_file_part.c_str(),out_file_mp4.c_str())!=0){
+    console->warn("Cannot rename {}",out_file_part);
+    OHDFilesystemUtil::remove_if_existing(out_file_part);
+    return false;
+  }
+  progress_perc=100;
+  OHDFilesystemUtil::remove_if_existing(in_file);
+  OHDFilesystemUtil::make_file_read_write_everyone(out_file_mp4);
+  console->debug("Remuxing {} done", in_file);
+  return true;
+}
+
+// Returns all files ending in .mkv / .rtp in the video recordings directory
+// (not the .part files of recordings that are still written)
+static std::vector<std::string> get_all_video_files_to_demux(){
   const auto files=OHDFilesystemUtil::getAllEntriesFullPathInDirectory(openhd::video::RECORDINGS_PATH);
   std::vector<std::string> files_to_convert{};
   for(const auto& file: files){
-    if(OHDUtil::endsWith(file,".mkv")){
+    if(OHDUtil::endsWith(file,".mkv") || OHDUtil::endsWith(file,".rtp")){
       files_to_convert.push_back(file);
     }
   }
   return files_to_convert;
 }
 
+GstRecordingDemuxer::GstRecordingDemuxer(int n_workers) {
+  assert(n_workers>=1);
+  OHDGstHelper::initGstreamerOrThrow();
+  for(int i=0;i<n_workers;i++){
+    m_workers.push_back(std::make_unique<std::thread>(&GstRecordingDemuxer::loop_worker,this));
+  }
+}
 
 GstRecordingDemuxer::~GstRecordingDemuxer() {
   auto console=openhd::log::create_or_get("gst_demuxer");
-  console->debug("~GstRecordingDemuxer, Terminating {} demux ops",m_demux_ops.size());
-  for(auto& demux: m_demux_ops){
-    auto demux_thread=demux.thread;
-    if(demux_thread->joinable()){
-      console->debug("Waiting for demuxing to end");
-      demux_thread->join();
+  console->debug("~GstRecordingDemuxer, {}",get_status());
+  {
+    std::lock_guard<std::mutex> guard(m_jobs_mutex);
+    m_terminate=true;
+  }
+  m_jobs_cv.notify_all();
+  for(auto& worker:m_workers){
+    if(worker->joinable()){
+      worker->join();
     }
   }
 }
 
-void GstRecordingDemuxer::demux_all_remaining_mkv_files_async() {
-  auto console=openhd::log::create_or_get("gst_demuxer");
-  auto files_to_demux=get_all_mkv_video_files();
+void GstRecordingDemuxer::loop_worker() {
+  lower_current_thread_priority();
+  std::unique_lock<std::mutex> lock(m_jobs_mutex);
+  while (true){
+    m_jobs_cv.wait(lock,[this](){
+      return m_terminate || !m_queued_jobs.empty();
+    });
+    if(m_terminate)break;
+    auto job=std::make_shared<ActiveJob>();
+    job->filename=m_queued_jobs.front();
+    m_queued_jobs.pop_front();
+    m_active_jobs.push_back(job);
+    lock.unlock();
+    const bool success=OHDUtil::endsWith(job->filename,".rtp") ? remux_rtp(job->filename,job->progress_perc)
+                                                                 : demux_mkv(job->filename,job->progress_perc);
+    lock.lock();
+    m_active_jobs.erase(std::find(m_active_jobs.begin(),m_active_jobs.end(),job));
+    // Done - the .mkv / .rtp is gone. Failed / aborted - it is kept, and can be demuxed again later.
+    // Either way, the set doesn't grow with each recording.
+    m_known_files.erase(job->filename);
+    if(!m_terminate){
+      if(success){
+        m_n_done++;
+      }else{
+        m_n_failed++;
+      }
+    }
+    m_jobs_cv.notify_all();
+  }
+}
+
+void GstRecordingDemuxer::demux_all_remaining_files_async() {
+  auto files_to_demux=get_all_video_files_to_demux();
   for(auto& file:files_to_demux){
-    demux_mkv_file_async_threadsafe(file);
+    demux_file_async_threadsafe(file);
   }
 }
 
@@ -93,25 +408,47 @@ GstRecordingDemuxer& GstRecordingDemuxer::instance() {
   return demuxer;
 }
 
-void GstRecordingDemuxer::demux_mkv_file_async_threadsafe(std::string filename) {
+void GstRecordingDemuxer::demux_file_async_threadsafe(std::string filename) {
   auto console=openhd::log::create_or_get("gst_demuxer");
-  if(!OHDUtil::endsWith(filename,".mkv")){
-    console->debug("{} not a .mkv file",filename);
+  if(!OHDUtil::endsWith(filename,".mkv") && !OHDUtil::endsWith(filename,".rtp")){
+    console->debug("{} not a .mkv / .rtp file",filename);
     return ;
   }
+  std::lock_guard<std::mutex> guard(m_jobs_mutex);
   // Check if we are already demuxing file X
-  std::lock_guard<std::mutex> guard(m_demux_ops_mutex);
-  auto already_demuxing=std::find_if(
-      m_demux_ops.begin(), m_demux_ops.end(),
-      [&filename](const DeMuxOperation& x) { return x.filename == filename;});
-  if(already_demuxing==m_demux_ops.end()){
-    // not yet demuxed
-    auto demux_thread=std::make_shared<std::thread>([this,filename](){
-      demux_mkv(filename);
-    });
-    m_demux_ops.push_back({filename,demux_thread});
-  }else{
-    // aldrady demuxed / currently demuxing
-    console->debug("Already demuxed {}",filename);
+  if(!m_known_files.insert(filename).second){
+    // already queued / currently demuxing
+    console->debug("Already demuxing {}",filename);
+    return;
   }
+  m_queued_jobs.push_back(filename);
+  m_jobs_cv.notify_all();
+}
+
+bool GstRecordingDemuxer::wait_until_idle(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(m_jobs_mutex);
+  return m_jobs_cv.wait_for(lock,timeout,[this](){
+    return m_queued_jobs.empty() && m_active_jobs.empty();
+  });
+}
+
+std::string GstRecordingDemuxer::get_status() {
+  std::lock_guard<std::mutex> guard(m_jobs_mutex);
+  std::stringstream ss;
+  ss<<"Demuxer{queued:"<<m_queued_jobs.size()<<" active:[";
+  for(const auto& job:m_active_jobs){
+    ss<<job->filename<<" "<<job->progress_perc<<"%,";
+  }
+  ss<<"] done:"<<m_n_done<<" failed:"<<m_n_failed<<"}";
+  return ss.str();
+}
+
+int GstRecordingDemuxer::get_n_done_jobs() {
+  std::lock_guard<std::mutex> guard(m_jobs_mutex);
+  return m_n_done;
+}
+
+int GstRecordingDemuxer::get_n_failed_jobs() {
+  std::lock_guard<std::mutex> guard(m_jobs_mutex);
+  return m_n_failed;
 }
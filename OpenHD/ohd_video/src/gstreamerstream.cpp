@@ -9,12 +9,14 @@
 #include "air_recording_helper.hpp"
 #include "ffmpeg_videosamples.hpp"
 #include "gst_helper.hpp"
+#include "gst_pipeline_builder.h"
 
 #include "gst_appsink_helper.h"
 #include "gst_debug_helper.h"
 #include "rtp_eof_helper.h"
 #include "gst_recording_demuxer.h"
 
+#include "openhd_config.h"
 #include "openhd_util_time.hpp"
 
 GStreamerStream::GStreamerStream(PlatformType platform,std::shared_ptr<CameraHolder> camera_holder,
@@ -35,9 +37,8 @@ GStreamerStream::GStreamerStream(PlatformType platform,std::shared_ptr<CameraHol
     m_console->warn("Warning- Dummy camera is done in sw, high resolution/framerate might not work");
   }
   m_camera_holder->register_listener([this](){
-    // right now, every time the settings for this camera change, we just re-start the whole stream.
-    // That is not ideal, since some cameras support changing for example the bitrate or white balance during operation.
-    // But wiring that up is not that easy.
+    // If possible, only the affected part of the pipeline is changed (see restart_after_new_setting / gst_pipeline_reconfigure.h),
+    // otherwise the whole stream is re-started.
     // We call restart_async() to make sure to not perform heavy operation(s) on the mavlink settings callback, since we need to send the
     // acknowledging response in time. Also, gstreamer and camera(s) are sometimes buggy, so in the worst case gstreamer can become unresponsive
     // and block on the restart operation(s) which would be fatal for telemetry.
@@ -45,7 +46,28 @@ GStreamerStream::GStreamerStream(PlatformType platform,std::shared_ptr<CameraHol
   });
   assert(setting.streamed_video_format.isValid());
   OHDGstHelper::initGstreamerOrThrow();
-  //m_gst_video_recorder=std::make_unique<GstVideoRecorder>();
+  const auto config=openhd::load_config();
+  m_appsink_push_mode=config.DEV_GST_APPSINK_PUSH_MODE;
+  m_enable_latency_tracing=config.DEV_VIDEO_LATENCY_TRACING;
+  m_use_pipeline_builder=config.DEV_GST_PIPELINE_BUILDER;
+  m_recording_fragmented_mp4=config.DEV_AIR_RECORDING_FRAGMENTED_MP4;
+  m_appsink_push_delivery=std::make_unique<openhd::AppsinkPushDelivery>();
+  m_appsink_push_delivery->out_cb=[this](std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts){
+    on_new_rtp_frame_fragment(std::move(fragment),dts);
+  };
+  m_appsink_push_delivery->opt_pool=m_fragment_pool;
+  m_appsink_push_delivery->opt_delay_histogram=&m_appsink_delay_histogram;
+  if(config.DEV_AIR_RECORDING_PREROLL_S>0){
+    m_preroll=std::chrono::seconds(config.DEV_AIR_RECORDING_PREROLL_S);
+    // Sized for the current bitrate, grown if the bitrate goes up (see update_preroll_ring_size)
+    m_preroll_recorder=std::make_unique<openhd::PrerollRingRecorder>(
+        m_preroll,openhd::PrerollRingRecorder::calculate_ring_size(m_preroll,setting.h26x_bitrate_kbits));
+    // Once a recording is complete, it is remuxed to .mp4 like the .mkv recordings
+    m_preroll_recorder->set_on_recording_complete([this](const std::string& filename){
+      if(m_opt_action_handler && m_opt_action_handler->is_currently_armed())return;
+      GstRecordingDemuxer::instance().demux_file_async_threadsafe(filename);
+    });
+  }
   // Register a callback such that we get notified when the FC is armed / disarmed
   if(m_opt_action_handler){
     auto cb=[this](bool armed){
@@ -60,6 +82,9 @@ GStreamerStream::~GStreamerStream() {
   if(m_opt_action_handler){
     m_opt_action_handler->m_action_record_video_when_armed= nullptr;
   }
+  if(m_preroll_recorder){
+    m_preroll_recorder->stop_recording(true);
+  }
   // they are safe to call, regardless if we are already in cleaned up state or not
   GStreamerStream::stop();
   GStreamerStream::cleanup_pipe();
@@ -74,6 +99,7 @@ void GStreamerStream::setup() {
   }
   // atomic & called in regular intervals if variable bitrate is enabled.
   m_curr_dynamic_bitrate_kbits=setting.h26x_bitrate_kbits;
+  update_preroll_ring_size(setting.h26x_bitrate_kbits);
   if(!setting.enable_streaming){
     // When streaming is disabled, we just don't create the pipeline. We fully restart on all changes anyways.
     m_console->info("Streaming disabled");
@@ -135,14 +161,16 @@ void GStreamerStream::setup() {
       return;
     }
   }
+  const std::string camera_pipeline_part=m_pipeline_content.str();
   // quick check,here the pipeline should end with a "! ";
   if(!OHDUtil::endsWith(m_pipeline_content.str(),"! ")){
     m_console->warn("Probably ill-formatted pipeline: [{}]",m_pipeline_content.str());
   }
-  const bool ADD_RECORDING_TO_PIPELINE=
-      setting.air_recording==AIR_RECORDING_ON ||
-      (setting.air_recording==AIR_RECORDING_AUTO_ARM_DISARM && m_armed_enable_air_recording);
+  const bool ADD_RECORDING_TO_PIPELINE=should_record();
+  m_applied_settings=setting;
+  m_applied_recording=ADD_RECORDING_TO_PIPELINE;
   // for safety we only add the tee command at the right place if recording is enabled.
+  // (The pipeline builder always adds a tee, and attaches the recording branch to it at run time)
   if(ADD_RECORDING_TO_PIPELINE){
     m_console->info("Air recording active");
     m_pipeline_content <<"tee name=t ! ";
@@ -156,31 +184,94 @@ void GStreamerStream::setup() {
   m_pipeline_content << OHDGstHelper::createOutputAppSink();
   if(ADD_RECORDING_TO_PIPELINE){
     const auto recording_filename=openhd::video::create_unused_recording_filename(
-        OHDGstHelper::file_suffix_for_video_codec(setting.streamed_video_format.videoCodec));
+        OHDGstHelper::file_suffix_for_video_codec(setting.streamed_video_format.videoCodec,m_recording_fragmented_mp4));
     m_console->debug("Using [{}] for recording",recording_filename);
-    m_pipeline_content <<OHDGstHelper::createRecordingForVideoCodec(setting.streamed_video_format.videoCodec,recording_filename);
+    m_pipeline_content <<OHDGstHelper::createRecordingForVideoCodec(setting.streamed_video_format.videoCodec,recording_filename,
+                                                                    m_recording_fragmented_mp4);
     m_opt_curr_recording_filename=recording_filename;
   }else{
     m_opt_curr_recording_filename=std::nullopt;
   }
-  m_console->debug("Starting pipeline:[{}]",m_pipeline_content.str());
   // Protect against unwanted use - stop and free the pipeline first
   assert(m_gst_pipeline == nullptr);
-  // Now start the (as a string) built pipeline
-  GError *error = nullptr;
-  m_gst_pipeline = gst_parse_launch(m_pipeline_content.str().c_str(), &error);
-  m_console->debug("GStreamerStream::setup() end");
-  m_stream_creation_time=std::chrono::steady_clock::now();
-  if (error) {
-    m_console->error( "Failed to create pipeline: {}",error->message);
-    return;
+  m_pipeline_handles={};
+  if(m_use_pipeline_builder){
+    m_gst_pipeline=build_pipeline(camera_pipeline_part);
+    m_console->debug("GStreamerStream::setup() end");
+    m_stream_creation_time=std::chrono::steady_clock::now();
+    if(m_gst_pipeline==nullptr){
+      m_console->error("Failed to build pipeline");
+      return;
+    }
+    if(m_opt_curr_recording_filename.has_value()){
+      m_recording_branch=openhd::GstRecordingBranch::attach(m_gst_pipeline,m_pipeline_handles.tee,
+                                                             setting.streamed_video_format.videoCodec,m_opt_curr_recording_filename.value(),
+                                                             m_recording_fragmented_mp4);
+      if(m_recording_branch==nullptr){
+        m_opt_curr_recording_filename=std::nullopt;
+        m_applied_recording=false;
+      }
+    }
+  }else{
+    m_console->debug("Starting pipeline:[{}]",m_pipeline_content.str());
+    // Now start the (as a string) built pipeline
+    const auto before=std::chrono::steady_clock::now();
+    GError *error = nullptr;
+    m_gst_pipeline = gst_parse_launch(m_pipeline_content.str().c_str(), &error);
+    m_pipeline_build_timings="gst_parse_launch:"+openhd::util::time::R(std::chrono::steady_clock::now()-before);
+    m_console->debug("GStreamerStream::setup() end");
+    m_stream_creation_time=std::chrono::steady_clock::now();
+    if (error) {
+      m_console->error( "Failed to create pipeline: {}",error->message);
+      return;
+    }
+    // we pull data out of the gst pipeline as cpu memory buffer(s) using the gstreamer "appsink" element
+    m_pipeline_handles.appsink=gst_bin_get_by_name(GST_BIN(m_gst_pipeline), "out_appsink");
   }
   m_bitrate_ctrl_element=get_dynamic_bitrate_control_element_in_pipeline(m_gst_pipeline,camera.type);
-  // we pull data out of the gst pipeline as cpu memory buffer(s) using the gstreamer "appsink" element
-  m_app_sink_element=gst_bin_get_by_name(GST_BIN(m_gst_pipeline), "out_appsink");
+  if(m_pipeline_handles.encoder==nullptr && m_bitrate_ctrl_element.has_value()){
+    m_pipeline_handles.encoder=m_bitrate_ctrl_element->encoder;
+  }
+  m_app_sink_element=m_pipeline_handles.appsink;
   assert(m_app_sink_element);
-  m_pull_samples_run= true;
-  m_pull_samples_thread=std::make_unique<std::thread>(&GStreamerStream::loop_pull_samples, this);
+  m_appsink_delay_histogram.reset();
+  // m_frame_interval_histogram / m_last_frame_time are intentionally kept - on a full restart, the first frame of the
+  // new pipeline records the gap since the last frame of the old one (the restart blackout)
+  if(m_appsink_push_mode){
+    m_console->debug("appsink push mode");
+    openhd::appsink_install_push_delivery(m_app_sink_element,*m_appsink_push_delivery);
+  }else{
+    m_pull_samples_run= true;
+    m_pull_samples_thread=std::make_unique<std::thread>(&GStreamerStream::loop_pull_samples, this);
+  }
+}
+
+GstElement* GStreamerStream::build_pipeline(const std::string& camera_pipeline_part) {
+  const auto& camera= m_camera_holder->get_camera();
+  const auto& setting= m_camera_holder->get_settings();
+  const auto video_codec=setting.streamed_video_format.videoCodec;
+  openhd::GstPipelineBuilder builder;
+  builder.begin_stage("source");
+  if(camera.type==CameraType::DUMMY_SW){
+    m_pipeline_handles.encoder=OHDGstHelper::add_dummy_stream(builder,setting);
+    m_pipeline_handles.caps_filter=builder.get_element("source_caps");
+  }else{
+    builder.add_from_description(camera_pipeline_part);
+  }
+  m_pipeline_handles.tee=OHDGstHelper::add_recording_tee(builder);
+  builder.begin_stage("rtp");
+  OHDGstHelper::add_parse_and_rtp_packetize(builder,video_codec);
+  builder.begin_stage("output");
+  m_pipeline_handles.appsink=OHDGstHelper::add_output_appsink(builder);
+  m_pipeline_handles.parser=builder.get_element("out_parser");
+  m_pipeline_handles.payloader=builder.get_element("out_rtppay");
+  m_pipeline_build_timings=builder.get_stage_timings_string();
+  m_console->debug("Built pipeline:[{}] {}",builder.get_description(),m_pipeline_build_timings);
+  GstElement* pipeline=builder.release_pipeline();
+  if(pipeline==nullptr){
+    m_pipeline_handles={};
+  }
+  return pipeline;
 }
 
 void GStreamerStream::setup_raspberrypi_mmal_csi() {
@@ -318,6 +409,14 @@ std::string GStreamerStream::createDebug(){
   GstState pending;
   auto returnValue = gst_element_get_state(m_gst_pipeline, &state, &pending, 1000000000);
   ss << "GStreamerStream for camera:"<< m_camera_holder->get_camera().to_short_string()<<" State:"<< returnValue << "." << state << "." << pending << ".";
+  ss << " " << m_fragment_pool->get_stats().to_string();
+  ss << " appsink " << (m_appsink_push_mode ? "push" : "pull") << " delay:" << m_appsink_delay_histogram.to_string();
+  ss << " built in " << m_pipeline_build_timings;
+  ss << " " << m_blackout_tracker.to_string();
+  ss << " frame interval:" << m_frame_interval_histogram.to_string();
+  if(m_preroll_recorder){
+    ss << " " << m_preroll_recorder->get_stats().to_string();
+  }
   return ss.str();
 }
 
@@ -355,6 +454,12 @@ void GStreamerStream::cleanup_pipe() {
     m_console->debug("gst_pipeline==null");
     return;
   }
+  const bool push_delivery_active=m_appsink_push_delivery->enabled;
+  if(push_delivery_active){
+    // Same semantics as terminating the pull thread - no data is forwarded after this point.
+    // A callback might still be in flight, but setting the pipeline to NULL below waits for the streaming thread(s).
+    openhd::appsink_remove_push_delivery(m_app_sink_element,*m_appsink_push_delivery);
+  }
   // Jan 22: Confirmed this hangs quite a lot of pipeline(s) - removed for that reason
   /*m_console->debug("send EOS begin");
   // according to @Alex W we need a EOS signal here to properly shut down the pipeline
@@ -364,9 +469,17 @@ void GStreamerStream::cleanup_pipe() {
     m_console->info("success gst_element_send_event eos");
   }*/
   // TODO do we need to wait until the pipeline is actually in state NULL ?
+  // Not detached (no EOS) - goes away with the pipeline, like the recording of the string pipeline
+  m_recording_branch=nullptr;
   openhd::gst_element_set_set_state_and_log_result(m_gst_pipeline, GST_STATE_NULL);
   gst_object_unref (m_gst_pipeline);
   m_gst_pipeline =nullptr;
+  m_pipeline_handles={};
+  if(push_delivery_active){
+    // Safe now, the streaming thread has been stopped
+    m_frame_fragments.resize(0);
+    m_console->debug("{}",m_fragment_pool->get_stats().to_string());
+  }
   if(m_opt_curr_recording_filename){
     // make file read / writeable by everybody
     OHDFilesystemUtil::make_file_read_write_everyone(m_opt_curr_recording_filename.value());
@@ -383,7 +496,7 @@ void GStreamerStream::cleanup_pipe() {
   // start demuxing of (all) .mkv files unless the FC is currently armed ( we are in flight)
   // this will of course also de-mux the new ground recording (if there is any)
   if(m_opt_action_handler && !m_opt_action_handler->is_currently_armed()){
-    GstRecordingDemuxer::instance().demux_all_remaining_mkv_files_async();
+    GstRecordingDemuxer::instance().demux_all_remaining_files_async();
   }
   m_console->debug("GStreamerStream::cleanup_pipe() end");
 }
@@ -429,9 +542,131 @@ void GStreamerStream::restartIfStopped() {
 void GStreamerStream::restart_after_new_setting() {
   std::lock_guard<std::mutex> guard(m_pipeline_mutex);
   m_console->debug("GStreamerStream::restart_after_new_setting() begin");
-  // R.N we need to fully re-set the pipeline if any camera setting has changed
-  stop_cleanup_restart();
-  m_console->debug("GStreamerStream::restart_after_new_setting() end");
+  const auto settings=m_camera_holder->get_settings();
+  auto type=classify_reconfigure(settings);
+  if(type>=openhd::ReconfigureType::RECORDING){
+    m_blackout_tracker.begin(type);
+  }
+  if(!try_hot_reconfigure(type,settings)){
+    if(type!=openhd::ReconfigureType::FULL_RESTART){
+      m_console->warn("Cannot apply {} change, restarting",openhd::reconfigure_type_to_string(type));
+      type=openhd::ReconfigureType::FULL_RESTART;
+      m_blackout_tracker.begin(type);
+    }
+    // Fully re-set the pipeline
+    stop_cleanup_restart();
+  }
+  m_console->debug("GStreamerStream::restart_after_new_setting() end ({})",openhd::reconfigure_type_to_string(type));
+}
+
+bool GStreamerStream::should_record() const {
+  const auto& setting=m_camera_holder->get_settings();
+  // With the pre-roll recorder, arm / disarm doesn't touch the pipeline (see update_arming_state)
+  return setting.air_recording==AIR_RECORDING_ON ||
+         (setting.air_recording==AIR_RECORDING_AUTO_ARM_DISARM && m_armed_enable_air_recording && !m_preroll_recorder);
+}
+
+bool GStreamerStream::start_recording_branch(VideoCodec codec) {
+  const auto recording_filename=openhd::video::create_unused_recording_filename(
+      OHDGstHelper::file_suffix_for_video_codec(codec,m_recording_fragmented_mp4));
+  m_recording_branch=openhd::GstRecordingBranch::attach(m_gst_pipeline,m_pipeline_handles.tee,codec,recording_filename,
+                                                        m_recording_fragmented_mp4);
+  if(m_recording_branch==nullptr){
+    return false;
+  }
+  m_console->info("Air recording active");
+  m_opt_curr_recording_filename=recording_filename;
+  m_applied_recording=true;
+  return true;
+}
+
+bool GStreamerStream::stop_recording_branch() {
+  if(m_recording_branch){
+    m_recording_branch->detach();
+    m_recording_branch=nullptr;
+  }
+  if(m_opt_curr_recording_filename){
+    OHDFilesystemUtil::make_file_read_write_everyone(m_opt_curr_recording_filename.value());
+    m_opt_curr_recording_filename=std::nullopt;
+  }
+  m_applied_recording=false;
+  // Same as on cleanup, the file is complete now
+  if(m_opt_action_handler && !m_opt_action_handler->is_currently_armed()){
+    GstRecordingDemuxer::instance().demux_all_remaining_files_async();
+  }
+  return true;
+}
+
+openhd::ReconfigureType GStreamerStream::classify_reconfigure(const CameraSettings& settings) {
+  if(m_gst_pipeline==nullptr){
+    return openhd::ReconfigureType::FULL_RESTART;
+  }
+  const auto type=openhd::classify_settings_change(m_applied_settings,settings);
+  if(should_record()!=m_applied_recording){
+    // If nothing else changed, the recording branch can be attached to / detached from the tee of the running pipeline
+    if(m_pipeline_handles.tee!=nullptr && type==openhd::ReconfigureType::NONE){
+      return openhd::ReconfigureType::RECORDING;
+    }
+    return openhd::ReconfigureType::FULL_RESTART;
+  }
+  if(type==openhd::ReconfigureType::CAPS || type==openhd::ReconfigureType::ENCODER){
+    // We only have a handle to the source caps filter if the source was built with the builder (r.n only the dummy camera,
+    // the sources / hw encoders of the real cameras are still built from a pipeline string - CAPS / ENCODER changes
+    // are a full restart for them).
+    // And the recording muxer cannot handle caps changes / the tee would be removed with the encoder.
+    if(m_pipeline_handles.caps_filter==nullptr || m_applied_recording){
+      return openhd::ReconfigureType::FULL_RESTART;
+    }
+  }
+  return type;
+}
+
+bool GStreamerStream::try_hot_reconfigure(openhd::ReconfigureType type,const CameraSettings& settings) {
+  bool success=false;
+  switch (type) {
+    case openhd::ReconfigureType::NONE:
+      success=true;
+      break;
+    case openhd::ReconfigureType::BITRATE:
+      success=try_dynamically_change_bitrate_locked(settings.h26x_bitrate_kbits);
+      break;
+    case openhd::ReconfigureType::RECORDING:
+      success=should_record() ? start_recording_branch(settings.streamed_video_format.videoCodec) : stop_recording_branch();
+      break;
+    case openhd::ReconfigureType::CAPS:
+      success=openhd::hot_change_caps(m_pipeline_handles.caps_filter,OHDGstHelper::create_dummy_stream_caps(settings));
+      if(success && settings.h26x_bitrate_kbits!=m_applied_settings.h26x_bitrate_kbits){
+        success=try_dynamically_change_bitrate_locked(settings.h26x_bitrate_kbits);
+      }
+      break;
+    case openhd::ReconfigureType::ENCODER:
+      success=openhd::hot_replace_encoder(m_gst_pipeline,m_pipeline_handles,settings,OHDGstHelper::create_dummy_stream_caps(settings));
+      if(success){
+        m_bitrate_ctrl_element=get_dynamic_bitrate_control_element_in_pipeline(m_gst_pipeline,m_camera_holder->get_camera().type);
+        // The new encoder starts with the bitrate from the settings - if the bitrate didn't change but was adjusted
+        // dynamically (e.g. by the link), keep using the adjusted one
+        const int curr_bitrate_kbits=m_curr_dynamic_bitrate_kbits;
+        if(settings.h26x_bitrate_kbits==m_applied_settings.h26x_bitrate_kbits && curr_bitrate_kbits>0 &&
+            curr_bitrate_kbits!=settings.h26x_bitrate_kbits){
+          try_dynamically_change_bitrate_locked(curr_bitrate_kbits);
+        }
+      }
+      break;
+    case openhd::ReconfigureType::FULL_RESTART:
+      break;
+  }
+  if(success){
+    // Only touch the bitrate if it was actually changed, a dynamically adjusted bitrate stays as it is otherwise
+    if(settings.h26x_bitrate_kbits!=m_applied_settings.h26x_bitrate_kbits){
+      m_curr_dynamic_bitrate_kbits=settings.h26x_bitrate_kbits;
+      if(m_opt_action_handler){
+        m_opt_action_handler->dirty_set_bitrate_of_camera(m_camera_holder->get_camera().index,settings.h26x_bitrate_kbits);
+      }
+      update_preroll_ring_size(settings.h26x_bitrate_kbits);
+    }
+    m_applied_settings=settings;
+  }
+  return success;
 }
 
 void GStreamerStream::restart_async() {
@@ -480,6 +715,7 @@ void GStreamerStream::handle_change_bitrate_request(openhd::ActionHandler::LinkB
     if(m_opt_action_handler){
       m_opt_action_handler->dirty_set_bitrate_of_camera(m_camera_holder->get_camera().index,m_curr_dynamic_bitrate_kbits);
     }
+    update_preroll_ring_size(bitrate_for_encoder_kbits);
   }else{
     const auto cam_type=m_camera_holder->get_camera().type;
     if(cam_type==CameraType::RPI_CSI_LIBCAMERA || cam_type==CameraType::RPI_CSI_VEYE_V4l2){
@@ -496,6 +732,10 @@ void GStreamerStream::handle_change_bitrate_request(openhd::ActionHandler::LinkB
 
 bool GStreamerStream::try_dynamically_change_bitrate(int bitrate_kbits) {
   std::lock_guard<std::mutex> guard(m_pipeline_mutex);
+  return try_dynamically_change_bitrate_locked(bitrate_kbits);
+}
+
+bool GStreamerStream::try_dynamically_change_bitrate_locked(int bitrate_kbits) {
   if(m_gst_pipeline== nullptr){
     m_console->debug("cannot change_bitrate, no pipeline");
     return false;
@@ -515,15 +755,38 @@ bool GStreamerStream::try_dynamically_change_bitrate(int bitrate_kbits) {
 
 void GStreamerStream::on_new_rtp_fragmented_frame(std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments) {
   //m_console->debug("Got frame with {} fragments",frame_fragments.size());
+  const auto now=std::chrono::steady_clock::now();
+  if(m_last_frame_time.has_value()){
+    m_frame_interval_histogram.record(now-m_last_frame_time.value());
+  }
+  m_last_frame_time=now;
+  openhd::FragmentedVideoFrame frame{std::move(frame_fragments)};
+  if(m_enable_latency_tracing){
+    frame.opt_trace_appsink_time=m_frame_first_fragment_time;
+  }
+  if(m_preroll_recorder){
+    // The pre-roll is only needed for recording on arm - otherwise, don't pay for the copy
+    const auto& settings=m_camera_holder->get_settings();
+    if(settings.air_recording==AIR_RECORDING_AUTO_ARM_DISARM){
+      m_preroll_recorder->on_new_frame(frame,settings.streamed_video_format.videoCodec);
+    }
+  }
   if(m_link_handle){
     const auto stream_index=m_camera_holder->get_camera().index;
-    m_link_handle->transmit_video_data(stream_index,openhd::FragmentedVideoFrame{frame_fragments});
+    m_link_handle->transmit_video_data(stream_index,frame);
   }else{
     m_console->debug("No transmit interface");
   }
 }
 
 void GStreamerStream::on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts) {
+  if(m_blackout_tracker.on_fragment()==openhd::ReconfigureType::ENCODER){
+    // Whatever is left of the last frame of the previous encoder
+    m_frame_fragments.resize(0);
+  }
+  if(m_enable_latency_tracing && m_frame_fragments.empty()){
+    m_frame_first_fragment_time=std::chrono::steady_clock::now();
+  }
   m_frame_fragments.push_back(fragment);
   const auto curr_video_codec=m_camera_holder->get_settings().streamed_video_format.videoCodec;
   bool is_last_fragment_of_frame=false;
@@ -548,9 +811,6 @@ void GStreamerStream::on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint
     on_new_rtp_fragmented_frame(m_frame_fragments);
     m_frame_fragments.resize(0);
   }
-  /*if(m_gst_video_recorder){
-    m_gst_video_recorder->enqueue_rtp_fragment(fragment);
-  }*/
 }
 
 void GStreamerStream::loop_pull_samples() {
@@ -558,13 +818,54 @@ void GStreamerStream::loop_pull_samples() {
   auto cb=[this](std::shared_ptr<std::vector<uint8_t>> fragment,uint64_t dts){
     on_new_rtp_frame_fragment(fragment,dts);
   };
-  openhd::loop_pull_appsink_samples(m_pull_samples_run,m_app_sink_element,cb);
+  openhd::loop_pull_appsink_samples(m_pull_samples_run,m_app_sink_element,cb,m_fragment_pool,&m_appsink_delay_histogram);
   m_frame_fragments.resize(0);
+  m_console->debug("{}",m_fragment_pool->get_stats().to_string());
+}
+
+void GStreamerStream::dirty_set_appsink_push_mode(bool push_mode) {
+  m_console->debug("dirty_set_appsink_push_mode {}",push_mode);
+  m_appsink_push_mode=push_mode;
+}
+
+void GStreamerStream::dirty_set_use_pipeline_builder(bool use_pipeline_builder) {
+  m_console->debug("dirty_set_use_pipeline_builder {}",use_pipeline_builder);
+  m_use_pipeline_builder=use_pipeline_builder;
+}
+
+void GStreamerStream::update_preroll_ring_size(int bitrate_kbits) {
+  if(!m_preroll_recorder)return;
+  m_preroll_recorder->request_ring_size(openhd::PrerollRingRecorder::calculate_ring_size(m_preroll,bitrate_kbits));
+  // While recording, the ring is only grown once the recording is complete - until then, less pre-roll is kept
+  const auto effective_preroll=std::min(m_preroll,openhd::PrerollRingRecorder::calculate_preroll(
+      m_preroll_recorder->get_ring_size(),bitrate_kbits));
+  if(effective_preroll<m_preroll){
+    m_console->warn("Pre-roll {}ms at {}kBit/s (configured {}ms), ring grown after the current recording",
+                    effective_preroll.count(),bitrate_kbits,m_preroll.count());
+  }else{
+    m_console->debug("Pre-roll {}ms at {}kBit/s, ring {}KB",effective_preroll.count(),bitrate_kbits,
+                     m_preroll_recorder->get_ring_size()/1024);
+  }
 }
 
 void GStreamerStream::update_arming_state(bool armed) {
   m_console->debug("update_arming_state: {}",armed);
   const auto settings=m_camera_holder->get_settings();
+  if(settings.air_recording==AIR_RECORDING_AUTO_ARM_DISARM && m_preroll_recorder){
+    // The pre-roll (seconds before arming) is written too, the pipeline is not touched
+    if(armed){
+      const auto recording_filename=openhd::video::create_unused_recording_filename(
+          openhd::PrerollRingRecorder::file_suffix_for_video_codec(settings.streamed_video_format.videoCodec));
+      m_console->warn("Starting air recording (with pre-roll)");
+      // Only queued, the file is opened by the recorder's write thread
+      if(!m_preroll_recorder->start_recording(recording_filename)){
+        m_console->warn("Air recording already active");
+      }
+    }else{
+      m_preroll_recorder->stop_recording();
+    }
+    return;
+  }
   if(settings.air_recording==AIR_RECORDING_AUTO_ARM_DISARM){
     if(armed){
       m_armed_enable_air_recording= true;
@@ -572,7 +873,7 @@ void GStreamerStream::update_arming_state(bool armed) {
     }else{
       m_armed_enable_air_recording= false;
     }
-    // restart pipeline such that recording is started / stopped
+    // restart pipeline (or attach / detach the recording branch) such that recording is started / stopped
     restart_async();
   }
 }
@@ -10,16 +10,23 @@
 OHDVideoGround::OHDVideoGround(std::shared_ptr<OHDLink> link_handle):
 m_link_handle(std::move(link_handle)){
   m_console = openhd::log::create_or_get("v_gnd");
-  m_primary_video_forwarder = std::make_unique<SocketHelper::UDPMultiForwarder>();
-  m_secondary_video_forwarder = std::make_unique<SocketHelper::UDPMultiForwarder>();
+  const auto config=openhd::load_config();
+  if(config.DEV_VIDEO_GROUND_BATCH_FORWARDER){
+    m_console->debug("Using batch forwarder");
+    m_primary_video_batch_forwarder = std::make_unique<openhd::UDPBatchForwarder>();
+    m_secondary_video_batch_forwarder = std::make_unique<openhd::UDPBatchForwarder>();
+  }else{
+    m_primary_video_forwarder = std::make_unique<SocketHelper::UDPMultiForwarder>();
+    m_secondary_video_forwarder = std::make_unique<SocketHelper::UDPMultiForwarder>();
+  }
   // We always forward video to localhost::5600 (primary) and 5601 (secondary) for the default Ground control application (e.g. QOpenHD) to pick up
   addForwarder("127.0.0.1");
   // See the description in the .config file for more info
-  if(openhd::load_config().NW_FORWARD_TO_LOCALHOST_58XX){
+  if(config.NW_FORWARD_TO_LOCALHOST_58XX){
     m_console->debug("Forwarding video to 5800/5801 localhost is enabled");
     // Adding forwarder for WebRTC
-    m_primary_video_forwarder->addForwarder("127.0.0.1", 5800);
-    m_secondary_video_forwarder->addForwarder("127.0.0.1",5801);
+    add_forwarder(0,"127.0.0.1", 5800);
+    add_forwarder(1,"127.0.0.1",5801);
   }
   if(m_link_handle){
     m_link_handle->register_on_receive_video_data_cb([this](int stream_index,const uint8_t * data,int data_len){
@@ -34,24 +41,57 @@ OHDVideoGround::~OHDVideoGround() {
   if(m_link_handle){
     m_link_handle->register_on_receive_video_data_cb(nullptr);
   }
+  if(m_primary_video_batch_forwarder){
+    m_console->debug("Primary {}",m_primary_video_batch_forwarder->get_stats_string());
+    m_console->debug("Secondary {}",m_secondary_video_batch_forwarder->get_stats_string());
+  }
 }
 
 void OHDVideoGround::addForwarder(const std::string& client_addr) {
-  m_primary_video_forwarder->addForwarder(client_addr,5600);
-  m_secondary_video_forwarder->addForwarder(client_addr,5601);
+  add_forwarder(0,client_addr,5600);
+  add_forwarder(1,client_addr,5601);
 }
 
 void OHDVideoGround::removeForwarder(const std::string& client_addr) {
-  m_primary_video_forwarder->removeForwarder(client_addr,5600);
-  m_secondary_video_forwarder->removeForwarder(client_addr,5601);
+  remove_forwarder(0,client_addr,5600);
+  remove_forwarder(1,client_addr,5601);
+}
+
+void OHDVideoGround::add_forwarder(int stream_index,const std::string& client_addr,int port) {
+  if(m_primary_video_batch_forwarder){
+    auto& forwarder= stream_index==0 ? *m_primary_video_batch_forwarder : *m_secondary_video_batch_forwarder;
+    forwarder.addForwarder(client_addr,port);
+  }else{
+    auto& forwarder= stream_index==0 ? *m_primary_video_forwarder : *m_secondary_video_forwarder;
+    forwarder.addForwarder(client_addr,port);
+  }
+}
+
+void OHDVideoGround::remove_forwarder(int stream_index,const std::string& client_addr,int port) {
+  if(m_primary_video_batch_forwarder){
+    auto& forwarder= stream_index==0 ? *m_primary_video_batch_forwarder : *m_secondary_video_batch_forwarder;
+    m_console->debug("{}",forwarder.get_stats_string());
+    forwarder.removeForwarder(client_addr,port);
+  }else{
+    auto& forwarder= stream_index==0 ? *m_primary_video_forwarder : *m_secondary_video_forwarder;
+    forwarder.removeForwarder(client_addr,port);
+  }
 }
 
 void OHDVideoGround::on_video_data(int stream_index, const uint8_t *data,
                                    int data_len) {
   if(stream_index==0){
-    m_primary_video_forwarder->forwardPacketViaUDP(data,data_len);
+    if(m_primary_video_batch_forwarder){
+      m_primary_video_batch_forwarder->forwardPacketViaUDP(data,data_len);
+    }else{
+      m_primary_video_forwarder->forwardPacketViaUDP(data,data_len);
+    }
   }else if(stream_index==1){
-    m_secondary_video_forwarder->forwardPacketViaUDP(data,data_len);
+    if(m_secondary_video_batch_forwarder){
+      m_secondary_video_batch_forwarder->forwardPacketViaUDP(data,data_len);
+    }else{
+      m_secondary_video_forwarder->forwardPacketViaUDP(data,data_len);
+    }
   }else{
     openhd::log::get_default()->debug("Invalid stream index {}",stream_index);
   }
@@ -0,0 +1,363 @@
+#include "preroll_ring_recorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "openhd_spdlog.h"
+#include "rtp_eof_helper.h"
+
+openhd::PrerollRingRecorder::PrerollRingRecorder(std::chrono::milliseconds preroll,size_t ring_size_bytes)
+    :m_preroll_us(std::chrono::duration_cast<std::chrono::microseconds>(preroll).count()),
+     m_ring(ring_size_bytes),
+     m_frames(calculate_n_frame_entries(ring_size_bytes)) {
+  assert(ring_size_bytes>0);
+  m_stats.n_bytes_allocated=m_ring.size()+m_frames.size()*sizeof(FrameEntry);
+  openhd::log::get_default()->debug("PrerollRingRecorder {}ms, {}KB",preroll.count(),m_stats.n_bytes_allocated/1024);
+  m_write_thread=std::make_unique<std::thread>(&PrerollRingRecorder::loop_write,this);
+}
+
+openhd::PrerollRingRecorder::~PrerollRingRecorder() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_terminate=true;
+    m_pending_filename.reset();
+  }
+  m_cv.notify_all();
+  m_write_thread->join();
+}
+
+openhd::PrerollRingRecorder::FrameEntry& openhd::PrerollRingRecorder::frame_at(size_t index) {
+  return m_frames[(m_frames_head+index)%m_frames.size()];
+}
+
+bool openhd::PrerollRingRecorder::evict_oldest_frame() {
+  if(m_n_frames==0)return false;
+  const auto& oldest=frame_at(0);
+  if(m_fd>=0 && oldest.begin+oldest.size>m_flush_pos){
+    // Not on disk yet
+    return false;
+  }
+  m_read_pos=oldest.begin+oldest.size;
+  m_frames_head=(m_frames_head+1)%m_frames.size();
+  m_n_frames--;
+  m_stats.n_frames_evicted++;
+  return true;
+}
+
+void openhd::PrerollRingRecorder::evict_expired_frames(int64_t now_us) {
+  const int64_t window_start=now_us-m_preroll_us;
+  while (m_n_frames>0 && frame_at(0).time_us<=window_start){
+    if(!frame_at(0).keyframe){
+      // Cannot be decoded without the keyframe in front of it
+      if(!evict_oldest_frame())return;
+      continue;
+    }
+    // The oldest GOP can go if the next one still starts before the pre-roll window
+    size_t next_keyframe=0;
+    for(size_t i=1;i<m_n_frames && frame_at(i).time_us<=window_start;i++){
+      if(frame_at(i).keyframe){
+        next_keyframe=i;
+        break;
+      }
+    }
+    if(next_keyframe==0)return;
+    for(size_t i=0;i<next_keyframe;i++){
+      if(!evict_oldest_frame())return;
+    }
+  }
+}
+
+void openhd::PrerollRingRecorder::copy_into_ring(std::vector<uint8_t>& ring,uint64_t pos,const uint8_t* data,size_t size) {
+  const size_t offset=pos%ring.size();
+  const size_t first=std::min(size,ring.size()-offset);
+  std::memcpy(&ring[offset],data,first);
+  if(size>first){
+    std::memcpy(&ring[0],data+first,size-first);
+  }
+}
+
+size_t openhd::PrerollRingRecorder::calculate_n_frame_entries(size_t ring_size_bytes) {
+  // A frame is at least a couple of rtp packets
+  return std::max(static_cast<size_t>(1024),ring_size_bytes/512);
+}
+
+void openhd::PrerollRingRecorder::on_new_frame(const FragmentedVideoFrame& frame,VideoCodec codec) {
+  size_t size=0;
+  bool keyframe=codec==VideoCodec::MJPEG;
+  bool valid=true;
+  for(const auto& fragment:frame.frame_fragments){
+    size+=2+fragment->size();
+    valid=valid && fragment->size()<=0xFFFF;
+    if(!keyframe){
+      keyframe=codec==VideoCodec::H264 ? rtp_eof_helper::h264_is_keyframe(fragment->data(),fragment->size())
+                                       : rtp_eof_helper::h265_is_keyframe(fragment->data(),fragment->size());
+    }
+  }
+  const int64_t time_us=std::chrono::duration_cast<std::chrono::microseconds>(frame.creation_time.time_since_epoch()).count();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stats.n_frames++;
+  m_stats.n_bytes_in+=size;
+  if(!valid || size==0 || size>m_ring.size()){
+    m_stats.n_frames_dropped++;
+    return;
+  }
+  if(m_fd>=0 && m_wait_for_keyframe){
+    if(!keyframe){
+      m_stats.n_frames_dropped++;
+      return;
+    }
+    m_wait_for_keyframe=false;
+  }
+  evict_expired_frames(time_us);
+  while (m_n_frames==m_frames.size() || m_write_pos+size-m_read_pos>m_ring.size()){
+    if(!evict_oldest_frame()){
+      // Recording, and the disk cannot keep up
+      m_stats.n_frames_dropped++;
+      return;
+    }
+  }
+  uint64_t pos=m_write_pos;
+  for(const auto& fragment:frame.frame_fragments){
+    const uint8_t size_prefix[2]={static_cast<uint8_t>(fragment->size()>>8),static_cast<uint8_t>(fragment->size() & 0xFF)};
+    copy_into_ring(m_ring,pos,size_prefix,2);
+    copy_into_ring(m_ring,pos+2,fragment->data(),fragment->size());
+    pos+=2+fragment->size();
+  }
+  frame_at(m_n_frames)=FrameEntry{m_write_pos,static_cast<uint32_t>(size),time_us,keyframe};
+  m_n_frames++;
+  m_write_pos=pos;
+  if(m_fd>=0 && m_write_pos-m_flush_pos>=WRITE_CHUNK_SIZE){
+    m_cv.notify_all();
+  }
+}
+
+void openhd::PrerollRingRecorder::request_ring_size(size_t ring_size_bytes) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_requested_ring_size=std::max(m_requested_ring_size,ring_size_bytes);
+  grow_ring_if_requested(lock);
+}
+
+size_t openhd::PrerollRingRecorder::get_ring_size() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_ring.size();
+}
+
+void openhd::PrerollRingRecorder::set_on_recording_complete(std::function<void(const std::string&)> cb) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_on_recording_complete=std::move(cb);
+}
+
+void openhd::PrerollRingRecorder::grow_ring_if_requested(std::unique_lock<std::mutex>& lock) {
+  // The write thread reads out of the ring without holding the lock while recording
+  const auto can_swap=[this](){
+    return m_fd<0 && !m_pending_filename.has_value();
+  };
+  const size_t size=m_requested_ring_size;
+  if(size<=m_ring.size() || !can_swap())return;
+  lock.unlock();
+  std::vector<uint8_t> ring(size);
+  std::vector<FrameEntry> frames(calculate_n_frame_entries(size));
+  lock.lock();
+  if(size<=m_ring.size() || !can_swap()){
+    // Already grown, or recording started meanwhile (then it is grown once the recording is complete)
+    return;
+  }
+  // Keep the current pre-roll, at the same (monotonic) positions
+  for(uint64_t pos=m_read_pos;pos<m_write_pos;){
+    const size_t offset=pos%m_ring.size();
+    const size_t len=std::min(static_cast<size_t>(m_write_pos-pos),m_ring.size()-offset);
+    copy_into_ring(ring,pos,&m_ring[offset],len);
+    pos+=len;
+  }
+  for(size_t i=0;i<m_n_frames;i++){
+    frames[i]=frame_at(i);
+  }
+  m_frames_head=0;
+  std::swap(m_ring,ring);
+  std::swap(m_frames,frames);
+  m_stats.n_bytes_allocated=m_ring.size()+m_frames.size()*sizeof(FrameEntry);
+  openhd::log::get_default()->debug("PrerollRingRecorder grown to {}KB",m_stats.n_bytes_allocated/1024);
+}
+
+bool openhd::PrerollRingRecorder::start_recording(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if((m_fd>=0 && !m_stop_requested) || m_pending_filename.has_value()){
+    return false;
+  }
+  m_pending_filename=filename;
+  m_cv.notify_all();
+  return true;
+}
+
+bool openhd::PrerollRingRecorder::wait_until_recording_started() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock,[this](){return !m_pending_filename.has_value();});
+  return m_fd>=0 && !m_stop_requested;
+}
+
+void openhd::PrerollRingRecorder::stop_recording(bool wait_until_written) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_pending_filename.reset();
+  m_cv.notify_all();
+  if(m_fd<0)return;
+  m_stop_requested=true;
+  if(wait_until_written){
+    m_cv.wait(lock,[this](){return m_fd<0;});
+  }
+}
+
+bool openhd::PrerollRingRecorder::save_preroll(const std::string& filename) {
+  if(!start_recording(filename) || !wait_until_recording_started()){
+    return false;
+  }
+  stop_recording(true);
+  return true;
+}
+
+bool openhd::PrerollRingRecorder::is_recording() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return (m_fd>=0 && !m_stop_requested) || m_pending_filename.has_value();
+}
+
+openhd::PrerollRingRecorder::Stats openhd::PrerollRingRecorder::get_stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+bool openhd::PrerollRingRecorder::write_to_file(int fd,uint64_t begin,uint64_t end,uint64_t& n_writes) {
+  // The producer never overwrites [m_flush_pos,m_write_pos), and m_ring is not re-allocated while recording
+  const size_t offset=begin%m_ring.size();
+  const size_t len=end-begin;
+  const size_t first=std::min(len,m_ring.size()-offset);
+  const std::pair<const uint8_t*,size_t> spans[2]={{&m_ring[offset],first},{&m_ring[0],len-first}};
+  for(const auto& span:spans){
+    size_t written=0;
+    while (written<span.second){
+      const auto ret=write(fd,span.first+written,span.second-written);
+      if(ret<0){
+        if(errno==EINTR)continue;
+        openhd::log::get_default()->warn("Cannot write recording: {}",strerror(errno));
+        return false;
+      }
+      written+=ret;
+      n_writes++;
+    }
+  }
+  return true;
+}
+
+void openhd::PrerollRingRecorder::start_pending_recording(std::unique_lock<std::mutex>& lock) {
+  const std::string filename=m_pending_filename.value();
+  // Not while holding the lock, we don't want to block on_new_frame on the disk
+  lock.unlock();
+  const std::string part_filename=filename+".part";
+  const int fd=open(part_filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0666);
+  if(fd<0){
+    openhd::log::get_default()->warn("Cannot open {} for recording: {}",part_filename,strerror(errno));
+  }
+  lock.lock();
+  if(m_pending_filename!=filename){
+    // Cancelled (stop_recording) while opening
+    if(fd>=0)close(fd);
+    return;
+  }
+  m_pending_filename.reset();
+  m_cv.notify_all();
+  if(fd<0)return;
+  // The pre-roll starts with its first keyframe
+  while (m_n_frames>0 && !frame_at(0).keyframe){
+    evict_oldest_frame();
+  }
+  m_flush_pos=m_n_frames>0 ? frame_at(0).begin : m_write_pos;
+  m_wait_for_keyframe=m_n_frames==0;
+  m_stop_requested=false;
+  m_curr_filename=filename;
+  m_fd=fd;
+  openhd::log::get_default()->debug("Recording to {}, pre-roll {}KB",filename,(m_write_pos-m_flush_pos)/1024);
+}
+
+void openhd::PrerollRingRecorder::loop_write() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true){
+    m_cv.wait_for(lock,WRITE_INTERVAL,[this](){
+      return m_terminate || (m_fd<0 && m_pending_filename.has_value()) ||
+             (m_fd>=0 && (m_stop_requested || m_write_pos-m_flush_pos>=WRITE_CHUNK_SIZE));
+    });
+    if(m_fd<0){
+      if(m_terminate)break;
+      if(m_pending_filename.has_value()){
+        start_pending_recording(lock);
+      }
+      continue;
+    }
+    const int fd=m_fd;
+    const uint64_t begin=m_flush_pos;
+    const uint64_t end=m_write_pos;
+    const bool stop=m_stop_requested || m_terminate;
+    const std::string filename=m_curr_filename;
+    const auto on_recording_complete=m_on_recording_complete;
+    lock.unlock();
+    const auto before=std::chrono::steady_clock::now();
+    uint64_t n_writes=0;
+    const bool success=write_to_file(fd,begin,end,n_writes);
+    if(stop || !success){
+      fdatasync(fd);
+      close(fd);
+      // Whatever made it to disk is a valid recording
+      if(std::rename((filename+".part").c_str(),filename.c_str())!=0){
+        openhd::log::get_default()->warn("Cannot rename {}.part: {}",filename,strerror(errno));
+      }else if(on_recording_complete){
+        on_recording_complete(filename);
+      }
+    }
+    const auto elapsed=std::chrono::steady_clock::now()-before;
+    lock.lock();
+    m_flush_pos=end;
+    m_stats.n_bytes_written+=end-begin;
+    m_stats.n_writes+=n_writes;
+    m_stats.write_time+=elapsed;
+    if(stop || !success){
+      m_fd=-1;
+      m_stop_requested=false;
+      // Deferred while recording
+      grow_ring_if_requested(lock);
+      m_cv.notify_all();
+    }
+  }
+}
+
+size_t openhd::PrerollRingRecorder::calculate_ring_size(std::chrono::milliseconds preroll,int max_bitrate_kbits) {
+  // 2 seconds slack - the pre-roll starts with a keyframe (up to one GOP more), and the disk might stall for a bit
+  const size_t bytes_per_second=static_cast<size_t>(max_bitrate_kbits)*1000/8;
+  return bytes_per_second*(preroll.count()+2000)/1000;
+}
+
+std::chrono::milliseconds openhd::PrerollRingRecorder::calculate_preroll(size_t ring_size_bytes,int bitrate_kbits) {
+  const size_t bytes_per_second=static_cast<size_t>(std::max(bitrate_kbits,1))*1000/8;
+  const auto ring_ms=static_cast<int64_t>(ring_size_bytes*1000/bytes_per_second);
+  return std::chrono::milliseconds(std::max(static_cast<int64_t>(0),ring_ms-2000));
+}
+
+std::string openhd::PrerollRingRecorder::file_suffix_for_video_codec(VideoCodec codec) {
+  if(codec==VideoCodec::H264)return ".h264.rtp";
+  if(codec==VideoCodec::H265)return ".h265.rtp";
+  return ".mjpeg.rtp";
+}
+
+std::string openhd::PrerollRingRecorder::Stats::to_string() const {
+  std::stringstream ss;
+  const auto write_time_us=std::chrono::duration_cast<std::chrono::microseconds>(write_time).count();
+  ss<<"Preroll{frames:"<<n_frames<<" dropped:"<<n_frames_dropped<<" evicted:"<<n_frames_evicted
+    <<" written:"<<n_bytes_written/1024<<"KB in "<<n_writes<<" writes";
+  if(n_writes>0)ss<<" (avg "<<n_bytes_written/n_writes/1024<<"KB)";
+  if(write_time_us>0)ss<<" "<<n_bytes_written/write_time_us<<"MB/s";
+  ss<<" allocated:"<<n_bytes_allocated/1024<<"KB}";
+  return ss.str();
+}
@@ -109,3 +109,55 @@ bool openhd::rtp_eof_helper::mjpeg_end_block(const uint8_t *payload,
   // TODO not yet supported
   return false;
 }
+
+static bool h264_is_keyframe_nalu_type(uint8_t type){
+  // IDR, SPS, PPS
+  return type==5 || type==7 || type==8;
+}
+
+bool openhd::rtp_eof_helper::h264_is_keyframe(const uint8_t *payload,
+                                          const std::size_t payloadSize) {
+  if (payloadSize < RTP_HEADER_SIZE + sizeof(H264::nalu_header_t) + sizeof(H264::fu_header_t)) {
+    return false;
+  }
+  const H264::nalu_header_t &naluHeader = *(H264::nalu_header_t *) (&payload[RTP_HEADER_SIZE]);
+  if (naluHeader.type == 28) {// fragmented nalu
+    const H264::fu_header_t &fuHeader = *(H264::fu_header_t *) &payload[RTP_HEADER_SIZE + sizeof(H264::nalu_header_t)];
+    return h264_is_keyframe_nalu_type(fuHeader.type);
+  }
+  if (naluHeader.type == 24) {// STAP-A, 2 bytes size in front of the first nalu
+    if (payloadSize < RTP_HEADER_SIZE + 1 + 2 + sizeof(H264::nalu_header_t)) {
+      return false;
+    }
+    const H264::nalu_header_t &firstHeader = *(H264::nalu_header_t *) (&payload[RTP_HEADER_SIZE + 1 + 2]);
+    return h264_is_keyframe_nalu_type(firstHeader.type);
+  }
+  return h264_is_keyframe_nalu_type(naluHeader.type);
+}
+
+static bool h265_is_keyframe_nalu_type(uint8_t type){
+  // IRAP (BLA, IDR, CRA), VPS, SPS, PPS
+  return (type>=16 && type<=21) || type==32 || type==33 || type==34;
+}
+
+bool openhd::rtp_eof_helper::h265_is_keyframe(const uint8_t *payload,
+                                          const std::size_t payloadSize) {
+  if (payloadSize < RTP_HEADER_SIZE + sizeof(H265::nal_unit_header_h265_t) + sizeof(H265::fu_header_h265_t)) {
+    return false;
+  }
+  const H265::nal_unit_header_h265_t &naluHeader = *(H265::nal_unit_header_h265_t *) (&payload[RTP_HEADER_SIZE]);
+  if (naluHeader.type == 49) {// fragmentation unit
+    const H265::fu_header_h265_t
+        &fuHeader = *(H265::fu_header_h265_t *) &payload[RTP_HEADER_SIZE + sizeof(H265::nal_unit_header_h265_t)];
+    return h265_is_keyframe_nalu_type(fuHeader.fuType);
+  }
+  if (naluHeader.type == 48) {// aggregation packet, 2 bytes size in front of the first nalu
+    if (payloadSize < RTP_HEADER_SIZE + sizeof(H265::nal_unit_header_h265_t) + 2 + sizeof(H265::nal_unit_header_h265_t)) {
+      return false;
+    }
+    const H265::nal_unit_header_h265_t &firstHeader =
+        *(H265::nal_unit_header_h265_t *) (&payload[RTP_HEADER_SIZE + sizeof(H265::nal_unit_header_h265_t) + 2]);
+    return h265_is_keyframe_nalu_type(firstHeader.type);
+  }
+  return h265_is_keyframe_nalu_type(naluHeader.type);
+}
@@ -0,0 +1,260 @@
+#include "udp_batch_forwarder.h"
+
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+#ifndef UDP_SEGMENT
+// from linux/udp.h, not exposed by all libc versions
+#define UDP_SEGMENT 103
+#endif
+
+// Max payload / n of segments of one GSO "super datagram"
+static constexpr size_t MAX_GSO_PAYLOAD=65000;
+static constexpr size_t MAX_GSO_SEGMENTS=64;
+// The batch buffer is flushed before it would grow beyond this size
+static constexpr size_t MAX_BATCH_BUFFER_SIZE=128*1024;
+static constexpr size_t RTP_HEADER_SIZE=12;
+
+// The marker bit is set on the last rtp packet of a frame for all the codecs we use (h264,h265,mjpeg)
+static bool is_rtp_marker_set(const uint8_t* packet,std::size_t packet_len){
+  if(packet_len<RTP_HEADER_SIZE)return false;
+  const bool is_rtp_v2=(packet[0] >> 6)==2;
+  return is_rtp_v2 && (packet[1] & 0x80)!=0;
+}
+
+std::string openhd::UDPBatchForwarder::DestinationStats::to_string() const {
+  std::stringstream ss;
+  ss<<ip<<":"<<port<<"{packets:"<<n_packets<<", bytes:"<<n_bytes<<", syscalls:"<<n_syscalls<<", errors:"<<n_errors<<"}";
+  return ss.str();
+}
+
+openhd::UDPBatchForwarder::UDPBatchForwarder(Options options):m_options(options){
+  m_console=openhd::log::create_or_get("udp_batch_fw");
+  assert(m_console);
+  m_socket_fd=socket(AF_INET,SOCK_DGRAM,0);
+  if(m_socket_fd<0){
+    m_console->error("Cannot create socket {}",strerror(errno));
+  }
+  m_gso_active=m_options.enable_gso && m_socket_fd>=0 && kernel_supports_gso(m_socket_fd);
+  m_batch_buffer.reserve(MAX_BATCH_BUFFER_SIZE);
+  m_batch_packets.reserve(m_options.max_batch_size);
+  // worst case one message per packet
+  m_msgs.resize(m_options.max_batch_size);
+  m_iovs.resize(m_options.max_batch_size);
+  m_msg_n_packets.resize(m_options.max_batch_size);
+  m_controls.resize(m_options.max_batch_size);
+  m_console->debug("max_batch_size:{} max_delay:{}us gso:{}",m_options.max_batch_size,m_options.max_delay.count(),m_gso_active);
+  m_flush_thread=std::make_unique<std::thread>(&UDPBatchForwarder::loop_flush_timeout,this);
+}
+
+openhd::UDPBatchForwarder::~UDPBatchForwarder() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_flush_thread_run=false;
+  }
+  m_cv.notify_all();
+  if(m_flush_thread && m_flush_thread->joinable()){
+    m_flush_thread->join();
+  }
+  m_flush_thread=nullptr;
+  flush();
+  if(m_socket_fd>=0){
+    close(m_socket_fd);
+  }
+}
+
+void openhd::UDPBatchForwarder::addForwarder(const std::string& ip,int port) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(const auto& destination:m_destinations){
+    if(destination.stats.ip==ip && destination.stats.port==port){
+      m_console->debug("Forwarder {}:{} already exists",ip,port);
+      return;
+    }
+  }
+  Destination destination{};
+  destination.addr.sin_family=AF_INET;
+  destination.addr.sin_port=htons(port);
+  if(inet_pton(AF_INET,ip.c_str(),&destination.addr.sin_addr)!=1){
+    m_console->warn("Invalid ip {}",ip);
+    return;
+  }
+  destination.stats.ip=ip;
+  destination.stats.port=port;
+  m_destinations.push_back(destination);
+}
+
+void openhd::UDPBatchForwarder::removeForwarder(const std::string& ip,int port) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // flush first, such that the destination gets everything that was enqueued while it was still registered
+  flush_locked();
+  m_destinations.erase(std::remove_if(m_destinations.begin(),m_destinations.end(),[&ip,port](const Destination& destination){
+    return destination.stats.ip==ip && destination.stats.port==port;
+  }),m_destinations.end());
+}
+
+void openhd::UDPBatchForwarder::forwardPacketViaUDP(const uint8_t* packet,std::size_t packet_len) {
+  if(packet_len==0 || packet_len>UINT16_MAX)return;
+  bool notify_flush_thread=false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_batch_buffer.size()+packet_len>MAX_BATCH_BUFFER_SIZE){
+      flush_locked();
+    }
+    if(m_batch_packets.empty()){
+      m_batch_first_packet_time=std::chrono::steady_clock::now();
+      notify_flush_thread=true;
+    }
+    m_batch_packets.push_back(PacketRef{m_batch_buffer.size(),static_cast<uint16_t>(packet_len)});
+    m_batch_buffer.insert(m_batch_buffer.end(),packet,packet+packet_len);
+    const bool end_of_frame=m_options.flush_on_rtp_marker && is_rtp_marker_set(packet,packet_len);
+    if(end_of_frame || m_batch_packets.size()>=static_cast<size_t>(m_options.max_batch_size)){
+      flush_locked();
+      notify_flush_thread=false;
+    }
+  }
+  if(notify_flush_thread){
+    m_cv.notify_one();
+  }
+}
+
+void openhd::UDPBatchForwarder::flush() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  flush_locked();
+}
+
+void openhd::UDPBatchForwarder::flush_locked() {
+  if(m_batch_packets.empty())return;
+  for(auto& destination:m_destinations){
+    send_batch_to(destination);
+  }
+  m_batch_packets.resize(0);
+  m_batch_buffer.resize(0);
+}
+
+void openhd::UDPBatchForwarder::send_batch_to(Destination& destination) {
+  const size_t n_packets=m_batch_packets.size();
+  size_t packet_idx=0;
+  // Re-built if GSO turns out not to work, starting with the first packet that has not been sent yet
+  while(packet_idx<n_packets){
+    // One message per packet, or one message per GSO group of packets
+    auto& msgs=m_msgs;
+    auto& iovs=m_iovs;
+    auto& msg_n_packets=m_msg_n_packets;
+    std::memset(msgs.data(),0,sizeof(mmsghdr)*msgs.size());
+    int n_msgs=0;
+    for(size_t i=packet_idx;i<n_packets;){
+      const auto& first=m_batch_packets[i];
+      size_t j=i+1;
+      size_t total=first.len;
+      if(m_gso_active){
+        while(j<n_packets && (j-i)<MAX_GSO_SEGMENTS && m_batch_packets[j].len==first.len && total+first.len<=MAX_GSO_PAYLOAD){
+          total+=first.len;
+          j++;
+        }
+        // The last segment of a GSO datagram is allowed to be smaller
+        if(j<n_packets && (j-i)<MAX_GSO_SEGMENTS && m_batch_packets[j].len<first.len && total+m_batch_packets[j].len<=MAX_GSO_PAYLOAD){
+          total+=m_batch_packets[j].len;
+          j++;
+        }
+      }
+      // packets are stored back to back, the group is contiguous
+      iovs[n_msgs].iov_base=m_batch_buffer.data()+first.offset;
+      iovs[n_msgs].iov_len=total;
+      msghdr& hdr=msgs[n_msgs].msg_hdr;
+      hdr.msg_name=&destination.addr;
+      hdr.msg_namelen=sizeof(destination.addr);
+      hdr.msg_iov=&iovs[n_msgs];
+      hdr.msg_iovlen=1;
+      if(j-i>1){
+        hdr.msg_control=m_controls[n_msgs].data();
+        hdr.msg_controllen=CMSG_SPACE(sizeof(uint16_t));
+        cmsghdr* cm=CMSG_FIRSTHDR(&hdr);
+        cm->cmsg_level=SOL_UDP;
+        cm->cmsg_type=UDP_SEGMENT;
+        cm->cmsg_len=CMSG_LEN(sizeof(uint16_t));
+        const uint16_t gso_size=first.len;
+        std::memcpy(CMSG_DATA(cm),&gso_size,sizeof(uint16_t));
+      }
+      msg_n_packets[n_msgs]=j-i;
+      n_msgs++;
+      i=j;
+    }
+    int n_msgs_sent=0;
+    bool gso_failed=false;
+    while(n_msgs_sent<n_msgs){
+      const int ret=sendmmsg(m_socket_fd,&msgs[n_msgs_sent],n_msgs-n_msgs_sent,0);
+      destination.stats.n_syscalls++;
+      if(ret<0){
+        if(errno==EINTR)continue;
+        if(m_gso_active && (errno==EIO || errno==EINVAL)){
+          // e.g. the route doesn't support GSO (no checksum offload) - disable and re-send the rest without
+          m_console->warn("GSO send failed ({}), disabling GSO",strerror(errno));
+          m_gso_active=false;
+          gso_failed=true;
+          break;
+        }
+        destination.stats.n_errors++;
+        return;
+      }
+      for(int k=n_msgs_sent;k<n_msgs_sent+ret;k++){
+        destination.stats.n_packets+=msg_n_packets[k];
+        destination.stats.n_bytes+=iovs[k].iov_len;
+        packet_idx+=msg_n_packets[k];
+      }
+      n_msgs_sent+=ret;
+    }
+    if(!gso_failed){
+      return;
+    }
+  }
+}
+
+void openhd::UDPBatchForwarder::loop_flush_timeout() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_flush_thread_run){
+    if(m_batch_packets.empty()){
+      m_cv.wait(lock);
+      continue;
+    }
+    const auto deadline=m_batch_first_packet_time+m_options.max_delay;
+    if(std::chrono::steady_clock::now()>=deadline){
+      flush_locked();
+      continue;
+    }
+    m_cv.wait_until(lock,deadline);
+  }
+}
+
+std::vector<openhd::UDPBatchForwarder::DestinationStats> openhd::UDPBatchForwarder::get_destination_stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<DestinationStats> ret;
+  ret.reserve(m_destinations.size());
+  for(const auto& destination:m_destinations){
+    ret.push_back(destination.stats);
+  }
+  return ret;
+}
+
+std::string openhd::UDPBatchForwarder::get_stats_string() {
+  std::stringstream ss;
+  ss<<"UDPBatchForwarder{gso:"<<(m_gso_active ? "Y":"N")<<" ";
+  for(const auto& stats: get_destination_stats()){
+    ss<<stats.to_string()<<" ";
+  }
+  ss<<"}";
+  return ss.str();
+}
+
+bool openhd::UDPBatchForwarder::kernel_supports_gso(int fd) {
+  int gso_size=0;
+  socklen_t len=sizeof(gso_size);
+  // Added in linux 4.18
+  return getsockopt(fd,SOL_UDP,UDP_SEGMENT,&gso_size,&len)==0;
+}
@@ -2,8 +2,11 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <cassert>
+#include <functional>
 
 #include "gstreamerstream.h"
+#include "openhd_test_check.hpp"
 
 // Independent of OpenHD, start a stream for the dummy camera
 // Which rn is implemented in gstreamer.
@@ -21,7 +24,150 @@ static void update_settings(int index,CameraHolder& camera_holder){
   camera_holder.update_settings(current);
 }
 
+// Run the dummy camera once with the appsink pull thread and once with push (callback) delivery
+// and print the appsink delay histogram for both.
+static void compare_appsink_modes(){
+  for(const bool push_mode:{false,true}){
+    auto camera_holder=createDummyCamera2();
+    update_settings(0,*camera_holder);
+    PlatformType platformType{};
+    auto stream = std::make_unique<GStreamerStream>(platformType, camera_holder, nullptr);
+    stream->dirty_set_appsink_push_mode(push_mode);
+    stream->setup();
+    stream->start();
+    std::this_thread::sleep_for(std::chrono::seconds(20));
+    std::cout << stream->createDebug() << "\n";
+    stream.reset();
+  }
+}
+
+// Change resolution, codec, keyframe interval and bitrate of the running dummy camera, once with the pipeline built
+// from a string (every change is a full restart) and once with the pipeline builder (changes are applied to the
+// running pipeline), and print the video blackout per change type for both.
+// Checks frames keep flowing after each change, and with the builder no change needs a full restart.
+static void compare_hot_reconfigure(){
+  {
+    // What needs to be done for each change
+    CameraSettings applied{};
+    auto next=applied;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::NONE);
+    next.h26x_bitrate_kbits=applied.h26x_bitrate_kbits+1000;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::BITRATE);
+    next.streamed_video_format.width=1280;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::CAPS);
+    next.streamed_video_format.videoCodec=VideoCodec::H265;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::ENCODER);
+    // Recording is handled by GStreamerStream, since it also depends on the arming state
+    next.air_recording=AIR_RECORDING_ON;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::ENCODER);
+    next.horizontal_flip=!applied.horizontal_flip;
+    OHD_TEST_CHECK(openhd::classify_settings_change(applied,next)==openhd::ReconfigureType::FULL_RESTART);
+  }
+  for(const bool use_pipeline_builder:{false,true}){
+    auto camera_holder=createDummyCamera2();
+    update_settings(0,*camera_holder);
+    PlatformType platformType{};
+    auto stream = std::make_unique<GStreamerStream>(platformType, camera_holder, nullptr);
+    stream->dirty_set_use_pipeline_builder(use_pipeline_builder);
+    stream->setup();
+    stream->start();
+    const std::vector<std::function<void(CameraSettings&)>> changes{
+        [](CameraSettings& settings){settings.streamed_video_format.width=320;settings.streamed_video_format.height=240;},
+        [](CameraSettings& settings){settings.streamed_video_format.framerate=15;},
+        [](CameraSettings& settings){settings.h26x_keyframe_interval=10;},
+        [](CameraSettings& settings){settings.streamed_video_format.videoCodec=VideoCodec::H265;},
+        [](CameraSettings& settings){settings.streamed_video_format.videoCodec=VideoCodec::MJPEG;},
+        [](CameraSettings& settings){settings.streamed_video_format.videoCodec=VideoCodec::H264;},
+        [](CameraSettings& settings){settings.streamed_video_format.width=640;settings.streamed_video_format.height=480;},
+    };
+    uint64_t n_frames=0;
+    const auto check_frames_flowing=[&stream,&n_frames](){
+      const auto curr_n_frames=stream->get_frame_interval_histogram().count();
+      OHD_TEST_CHECK(curr_n_frames>n_frames);
+      n_frames=curr_n_frames;
+    };
+    for(int i=0;i<3;i++){
+      for(const auto& change:changes){
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        check_frames_flowing();
+        auto settings=camera_holder->get_settings();
+        change(settings);
+        camera_holder->update_settings(settings);
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    check_frames_flowing();
+    std::cout <<(use_pipeline_builder ? "Builder: " : "gst_parse_launch: ") << stream->createDebug() << "\n";
+    const auto& blackout=stream->get_blackout_tracker();
+    if(use_pipeline_builder){
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::CAPS).count()>0);
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::ENCODER).count()>0);
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::FULL_RESTART).count()==0);
+    }else{
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::FULL_RESTART).count()>0);
+    }
+    stream.reset();
+  }
+}
+
+// Arm / disarm a few times with air recording set to auto (arm / disarm), once with the pipeline built from a string
+// (every toggle is a full restart) and once with the pipeline builder (the recording branch is attached / detached),
+// and print the gaps in between frames on the downlink and the blackout per toggle for both.
+// Checks the max gap of each path - the restart gap shows up in the frame intervals of the string pipeline,
+// and with the builder frames keep flowing while the recording branch is attached / detached.
+static void compare_toggle_recording(){
+  static constexpr int N_TOGGLES=10;
+  // Generous, the dummy camera produces a frame every ~33ms
+  static constexpr int64_t MAX_GAP_ATTACH_DETACH_US=500*1000;
+  for(const bool use_pipeline_builder:{false,true}){
+    auto camera_holder=createDummyCamera2();
+    update_settings(0,*camera_holder);
+    auto settings=camera_holder->get_settings();
+    settings.air_recording=AIR_RECORDING_AUTO_ARM_DISARM;
+    camera_holder->update_settings(settings);
+    auto action_handler=std::make_shared<openhd::ActionHandler>();
+    PlatformType platformType{};
+    auto stream = std::make_unique<GStreamerStream>(platformType, camera_holder, nullptr,action_handler);
+    stream->dirty_set_use_pipeline_builder(use_pipeline_builder);
+    stream->setup();
+    stream->start();
+    for(int i=0;i<N_TOGGLES;i++){
+      std::this_thread::sleep_for(std::chrono::seconds(3));
+      action_handler->update_arming_state_if_changed(i%2==0);
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    std::cout <<(use_pipeline_builder ? "Builder: " : "gst_parse_launch: ") << stream->createDebug() << "\n";
+    const auto& frame_interval=stream->get_frame_interval_histogram();
+    const auto& blackout=stream->get_blackout_tracker();
+    OHD_TEST_CHECK(frame_interval.count()>0);
+    if(use_pipeline_builder){
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::RECORDING).count()==N_TOGGLES);
+      OHD_TEST_CHECK(blackout.get_blackout(openhd::ReconfigureType::FULL_RESTART).count()==0);
+      OHD_TEST_CHECK(frame_interval.max_us()<MAX_GAP_ATTACH_DETACH_US);
+    }else{
+      const auto& restart=blackout.get_blackout(openhd::ReconfigureType::FULL_RESTART);
+      OHD_TEST_CHECK(restart.count()==N_TOGGLES);
+      // The last frame of the old pipeline is before the restart began, the first one of the new pipeline after the
+      // first fragment came out - the frame gap includes the whole blackout
+      OHD_TEST_CHECK(frame_interval.max_us()>=restart.max_us());
+    }
+    stream.reset();
+  }
+}
+
 int main(int argc, char *argv[]) {
+  if(argc>1 && std::string(argv[1])=="--compare-appsink-modes"){
+    compare_appsink_modes();
+    return 0;
+  }
+  if(argc>1 && std::string(argv[1])=="--hot-reconfigure"){
+    compare_hot_reconfigure();
+    return 0;
+  }
+  if(argc>1 && std::string(argv[1])=="--toggle-recording"){
+    compare_toggle_recording();
+    return 0;
+  }
   //
   auto camera_holder=createDummyCamera2();
   update_settings(0,*camera_holder);
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <set>
+
+#include "gst_helper.hpp"
+#include "gst_pipeline_builder.h"
+#include "openhd_test_check.hpp"
+#include "openhd_util_time.hpp"
+
+// Validates the typed pipeline builder against the string (gst_parse_launch) pipeline for the dummy camera
+// (videotestsrc), for all video codecs:
+// 1) Both pipelines have the same chain of elements, with the same (non-default) properties
+// 2) Both produce rtp data at the appsink
+// And measures how long it takes to create both (first one is cold, the others warm).
+
+// The properties that differ from their default value, as name=serialized value
+static std::set<std::string> get_non_default_properties(GstElement* element){
+  std::set<std::string> ret;
+  guint n_properties=0;
+  GParamSpec** properties=g_object_class_list_properties(G_OBJECT_GET_CLASS(element),&n_properties);
+  for(guint i=0;i<n_properties;i++){
+    GParamSpec* spec=properties[i];
+    const std::string name=g_param_spec_get_name(spec);
+    if(!(spec->flags & G_PARAM_READABLE) || name=="name" || name=="parent")continue;
+    GValue value=G_VALUE_INIT;
+    g_value_init(&value,spec->value_type);
+    g_object_get_property(G_OBJECT(element),name.c_str(),&value);
+    if(!g_param_value_defaults(spec,&value)){
+      gchar* serialized=gst_value_serialize(&value);
+      ret.insert(name+"="+(serialized ? serialized : "?"));
+      g_free(serialized);
+    }
+    g_value_unset(&value);
+  }
+  g_free(properties);
+  return ret;
+}
+
+struct ElementInfo{
+  std::string factory_name;
+  std::set<std::string> properties;
+};
+
+// Follows the src pads from the source to the sink
+static std::vector<ElementInfo> get_element_chain(GstElement* pipeline){
+  std::vector<ElementInfo> ret;
+  GstElement* element=gst_bin_get_by_name(GST_BIN(pipeline),"videotestsrc");
+  OHD_TEST_CHECK(element);
+  while (element!=nullptr){
+    GstElementFactory* factory=gst_element_get_factory(element);
+    ret.push_back(ElementInfo{GST_OBJECT_NAME(factory),get_non_default_properties(element)});
+    GstPad* src_pad=gst_element_get_static_pad(element,"src");
+    gst_object_unref(element);
+    element=nullptr;
+    if(src_pad==nullptr)break;
+    GstPad* peer=gst_pad_get_peer(src_pad);
+    gst_object_unref(src_pad);
+    if(peer==nullptr)break;
+    element=gst_pad_get_parent_element(peer);
+    gst_object_unref(peer);
+  }
+  return ret;
+}
+
+static CameraSettings create_settings(VideoCodec codec){
+  CameraSettings settings{};
+  settings.streamed_video_format.videoCodec=codec;
+  settings.streamed_video_format.width=640;
+  settings.streamed_video_format.height=480;
+  settings.streamed_video_format.framerate=30;
+  return settings;
+}
+
+static GstElement* create_with_parse_launch(const CameraSettings& settings){
+  std::stringstream ss;
+  ss<<OHDGstHelper::createDummyStream(settings);
+  ss<<OHDGstHelper::create_parse_and_rtp_packetize(settings.streamed_video_format.videoCodec);
+  ss<<OHDGstHelper::createOutputAppSink();
+  GError* error=nullptr;
+  GstElement* pipeline=gst_parse_launch(ss.str().c_str(),&error);
+  OHD_TEST_CHECK(error==nullptr);
+  return pipeline;
+}
+
+static GstElement* create_with_builder(const CameraSettings& settings,std::string& out_timings){
+  openhd::GstPipelineBuilder builder;
+  builder.begin_stage("source");
+  GstElement* encoder=OHDGstHelper::add_dummy_stream(builder,settings);
+  builder.begin_stage("rtp");
+  OHDGstHelper::add_parse_and_rtp_packetize(builder,settings.streamed_video_format.videoCodec);
+  builder.begin_stage("output");
+  GstElement* appsink=OHDGstHelper::add_output_appsink(builder);
+  OHD_TEST_CHECK(!builder.has_error());
+  OHD_TEST_CHECK(encoder!=nullptr && appsink!=nullptr);
+  OHD_TEST_CHECK(builder.get_element("out_parser")!=nullptr);
+  OHD_TEST_CHECK(builder.get_element("out_rtppay")!=nullptr);
+  OHD_TEST_CHECK(builder.get_element("out_appsink")==appsink);
+  out_timings=builder.get_stage_timings_string();
+  std::cout<<builder.get_description()<<"\n";
+  return builder.release_pipeline();
+}
+
+static bool receives_rtp_data(GstElement* pipeline){
+  gst_element_set_state(pipeline,GST_STATE_PLAYING);
+  GstElement* appsink=gst_bin_get_by_name(GST_BIN(pipeline),"out_appsink");
+  OHD_TEST_CHECK(appsink);
+  GstSample* sample=nullptr;
+  g_signal_emit_by_name(appsink,"try-pull-sample",5*GST_SECOND,&sample);
+  const bool ret=sample!=nullptr;
+  if(sample)gst_sample_unref(sample);
+  gst_object_unref(appsink);
+  gst_element_set_state(pipeline,GST_STATE_NULL);
+  return ret;
+}
+
+static void validate_for_codec(VideoCodec codec){
+  const auto settings=create_settings(codec);
+  for(int i=0;i<3;i++){
+    auto before=std::chrono::steady_clock::now();
+    GstElement* parsed=create_with_parse_launch(settings);
+    const auto parse_launch_time=std::chrono::steady_clock::now()-before;
+    std::string timings;
+    before=std::chrono::steady_clock::now();
+    GstElement* built=create_with_builder(settings,timings);
+    const auto builder_time=std::chrono::steady_clock::now()-before;
+    OHD_TEST_CHECK(built);
+    std::cout<<video_codec_to_string(codec)<<" run "<<i<<" gst_parse_launch:"<<openhd::util::time::R(parse_launch_time)
+             <<" builder:"<<openhd::util::time::R(builder_time)<<" ("<<timings<<")\n";
+    const auto chain_parsed=get_element_chain(parsed);
+    const auto chain_built=get_element_chain(built);
+    OHD_TEST_CHECK(chain_parsed.size()==chain_built.size());
+    for(size_t j=0;j<chain_parsed.size();j++){
+      OHD_TEST_CHECK(chain_parsed[j].factory_name==chain_built[j].factory_name);
+      if(chain_parsed[j].properties!=chain_built[j].properties){
+        std::cout<<"Properties of "<<chain_parsed[j].factory_name<<" differ:\n";
+        for(const auto& property:chain_parsed[j].properties)std::cout<<" parsed:"<<property<<"\n";
+        for(const auto& property:chain_built[j].properties)std::cout<<" built:"<<property<<"\n";
+        OHD_TEST_CHECK(false);
+      }
+    }
+    if(i==0){
+      OHD_TEST_CHECK(receives_rtp_data(parsed));
+      OHD_TEST_CHECK(receives_rtp_data(built));
+    }
+    gst_object_unref(parsed);
+    gst_object_unref(built);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  OHDGstHelper::initGstreamerOrThrow();
+  for(const auto codec:{VideoCodec::H264,VideoCodec::H265,VideoCodec::MJPEG}){
+    validate_for_codec(codec);
+  }
+  // Errors are reported, not crashed on
+  openhd::GstPipelineBuilder builder;
+  builder.add("videotestsrc");
+  OHD_TEST_CHECK(builder.add("this_element_does_not_exist")==nullptr);
+  OHD_TEST_CHECK(builder.has_error());
+  OHD_TEST_CHECK(builder.add("fakesink")==nullptr);
+  OHD_TEST_CHECK(builder.release_pipeline()==nullptr);
+  std::cout<<"Done\n";
+  return 0;
+}
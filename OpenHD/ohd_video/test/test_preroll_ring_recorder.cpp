@@ -0,0 +1,283 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <thread>
+
+#include "openhd_test_check.hpp"
+#include "openhd_util_filesystem.h"
+#include "preroll_ring_recorder.h"
+
+// Feeds synthetic h264 rtp frames (60fps, keyframe every 30 frames, 10 packets per frame) into the pre-roll recorder and checks
+// 1) The pre-roll written on demand starts with a keyframe and holds the last 2 seconds (plus at most one GOP)
+// 2) Recording after the pre-roll is continuous (no frame missing between the pre-roll and the live frames)
+// 3) Feeding frames never allocates (neither before nor while recording)
+// 4) Growing the ring (e.g. the bitrate went up) keeps the pre-roll, and is deferred while recording
+// And benchmarks on_new_frame (ns per frame) and the disk writes.
+
+// Counts the heap allocations of the calling thread only (the write thread is allowed to allocate)
+static thread_local uint64_t n_heap_allocations=0;
+void* operator new(std::size_t size){
+  n_heap_allocations++;
+  void* p=std::malloc(size);
+  if(p==nullptr)throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p)noexcept{
+  std::free(p);
+}
+void operator delete(void* p,std::size_t)noexcept{
+  std::free(p);
+}
+
+static constexpr auto TEST_DIRECTORY="/tmp/openhd_test_preroll/";
+static constexpr int FPS=60;
+static constexpr int GOP_SIZE=30;
+static constexpr int N_PACKETS_PER_FRAME=10;
+static constexpr int PACKET_SIZE=1000;
+static constexpr auto FRAME_INTERVAL=std::chrono::microseconds(1000*1000/FPS);
+static constexpr auto PREROLL=std::chrono::seconds(2);
+
+// Frame index in the rtp sequence number (packet index in the timestamp) - such that we can check for missing frames
+static std::shared_ptr<std::vector<uint8_t>> create_rtp_packet(uint16_t frame_index,int packet_index,uint8_t nalu_header){
+  auto ret=std::make_shared<std::vector<uint8_t>>(PACKET_SIZE,0);
+  auto& packet=*ret;
+  packet[0]=0x80;
+  packet[1]=96;
+  packet[2]=frame_index>>8;
+  packet[3]=frame_index & 0xFF;
+  packet[7]=packet_index;
+  packet[12]=nalu_header;
+  // FU-A, non-IDR slice
+  packet[13]=1;
+  return ret;
+}
+
+// keyframes start with a SPS
+static openhd::FragmentedVideoFrame create_frame(uint16_t frame_index){
+  openhd::FragmentedVideoFrame frame;
+  const bool keyframe=frame_index % GOP_SIZE==0;
+  for(int i=0;i<N_PACKETS_PER_FRAME;i++){
+    frame.frame_fragments.push_back(create_rtp_packet(frame_index,i,(keyframe && i==0) ? 0x67 : 0x7C));
+  }
+  return frame;
+}
+
+// Re-uses the same frames, only the frame index / time changes (no allocations while feeding)
+struct FrameSource{
+  explicit FrameSource(std::chrono::steady_clock::time_point start):start(start){
+    keyframe=create_frame(0);
+    delta_frame=create_frame(1);
+  }
+  const openhd::FragmentedVideoFrame& next(){
+    auto& frame= (frame_index % GOP_SIZE==0) ? keyframe : delta_frame;
+    for(auto& packet:frame.frame_fragments){
+      (*packet)[2]=frame_index>>8;
+      (*packet)[3]=frame_index & 0xFF;
+    }
+    frame.creation_time=start+FRAME_INTERVAL*frame_index;
+    frame_index++;
+    return frame;
+  }
+  std::chrono::steady_clock::time_point start;
+  openhd::FragmentedVideoFrame keyframe;
+  openhd::FragmentedVideoFrame delta_frame;
+  uint16_t frame_index=0;
+};
+
+struct ParsedRecording{
+  int n_frames=0;
+  bool starts_with_keyframe=false;
+  bool continuous=true;
+  int first_frame_index=-1;
+};
+
+// RFC 4571 - 2 byte size, then the rtp packet
+static ParsedRecording parse_recording(const std::string& filename){
+  std::ifstream file(filename,std::ios::binary);
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+  ParsedRecording ret;
+  int n_packets=0;
+  int last_frame_index=-1;
+  size_t pos=0;
+  while (pos+2<=data.size()){
+    const size_t size=(data[pos]<<8) | data[pos+1];
+    OHD_TEST_CHECK(size==PACKET_SIZE);
+    OHD_TEST_CHECK(pos+2+size<=data.size());
+    const uint8_t* packet=&data[pos+2];
+    const int frame_index=(packet[2]<<8) | packet[3];
+    OHD_TEST_CHECK(packet[7]==n_packets % N_PACKETS_PER_FRAME);
+    if(n_packets==0){
+      ret.starts_with_keyframe=(packet[12] & 0x1F)==7;
+      ret.first_frame_index=frame_index;
+    }else if(n_packets % N_PACKETS_PER_FRAME==0){
+      ret.continuous=ret.continuous && frame_index==last_frame_index+1;
+    }
+    last_frame_index=frame_index;
+    n_packets++;
+    pos+=2+size;
+  }
+  OHD_TEST_CHECK(pos==data.size());
+  OHD_TEST_CHECK(n_packets % N_PACKETS_PER_FRAME==0);
+  ret.n_frames=n_packets/N_PACKETS_PER_FRAME;
+  return ret;
+}
+
+static size_t ring_size(){
+  return openhd::PrerollRingRecorder::calculate_ring_size(PREROLL,19000);
+}
+
+static void test_save_preroll(){
+  openhd::PrerollRingRecorder recorder(PREROLL,ring_size());
+  FrameSource source(std::chrono::steady_clock::now());
+  const auto allocations_before=n_heap_allocations;
+  // 10 seconds
+  for(int i=0;i<10*FPS;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  OHD_TEST_CHECK(n_heap_allocations==allocations_before);
+  const std::string filename=std::string(TEST_DIRECTORY)+"preroll.h264.rtp";
+  OHD_TEST_CHECK(recorder.save_preroll(filename));
+  const auto parsed=parse_recording(filename);
+  std::cout<<"Pre-roll: "<<parsed.n_frames<<" frames, first:"<<parsed.first_frame_index<<"\n";
+  OHD_TEST_CHECK(parsed.starts_with_keyframe);
+  OHD_TEST_CHECK(parsed.continuous);
+  // 2 seconds, from the last keyframe before them on
+  OHD_TEST_CHECK(parsed.n_frames>=PREROLL.count()*FPS && parsed.n_frames<=PREROLL.count()*FPS+GOP_SIZE+1);
+  OHD_TEST_CHECK(parsed.first_frame_index+parsed.n_frames==source.frame_index);
+  OHD_TEST_CHECK(recorder.get_stats().n_frames_dropped==0);
+  std::cout<<recorder.get_stats().to_string()<<"\n";
+}
+
+static void test_record_after_preroll(){
+  openhd::PrerollRingRecorder recorder(PREROLL,ring_size());
+  // The first 5 seconds are in the past
+  FrameSource source(std::chrono::steady_clock::now()-std::chrono::seconds(5));
+  for(int i=0;i<5*FPS;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  const std::string filename=std::string(TEST_DIRECTORY)+"recording.h264.rtp";
+  const uint16_t first_frame_after_arming=source.frame_index;
+  OHD_TEST_CHECK(recorder.start_recording(filename));
+  OHD_TEST_CHECK(recorder.is_recording());
+  // The pre-roll is taken when the write thread opened the file
+  OHD_TEST_CHECK(recorder.wait_until_recording_started());
+  const auto allocations_before=n_heap_allocations;
+  for(int i=0;i<5*FPS;i++){
+    const auto& frame=source.next();
+    // In real time, like the encoder would (such that the disk can keep up)
+    std::this_thread::sleep_until(frame.creation_time);
+    recorder.on_new_frame(frame,VideoCodec::H264);
+  }
+  OHD_TEST_CHECK(n_heap_allocations==allocations_before);
+  recorder.stop_recording(true);
+  OHD_TEST_CHECK(!recorder.is_recording());
+  // Not recorded anymore
+  recorder.on_new_frame(source.next(),VideoCodec::H264);
+  const auto parsed=parse_recording(filename);
+  std::cout<<"Recording: "<<parsed.n_frames<<" frames, "<<(first_frame_after_arming-parsed.first_frame_index)<<" before arming\n";
+  OHD_TEST_CHECK(parsed.starts_with_keyframe);
+  OHD_TEST_CHECK(parsed.continuous);
+  OHD_TEST_CHECK(first_frame_after_arming-parsed.first_frame_index>=PREROLL.count()*FPS);
+  OHD_TEST_CHECK(parsed.first_frame_index+parsed.n_frames==source.frame_index-1);
+  const auto stats=recorder.get_stats();
+  OHD_TEST_CHECK(stats.n_frames_dropped==0);
+  std::cout<<stats.to_string()<<"\n";
+}
+
+static void test_record_without_preroll(){
+  openhd::PrerollRingRecorder recorder(PREROLL,ring_size());
+  FrameSource source(std::chrono::steady_clock::now());
+  const std::string filename=std::string(TEST_DIRECTORY)+"no_preroll.h264.rtp";
+  OHD_TEST_CHECK(recorder.start_recording(filename));
+  OHD_TEST_CHECK(recorder.wait_until_recording_started());
+  // Starts in the middle of a GOP - the frames up to the next keyframe cannot be decoded
+  source.frame_index=GOP_SIZE/2;
+  for(int i=0;i<GOP_SIZE*2;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  recorder.stop_recording(true);
+  const auto parsed=parse_recording(filename);
+  OHD_TEST_CHECK(parsed.starts_with_keyframe);
+  OHD_TEST_CHECK(parsed.continuous);
+  OHD_TEST_CHECK(parsed.first_frame_index==GOP_SIZE);
+  OHD_TEST_CHECK(recorder.get_stats().n_frames_dropped==GOP_SIZE/2);
+}
+
+static void test_grow_ring(){
+  // Sized for a lower bitrate than the frames have (~4.8MBit/s) - the pre-roll is cut short
+  openhd::PrerollRingRecorder recorder(PREROLL,openhd::PrerollRingRecorder::calculate_ring_size(PREROLL,2000));
+  std::vector<std::string> completed;
+  recorder.set_on_recording_complete([&completed](const std::string& filename){
+    completed.push_back(filename);
+  });
+  FrameSource source(std::chrono::steady_clock::now());
+  for(int i=0;i<10*FPS;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  recorder.request_ring_size(ring_size());
+  OHD_TEST_CHECK(recorder.get_ring_size()==ring_size());
+  OHD_TEST_CHECK(recorder.get_stats().n_bytes_allocated>=ring_size());
+  // Never shrinks
+  recorder.request_ring_size(ring_size()/2);
+  OHD_TEST_CHECK(recorder.get_ring_size()==ring_size());
+  // What was in the smaller ring is kept
+  const std::string filename_kept=std::string(TEST_DIRECTORY)+"grow_kept.h264.rtp";
+  OHD_TEST_CHECK(recorder.save_preroll(filename_kept));
+  auto parsed=parse_recording(filename_kept);
+  std::cout<<"Pre-roll before growing: "<<parsed.n_frames<<" frames\n";
+  OHD_TEST_CHECK(parsed.starts_with_keyframe);
+  OHD_TEST_CHECK(parsed.continuous);
+  OHD_TEST_CHECK(parsed.n_frames>0 && parsed.n_frames<PREROLL.count()*FPS);
+  OHD_TEST_CHECK(parsed.first_frame_index+parsed.n_frames==source.frame_index);
+  // Now it holds the whole pre-roll
+  for(int i=0;i<10*FPS;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  const std::string filename_grown=std::string(TEST_DIRECTORY)+"grow_grown.h264.rtp";
+  OHD_TEST_CHECK(recorder.save_preroll(filename_grown));
+  parsed=parse_recording(filename_grown);
+  OHD_TEST_CHECK(parsed.continuous);
+  OHD_TEST_CHECK(parsed.n_frames>=PREROLL.count()*FPS);
+  // While recording, the write thread reads out of the ring - grown once the recording is complete
+  const std::string filename_recording=std::string(TEST_DIRECTORY)+"grow_recording.h264.rtp";
+  OHD_TEST_CHECK(recorder.start_recording(filename_recording));
+  OHD_TEST_CHECK(recorder.wait_until_recording_started());
+  OHD_TEST_CHECK(OHDFilesystemUtil::exists(filename_recording+".part"));
+  recorder.request_ring_size(ring_size()*2);
+  OHD_TEST_CHECK(recorder.get_ring_size()==ring_size());
+  recorder.stop_recording(true);
+  OHD_TEST_CHECK(recorder.get_ring_size()==ring_size()*2);
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(filename_recording+".part"));
+  OHD_TEST_CHECK(parse_recording(filename_recording).n_frames>=PREROLL.count()*FPS);
+  OHD_TEST_CHECK((completed==std::vector<std::string>{filename_kept,filename_grown,filename_recording}));
+  std::cout<<recorder.get_stats().to_string()<<"\n";
+}
+
+static void benchmark_on_new_frame(){
+  openhd::PrerollRingRecorder recorder(PREROLL,ring_size());
+  FrameSource source(std::chrono::steady_clock::now());
+  static constexpr int N_FRAMES=60000;
+  const auto before=std::chrono::steady_clock::now();
+  for(int i=0;i<N_FRAMES;i++){
+    recorder.on_new_frame(source.next(),VideoCodec::H264);
+  }
+  const auto delta=std::chrono::steady_clock::now()-before;
+  std::cout<<"on_new_frame: "<<std::chrono::duration_cast<std::chrono::nanoseconds>(delta).count()/N_FRAMES<<"ns per frame ("
+           <<N_PACKETS_PER_FRAME<<"x"<<PACKET_SIZE<<" bytes)\n";
+}
+
+int main(int argc, char *argv[]) {
+  OHDFilesystemUtil::safe_delete_directory(TEST_DIRECTORY);
+  OHDFilesystemUtil::create_directories(TEST_DIRECTORY);
+  test_save_preroll();
+  test_record_after_preroll();
+  test_record_without_preroll();
+  test_grow_ring();
+  benchmark_on_new_frame();
+  OHDFilesystemUtil::safe_delete_directory(TEST_DIRECTORY);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,200 @@
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include "../src/ffmpeg_videosamples.hpp"
+#include "gst_helper.hpp"
+#include "gst_recording_demuxer.h"
+#include "openhd_test_check.hpp"
+#include "openhd_util.h"
+#include "openhd_util_filesystem.h"
+#include "openhd_util_time.hpp"
+
+// Benchmarks demuxing air recordings (.mkv to .mp4) on a synthetic 10 minute recording (720p60 h264 test frame):
+// 1) Per file gst-launch-1.0 process (how it was done before)
+// 2) The in process worker pool, with 1 and 2 workers
+// And checks interrupted jobs are resumed, the raw .rtp recordings (pre-roll) are remuxed too, and how long writing
+// fragmented .mp4 directly (no demuxing) takes.
+
+static constexpr auto TEST_DIRECTORY="/tmp/openhd_test_remux/";
+static constexpr int N_FRAMES=10*60*60;
+
+enum class SyntheticFormat{MKV,FRAGMENTED_MP4,RTP};
+
+static void write_synthetic_recording(const std::string& filename,SyntheticFormat format){
+  std::stringstream ss;
+  ss<<"appsrc name=src format=time block=true ! h264parse ! ";
+  if(format==SyntheticFormat::MKV){
+    ss<<"matroskamux";
+  }else if(format==SyntheticFormat::FRAGMENTED_MP4){
+    ss<<"mp4mux fragment-duration=1000";
+  }else{
+    // Like the PrerollRingRecorder writes it (RFC 4571)
+    ss<<"rtph264pay config-interval=-1 mtu=1440 ! rtpstreampay";
+  }
+  ss<<" ! filesink location="<<filename;
+  GError* error=nullptr;
+  GstElement* pipeline=gst_parse_launch(ss.str().c_str(),&error);
+  OHD_TEST_CHECK(error==nullptr);
+  GstElement* appsrc=gst_bin_get_by_name(GST_BIN(pipeline),"src");
+  GstCaps* caps=gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au,width=1280,height=720,framerate=60/1");
+  g_object_set(appsrc,"caps",caps,nullptr);
+  gst_caps_unref(caps);
+  gst_element_set_state(pipeline,GST_STATE_PLAYING);
+  for(int i=0;i<N_FRAMES;i++){
+    GstBuffer* buffer=gst_buffer_new_allocate(nullptr,sizeof(k_H264TestFrame),nullptr);
+    gst_buffer_fill(buffer,0,k_H264TestFrame,sizeof(k_H264TestFrame));
+    GST_BUFFER_PTS(buffer)=gst_util_uint64_scale(i,GST_SECOND,60);
+    GST_BUFFER_DTS(buffer)=GST_BUFFER_PTS(buffer);
+    GST_BUFFER_DURATION(buffer)=gst_util_uint64_scale(1,GST_SECOND,60);
+    GstFlowReturn ret;
+    g_signal_emit_by_name(appsrc,"push-buffer",buffer,&ret);
+    gst_buffer_unref(buffer);
+    OHD_TEST_CHECK(ret==GST_FLOW_OK);
+  }
+  GstFlowReturn ret;
+  g_signal_emit_by_name(appsrc,"end-of-stream",&ret);
+  GstBus* bus=gst_element_get_bus(pipeline);
+  GstMessage* msg=gst_bus_timed_pop_filtered(bus,GST_CLOCK_TIME_NONE,static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  OHD_TEST_CHECK(GST_MESSAGE_TYPE(msg)==GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+  gst_element_set_state(pipeline,GST_STATE_NULL);
+  gst_object_unref(appsrc);
+  gst_object_unref(pipeline);
+}
+
+static std::string create_copy(const std::string& source,int index){
+  const std::string ret=std::string(TEST_DIRECTORY)+"recording"+std::to_string(index)+".mkv";
+  std::filesystem::copy_file(source,ret,std::filesystem::copy_options::overwrite_existing);
+  return ret;
+}
+
+static std::string as_mp4(const std::string& mkv_file){
+  return mkv_file.substr(0,mkv_file.size()-4)+".mp4";
+}
+
+static void benchmark_gst_launch(const std::string& source){
+  const auto in_file=create_copy(source,100);
+  const auto before=std::chrono::steady_clock::now();
+  OHDUtil::run_command("gst-launch-1.0",{"filesrc location="+in_file+" ! matroskademux ! qtmux ! filesink location="+as_mp4(in_file)},false);
+  std::cout<<"gst-launch-1.0 process, 1 file: "<<openhd::util::time::R(std::chrono::steady_clock::now()-before)<<"\n";
+  OHD_TEST_CHECK(OHDFilesystemUtil::get_file_size_bytes(as_mp4(in_file))>0);
+}
+
+static void benchmark_pool(const std::string& source,int n_workers,int n_files){
+  std::vector<std::string> files;
+  for(int i=0;i<n_files;i++){
+    files.push_back(create_copy(source,i));
+  }
+  GstRecordingDemuxer demuxer(n_workers);
+  const auto before=std::chrono::steady_clock::now();
+  for(const auto& file:files){
+    demuxer.demux_file_async_threadsafe(file);
+  }
+  while (!demuxer.wait_until_idle(std::chrono::seconds(1))){
+    std::cout<<demuxer.get_status()<<"\n";
+  }
+  std::cout<<"In process, "<<n_workers<<" worker(s), "<<n_files<<" files: "
+           <<openhd::util::time::R(std::chrono::steady_clock::now()-before)<<" "<<demuxer.get_status()<<"\n";
+  OHD_TEST_CHECK(demuxer.get_n_done_jobs()==n_files);
+  for(const auto& file:files){
+    OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file));
+    OHD_TEST_CHECK(OHDFilesystemUtil::get_file_size_bytes(as_mp4(file))>0);
+    OHDFilesystemUtil::remove_if_existing(as_mp4(file));
+  }
+}
+
+static void test_resume(const std::string& source){
+  const auto file=create_copy(source,200);
+  {
+    // Destroyed while demuxing (e.g. on shutdown)
+    GstRecordingDemuxer demuxer(1);
+    demuxer.demux_file_async_threadsafe(file);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  // Either aborted (only the .mkv is left) or already done - never a partial .mp4
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(as_mp4(file)+".part"));
+  OHD_TEST_CHECK(OHDFilesystemUtil::exists(file)!=OHDFilesystemUtil::exists(as_mp4(file)));
+  std::cout<<"Interrupted, .mkv "<<(OHDFilesystemUtil::exists(file) ? "kept" : "already demuxed")<<"\n";
+  if(!OHDFilesystemUtil::exists(file)){
+    create_copy(source,200);
+    OHDFilesystemUtil::remove_if_existing(as_mp4(file));
+  }
+  {
+    GstRecordingDemuxer demuxer(1);
+    demuxer.demux_file_async_threadsafe(file);
+    // Only once - a second job would fail, since the .mkv is gone after the first one
+    demuxer.demux_file_async_threadsafe(file);
+    OHD_TEST_CHECK(demuxer.wait_until_idle(std::chrono::minutes(5)));
+    std::cout<<"Resumed "<<demuxer.get_status()<<"\n";
+    OHD_TEST_CHECK(demuxer.get_n_done_jobs()==1);
+    OHD_TEST_CHECK(demuxer.get_n_failed_jobs()==0);
+  }
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file));
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(as_mp4(file)+".part"));
+  OHD_TEST_CHECK(OHDFilesystemUtil::get_file_size_bytes(as_mp4(file))>0);
+  // Interrupted after the .mp4 was written, but before the .mkv was deleted
+  create_copy(source,200);
+  {
+    GstRecordingDemuxer demuxer(1);
+    demuxer.demux_file_async_threadsafe(file);
+    OHD_TEST_CHECK(demuxer.wait_until_idle(std::chrono::minutes(5)));
+    OHD_TEST_CHECK(demuxer.get_n_done_jobs()==1);
+    OHD_TEST_CHECK(demuxer.get_n_failed_jobs()==0);
+  }
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file));
+  OHD_TEST_CHECK(OHDFilesystemUtil::get_file_size_bytes(as_mp4(file))>0);
+  std::cout<<"Resume OK\n";
+}
+
+// The raw rtp recordings of the PrerollRingRecorder are remuxed to .mp4 too
+static void test_remux_rtp(){
+  const std::string file=std::string(TEST_DIRECTORY)+"recording300.h264.rtp";
+  const std::string mp4_file=std::string(TEST_DIRECTORY)+"recording300.mp4";
+  write_synthetic_recording(file,SyntheticFormat::RTP);
+  const auto rtp_size=OHDFilesystemUtil::get_file_size_bytes(file);
+  OHD_TEST_CHECK(rtp_size>0);
+  // Still being recorded - not picked up
+  const std::string part_file=std::string(TEST_DIRECTORY)+"recording301.h264.rtp.part";
+  std::filesystem::copy_file(file,part_file);
+  GstRecordingDemuxer demuxer(1);
+  const auto before=std::chrono::steady_clock::now();
+  demuxer.demux_file_async_threadsafe(part_file);
+  demuxer.demux_file_async_threadsafe(file);
+  OHD_TEST_CHECK(demuxer.wait_until_idle(std::chrono::minutes(5)));
+  std::cout<<"Remuxed 10min .h264.rtp ("<<rtp_size/1024<<"KB) in "
+           <<openhd::util::time::R(std::chrono::steady_clock::now()-before)<<" "<<demuxer.get_status()<<"\n";
+  OHD_TEST_CHECK(demuxer.get_n_done_jobs()==1);
+  OHD_TEST_CHECK(demuxer.get_n_failed_jobs()==0);
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(file));
+  OHD_TEST_CHECK(!OHDFilesystemUtil::exists(mp4_file+".part"));
+  OHD_TEST_CHECK(OHDFilesystemUtil::get_file_size_bytes(mp4_file)>0);
+  OHD_TEST_CHECK(OHDFilesystemUtil::exists(part_file));
+  std::cout<<"Remux rtp OK\n";
+}
+
+int main(int argc, char *argv[]) {
+  OHDGstHelper::initGstreamerOrThrow();
+  OHDFilesystemUtil::safe_delete_directory(TEST_DIRECTORY);
+  OHDFilesystemUtil::create_directories(TEST_DIRECTORY);
+  const std::string source=std::string(TEST_DIRECTORY)+"source.mkv";
+  auto before=std::chrono::steady_clock::now();
+  write_synthetic_recording(source,SyntheticFormat::MKV);
+  std::cout<<"Wrote 10min .mkv ("<<OHDFilesystemUtil::get_file_size_bytes(source)/1024<<"KB) in "
+           <<openhd::util::time::R(std::chrono::steady_clock::now()-before)<<"\n";
+  const std::string source_fragmented_mp4=std::string(TEST_DIRECTORY)+"source_fragmented.mp4";
+  before=std::chrono::steady_clock::now();
+  write_synthetic_recording(source_fragmented_mp4,SyntheticFormat::FRAGMENTED_MP4);
+  std::cout<<"Wrote 10min fragmented .mp4 ("<<OHDFilesystemUtil::get_file_size_bytes(source_fragmented_mp4)/1024<<"KB) in "
+           <<openhd::util::time::R(std::chrono::steady_clock::now()-before)<<" (no demuxing needed)\n";
+  benchmark_gst_launch(source);
+  benchmark_pool(source,1,1);
+  benchmark_pool(source,1,3);
+  benchmark_pool(source,2,3);
+  test_resume(source);
+  test_remux_rtp();
+  OHDFilesystemUtil::safe_delete_directory(TEST_DIRECTORY);
+  std::cout<<"Done\n";
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/ffmpeg_videosamples.hpp"
+#include "udp_batch_forwarder.h"
+
+// Microbenchmark: replay the embedded sample frame(s) as rtp fragments to N localhost destinations,
+// once with one sendto per packet per destination (what SocketHelper::UDPMultiForwarder does)
+// and once with the batched (sendmmsg / GSO) forwarder.
+
+static constexpr int BASE_PORT=6600;
+static constexpr int N_DESTINATIONS=4;
+static constexpr int N_FRAMES=2000;
+// ~8MBit/s at 30fps
+static constexpr size_t FRAME_SIZE=32*1024;
+static constexpr size_t RTP_PAYLOAD_SIZE=1012;
+
+// Not a valid rtp h264 stream, but the same packet sizes / marker bits as one
+static std::vector<std::vector<uint8_t>> create_rtp_fragments_for_frame(const uint8_t* sample,size_t sample_size,uint16_t& seq_nr){
+  std::vector<uint8_t> frame;
+  while (frame.size()<FRAME_SIZE){
+    const size_t n=std::min(sample_size,FRAME_SIZE-frame.size());
+    frame.insert(frame.end(),sample,sample+n);
+  }
+  std::vector<std::vector<uint8_t>> ret;
+  for(size_t offset=0;offset<frame.size();offset+=RTP_PAYLOAD_SIZE){
+    const size_t n=std::min(RTP_PAYLOAD_SIZE,frame.size()-offset);
+    const bool last=offset+n>=frame.size();
+    std::vector<uint8_t> packet(12+n);
+    packet[0]=0x80;
+    packet[1]=(last ? 0x80 : 0x00) | 96;
+    packet[2]=seq_nr >> 8;
+    packet[3]=seq_nr & 0xFF;
+    seq_nr++;
+    std::memcpy(packet.data()+12,frame.data()+offset,n);
+    ret.push_back(packet);
+  }
+  return ret;
+}
+
+struct Receiver{
+  int fd;
+  std::atomic<uint64_t> n_packets=0;
+  std::atomic<bool> run=true;
+  std::unique_ptr<std::thread> thread;
+  explicit Receiver(int port){
+    fd=socket(AF_INET,SOCK_DGRAM,0);
+    int rcvbuf=8*1024*1024;
+    setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&rcvbuf,sizeof(rcvbuf));
+    timeval tv{0,100*1000};
+    setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    sockaddr_in addr{};
+    addr.sin_family=AF_INET;
+    addr.sin_port=htons(port);
+    addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+    bind(fd,(sockaddr*)&addr,sizeof(addr));
+    thread=std::make_unique<std::thread>([this](){
+      uint8_t buff[65536];
+      while (run){
+        if(recv(fd,buff,sizeof(buff),0)>0)n_packets++;
+      }
+    });
+  }
+  ~Receiver(){
+    run=false;
+    thread->join();
+    close(fd);
+  }
+};
+
+static void run_sendto_baseline(const std::vector<std::vector<uint8_t>>& packets){
+  const int fd=socket(AF_INET,SOCK_DGRAM,0);
+  std::vector<sockaddr_in> destinations;
+  for(int i=0;i<N_DESTINATIONS;i++){
+    sockaddr_in addr{};
+    addr.sin_family=AF_INET;
+    addr.sin_port=htons(BASE_PORT+i);
+    inet_pton(AF_INET,"127.0.0.1",&addr.sin_addr);
+    destinations.push_back(addr);
+  }
+  uint64_t n_syscalls=0;
+  const auto begin=std::chrono::steady_clock::now();
+  for(const auto& packet:packets){
+    for(const auto& addr:destinations){
+      sendto(fd,packet.data(),packet.size(),0,(const sockaddr*)&addr,sizeof(addr));
+      n_syscalls++;
+    }
+  }
+  const auto delta=std::chrono::steady_clock::now()-begin;
+  std::cout<<"sendto:  "<<std::chrono::duration_cast<std::chrono::microseconds>(delta).count()/1000.0f
+           <<"ms, syscalls:"<<n_syscalls<<"\n";
+  close(fd);
+}
+
+static void run_batched(const std::vector<std::vector<uint8_t>>& packets,bool enable_gso){
+  openhd::UDPBatchForwarder::Options options{};
+  options.enable_gso=enable_gso;
+  openhd::UDPBatchForwarder forwarder{options};
+  for(int i=0;i<N_DESTINATIONS;i++){
+    forwarder.addForwarder("127.0.0.1",BASE_PORT+i);
+  }
+  const auto begin=std::chrono::steady_clock::now();
+  for(const auto& packet:packets){
+    forwarder.forwardPacketViaUDP(packet.data(),packet.size());
+  }
+  forwarder.flush();
+  const auto delta=std::chrono::steady_clock::now()-begin;
+  uint64_t n_syscalls=0;
+  for(const auto& stats:forwarder.get_destination_stats()){
+    n_syscalls+=stats.n_syscalls;
+  }
+  std::cout<<(forwarder.is_gso_active() ? "mmsg+gso:" : "mmsg:    ")<<std::chrono::duration_cast<std::chrono::microseconds>(delta).count()/1000.0f
+           <<"ms, syscalls:"<<n_syscalls<<"\n";
+  std::cout<<forwarder.get_stats_string()<<"\n";
+}
+
+int main(int argc, char *argv[]) {
+  uint16_t seq_nr=0;
+  std::vector<std::vector<uint8_t>> packets;
+  for(int i=0;i<N_FRAMES;i++){
+    auto frame_packets= create_rtp_fragments_for_frame(k_H264TestFrame,sizeof(k_H264TestFrame),seq_nr);
+    packets.insert(packets.end(),frame_packets.begin(),frame_packets.end());
+  }
+  std::cout<<"Replaying "<<N_FRAMES<<" frames, "<<packets.size()<<" packets to "<<N_DESTINATIONS<<" destinations\n";
+  std::vector<std::unique_ptr<Receiver>> receivers;
+  for(int i=0;i<N_DESTINATIONS;i++){
+    receivers.push_back(std::make_unique<Receiver>(BASE_PORT+i));
+  }
+  const auto print_received=[&receivers](){
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    std::cout<<"received by first destination:"<<receivers.at(0)->n_packets<<"\n";
+    for(auto& receiver:receivers)receiver->n_packets=0;
+  };
+  run_sendto_baseline(packets);
+  print_received();
+  run_batched(packets,false);
+  print_received();
+  run_batched(packets,true);
+  print_received();
+  return 0;
+}